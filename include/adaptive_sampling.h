@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include "light_sensor.h"
+#include "signal_processor.h"
+
+namespace LightSensor {
+
+/**
+ * @brief Backs polled sampling off while the light level is steady
+ *
+ * Starts at the configured sample_rate_ms / oversampling. Each run of
+ * STABLE_READINGS_TO_RELAX steady readings doubles the interval (up to
+ * max_sample_rate_ms) and drops one oversampling step (down to
+ * min_oversampling). A peak, an outlier, a confident trend or a move of
+ * more than adaptive_change_threshold from the settled level restores the
+ * full rate at once.
+ */
+class AdaptiveSamplingController {
+public:
+    static const uint8_t STABLE_READINGS_TO_RELAX = 5;
+
+    explicit AdaptiveSamplingController(const SensorConfig& config);
+
+    void configure(const SensorConfig& config);
+
+    /**
+     * @brief Feed the analysis of the latest reading
+     * @return true if the sample rate or oversampling changed
+     */
+    bool update(const SignalAnalysis& analysis);
+
+    /**
+     * @brief Return to the full configured rate
+     */
+    void reset();
+
+    uint32_t getSampleRateMs() const;
+    uint8_t getOversampling() const;
+
+    /**
+     * @brief Check if the controller is running below the full rate
+     */
+    bool isRelaxed() const;
+
+private:
+    uint32_t fast_rate_ms_;
+    uint32_t slow_rate_ms_;
+    uint8_t max_oversampling_;
+    uint8_t min_oversampling_;
+    float change_threshold_;
+
+    uint32_t sample_rate_ms_;
+    uint8_t oversampling_;
+    uint8_t stable_count_;
+    float settled_value_;
+    bool has_settled_value_;
+
+    bool isChange(const SignalAnalysis& analysis) const;
+};
+
+}  // namespace LightSensor
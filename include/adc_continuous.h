@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+// Maximum number of ADC1 channels in one conversion pattern (GPIO 32-39)
+static const size_t MAX_ADC_CHANNELS = 8;
+
+/**
+ * @brief Wrapper around the ESP32 continuous (DMA) ADC driver
+ *
+ * The driver converts the configured ADC1 channels in hardware and fills
+ * an internal ring of raw samples in the background. read() drains whatever
+ * is available without blocking, so the caller never waits on conversions.
+ */
+class ContinuousADC {
+public:
+    ContinuousADC();
+    ~ContinuousADC();
+
+    /**
+     * @brief Start continuous conversion
+     * @param pins ADC1 GPIO pins to convert, in pattern order
+     * @param pin_count Number of pins (1 - MAX_ADC_CHANNELS)
+     * @param sample_rate_hz Conversion rate per pattern entry
+     * @return true if the driver was started
+     */
+    bool begin(const uint8_t* pins, size_t pin_count, uint32_t sample_rate_hz);
+
+    /**
+     * @brief Stop conversion and release the driver
+     */
+    void end();
+
+    /**
+     * @brief Drain available samples without blocking
+     * @param codes Output 12-bit ADC codes
+     * @param slots Output pattern slot (index into the pins passed to begin), may be nullptr
+     * @param max_samples Capacity of the output arrays
+     * @return Number of samples written
+     */
+    size_t read(uint16_t* codes, uint8_t* slots, size_t max_samples);
+
+    bool isRunning() const;
+
+    /**
+     * @brief Actual hardware conversion rate (may exceed the requested rate)
+     */
+    uint32_t getHardwareRateHz() const;
+
+    /**
+     * @brief Per-channel rate begin() would run the hardware at
+     * @param sample_rate_hz Requested conversion rate per pattern entry
+     * @param pin_count Number of pins in the pattern
+     */
+    static uint32_t hardwareRateFor(uint32_t sample_rate_hz, size_t pin_count);
+
+    /**
+     * @brief Hardware codes averaged into one reading at the requested rate
+     * @param hardware_rate_hz Per-channel hardware rate
+     * @param sample_rate_hz Requested reading rate
+     * @return Decimation factor (at least 1)
+     */
+    static uint32_t decimationFor(uint32_t hardware_rate_hz, uint32_t sample_rate_hz);
+
+private:
+    static const size_t FRAME_BYTES = 256;
+
+    bool is_running_;
+    uint32_t hardware_rate_hz_;
+    size_t pin_count_;
+    uint8_t channel_to_slot_[16];
+
+    // Raw DMA frame bytes not yet decoded
+    uint8_t frame_[FRAME_BYTES];
+    size_t frame_len_;
+    size_t frame_pos_;
+};
+
+}  // namespace LightSensor
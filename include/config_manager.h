@@ -4,6 +4,8 @@
 #include "power_manager.h"
 #include "data_logger.h"
 #include "signal_processor.h"
+#include "uplink.h"
+#include "static_arena.h"
 #include <cstdint>
 #include <functional>
 
@@ -15,6 +17,26 @@ static const size_t MAX_VERSION_LEN = 16;
 static const size_t MAX_PATH_LEN = 64;
 static const size_t MAX_METHOD_LEN = 32;
 
+// Static arena for JSON documents (config.json is at most 4 KB)
+static const size_t JSON_ARENA_SIZE = 12288;
+
+/**
+ * @brief Dual-core pipeline runtime configuration
+ *
+ * When enabled, an acquisition task samples the sensor on one core and hands
+ * readings over a lock-free queue to a processing task (signal processing and
+ * logging) on the other core.
+ */
+struct PipelineConfig {
+    bool enabled;
+    uint8_t acquisition_core;
+    uint8_t processing_core;
+    uint8_t acquisition_priority;
+    uint8_t processing_priority;
+    uint32_t acquisition_stack_size;
+    uint32_t processing_stack_size;
+};
+
 /**
  * @brief System configuration structure
  */
@@ -31,10 +53,17 @@ struct SystemConfig {
     // Signal processing configuration
     SignalConfig signal;
     
+    // Task layout configuration
+    PipelineConfig pipeline;
+    
+    // Network uplink configuration
+    UplinkConfig uplink;
+    
     // System settings
     char device_id[MAX_DEVICE_ID_LEN];
     char firmware_version[MAX_VERSION_LEN];
     bool enable_debug_mode;
+    bool enable_async_logging;  // Format and write log messages from a background task
     uint32_t system_timeout_ms;
     bool enable_watchdog;
     uint32_t watchdog_timeout_ms;
@@ -64,11 +93,49 @@ struct ConfigValidation {
     char last_warning[64];
 };
 
+/**
+ * @brief Top-level groups of SystemConfig
+ */
+enum class ConfigSection : uint8_t {
+    SYSTEM,     // device_id, enable_debug_mode, ...
+    SENSOR,
+    POWER,
+    LOGGER,
+    SIGNAL,
+    PIPELINE,
+    UPLINK
+};
+
+static const size_t CONFIG_SECTION_COUNT = 7;
+
+/**
+ * @brief Fields that differ between two configurations
+ *
+ * One bit per field within its section. Fields are named by their JSON
+ * path, e.g. "sensor.adc_pin" or "enable_debug_mode".
+ */
+struct ConfigDiff {
+    uint32_t fields[CONFIG_SECTION_COUNT];
+    
+    bool any() const;
+    bool changed(ConfigSection section) const;
+    bool changed(const char* key) const;
+    uint8_t count() const;
+};
+
 /**
  * @brief Configuration change callback
  */
 using ConfigChangeCallback = std::function<void(const char*, const char*)>;
 
+/**
+ * @brief Called after updateConfig() stores a changed configuration
+ *
+ * Receives the new configuration and the fields that changed, so each
+ * component can be retuned in place instead of being re-created.
+ */
+using ConfigApplyCallback = std::function<void(const SystemConfig&, const ConfigDiff&)>;
+
 /**
  * @brief ESP32 Configuration manager with SPIFFS and ArduinoJson
  */
@@ -103,6 +170,11 @@ public:
     
     /**
      * @brief Update system configuration
+     *
+     * Saves and applies only when some field differs: every changed field
+     * is reported to the change callback, then the diff goes to the apply
+     * callback.
+     *
      * @param config New configuration
      * @return true if update successful
      */
@@ -149,6 +221,20 @@ public:
      */
     void setConfigChangeCallback(ConfigChangeCallback callback);
     
+    /**
+     * @brief Set the callback that applies an updated configuration
+     * @param callback Function to call with the new config and its diff
+     */
+    void setConfigApplyCallback(ConfigApplyCallback callback);
+    
+    /**
+     * @brief Compare two configurations field by field
+     * @param from Current configuration
+     * @param to New configuration
+     * @return Fields whose value differs
+     */
+    static ConfigDiff diffConfig(const SystemConfig& from, const SystemConfig& to);
+    
     /**
      * @brief Get default configuration
      * @return Default system configuration
@@ -161,30 +247,48 @@ public:
      */
     static CalibrationData getDefaultCalibrationData();
     
+    /**
+     * @brief Arena JSON documents are parsed and built in (for the memory report)
+     */
+    static const StaticArena& getJsonArena();
+    
     /**
      * @brief Check if SPIFFS is available
      * @return true if SPIFFS is mounted
      */
     bool isStorageAvailable() const;
     
+    /**
+     * @brief Check if initialize() used the RTC snapshot instead of parsing JSON
+     * @return true if the configuration came from the snapshot
+     */
+    bool isRestoredFromSnapshot() const;
+    
 private:
     char config_file_path_[MAX_PATH_LEN];
     char calibration_file_path_[MAX_PATH_LEN];
     SystemConfig config_;
     CalibrationData calibration_data_;
     ConfigChangeCallback config_change_callback_;
+    ConfigApplyCallback config_apply_callback_;
     bool spiffs_initialized_;
+    bool restored_from_snapshot_;
     
     bool initializeSPIFFS();
-    bool parseJsonConfig(const char* json);
+    bool parseJsonConfig(File& input);
     bool generateJsonConfig(char* buffer, size_t buffer_size) const;
     bool loadCalibration();
     bool saveCalibration();
+    bool restoreSnapshot(uint32_t config_hash, uint32_t calibration_hash);
+    bool loadSecrets();
+    void storeSnapshot();
     
     ConfigValidation validateSensorConfig(const SensorConfig& sensor_config) const;
     ConfigValidation validatePowerConfig(const PowerConfig& power_config) const;
     ConfigValidation validateLoggerConfig(const LoggerConfig& logger_config) const;
     ConfigValidation validateSignalConfig(const SignalConfig& signal_config) const;
+    ConfigValidation validatePipelineConfig(const PipelineConfig& pipeline_config) const;
+    ConfigValidation validateUplinkConfig(const UplinkConfig& uplink_config) const;
     
     void notifyConfigChange(const char* key, const char* value);
 };
@@ -1,15 +1,97 @@
 #pragma once
 
 #include "light_sensor.h"
+#include "log_format.h"
+#include "log_compressor.h"
+#include "exception_filter.h"
+#include "event_detector.h"
+#include "spsc_ring_buffer.h"
 #include <cstdint>
 #include <functional>
 #include <FS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 
 namespace LightSensor {
 
 // Maximum path length for log files
 static const size_t MAX_LOG_PATH_LEN = 64;
 
+/**
+ * @brief Where DataLogger keeps readings on flash
+ */
+enum class StorageBackend {
+    FILES,      // SPIFFSDataStorage: one file per boot/rotation, CSV or binary
+    SEGMENTS,   // SegmentDataStorage: fixed-size indexed segments with range queries
+    LITTLEFS    // SegmentDataStorage on its own LittleFS partition, written in whole flash pages
+};
+
+/**
+ * @brief Callback for stored readings returned by a range query
+ * @param time_ms Monotonic log time of the reading (ms)
+ * @param reading Reading (timestamp_ms holds the low 32 bits of time_ms)
+ * @return false to stop the query
+ */
+using QueryCallback = std::function<bool(uint64_t time_ms, const SensorReading& reading)>;
+
+/**
+ * @brief Resolution of a rollup tier
+ */
+enum class RollupTier : uint8_t {
+    MINUTE,
+    HOUR
+};
+
+static const size_t ROLLUP_TIER_COUNT = 2;
+
+/**
+ * @brief Lux summary of the readings in one time bucket
+ */
+struct RollupBucket {
+    uint64_t start_time_ms;   // Log time the bucket starts at (multiple of the tier length)
+    uint32_t count;           // Readings in the bucket (0 = empty)
+    float min_lux;
+    float max_lux;
+    float mean_lux;
+};
+
+/**
+ * @brief Callback for buckets returned by a rollup query
+ * @return false to stop the query
+ */
+using RollupCallback = std::function<bool(const RollupBucket& bucket)>;
+
+class RollupStore;
+struct SegmentSummary;
+
+static const uint32_t EVENT_LOG_MAGIC = 0x4556534C;   // "LSVE" little-endian
+static const uint16_t EVENT_LOG_VERSION = 1;
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Event log file header, followed by EventLogRecord entries
+ */
+struct EventLogHeader {
+    uint32_t magic;             // EVENT_LOG_MAGIC
+    uint16_t version;           // EVENT_LOG_VERSION
+    uint16_t record_size;       // sizeof(EventLogRecord)
+};
+
+/**
+ * @brief One LightEvent as stored
+ */
+struct EventLogRecord {
+    uint32_t timestamp_ms;      // Reading timestamp, as in the reading log
+    uint8_t type;               // LightEventType
+    float lux;
+    float value;
+};
+
+#pragma pack(pop)
+
 /**
  * @brief Data logging configuration
  */
@@ -18,8 +100,11 @@ struct LoggerConfig {
     char log_file_path[MAX_LOG_PATH_LEN];
     size_t buffer_size;
     size_t flush_threshold;
-    bool enable_compression;
+    bool enable_compression;  // Store compressed blocks (implies a binary file)
     bool enable_timestamp;
+    LogFormat log_format;     // CSV text or packed binary records
+    bool enable_async_flush;  // Write to flash from a background task
+    StorageBackend storage_backend;
     
     // Data filtering
     float min_lux_threshold;
@@ -31,6 +116,19 @@ struct LoggerConfig {
     size_t max_file_size_bytes;
     uint32_t max_log_days;
     bool enable_rotation;
+    
+    // MemoryDataStorage readings (0 = buffer_size, at most MemoryDataStorage::MAX_BUFFER_SIZE)
+    size_t history_size;
+    
+    // Per-minute and per-hour summaries, each kept for its own number of days
+    bool enable_rollups;
+    uint32_t rollup_minute_days;
+    uint32_t rollup_hour_days;
+    
+    // Report-by-exception: store only corridor ends or deadband changes
+    ExceptionMode exception_mode;
+    float exception_deviation_lux;    // Allowed reconstruction error
+    uint32_t exception_max_interval_ms; // Longest gap between stored readings (0 = none)
 };
 
 /**
@@ -46,6 +144,10 @@ struct DataStats {
     float std_deviation;
     uint32_t buffer_overflow_count;
     size_t current_buffer_size;
+    uint32_t write_error_count;       // Failed writes; a dropped batch counts each reading in it
+    uint32_t storage_write_time_us;   // Time spent in storage writes (free-running, wraps)
+    uint32_t exception_readings;      // Accepted readings the exception filter held or dropped
+    uint32_t event_count;             // Events passed to logEvent()
 };
 
 /**
@@ -56,9 +158,51 @@ public:
     virtual ~IDataStorage() = default;
     virtual bool initialize() = 0;
     virtual bool write(const SensorReading& data) = 0;
+    virtual bool writeBatch(const SensorReading* data, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!write(data[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
     virtual bool flush() = 0;
+    
+    /**
+     * @brief Like flush(), but also write what the backend keeps staged in RAM
+     * to spare flash wear (SegmentDataStorage's partial page); call before RAM is lost
+     */
+    virtual bool sync() { return flush(); }
     virtual void close() = 0;
     virtual size_t getAvailableSpace() const = 0;
+    
+    /**
+     * @brief Record the sensor calibration used for stored readings
+     * @param sensor Sensor configuration in effect
+     */
+    virtual void setCalibration(const SensorConfig& sensor) {}
+    
+    /**
+     * @brief Apply new logger settings without reopening storage
+     * @param config New logger configuration
+     * @return false if the change needs the storage re-created
+     */
+    virtual bool configure(const LoggerConfig& config) { return false; }
+    
+    /**
+     * @brief Readings writeBatch() skipped because they could not be encoded
+     * @return Count since the previous call (reset on read)
+     */
+    virtual uint32_t takeSkippedCount() { return 0; }
+    
+    /**
+     * @brief Deliver stored readings in a time range, oldest first
+     * @param from_ms Start of the range (log time, inclusive)
+     * @param to_ms End of the range (log time, inclusive)
+     * @param callback Function called per reading
+     * @return Number of readings delivered (0 if the backend has no index)
+     */
+    virtual size_t query(uint64_t from_ms, uint64_t to_ms, const QueryCallback& callback) { return 0; }
 };
 
 /**
@@ -71,49 +215,206 @@ public:
     
     bool initialize() override;
     bool write(const SensorReading& data) override;
+    bool writeBatch(const SensorReading* data, size_t count) override;
     bool flush() override;
     void close() override;
     size_t getAvailableSpace() const override;
+    void setCalibration(const SensorConfig& sensor) override;
+    bool configure(const LoggerConfig& config) override;
+    uint32_t takeSkippedCount() override;
+    
+    /**
+     * @brief Encode one reading as it is written to the file
+     * @param reading Reading to encode
+     * @param buffer Output buffer (CSV line or binary records)
+     * @param buffer_size Buffer size (at least MAX_ENCODED_READING_SIZE for binary)
+     * @return Bytes written, or 0 if the buffer is too small
+     */
+    size_t encodeReading(const SensorReading& reading, char* buffer, size_t buffer_size);
     
 private:
+    static const size_t WRITE_CHUNK_SIZE = 1024;
+    
     LoggerConfig config_;
     File log_file_;
     char current_file_path_[MAX_LOG_PATH_LEN];
     size_t current_file_size_;
     bool is_initialized_;
     
+    // Binary format state
+    BinaryRecordEncoder encoder_;
+    float reference_voltage_;
+    float dark_offset_;
+    float sensitivity_;
+    
+    // Readings waiting to be compressed as one block
+    SensorReading pending_[COMPRESSION_BLOCK_SIZE];
+    size_t pending_count_;
+    
+    // Readings writeBatch() could not encode (e.g. a CSV line over the limit)
+    uint32_t skipped_count_;
+    
     bool createNewLogFile();
+    bool appendPending(const SensorReading& reading);
+    bool compressPending();
+    bool writeChunk(const char* data, size_t length);
     bool needsRotation() const;
+    bool rotateIfNeeded();
     bool rotateLogFile();
-    void formatReading(const SensorReading& reading, char* buffer, size_t buffer_size) const;
+    int formatReading(const SensorReading& reading, char* buffer, size_t buffer_size) const;
+};
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Packed reading kept by MemoryDataStorage (11 bytes, SensorReading is 20)
+ *
+ * voltage is not stored; it is raw_value * reference_voltage on decode.
+ */
+struct CompactReading {
+    uint32_t timestamp_ms;
+    uint16_t raw_code;          // raw_value quantised to 16 bits
+    float lux;
+    uint8_t quality;            // Signal quality (0-100), COMPACT_INVALID_FLAG if !is_valid
+};
+
+#pragma pack(pop)
+
+static const uint8_t COMPACT_INVALID_FLAG = 0x80;
+
+/**
+ * @brief Run of readings that is contiguous in memory
+ */
+struct CompactSpan {
+    const CompactReading* data;
+    size_t size;
+    
+    const CompactReading* begin() const { return data; }
+    const CompactReading* end() const { return data + size; }
+};
+
+/**
+ * @brief Readings held by MemoryDataStorage, oldest first, read in place
+ *
+ * The ring wraps at most once, so the readings are two spans back to back.
+ * Walk them with range-for over the view, or span by span for tight loops.
+ */
+class HistoryView {
+public:
+    class Iterator {
+    public:
+        Iterator(const CompactReading* position, const CompactReading* jump_from, const CompactReading* jump_to)
+            : position_(position), jump_from_(jump_from), jump_to_(jump_to) {}
+        
+        const CompactReading& operator*() const { return *position_; }
+        const CompactReading* operator->() const { return position_; }
+        
+        Iterator& operator++() {
+            // Step from the end of the first span to the start of the second
+            if (++position_ == jump_from_) {
+                position_ = jump_to_;
+            }
+            return *this;
+        }
+        
+        bool operator==(const Iterator& other) const { return position_ == other.position_; }
+        bool operator!=(const Iterator& other) const { return position_ != other.position_; }
+        
+    private:
+        const CompactReading* position_;
+        const CompactReading* jump_from_;
+        const CompactReading* jump_to_;
+    };
+    
+    HistoryView();
+    HistoryView(const CompactSpan& first, const CompactSpan& second, float reference_voltage);
+    
+    size_t size() const { return first_.size + second_.size; }
+    bool empty() const { return size() == 0; }
+    
+    /**
+     * @brief Oldest (0) or newest (1) span
+     */
+    const CompactSpan& span(size_t index) const { return index == 0 ? first_ : second_; }
+    
+    const CompactReading& operator[](size_t index) const {
+        return index < first_.size ? first_.data[index] : second_.data[index - first_.size];
+    }
+    
+    Iterator begin() const;
+    Iterator end() const;
+    
+    /**
+     * @brief Expand a stored reading with the calibration it was taken under
+     */
+    SensorReading decode(const CompactReading& reading) const;
+    
+private:
+    CompactSpan first_;
+    CompactSpan second_;
+    float reference_voltage_;
 };
 
 /**
  * @brief Memory-based circular buffer storage
+ *
+ * Readings are kept as CompactReading in one ring allocated by initialize().
+ * Its size is history_size readings (at most MAX_HISTORY_SIZE; or buffer_size,
+ * at most MAX_BUFFER_SIZE, when that is 0), rounded up to a power of two for
+ * masked indexing. The ring goes into PSRAM when the board has it; without
+ * PSRAM it is limited to MAX_INTERNAL_SIZE readings of internal RAM. If the
+ * allocation fails, the size is halved until it fits.
  */
 class MemoryDataStorage : public IDataStorage {
 public:
-    static const size_t MAX_BUFFER_SIZE = 100;
+    static const size_t MAX_BUFFER_SIZE = 128;      // Bound on buffer_size when history_size is 0
+    static const size_t MAX_INTERNAL_SIZE = 4096;   // Bound without PSRAM (44 KB)
+    static const size_t MAX_HISTORY_SIZE = 524288;  // Bound on history_size (5.5 MB of 8 MB PSRAM)
     
     explicit MemoryDataStorage(const LoggerConfig& config);
-    ~MemoryDataStorage() override = default;
+    ~MemoryDataStorage() override;
     
     bool initialize() override;
     bool write(const SensorReading& data) override;
+    bool writeBatch(const SensorReading* data, size_t count) override;
     bool flush() override;
     void close() override;
     size_t getAvailableSpace() const override;
+    void setCalibration(const SensorConfig& sensor) override;
+    bool configure(const LoggerConfig& config) override;
     
     size_t getDataCount() const;
-    bool getData(size_t index, SensorReading& reading) const;
+    
+    /**
+     * @brief Stored readings, oldest first, without copying
+     *
+     * Readings written after the call are not in the view. Once the ring is
+     * full each new reading overwrites the oldest one, so read the view from
+     * the task that writes, or while fewer readings arrive than capacity()
+     * minus the ones being read.
+     */
+    HistoryView getHistory() const;
     void clear();
     
+    size_t capacity() const;
+    
+    /**
+     * @brief Check if the ring was placed in PSRAM
+     */
+    bool isInPsram() const;
+    
 private:
     LoggerConfig config_;
-    SensorReading data_buffer_[MAX_BUFFER_SIZE];
-    size_t buffer_head_;
-    size_t buffer_count_;
+    CompactReading* data_buffer_;
+    size_t slots_;                     // Allocated entries, a power of two
+    bool in_psram_;
+    std::atomic<size_t> write_index_;  // Free-running, masked into data_buffer_
+    size_t base_index_;                // write_index_ at the last clear()
     bool is_initialized_;
+    float reference_voltage_;
+    
+    static size_t requestedCapacity(const LoggerConfig& config);
+    static CompactReading encode(const SensorReading& reading);
 };
 
 /**
@@ -121,19 +422,90 @@ private:
  */
 class DataLogger {
 public:
-    static const size_t MAX_QUEUE_SIZE = 50;
+    static const size_t MAX_QUEUE_SIZE = 64;  // Power of two (SpscRingBuffer)
+    static const uint32_t LOG_INTERVAL_MS = 1000;  // Sensor read period after startLogging()
+    static const uint32_t FLUSH_TASK_STACK_SIZE = 4096;
+    static const UBaseType_t FLUSH_TASK_PRIORITY = 2;
+    static const size_t MAX_EVENT_QUEUE_SIZE = 16;  // Power of two (SpscRingBuffer)
+    static const size_t MAX_EVENT_LOG_SIZE = 16384; // events.dat moves to events.old beyond this
+    static constexpr const char* EVENT_LOG_NAME = "events.dat";
+    static constexpr const char* EVENT_LOG_OLD_NAME = "events.old";
     
     explicit DataLogger(const LoggerConfig& config);
     ~DataLogger();
     
     bool initialize();
     bool logReading(const SensorReading& reading);
+    
+    /**
+     * @brief Log a block of readings with a single buffer check
+     * @param readings Input readings
+     * @param count Number of readings
+     * @return false if any reading was dropped due to buffer overflow
+     */
+    bool logBlock(const SensorReading* readings, size_t count);
+    
+    /**
+     * @brief Record an event and store its reading whatever the exception mode
+     *
+     * Call before the reading itself is passed to logReading()/logBlock();
+     * it is stored once. Events reach <log_file_path>/events.dat with the
+     * next flush.
+     * @param event Detected event
+     * @param reading Reading that raised it
+     * @return false if the event or its reading was dropped
+     */
+    bool logEvent(const LightEvent& event, const SensorReading& reading);
     void startLogging(ILightSensor* sensor);
     void stopLogging();
     bool flush();
+    
+    /**
+     * @brief Flush, then sync() the storage so nothing is left only in RAM (before deep sleep)
+     */
+    bool sync();
     DataStats getStats() const;
     void configure(const LoggerConfig& config);
     void setStorage(IDataStorage* storage);
+    
+    /**
+     * @brief Range query against the storage (flushes queued readings first)
+     * @param from_ms Start of the range (log time, inclusive)
+     * @param to_ms End of the range (log time, inclusive)
+     * @param callback Function called per reading, oldest first
+     * @return Number of readings delivered
+     */
+    size_t query(uint64_t from_ms, uint64_t to_ms, const QueryCallback& callback);
+    
+    /**
+     * @brief Rollup buckets overlapping a time range, oldest first
+     * @param tier Bucket length
+     * @param from_ms Start of the range (log time, inclusive)
+     * @param to_ms End of the range (log time, inclusive)
+     * @param callback Function called per non-empty bucket (the open one included)
+     * @return Number of buckets delivered (0 if rollups are disabled)
+     */
+    size_t queryRollups(RollupTier tier, uint64_t from_ms, uint64_t to_ms, const RollupCallback& callback);
+    
+    /**
+     * @brief Sealed segments newer than a sequence number, oldest first
+     * @param after_sequence Only segments with a higher sequence are returned
+     * @param segments Output summaries
+     * @param max_count Capacity of segments
+     * @return Number copied (0 unless a segment backend is in use)
+     */
+    size_t getSealedSegments(uint32_t after_sequence, SegmentSummary* segments, size_t max_count);
+    
+    /**
+     * @brief Open a segment file for reading, on whichever filesystem the backend uses
+     */
+    File openSegment(uint32_t sequence) const;
+    
+    /**
+     * @brief Set the sensor calibration recorded with logged data
+     * @param sensor Sensor configuration in effect (call before initialize())
+     */
+    void setCalibration(const SensorConfig& sensor);
     void process();
     bool isLogging() const;
     
@@ -141,25 +513,61 @@ private:
     LoggerConfig config_;
     IDataStorage* storage_;
     bool owns_storage_;
+    SensorConfig calibration_;
+    bool has_calibration_;
+    RollupStore* rollups_;
+    
+    // Producer: logReading()/logBlock(); consumer: flush()
+    SpscRingBuffer<SensorReading, MAX_QUEUE_SIZE> queue_;
     
-    // Simple circular buffer instead of std::queue
-    SensorReading buffer_[MAX_QUEUE_SIZE];
-    size_t buffer_head_;
-    size_t buffer_tail_;
-    size_t buffer_count_;
+    // Report-by-exception filter in front of the queue; events wait for
+    // the next flush
+    ExceptionFilter exception_filter_;
+    SpscRingBuffer<LightEvent, MAX_EVENT_QUEUE_SIZE> event_queue_;
     
-    volatile bool is_logging_;
-    volatile bool should_stop_;
+    // Asynchronous flush: the sampling side fills one swap buffer while
+    // the writer task drains the other
+    bool async_flush_;
+    SensorReading* swap_buffers_[2];
+    size_t fill_index_;
+    size_t fill_count_;
+    size_t drain_index_;
+    std::atomic<size_t> drain_count_;
+    std::atomic<bool> flush_task_stop_;
+    std::atomic<bool> flush_task_running_;
+    std::atomic<uint32_t> write_error_count_;
+    std::atomic<uint32_t> storage_write_time_us_;
+    TaskHandle_t flush_task_;
+    SemaphoreHandle_t storage_mutex_;
+    
+    std::atomic<bool> is_logging_;
+    std::atomic<bool> should_stop_;
     DataStats stats_;
     
     ILightSensor* sensor_;
     uint32_t last_log_time_ms_;
     
+    static IDataStorage* createStorage(const LoggerConfig& config);
+    bool writeToStorage(const SensorReading* data, size_t count);
+    void rollUp(const SensorReading& reading);
+    void startRollups();
+    void stopRollups();
     bool shouldLogReading(const SensorReading& reading) const;
     void updateStats(const SensorReading& reading);
     void processBuffer();
+    bool enqueueFiltered(const SensorReading& reading);
+    bool enqueueAll(const SensorReading* readings, size_t count);
     bool enqueue(const SensorReading& reading);
+    bool writeEvents();
+    void eventLogPath(const char* name, char* buffer, size_t buffer_size) const;
     bool dequeue(SensorReading& reading);
+    
+    bool startFlushTask();
+    void stopFlushTask();
+    bool swapBuffers();
+    void waitForWriter() const;
+    void flushTaskLoop();
+    static void flushTaskEntry(void* arg);
 };
 
 }  // namespace LightSensor
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "light_sensor.h"
+#include "signal_processor.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Kinds of light event
+ */
+enum class LightEventType : uint8_t {
+    THRESHOLD_RISE,     // Filtered lux rose through a threshold (value = threshold)
+    THRESHOLD_FALL,     // Filtered lux fell through a threshold (value = threshold)
+    PEAK,               // SignalProcessor reported a peak
+    OUTLIER,            // SignalProcessor reported an outlier
+    TREND_CHANGE        // A confident trend reversed direction (value = new slope)
+};
+
+/**
+ * @brief One detected event
+ */
+struct LightEvent {
+    uint32_t timestamp_ms;      // Timestamp of the reading that raised it
+    LightEventType type;
+    float lux;                  // Reading lux
+    float value;                // Type-specific, see LightEventType
+};
+
+/**
+ * @brief Turns SignalAnalysis results into discrete events
+ *
+ * Threshold crossings use the filtered value and need the signal to come
+ * back past the threshold by event_hysteresis_lux before the same
+ * threshold fires again, so a signal resting on a threshold does not
+ * chatter. A trend change is reported when the sign of a trend with
+ * confidence of at least TREND_CONFIDENCE differs from the last confident
+ * one.
+ */
+class EventDetector {
+public:
+    // Events a single reading can raise
+    static const size_t MAX_EVENTS = 4;
+    static constexpr float TREND_CONFIDENCE = 0.8f;
+
+    explicit EventDetector(const SignalConfig& config);
+
+    /**
+     * @brief Check one analysed reading for events
+     * @param reading Reading the analysis belongs to
+     * @param analysis Its SignalProcessor result
+     * @param events Output events (MAX_EVENTS slots)
+     * @return Number of events raised
+     */
+    size_t update(const SensorReading& reading, const SignalAnalysis& analysis, LightEvent* events);
+
+    /**
+     * @brief Apply new settings (threshold state starts over)
+     */
+    void configure(const SignalConfig& config);
+    void reset();
+
+    uint32_t getEventCount() const;
+
+    static const char* typeToString(LightEventType type);
+
+private:
+    static const size_t THRESHOLD_COUNT = 2;
+
+    SignalConfig config_;
+    float thresholds_[THRESHOLD_COUNT];   // event_low_lux, event_high_lux (0 = unused)
+    int8_t side_[THRESHOLD_COUNT];        // -1 below, +1 above, 0 not yet known
+    int8_t trend_direction_;              // Sign of the last confident trend (0 = none)
+    uint32_t event_count_;
+};
+
+}  // namespace LightSensor
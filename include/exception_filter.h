@@ -0,0 +1,93 @@
+#pragma once
+
+#include "light_sensor.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Which readings DataLogger stores
+ */
+enum class ExceptionMode : uint8_t {
+    OFF,            // Every reading that passes the logger filters
+    DEADBAND,       // Readings more than the deviation away from the last stored one
+    SWINGING_DOOR   // Corridor ends: linear interpolation stays within the deviation
+};
+
+/**
+ * @brief Report-by-exception filter in front of the log
+ *
+ * Swinging door: from the last stored point two "doors" open towards
+ * every new reading, at +/- deviation around it. While the line from the
+ * stored point to the newest reading still passes between them, every
+ * reading so far lies within the deviation of that line, so nothing needs
+ * storing. Once it does not, the previous reading is stored and becomes
+ * the new pivot. Stored values are real readings. The newest reading is
+ * held back, so a stored point can lag by one reading; close() emits it.
+ *
+ * Deadband stores a reading once it moves more than the deviation from
+ * the last stored value (step reconstruction).
+ *
+ * In both modes max_interval_ms bounds the gap between stored points,
+ * so a steady signal still leaves a heartbeat.
+ */
+class ExceptionFilter {
+public:
+    // Readings a single call can emit
+    static const size_t MAX_OUTPUT = 2;
+
+    ExceptionFilter();
+
+    /**
+     * @brief Apply new settings (starts a new corridor)
+     * @param mode Filter mode
+     * @param deviation_lux Allowed reconstruction error
+     * @param max_interval_ms Longest gap between stored points (0 = none)
+     */
+    void configure(ExceptionMode mode, float deviation_lux, uint32_t max_interval_ms);
+
+    /**
+     * @brief Feed a reading
+     * @param reading Reading that passed the logger filters
+     * @param out Readings to store, oldest first (MAX_OUTPUT slots)
+     * @return Number of readings in out
+     */
+    size_t add(const SensorReading& reading, SensorReading* out);
+
+    /**
+     * @brief Store a reading regardless of the corridor (events)
+     *
+     * The held reading is emitted first so the stored points stay in
+     * order. Passing the same reading to add() afterwards stores nothing.
+     * In OFF mode nothing is emitted; add() stores the reading as usual.
+     */
+    size_t force(const SensorReading& reading, SensorReading* out);
+
+    /**
+     * @brief Emit the held reading, if any (before a flush)
+     */
+    size_t close(SensorReading* out);
+
+    void reset();
+
+    bool isEnabled() const;
+
+private:
+    ExceptionMode mode_;
+    float deviation_;
+    uint32_t max_interval_ms_;
+
+    bool has_pivot_;
+    SensorReading pivot_;       // Last stored reading
+    bool has_held_;
+    SensorReading held_;        // Newest reading inside the corridor
+    float upper_slope_;         // Lowest slope of the upper door (lux/ms)
+    float lower_slope_;         // Highest slope of the lower door (lux/ms)
+
+    size_t restart(const SensorReading& reading, SensorReading* out);
+    void openDoors(const SensorReading& reading);
+    bool isDuplicate(const SensorReading& reading) const;
+};
+
+}  // namespace LightSensor
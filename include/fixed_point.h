@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Signed 32-bit fixed-point number with FracBits fractional bits
+ *
+ * Products and quotients go through 64-bit intermediates. Fixed<16> (Q16)
+ * covers +/-32768 at 1.5e-5 resolution, which is plenty for the normalised
+ * [0, 1] ADC signal the fixed-point filter chain works on.
+ */
+template <int FracBits>
+class Fixed {
+    static_assert(FracBits > 0 && FracBits < 31, "Fixed needs 1-30 fractional bits");
+
+public:
+    static const int32_t ONE = static_cast<int32_t>(1) << FracBits;
+
+    Fixed() : raw_(0) {}
+
+    static Fixed fromRaw(int32_t raw) {
+        Fixed value;
+        value.raw_ = raw;
+        return value;
+    }
+
+    static Fixed fromFloat(float value) {
+        float scaled = value * ONE;
+        return fromRaw(static_cast<int32_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f));
+    }
+
+    static Fixed fromInt(int32_t value) {
+        return fromRaw(value * ONE);
+    }
+
+    /**
+     * @brief Convert an ADC code to a [0, 1] fraction of full scale
+     * @param code ADC code
+     * @param max_code Full-scale code (e.g. 4095)
+     */
+    static Fixed fromCode(uint32_t code, uint32_t max_code) {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(code) << FracBits) / max_code));
+    }
+
+    int32_t raw() const { return raw_; }
+    float toFloat() const { return static_cast<float>(raw_) * (1.0f / ONE); }
+
+    Fixed operator+(Fixed other) const { return fromRaw(raw_ + other.raw_); }
+    Fixed operator-(Fixed other) const { return fromRaw(raw_ - other.raw_); }
+    Fixed operator-() const { return fromRaw(-raw_); }
+
+    Fixed operator*(Fixed other) const {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(raw_) * other.raw_) >> FracBits));
+    }
+
+    Fixed operator/(Fixed other) const {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(raw_) << FracBits) / other.raw_));
+    }
+
+    Fixed& operator+=(Fixed other) { raw_ += other.raw_; return *this; }
+    Fixed& operator-=(Fixed other) { raw_ -= other.raw_; return *this; }
+    Fixed& operator*=(Fixed other) { *this = *this * other; return *this; }
+
+    bool operator==(Fixed other) const { return raw_ == other.raw_; }
+    bool operator!=(Fixed other) const { return raw_ != other.raw_; }
+    bool operator<(Fixed other) const { return raw_ < other.raw_; }
+    bool operator<=(Fixed other) const { return raw_ <= other.raw_; }
+    bool operator>(Fixed other) const { return raw_ > other.raw_; }
+    bool operator>=(Fixed other) const { return raw_ >= other.raw_; }
+
+private:
+    int32_t raw_;
+};
+
+using Q15 = Fixed<15>;
+using Q16 = Fixed<16>;
+
+/**
+ * @brief Numeric operations the templated filters need beyond + - * and compare
+ *
+ * accum_type is wide enough to sum a full filter window without overflow;
+ * square_type holds squared values (variances) without losing small ones.
+ */
+template <typename T>
+struct NumericTraits {
+    using accum_type = T;
+
+    static T fromFloat(float value) { return static_cast<T>(value); }
+    static float toFloat(T value) { return static_cast<float>(value); }
+    static accum_type widen(T value) { return value; }
+    static T scale(accum_type sum, T factor) { return static_cast<T>(sum * factor); }
+    static bool isNaN(T value) { return value != value; }
+    
+    using square_type = T;
+    static square_type square(T value) { return value * value; }
+    static square_type squareFromFloat(float value) { return static_cast<T>(value); }
+    static square_type blend(square_type current, square_type target, T rate) {
+        return current + rate * (target - current);
+    }
+};
+
+template <int FracBits>
+struct NumericTraits<Fixed<FracBits>> {
+    using accum_type = int64_t;
+
+    static Fixed<FracBits> fromFloat(float value) { return Fixed<FracBits>::fromFloat(value); }
+    static float toFloat(Fixed<FracBits> value) { return value.toFloat(); }
+    static accum_type widen(Fixed<FracBits> value) { return value.raw(); }
+    static Fixed<FracBits> scale(accum_type sum, Fixed<FracBits> factor) {
+        return Fixed<FracBits>::fromRaw(static_cast<int32_t>((sum * factor.raw()) >> FracBits));
+    }
+    static bool isNaN(Fixed<FracBits>) { return false; }
+    
+    // Squares keep 2 * FracBits fractional bits
+    using square_type = int64_t;
+    static square_type square(Fixed<FracBits> value) {
+        return static_cast<int64_t>(value.raw()) * value.raw();
+    }
+    static square_type squareFromFloat(float value) {
+        return static_cast<int64_t>(value * (static_cast<float>(Fixed<FracBits>::ONE) * Fixed<FracBits>::ONE));
+    }
+    static square_type blend(square_type current, square_type target, Fixed<FracBits> rate) {
+        return current + (((target - current) * rate.raw()) >> FracBits);
+    }
+};
+
+}  // namespace LightSensor
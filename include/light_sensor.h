@@ -2,9 +2,14 @@
 
 #include <cstdint>
 #include <functional>
+#include <atomic>
+#include "adc_continuous.h"
 
 namespace LightSensor {
 
+// Maximum number of readings delivered in one block
+static const size_t MAX_BLOCK_SIZE = 64;
+
 /**
  * @brief Light sensor reading data structure
  */
@@ -15,6 +20,15 @@ struct SensorReading {
     float voltage;            // Measured voltage
     bool is_valid;            // Data validity flag
     uint8_t quality;          // Signal quality (0-100)
+    uint16_t raw_q16;         // raw_value as a Q16 fraction of full scale, not an ADC code (fixed-point input)
+};
+
+/**
+ * @brief Sensor sampling modes
+ */
+enum class SamplingMode {
+    POLLED,         // analogRead() per reading, paced by sample_rate_ms
+    CONTINUOUS      // DMA-driven continuous ADC, readings delivered in blocks
 };
 
 /**
@@ -23,6 +37,8 @@ struct SensorReading {
 struct SensorConfig {
     // ADC Configuration
     uint8_t adc_pin;          // ADC pin number (GPIO 32-39 for ESP32)
+    uint8_t array_pins[MAX_ADC_CHANNELS]; // LightSensorArray channels (ADC1, GPIO 32-39)
+    uint8_t array_channel_count;          // 0 = single sensor on adc_pin
     uint16_t adc_resolution;  // ADC resolution (bits)
     float reference_voltage;  // Reference voltage (V)
     
@@ -35,6 +51,15 @@ struct SensorConfig {
     uint32_t sample_rate_ms;  // Sampling interval in milliseconds
     uint8_t oversampling;     // Number of samples to average
     bool auto_gain;           // Enable automatic gain adjustment
+    SamplingMode sampling_mode; // Polled or continuous (DMA) sampling
+    uint32_t continuous_sample_rate_hz; // Reading rate in continuous mode
+    uint16_t block_size;      // Readings per block in continuous mode
+    
+    // Adaptive sampling (polled mode): back off while the light is steady
+    bool enable_adaptive_sampling;
+    uint32_t max_sample_rate_ms;      // Slowest interval when steady
+    uint8_t min_oversampling;         // Oversampling when steady
+    float adaptive_change_threshold;  // Relative change that restores the full rate
     
     // Power management
     bool low_power_mode;      // Enable low power mode
@@ -46,6 +71,11 @@ struct SensorConfig {
  */
 using DataCallback = std::function<void(const SensorReading&)>;
 
+/**
+ * @brief Callback function type for blocks of sensor data
+ */
+using BlockCallback = std::function<void(const SensorReading* readings, size_t count)>;
+
 /**
  * @brief Abstract base class for light sensor implementations
  */
@@ -65,12 +95,38 @@ public:
      */
     virtual SensorReading read() = 0;
     
+    /**
+     * @brief Read a block of sensor values
+     * @param readings Output array
+     * @param max_count Capacity of the output array
+     * @return Number of readings written
+     */
+    virtual size_t readBlock(SensorReading* readings, size_t max_count) {
+        for (size_t i = 0; i < max_count; ++i) {
+            readings[i] = read();
+        }
+        return max_count;
+    }
+    
     /**
      * @brief Start continuous sampling
      * @param callback Function to call with each reading
      */
     virtual void startSampling(DataCallback callback) = 0;
     
+    /**
+     * @brief Start continuous sampling with block delivery
+     * @param callback Function to call with each block of readings
+     */
+    virtual void startBlockSampling(BlockCallback callback) {
+        if (callback == nullptr) {
+            return;
+        }
+        startSampling([callback](const SensorReading& reading) {
+            callback(&reading, 1);
+        });
+    }
+    
     /**
      * @brief Stop continuous sampling
      */
@@ -115,7 +171,9 @@ public:
     
     bool initialize() override;
     SensorReading read() override;
+    size_t readBlock(SensorReading* readings, size_t max_count) override;
     void startSampling(DataCallback callback) override;
+    void startBlockSampling(BlockCallback callback) override;
     void stopSampling() override;
     void configure(const SensorConfig& config) override;
     void calibrate(float dark_value, float light_value) override;
@@ -123,25 +181,123 @@ public:
     void wakeUp() override;
     void process() override;
     
+    /**
+     * @brief Convert an ADC code sampled outside the driver (e.g. by the ULP)
+     * @param code 12-bit ADC code
+     * @param timestamp_ms Time the code was sampled
+     * @return Calibrated reading
+     */
+    SensorReading convertCode(uint16_t code, uint32_t timestamp_ms);
+    
+    /**
+     * @brief Time the ADC has spent converting (for energy accounting)
+     * @return Free-running microsecond counter (wraps)
+     */
+    uint32_t getAdcActiveTimeUs();
+    
+    /**
+     * @brief Change the polled sample interval and oversampling in place
+     * @param sample_rate_ms Sampling interval
+     * @param oversampling Samples averaged per reading (at least 1)
+     *
+     * Unlike configure() this leaves the ADC set up; safe to call from a
+     * different task than the one sampling.
+     */
+    void setSamplingParameters(uint32_t sample_rate_ms, uint8_t oversampling);
+    
+    uint32_t getSampleRateMs() const;
+    uint8_t getOversampling() const;
+    
+    /**
+     * @brief Rate readings are actually delivered at
+     *
+     * In continuous mode the hardware rate divided by the whole number of
+     * codes averaged per reading, which can differ from
+     * continuous_sample_rate_hz; reading timestamps follow this rate.
+     */
+    float getReadingRateHz() const;
+    
+    /**
+     * @brief Whether startSampling() / startBlockSampling() took effect
+     */
+    bool isSampling() const;
+    
+    /**
+     * @brief Signal quality of a valid reading
+     * @param raw_value ADC fraction (0.0 - 1.0)
+     * @return Quality (0-100)
+     */
+    static uint8_t qualityFromRaw(float raw_value);
+    
+    /**
+     * @brief Scale for q16FromSum(): 2^32 / (code_count * 4095)
+     * @param code_count Number of 12-bit codes summed per reading
+     */
+    static uint32_t q16Scale(uint32_t code_count);
+    
+    /**
+     * @brief SensorReading::raw_q16 of an averaged reading (one multiply, no divide)
+     * @param code_sum Sum of 12-bit ADC codes
+     * @param code_scale q16Scale() of the number of codes summed
+     */
+    static uint16_t q16FromSum(uint32_t code_sum, uint32_t code_scale);
+    
 private:
     static const size_t FILTER_BUFFER_SIZE = 5;
+    static const size_t RAW_CHUNK_SIZE = 128;
     
     SensorConfig config_;
     bool is_sampling_;
     bool is_initialized_;
     bool was_sampling_before_sleep_;
     DataCallback data_callback_;
+    BlockCallback block_callback_;
     uint32_t last_sample_time_ms_;
     
-    // Noise filter buffer (static array instead of std::vector)
+    // Polled timing, adjustable at runtime (adaptive sampling)
+    std::atomic<uint32_t> sample_rate_ms_;
+    std::atomic<uint8_t> oversampling_;
+    
+    // Continuous (DMA) sampling state
+    ContinuousADC continuous_adc_;
+    SensorReading block_[MAX_BLOCK_SIZE];
+    size_t block_count_;
+    uint32_t decimation_;       // ADC codes averaged per reading
+    uint32_t decimation_sum_;
+    uint32_t decimation_count_;
+    uint32_t reading_index_;    // Readings produced since sampling started
+    uint32_t stream_start_ms_;
+    float decimation_scale_;    // 1 / (decimation_ * ADC_MAX_VALUE)
+    uint32_t decimation_q16_scale_;  // q16Scale(decimation_)
+    
+    // ADC busy time: polled reads plus continuous run time folded in on query.
+    // The fold swaps continuous_start_us_, so loop() can query while the
+    // acquisition task stops or restarts the stream
+    std::atomic<uint32_t> adc_active_us_;
+    std::atomic<uint32_t> continuous_start_us_;
+    
+    // Precomputed conversion constants (no divide per sample)
+    float inv_sensitivity_;
+    
+    // Noise filter buffer (static array instead of std::vector); the same
+    // average runs on raw_q16 so both signal paths see the same input
     float filter_buffer_[FILTER_BUFFER_SIZE];
+    uint16_t q16_filter_buffer_[FILTER_BUFFER_SIZE];
     size_t filter_buffer_index_;
     
-    float readRawADC();
+    bool startContinuous();
+    void stopContinuous();
+    void drainContinuous();
+    size_t convertContinuous(SensorReading* readings, size_t max_count);
+    void deliverBlock();
+    SensorReading makeReading(float raw_value, uint16_t raw_q16, uint32_t timestamp_ms);
+    uint16_t readRawADC();
     float adcToVoltage(float raw_value);
     float voltageToLux(float voltage);
     float applyNoiseFilter(float reading);
+    uint16_t applyQ16NoiseFilter(uint16_t raw_q16);
     uint8_t calculateQuality(const SensorReading& reading);
+    void updateConversion();
 };
 
 }  // namespace LightSensor
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include "light_sensor.h"
+#include "signal_processor.h"
+#include "adc_continuous.h"
+#include "static_arena.h"
+
+namespace LightSensor {
+
+/**
+ * @brief Several photodiodes on ADC1, sampled together
+ *
+ * One sweep covers every channel: in continuous mode the DMA controller
+ * converts all pins in a single pattern, in polled mode one pass
+ * reads each pin in turn. Readings are stored structure-of-arrays per
+ * channel (timestamps, raw, lux, filtered lux and quality each in their
+ * own contiguous array) and each channel has its own SignalProcessor,
+ * run once per sweep over the new values. The processors are built in
+ * static slots inside the array object, like the subsystems in main.cpp.
+ *
+ * The columns hold the readings of the latest sweep only; read them
+ * before the next sweep() call.
+ */
+class LightSensorArray {
+public:
+    static const size_t MAX_CHANNELS = MAX_ADC_CHANNELS;
+    static const size_t CHANNEL_CAPACITY = MAX_BLOCK_SIZE;   // Readings per channel per sweep
+
+    LightSensorArray(const SensorConfig& config, const SignalConfig& signal_config);
+    ~LightSensorArray();
+
+    /**
+     * @brief Set up the channels listed in config.array_pins
+     * @return true if every pin is an ADC1 pin and sampling could start
+     */
+    bool initialize();
+
+    /**
+     * @brief Stop sampling and release the ADC
+     */
+    void end();
+
+    /**
+     * @brief Take the readings available for every channel and filter them
+     *
+     * Continuous mode drains what the DMA ring holds (at most
+     * CHANNEL_CAPACITY readings per channel); polled mode reads one
+     * oversampled value per channel.
+     * @return Readings produced across all channels
+     */
+    size_t sweep();
+
+    /**
+     * @brief Apply new sensor settings (a pin, mode or rate change restarts sampling)
+     *
+     * A change to the shared calibration replaces the per-channel overrides.
+     */
+    void configure(const SensorConfig& config);
+
+    /**
+     * @brief Apply new filter settings to every channel
+     */
+    void configureSignal(const SignalConfig& signal_config);
+
+    /**
+     * @brief Override the shared calibration for one channel
+     * @param channel Channel index
+     * @param dark_offset Dark current offset (V)
+     * @param sensitivity Sensitivity, as SensorConfig::sensitivity
+     */
+    void setChannelCalibration(size_t channel, float dark_offset, float sensitivity);
+
+    size_t getChannelCount() const;
+    uint8_t getPin(size_t channel) const;
+
+    /**
+     * @brief Channel index of a GPIO pin
+     * @return Index, or -1 if the pin is not part of the array
+     */
+    int findChannel(uint8_t pin) const;
+
+    // Columns of the latest sweep, getCount(channel) entries each
+    size_t getCount(size_t channel) const;
+    const uint32_t* getTimestamps(size_t channel) const;
+    const float* getRawValues(size_t channel) const;
+    const float* getLuxValues(size_t channel) const;
+    const float* getFilteredValues(size_t channel) const;
+    const uint8_t* getQuality(size_t channel) const;
+
+    /**
+     * @brief Analysis after the channel's most recent reading
+     */
+    const SignalAnalysis& getAnalysis(size_t channel) const;
+
+    /**
+     * @brief Gather one reading of the latest sweep into a SensorReading
+     */
+    SensorReading getReading(size_t channel, size_t index) const;
+
+    /**
+     * @brief Time the ADC has spent converting (for energy accounting)
+     * @return Free-running microsecond counter (wraps)
+     */
+    uint32_t getAdcActiveTimeUs();
+
+private:
+    static const size_t RAW_CHUNK_SIZE = 128;
+
+    SensorConfig config_;
+    SignalConfig signal_config_;
+    size_t channel_count_;
+    bool is_initialized_;
+
+    // Per-channel conversion: lux = (raw * reference - dark_offset) / sensitivity
+    float dark_offset_[MAX_CHANNELS];
+    float sensitivity_[MAX_CHANNELS];
+    float inv_sensitivity_[MAX_CHANNELS];
+    StaticSlot<SignalProcessor> processors_[MAX_CHANNELS];
+    SignalAnalysis analysis_[MAX_CHANNELS];
+
+    // Structure-of-arrays reading store, one row per channel
+    size_t count_[MAX_CHANNELS];
+    uint32_t timestamps_[MAX_CHANNELS][CHANNEL_CAPACITY];
+    float raw_[MAX_CHANNELS][CHANNEL_CAPACITY];
+    uint16_t raw_q16_[MAX_CHANNELS][CHANNEL_CAPACITY]; // SensorReading::raw_q16
+    float lux_[MAX_CHANNELS][CHANNEL_CAPACITY];
+    float filtered_[MAX_CHANNELS][CHANNEL_CAPACITY];
+    uint8_t quality_[MAX_CHANNELS][CHANNEL_CAPACITY];
+
+    // Continuous (DMA) sampling state, decimated per channel
+    ContinuousADC continuous_adc_;
+    uint32_t decimation_;
+    uint32_t decimation_sum_[MAX_CHANNELS];
+    uint32_t decimation_count_[MAX_CHANNELS];
+    uint32_t reading_index_[MAX_CHANNELS];
+    uint32_t stream_start_ms_;
+    float decimation_scale_;
+    uint32_t decimation_q16_scale_;
+
+    std::atomic<uint32_t> adc_active_us_;
+    std::atomic<uint32_t> continuous_start_us_;   // Swapped on each fold, as in ADCLightSensor
+
+    bool startContinuous();
+    void stopContinuous();
+    void sweepContinuous();
+    void sweepPolled();
+    void store(size_t channel, float raw_value, uint16_t raw_q16, uint32_t timestamp_ms);
+    void resetCalibration();
+    void applyCalibration(size_t channel);
+};
+
+}  // namespace LightSensor
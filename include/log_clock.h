@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+namespace LightSensor {
+
+/**
+ * @brief 64-bit millisecond clock for stored data
+ *
+ * System time, which the ESP32 keeps through deep sleep, plus an offset.
+ * After a power loss system time restarts near zero; each store calls
+ * advancePast() with the newest time it holds, so the clock never runs
+ * backwards relative to anything already on flash. Shared by every store
+ * so their times line up.
+ */
+class LogClock {
+public:
+    static LogClock& getInstance();
+
+    /**
+     * @brief Current log time
+     */
+    uint64_t nowMs() const;
+
+    /**
+     * @brief Convert a millis() timestamp to log time
+     */
+    uint64_t fromMillis(uint32_t timestamp_ms) const;
+
+    /**
+     * @brief Move the clock forward so nowMs() is later than time_ms
+     * @param time_ms Newest log time found in storage
+     */
+    void advancePast(uint64_t time_ms);
+
+private:
+    LogClock();
+
+    // Prevent copying
+    LogClock(const LogClock&) = delete;
+    LogClock& operator=(const LogClock&) = delete;
+
+    std::atomic<uint64_t> offset_ms_;
+
+    static uint64_t systemTimeMs();
+};
+
+}  // namespace LightSensor
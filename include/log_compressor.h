@@ -0,0 +1,96 @@
+#pragma once
+
+#include "light_sensor.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+// Readings per compressed block
+static const size_t COMPRESSION_BLOCK_SIZE = 64;
+
+// Low lux mantissa bits dropped before XOR coding (keeps 1 part in 65536,
+// well below the 12-bit ADC resolution)
+static const uint8_t LUX_MANTISSA_DROP_BITS = 7;
+
+// Worst case encoded size of one block (frame header + ~14 bytes per reading)
+static const size_t MAX_COMPRESSED_BLOCK_SIZE = 8 + COMPRESSION_BLOCK_SIZE * 14;
+
+// BinaryLogHeader::flags bit for files made of compressed blocks
+static const uint16_t BINARY_LOG_FLAG_COMPRESSED = 0x0001;
+
+/**
+ * @brief MSB-first bit writer over a caller-supplied buffer
+ */
+class BitWriter {
+public:
+    BitWriter(uint8_t* buffer, size_t capacity);
+
+    void write(uint32_t value, uint8_t bits);
+    bool overflowed() const;
+    size_t bytesUsed() const;
+
+private:
+    uint8_t* buffer_;
+    size_t capacity_;
+    size_t bit_pos_;
+    bool overflowed_;
+};
+
+/**
+ * @brief MSB-first bit reader
+ */
+class BitReader {
+public:
+    BitReader(const uint8_t* buffer, size_t length);
+
+    uint32_t read(uint8_t bits);
+    bool exhausted() const;
+
+private:
+    const uint8_t* buffer_;
+    size_t length_;
+    size_t bit_pos_;
+    bool exhausted_;
+};
+
+/**
+ * @brief Streaming block compressor for sensor readings
+ *
+ * Each block is self-contained, so a damaged block only loses its own
+ * readings. Frame: uint16 payload bytes, uint16 reading count, then a
+ * bit stream:
+ * - timestamps: first value verbatim, then delta-of-delta in 1/9/12/16/36 bit buckets
+ * - lux: Gorilla-style XOR of the float bits against the previous value
+ * - raw code: zig-zag delta in 1/7/11/19 bit buckets
+ * - quality: 1 bit if unchanged, else 9 bits
+ *
+ * Voltage is not stored; it is raw_value * reference_voltage as in the
+ * uncompressed binary format.
+ */
+class BlockCompressor {
+public:
+    /**
+     * @brief Compress a block of readings
+     * @param readings Input readings (at most COMPRESSION_BLOCK_SIZE)
+     * @param count Number of readings
+     * @param out Output buffer
+     * @param capacity Output capacity (MAX_COMPRESSED_BLOCK_SIZE always fits)
+     * @return Bytes written, 0 on overflow
+     */
+    static size_t compress(const SensorReading* readings, size_t count, uint8_t* out, size_t capacity);
+
+    /**
+     * @brief Decompress one block
+     * @param data Block frame
+     * @param length Bytes available
+     * @param readings Output readings (COMPRESSION_BLOCK_SIZE capacity)
+     * @param reference_voltage Used to rebuild voltage
+     * @param consumed Bytes of the frame consumed
+     * @return Number of readings decoded, 0 on a malformed block
+     */
+    static size_t decompress(const uint8_t* data, size_t length, SensorReading* readings,
+                             float reference_voltage, size_t& consumed);
+};
+
+}  // namespace LightSensor
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "light_sensor.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief On-flash log file formats
+ */
+enum class LogFormat {
+    CSV,        // One text line per reading
+    BINARY      // Packed fixed-size records behind a BinaryLogHeader
+};
+
+static const uint32_t BINARY_LOG_MAGIC = 0x4C42534C;  // "LSBL" little-endian
+static const uint16_t BINARY_LOG_VERSION = 1;
+
+// Lux resolution of BinaryLogRecord::lux (0.01 lux, up to ~42.9M lux)
+static const float BINARY_LUX_SCALE = 0.01f;
+
+// delta_ms value marking a timestamp sync record
+static const uint16_t BINARY_SYNC_DELTA = 0xFFFF;
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Binary log file header (little-endian, written once per file)
+ *
+ * Describes the record schema and the calibration in effect when the file
+ * was opened, so voltage can be reconstructed from raw_code on the host.
+ */
+struct BinaryLogHeader {
+    uint32_t magic;             // BINARY_LOG_MAGIC
+    uint16_t version;           // BINARY_LOG_VERSION
+    uint16_t header_size;       // sizeof(BinaryLogHeader)
+    uint16_t record_size;       // sizeof(BinaryLogRecord)
+    uint16_t flags;             // Reserved, 0
+    uint32_t base_timestamp_ms; // Timestamp the first delta is relative to
+    float lux_scale;            // Lux per LSB of BinaryLogRecord::lux
+    float reference_voltage;    // voltage = raw_code / 65535 * reference_voltage
+    float dark_offset;          // Calibration dark offset (V)
+    float sensitivity;          // Calibration sensitivity (V per lux)
+};
+
+/**
+ * @brief Packed reading record
+ *
+ * A record with delta_ms == BINARY_SYNC_DELTA is a sync record: lux holds
+ * the absolute timestamp of the next record, which then has delta_ms == 0.
+ */
+struct BinaryLogRecord {
+    uint16_t delta_ms;          // Milliseconds since the previous record
+    uint16_t raw_code;          // raw_value quantised to 16 bits
+    uint32_t lux;               // lux_value / lux_scale
+    uint8_t quality;            // Signal quality (0-100)
+};
+
+#pragma pack(pop)
+
+// Worst case bytes for one encoded reading (sync record + record)
+static const size_t MAX_ENCODED_READING_SIZE = 2 * sizeof(BinaryLogRecord);
+
+/**
+ * @brief Encodes readings into BinaryLogRecord streams
+ */
+class BinaryRecordEncoder {
+public:
+    BinaryRecordEncoder();
+
+    /**
+     * @brief Start a new stream relative to a base timestamp
+     */
+    void reset(uint32_t base_timestamp_ms);
+
+    /**
+     * @brief Encode one reading
+     * @param reading Reading to encode
+     * @param out Output buffer, at least MAX_ENCODED_READING_SIZE bytes
+     * @return Number of bytes written
+     */
+    size_t encode(const SensorReading& reading, uint8_t* out);
+
+private:
+    uint32_t last_timestamp_ms_;
+};
+
+/**
+ * @brief Decodes BinaryLogRecord streams back into readings
+ */
+class BinaryRecordDecoder {
+public:
+    BinaryRecordDecoder();
+
+    void reset(uint32_t base_timestamp_ms, float reference_voltage);
+
+    /**
+     * @brief Decode one record
+     * @param record Record to decode
+     * @param reading Output reading (valid only when true is returned)
+     * @return true if a reading was produced (false for sync records)
+     */
+    bool decode(const BinaryLogRecord& record, SensorReading& reading);
+
+private:
+    uint32_t timestamp_ms_;
+    float reference_voltage_;
+};
+
+/**
+ * @brief Fill a header for a new binary log file
+ */
+void initBinaryLogHeader(BinaryLogHeader& header, uint32_t base_timestamp_ms,
+                         float reference_voltage, float dark_offset, float sensitivity);
+
+}  // namespace LightSensor
@@ -1,7 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
 #include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Lowest level the LS_LOG_* macros compile in (0 = DEBUG ... 4 = CRITICAL, 5 = none).
+// Calls below it are removed along with their arguments.
+#ifndef LS_LOG_LEVEL
+#define LS_LOG_LEVEL 0
+#endif
 
 namespace LightSensor {
 
@@ -28,9 +39,24 @@ enum class LogOutput {
 
 /**
  * @brief ESP32 Logger class using Serial and SPIFFS
+ *
+ * logf() takes a printf-style format. By default the message is formatted
+ * and written by the caller. After startAsync() the caller only copies the
+ * format pointer and raw arguments into a ring buffer; a low-priority task
+ * formats the records and writes them out in batches.
+ *
+ * Formats must be string literals (only the pointer is stored). Arguments
+ * may be integers up to 32 bits, floats and C strings; strings are copied,
+ * truncated to MAX_STRING_ARG_LEN - 1 characters.
  */
 class Logger {
 public:
+    static const size_t ASYNC_BUFFER_SIZE = 4096;   // Power of two for masked indexing
+    static const uint8_t MAX_ARGS = 10;
+    static const size_t MAX_STRING_ARG_LEN = 128;
+    static const size_t MAX_LINE_LEN = 192;
+    static const uint32_t FILE_FLUSH_INTERVAL_MS = 1000;
+    
     static Logger& getInstance();
     
     void setLevel(LogLevel level);
@@ -43,25 +69,212 @@ public:
     void error(const char* message);
     void critical(const char* message);
     
+    /**
+     * @brief Log a printf-style message
+     * @param level Message level
+     * @param format Format string literal
+     * @param args Format arguments
+     */
+    template<typename... Args>
+    void logf(LogLevel level, const char* format, Args... args);
+    
+    /**
+     * @brief Start the background writer; messages are queued from now on
+     * @param core Core to pin the writer task to
+     * @param priority Writer task priority (keep below the application tasks)
+     * @return true if the writer task is running
+     */
+    bool startAsync(uint8_t core = 0, uint8_t priority = 1);
+    
+    /**
+     * @brief Write out queued messages and return to synchronous logging
+     */
+    void stopAsync();
+    
+    /**
+     * @brief Block until every queued message has been written
+     */
+    void flush();
+    
+    bool isAsync() const;
+    
+    /**
+     * @brief Messages lost because the ring buffer was full
+     */
+    uint32_t getDroppedCount() const;
+    
     bool setLogFile(const char* filename);
     void closeLogFile();
-    
+
 private:
     Logger();
-    ~Logger() { closeLogFile(); }
+    ~Logger() { stopAsync(); closeLogFile(); }
     
     // Prevent copying
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     
+    enum class ArgType : uint8_t {
+        INT,
+        UINT,
+        FLOAT,
+        STRING
+    };
+    
+    struct PackedArgs {
+        uint8_t count;
+        ArgType types[MAX_ARGS];
+        uint32_t values[MAX_ARGS];
+        const char* strings[MAX_ARGS];
+    };
+    
+    // Ring record: header, one 32-bit value per argument, then the copied
+    // strings (NUL-terminated; their value slot holds the copied length)
+    struct RecordHeader {
+        const char* format;
+        uint32_t timestamp_ms;
+        uint16_t size;
+        uint8_t level;
+        uint8_t arg_count;
+        ArgType types[MAX_ARGS];
+    };
+    
+    static const size_t MAX_RECORD_SIZE = sizeof(RecordHeader) +
+                                          MAX_ARGS * (sizeof(uint32_t) + MAX_STRING_ARG_LEN);
+    static const size_t BATCH_SIZE = 512;
+    
     LogLevel level_;
     LogOutput output_;
     File log_file_;
     bool file_is_open_;
     char log_file_path_[64];
+    uint32_t last_file_flush_ms_;
+    bool file_dirty_;               // Written since the last file flush
+    
+    // Async mode: producers serialise on ring_lock_, the writer task reads lock-free
+    uint8_t ring_[ASYNC_BUFFER_SIZE];
+    std::atomic<uint32_t> ring_head_;
+    std::atomic<uint32_t> ring_tail_;
+    portMUX_TYPE ring_lock_;
+    std::atomic<uint32_t> dropped_count_;
+    TaskHandle_t writer_task_;
+    std::atomic<bool> async_;
+    std::atomic<bool> writer_stop_;
+    std::atomic<bool> writer_running_;
+    std::atomic<bool> writer_busy_;
+    std::atomic<uint32_t> active_producers_;  // Past the async_ check; stopAsync() waits them out
+    
+    // Writer task only
+    uint8_t record_[MAX_RECORD_SIZE];
+    char batch_[BATCH_SIZE];
+    size_t batch_length_;
     
-    void formatMessage(LogLevel level, const char* message, char* buffer, size_t buffer_size) const;
+    template<typename T>
+    static void packArg(PackedArgs& packed, T value);
+    
+    void enqueue(LogLevel level, const char* format, const PackedArgs& args);
+    void enqueueRecord(LogLevel level, const char* format, const PackedArgs& args);
+    void writeMessage(LogLevel level, uint32_t timestamp_ms, const char* message);
+    void writeOut(const char* text, size_t length, bool force_file_flush);
+    void flushFileIfDue(bool force);
+    
+    static void writerTaskEntry(void* arg);
+    void writerTaskLoop();
+    bool readRecord();
+    void formatRecord(char* buffer, size_t buffer_size) const;
+    void appendToBatch(LogLevel level, uint32_t timestamp_ms, const char* message);
+    void flushBatch(bool force_file_flush = false);
+    
+    void copyIn(uint32_t position, const void* data, size_t length);
+    void copyOut(uint32_t position, void* data, size_t length) const;
+    
+    void formatMessage(LogLevel level, uint32_t timestamp_ms, const char* message,
+                       char* buffer, size_t buffer_size) const;
     const char* levelToString(LogLevel level) const;
 };
 
+template<typename T>
+void Logger::packArg(PackedArgs& packed, T value) {
+    if (packed.count >= MAX_ARGS) {
+        return;
+    }
+    
+    uint8_t index = packed.count++;
+    packed.strings[index] = nullptr;
+    
+    if constexpr (std::is_floating_point<T>::value) {
+        float narrowed = static_cast<float>(value);
+        memcpy(&packed.values[index], &narrowed, sizeof(narrowed));
+        packed.types[index] = ArgType::FLOAT;
+    } else if constexpr (std::is_pointer<T>::value) {
+        static_assert(std::is_same<typename std::remove_cv<typename std::remove_pointer<T>::type>::type,
+                                   char>::value, "Only C string pointers can be logged");
+        packed.strings[index] = value ? value : "(null)";
+        packed.types[index] = ArgType::STRING;
+    } else if constexpr (std::is_enum<T>::value) {
+        packed.values[index] = static_cast<uint32_t>(value);
+        packed.types[index] = ArgType::UINT;
+    } else {
+        static_assert(std::is_integral<T>::value && sizeof(T) <= sizeof(uint32_t),
+                      "Log arguments must be 32-bit integers, floats or C strings");
+        packed.values[index] = static_cast<uint32_t>(value);
+        packed.types[index] = std::is_signed<T>::value ? ArgType::INT : ArgType::UINT;
+    }
+}
+
+template<typename... Args>
+void Logger::logf(LogLevel level, const char* format, Args... args) {
+    if (level < level_ || output_ == LogOutput::NONE) {
+        return;
+    }
+    
+    if (async_.load(std::memory_order_acquire)) {
+        PackedArgs packed;
+        packed.count = 0;
+        (packArg(packed, args), ...);
+        enqueue(level, format, packed);
+        return;
+    }
+    
+    if constexpr (sizeof...(Args) == 0) {
+        log(level, format);
+    } else {
+        char message[MAX_LINE_LEN];
+        snprintf(message, sizeof(message), format, args...);
+        log(level, message);
+    }
+}
+
 }  // namespace LightSensor
+
+#define LS_LOG_AT(level, ...) ::LightSensor::Logger::getInstance().logf(level, __VA_ARGS__)
+
+#if LS_LOG_LEVEL <= 0
+#define LS_LOG_DEBUG(...) LS_LOG_AT(::LightSensor::LogLevel::DEBUG, __VA_ARGS__)
+#else
+#define LS_LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if LS_LOG_LEVEL <= 1
+#define LS_LOG_INFO(...) LS_LOG_AT(::LightSensor::LogLevel::INFO, __VA_ARGS__)
+#else
+#define LS_LOG_INFO(...) do {} while (0)
+#endif
+
+#if LS_LOG_LEVEL <= 2
+#define LS_LOG_WARNING(...) LS_LOG_AT(::LightSensor::LogLevel::WARNING, __VA_ARGS__)
+#else
+#define LS_LOG_WARNING(...) do {} while (0)
+#endif
+
+#if LS_LOG_LEVEL <= 3
+#define LS_LOG_ERROR(...) LS_LOG_AT(::LightSensor::LogLevel::ERROR, __VA_ARGS__)
+#else
+#define LS_LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LS_LOG_LEVEL <= 4
+#define LS_LOG_CRITICAL(...) LS_LOG_AT(::LightSensor::LogLevel::CRITICAL, __VA_ARGS__)
+#else
+#define LS_LOG_CRITICAL(...) do {} while (0)
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "static_arena.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Boot-time RAM usage per subsystem
+ *
+ * Each subsystem's start-up is bracketed with begin()/end(). The static
+ * bytes are its StaticSlot size. The heap bytes are the drop in free
+ * internal RAM and PSRAM in between, which covers its buffers and tasks.
+ * print() logs one line per subsystem, the arenas and the heap state.
+ */
+class MemoryReport {
+public:
+    static const size_t MAX_SECTIONS = 12;
+    static const size_t MAX_ARENAS = 4;
+
+    static MemoryReport& getInstance();
+
+    /**
+     * @brief Start measuring a subsystem
+     * @param name Subsystem name (string literal)
+     * @param static_bytes RAM reserved at compile time
+     */
+    void begin(const char* name, size_t static_bytes);
+
+    /**
+     * @brief Finish the subsystem started by begin()
+     */
+    void end();
+
+    /**
+     * @brief Include an arena's size and peak use in the report
+     */
+    void addArena(const char* name, const StaticArena& arena);
+
+    void print() const;
+
+private:
+    struct Section {
+        const char* name;
+        size_t static_bytes;
+        int32_t internal_bytes;   // Heap taken (negative if it was released)
+        int32_t psram_bytes;
+    };
+
+    struct ArenaEntry {
+        const char* name;
+        const StaticArena* arena;
+    };
+
+    Section sections_[MAX_SECTIONS];
+    size_t section_count_;
+    ArenaEntry arenas_[MAX_ARENAS];
+    size_t arena_count_;
+
+    // Free heap when the open section began
+    size_t internal_free_;
+    size_t psram_free_;
+    bool is_open_;
+
+    MemoryReport();
+
+    // Prevent copying
+    MemoryReport(const MemoryReport&) = delete;
+    MemoryReport& operator=(const MemoryReport&) = delete;
+};
+
+}  // namespace LightSensor
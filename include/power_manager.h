@@ -1,7 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <functional>
+#include <atomic>
+#include "ulp_sampler.h"
 
 namespace LightSensor {
 
@@ -15,6 +18,23 @@ enum class PowerMode {
     DEEP_SLEEP      // Deep sleep, minimal power consumption
 };
 
+static const size_t POWER_MODE_COUNT = 4;
+
+/**
+ * @brief Consumers energy is attributed to
+ */
+enum class PowerSubsystem {
+    CPU_240MHZ,     // Awake at full clock
+    CPU_80MHZ,      // Awake at reduced clock
+    SLEEP,          // Light and deep sleep floor
+    ULP,            // ULP coprocessor sampling during deep sleep
+    ADC,            // SAR ADC conversions
+    FLASH,          // Log writes to flash
+    RADIO           // WiFi while the uplink holds it
+};
+
+static const size_t POWER_SUBSYSTEM_COUNT = 7;
+
 /**
  * @brief Power management configuration
  */
@@ -24,29 +44,40 @@ struct PowerConfig {
     uint32_t deep_sleep_timeout_ms;   // Timeout before deep sleep
     bool enable_wake_on_light;        // Wake on light level change
     float light_threshold;            // Light level threshold for wake-up
+    bool enable_ulp_sampling;         // Sample on the ULP during deep sleep (ESP32 only)
+    uint32_t ulp_sample_period_ms;    // ULP sample period
     
     // Power optimization
     bool disable_unused_peripherals;  // Disable unused peripherals
     bool reduce_clock_speed;          // Reduce CPU clock speed
     uint32_t adc_sample_delay_ms;     // Delay between ADC samples
+    bool enable_sleep_scheduler;      // Light sleep between scheduled deadlines
+    uint32_t min_light_sleep_ms;      // Shorter idle gaps use delay() instead
     
     // Battery management
     float low_battery_threshold;      // Low battery voltage threshold
     float critical_battery_threshold; // Critical battery voltage threshold
     bool enable_battery_monitoring;   // Enable battery voltage monitoring
+    float battery_capacity_mah;       // Rated battery capacity for runtime projection
 };
 
 /**
  * @brief Power statistics
  */
 struct PowerStats {
-    uint32_t total_active_time_ms;    // Total time in active mode
-    uint32_t total_sleep_time_ms;     // Total time in sleep mode
+    uint32_t total_active_time_ms;    // Time in ACTIVE + LOW_POWER
+    uint32_t total_sleep_time_ms;     // Time in SLEEP + DEEP_SLEEP (incl. idle light sleep)
     uint32_t wake_count;              // Number of wake-ups
-    float average_current_ma;         // Average current consumption
+    float average_current_ma;         // Average current since power-on
     float peak_current_ma;            // Peak current consumption
     float battery_voltage;            // Current battery voltage
     uint8_t battery_percentage;       // Battery percentage (0-100)
+    
+    // Accumulated since power-on, including time in deep sleep
+    uint32_t mode_time_ms[POWER_MODE_COUNT];            // Residency, indexed by PowerMode
+    float subsystem_mah[POWER_SUBSYSTEM_COUNT];         // Charge, indexed by PowerSubsystem
+    float total_mah;                                    // Sum of subsystem_mah
+    float projected_runtime_hours;                      // Remaining capacity / average current
 };
 
 /**
@@ -79,6 +110,12 @@ public:
      */
     bool initialize();
     
+    /**
+     * @brief Apply new settings without resetting statistics or energy totals
+     * @param config New power configuration
+     */
+    void configure(const PowerConfig& config);
+    
     /**
      * @brief Set power mode
      * @param mode Power mode to set
@@ -98,9 +135,21 @@ public:
      */
     void sleep(uint32_t duration_ms, WakeSource wake_source = WakeSource::TIMER);
     
+    /**
+     * @brief Wait until the next deadline, in light sleep when worthwhile
+     * @param duration_ms Time until the next scheduled work
+     *
+     * Unlike sleep() this leaves the power mode and activity timer alone;
+     * it is the idle step between SleepScheduler deadlines.
+     */
+    void idle(uint32_t duration_ms);
+    
     /**
      * @brief Enter deep sleep mode (CPU resets on wake)
-     * @param duration_ms Sleep duration in milliseconds
+     * @param duration_ms Sleep duration in milliseconds (0 = until the ULP wakes the CPU)
+     *
+     * With ULP sampling enabled the ULP keeps sampling light and wakes the
+     * CPU on a light change or when its buffer is full.
      */
     void deepSleep(uint32_t duration_ms);
     
@@ -127,6 +176,35 @@ public:
      */
     PowerStats getPowerStats() const;
     
+    /**
+     * @brief Report a subsystem's busy time for energy attribution
+     * @param subsystem ADC, FLASH or RADIO
+     * @param total_active_us Free-running busy counter kept by the driver (wraps)
+     *
+     * The time since the previous report is charged at the subsystem's
+     * typical current on top of the CPU.
+     */
+    void updateSubsystemTime(PowerSubsystem subsystem, uint32_t total_active_us);
+    
+    /**
+     * @brief Take a lease on the radio (callable from any task)
+     * @return false if the battery is too low for a transmission
+     *
+     * While a lease is held WiFi is not stopped, idle() does not light
+     * sleep and the system does not enter deep sleep on inactivity.
+     */
+    bool acquireRadio();
+    
+    /**
+     * @brief Return a lease taken with acquireRadio()
+     */
+    void releaseRadio();
+    
+    /**
+     * @brief Check if any task holds the radio
+     */
+    bool isRadioActive() const;
+    
     /**
      * @brief Set power event callback
      * @param callback Function to call on power events
@@ -158,6 +236,23 @@ public:
      */
     void setWakeOnLight(bool enable, float threshold = 0.1f);
     
+    /**
+     * @brief Record the latest light level (baseline for ULP wake-up)
+     * @param raw_value Normalised ADC reading (0.0 - 1.0)
+     */
+    void updateLightLevel(float raw_value);
+    
+    /**
+     * @brief Set the ADC1 pin the ULP samples during deep sleep
+     * @param adc_pin GPIO of the light sensor
+     */
+    void setLightSensorPin(uint8_t adc_pin);
+    
+    /**
+     * @brief Get the ULP sampler (samples taken during the last deep sleep)
+     */
+    UlpSampler& getUlpSampler();
+    
     /**
      * @brief Record user activity (resets sleep timer)
      */
@@ -178,6 +273,16 @@ private:
     uint32_t sleep_start_time_ms_;
     bool wake_on_light_enabled_;
     float last_light_level_;
+    uint8_t light_sensor_pin_;
+    UlpSampler ulp_sampler_;
+    std::atomic<uint8_t> radio_leases_;
+    
+    // Energy accounting (charge in uA*us, exact integer sums)
+    uint32_t last_account_ms_;
+    uint32_t cpu_freq_mhz_;         // Clock the time since last_account_ms_ ran at
+    uint64_t mode_time_ms_[POWER_MODE_COUNT];
+    uint64_t subsystem_charge_[POWER_SUBSYSTEM_COUNT];
+    uint32_t last_subsystem_us_[POWER_SUBSYSTEM_COUNT];
     
     void configureHardwareForMode(PowerMode mode);
     void setCpuFrequency(uint32_t freq_mhz);
@@ -185,6 +290,12 @@ private:
     void enableEssentialPeripherals();
     void updatePowerStats();
     float calculateCurrentConsumption() const;
+    void accountElapsed();
+    void accountSleep(PowerMode mode, uint32_t duration_ms, bool ulp_running);
+    void chargeSubsystem(PowerSubsystem subsystem, uint32_t current_ua, uint64_t duration_us);
+    void saveEnergyState(bool ulp_running);
+    void restoreEnergyState();
+    bool isUlpSamplingEnabled() const;
 };
 
 }  // namespace LightSensor
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <freertos/FreeRTOS.h>
+#include "timer.h"
+
+// Probes compile in only with -DLS_ENABLE_PROFILING=1
+#ifndef LS_ENABLE_PROFILING
+#define LS_ENABLE_PROFILING 0
+#endif
+
+namespace LightSensor {
+
+/**
+ * @brief Instrumented hot-path sections
+ */
+enum class ProfileProbe : uint8_t {
+    SENSOR_READ,            // ADCLightSensor::read
+    SIGNAL_PROCESS,         // SignalProcessor::processReading
+    SIGNAL_PROCESS_BLOCK,   // SignalProcessor::processBlock
+    LOGGER_FLUSH,           // DataLogger::flush
+    STORAGE_WRITE,          // SPIFFSDataStorage::write
+    STORAGE_WRITE_BATCH,    // SPIFFSDataStorage::writeBatch
+    CONFIG_LOAD,            // ConfigManager::loadConfig
+    SPECTRAL_ANALYSIS       // SpectralAnalyzer, one block
+};
+
+static const size_t PROFILE_PROBE_COUNT = 8;
+
+/**
+ * @brief Summary of one probe, in CPU cycles
+ */
+struct ProfileStats {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t mean_cycles;
+    uint32_t p99_cycles;    // Upper edge of the histogram bucket holding the 99th percentile
+};
+
+/**
+ * @brief Fixed-size table of cycle-count histograms, one per probe
+ *
+ * Each probe keeps count/min/max/sum and a log-linear histogram (four
+ * buckets per power of two, so a percentile overstates the true value by
+ * at most 25%). Nothing is allocated; recording takes a short spinlock
+ * so probes may run on either core.
+ */
+class Profiler {
+public:
+    static const uint8_t SUB_BUCKET_BITS = 2;
+    static const size_t HISTOGRAM_BUCKETS = (32 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    static Profiler& getInstance();
+
+    /**
+     * @brief Add one measurement to a probe
+     * @param probe Probe to update
+     * @param cycles Duration in CPU cycles
+     */
+    void record(ProfileProbe probe, uint32_t cycles);
+
+    ProfileStats getStats(ProfileProbe probe) const;
+
+    /**
+     * @brief Clear every probe
+     */
+    void reset();
+
+    /**
+     * @brief Print one CSV line per probe that has samples
+     *
+     * Format: profile,<probe>,<count>,<min>,<mean>,<p99>,<max>,<cpu_mhz>
+     * with durations in cycles.
+     */
+    void dump() const;
+
+    static const char* probeName(ProfileProbe probe);
+
+private:
+    Profiler();
+
+    // Prevent copying
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    struct ProbeData {
+        uint32_t count;
+        uint32_t min_cycles;
+        uint32_t max_cycles;
+        uint64_t total_cycles;
+        uint32_t histogram[HISTOGRAM_BUCKETS];
+    };
+
+    ProbeData probes_[PROFILE_PROBE_COUNT];
+    mutable portMUX_TYPE lock_;
+
+    static size_t bucketIndex(uint32_t cycles);
+    static uint32_t bucketUpperBound(size_t index);
+};
+
+/**
+ * @brief Records the cycles spent in its scope to a probe
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileProbe probe) : probe_(probe), start_cycles_(Timer::cycleCount()) {}
+    ~ProfileScope() { Profiler::getInstance().record(probe_, Timer::cycleCount() - start_cycles_); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfileProbe probe_;
+    uint32_t start_cycles_;
+};
+
+}  // namespace LightSensor
+
+#define LS_PROFILE_CONCAT_INNER(a, b) a##b
+#define LS_PROFILE_CONCAT(a, b) LS_PROFILE_CONCAT_INNER(a, b)
+
+#if LS_ENABLE_PROFILING
+#define LS_PROFILE_SCOPE(probe) \
+    ::LightSensor::ProfileScope LS_PROFILE_CONCAT(ls_profile_scope_, __LINE__)(::LightSensor::ProfileProbe::probe)
+#else
+#define LS_PROFILE_SCOPE(probe) do {} while (0)
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "data_logger.h"
+#include <cstdint>
+#include <cstddef>
+#include <FS.h>
+
+namespace LightSensor {
+
+static const uint32_t ROLLUP_MAGIC = 0x5253534C;   // "LSSR" little-endian
+static const uint16_t ROLLUP_VERSION = 1;
+
+// Upper bound on buckets per tier file (24 bytes each)
+static const uint32_t MAX_ROLLUP_BUCKETS = 8192;
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Rollup file header, followed by capacity RollupBucket slots
+ */
+struct RollupFileHeader {
+    uint32_t magic;             // ROLLUP_MAGIC
+    uint16_t version;           // ROLLUP_VERSION
+    uint16_t header_size;       // sizeof(RollupFileHeader)
+    uint16_t bucket_size;       // sizeof(RollupBucket)
+    uint16_t reserved;
+    uint32_t bucket_ms;         // Tier length
+    uint32_t capacity;          // Slots in the ring
+    uint64_t last_time_ms;      // Newest log time written, so time stays monotonic across boots
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(RollupBucket) == 24, "RollupBucket is stored as-is");
+
+/**
+ * @brief Per-minute and per-hour lux summaries on flash
+ *
+ * Each tier is one preallocated file used as a ring: the bucket starting
+ * at time t lives in slot (t / bucket_ms) % capacity, so a tier keeps
+ * exactly its retention window and old buckets are overwritten in place
+ * without deleting anything. A bucket is written when it closes; at the
+ * same time the open buckets of the coarser tiers are checkpointed, so a
+ * reset loses at most the current minute.
+ *
+ * Files: <log_file_path>/rollup_1m.dat and <log_file_path>/rollup_1h.dat.
+ */
+class RollupStore {
+public:
+    explicit RollupStore(const LoggerConfig& config);
+    ~RollupStore();
+
+    /**
+     * @brief Open (or create) the tier files and resume their open buckets
+     * @return false if no tier could be opened
+     */
+    bool initialize();
+
+    /**
+     * @brief Add readings to every tier
+     * @param data Readings, oldest first
+     * @param count Number of readings
+     */
+    void addBatch(const SensorReading* data, size_t count);
+
+    /**
+     * @brief Write the open buckets and close the files
+     */
+    void close();
+
+    /**
+     * @brief Apply new logger settings
+     * @return false if the path, backend or a retention changed (the store must be re-created)
+     */
+    bool configure(const LoggerConfig& config);
+
+    /**
+     * @brief Deliver the non-empty buckets overlapping a time range, oldest first
+     */
+    size_t query(RollupTier tier, uint64_t from_ms, uint64_t to_ms, const RollupCallback& callback);
+
+    /**
+     * @brief File path of a tier
+     */
+    void tierPath(RollupTier tier, char* buffer, size_t buffer_size) const;
+
+private:
+    static const size_t IO_CHUNK_BUCKETS = 16;
+
+    struct Tier {
+        File file;
+        uint32_t bucket_ms;
+        uint32_t capacity;        // 0 = tier disabled
+        RollupBucket open;
+        double lux_sum;           // Sum behind open.mean_lux
+    };
+
+    LoggerConfig config_;
+    fs::FS& fs_;              // Same filesystem as the raw log
+    bool is_initialized_;
+    Tier tiers_[ROLLUP_TIER_COUNT];
+    uint64_t last_time_ms_;
+
+    bool openTier(RollupTier tier, uint32_t retention_days);
+    bool createTierFile(const char* path, const RollupFileHeader& header);
+    void resumeTier(Tier& tier);
+    void add(uint64_t time_ms, float lux);
+    void closeBucket(size_t tier_index);
+    bool writeBucket(Tier& tier, const RollupBucket& bucket);
+    bool writeLastTime(Tier& tier);
+    size_t slotOffset(const Tier& tier, uint64_t bucket_index) const;
+    static uint32_t retentionDays(const LoggerConfig& config, RollupTier tier);
+};
+
+}  // namespace LightSensor
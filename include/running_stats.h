@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+namespace LightSensor {
+
+/**
+ * @brief Sliding-window mean/variance with O(1) updates (fixed-size buffer)
+ *
+ * Welford-style add/replace: once the window is full each new value
+ * replaces the oldest one and the moments are adjusted in place. The sums
+ * are recomputed from the buffer once per window to stop rounding drift,
+ * which keeps the amortised cost constant.
+ */
+template <size_t Capacity>
+class RunningStats {
+public:
+    explicit RunningStats(size_t window_size = Capacity) {
+        setWindowSize(window_size);
+    }
+
+    void setWindowSize(size_t window_size) {
+        window_size_ = window_size == 0 ? 1 : (window_size < Capacity ? window_size : Capacity);
+        reset();
+    }
+
+    void reset() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            buffer_[i] = 0.0f;
+        }
+        index_ = 0;
+        count_ = 0;
+        mean_ = 0.0f;
+        m2_ = 0.0f;
+    }
+
+    void add(float value) {
+        if (count_ < window_size_) {
+            count_++;
+            float delta = value - mean_;
+            mean_ += delta / count_;
+            m2_ += delta * (value - mean_);
+        } else {
+            float old_value = buffer_[index_];
+            float old_mean = mean_;
+            mean_ += (value - old_value) / count_;
+            m2_ += (value - old_value) * (value - mean_ + old_value - old_mean);
+        }
+
+        buffer_[index_] = value;
+        index_ = (index_ + 1) % window_size_;
+
+        if (index_ == 0) {
+            resync();
+        }
+        if (m2_ < 0.0f) {
+            m2_ = 0.0f;
+        }
+    }
+
+    size_t count() const { return count_; }
+    float mean() const { return mean_; }
+
+    /**
+     * @brief Sample variance (n - 1 denominator)
+     */
+    float variance() const {
+        return count_ < 2 ? 0.0f : m2_ / (count_ - 1);
+    }
+
+    float stdDev() const {
+        return sqrtf(variance());
+    }
+
+private:
+    float buffer_[Capacity];
+    size_t window_size_;
+    size_t index_;
+    size_t count_;
+    float mean_;
+    float m2_;
+
+    void resync() {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count_; ++i) {
+            sum += buffer_[i];
+        }
+        mean_ = sum / count_;
+
+        float m2 = 0.0f;
+        for (size_t i = 0; i < count_; ++i) {
+            float diff = buffer_[i] - mean_;
+            m2 += diff * diff;
+        }
+        m2_ = m2;
+    }
+};
+
+/**
+ * @brief Sliding-window least-squares line fit with O(1) updates
+ *
+ * x is the sample position in the window (0 = oldest). When the window
+ * slides every x shifts down by one, which only needs the running sum of y
+ * to correct sum(x*y). Values are stored relative to a pivot taken at each
+ * resync so the sums stay small and float cancellation does not hide slope.
+ */
+template <size_t Capacity>
+class RunningRegression {
+public:
+    explicit RunningRegression(size_t window_size = Capacity) {
+        setWindowSize(window_size);
+    }
+
+    void setWindowSize(size_t window_size) {
+        window_size_ = window_size == 0 ? 1 : (window_size < Capacity ? window_size : Capacity);
+        reset();
+    }
+
+    void reset() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            buffer_[i] = 0.0f;
+        }
+        index_ = 0;
+        count_ = 0;
+        pivot_ = 0.0f;
+        sum_y_ = 0.0f;
+        sum_xy_ = 0.0f;
+        sum_yy_ = 0.0f;
+    }
+
+    void add(float value) {
+        if (count_ == 0) {
+            pivot_ = value;
+        }
+
+        float y = value - pivot_;
+
+        if (count_ < window_size_) {
+            sum_xy_ += static_cast<float>(count_) * y;
+            sum_y_ += y;
+            sum_yy_ += y * y;
+            count_++;
+        } else {
+            float oldest = buffer_[index_] - pivot_;
+            sum_xy_ = sum_xy_ - (sum_y_ - oldest) + static_cast<float>(count_ - 1) * y;
+            sum_y_ += y - oldest;
+            sum_yy_ += y * y - oldest * oldest;
+        }
+
+        buffer_[index_] = value;
+        index_ = (index_ + 1) % window_size_;
+
+        if (index_ == 0) {
+            resync();
+        }
+    }
+
+    size_t count() const { return count_; }
+
+    /**
+     * @brief Sum of squared x deviations, sum((x - x_mean)^2)
+     */
+    float xDenominator() const {
+        float n = static_cast<float>(count_);
+        return n * (n * n - 1.0f) / 12.0f;
+    }
+
+    /**
+     * @brief Sum of squared y deviations, sum((y - y_mean)^2)
+     */
+    float yDenominator() const {
+        if (count_ == 0) {
+            return 0.0f;
+        }
+        float value = sum_yy_ - sum_y_ * sum_y_ / count_;
+        return value > 0.0f ? value : 0.0f;
+    }
+
+    /**
+     * @brief Cross deviation sum, sum((x - x_mean) * (y - y_mean))
+     */
+    float numerator() const {
+        if (count_ == 0) {
+            return 0.0f;
+        }
+        float x_mean = (count_ - 1) / 2.0f;
+        return sum_xy_ - x_mean * sum_y_;
+    }
+
+private:
+    float buffer_[Capacity];
+    size_t window_size_;
+    size_t index_;
+    size_t count_;
+    float pivot_;
+    float sum_y_;
+    float sum_xy_;
+    float sum_yy_;
+
+    // Called when index_ wraps, so buffer_[0] is the oldest sample
+    void resync() {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count_; ++i) {
+            sum += buffer_[i];
+        }
+        pivot_ = sum / count_;
+
+        sum_y_ = 0.0f;
+        sum_xy_ = 0.0f;
+        sum_yy_ = 0.0f;
+        for (size_t i = 0; i < count_; ++i) {
+            float y = buffer_[i] - pivot_;
+            sum_y_ += y;
+            sum_xy_ += static_cast<float>(i) * y;
+            sum_yy_ += y * y;
+        }
+    }
+};
+
+}  // namespace LightSensor
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "data_logger.h"
+#include <cstdint>
+#include <cstddef>
+#include <FS.h>
+
+namespace LightSensor {
+
+static const uint32_t SEGMENT_MAGIC = 0x4753534C;           // "LSSG" little-endian
+static const uint32_t SEGMENT_FOOTER_MAGIC = 0x4653534C;    // "LSSF"
+static const uint32_t SEGMENT_MANIFEST_MAGIC = 0x4D53534C;  // "LSSM"
+static const uint16_t SEGMENT_VERSION = 1;
+
+// One index entry per this many records
+static const uint16_t SEGMENT_INDEX_INTERVAL = 64;
+
+// Upper bound on records per segment (sets the in-RAM index size)
+static const uint32_t MAX_SEGMENT_RECORDS = 4096;
+static const size_t MAX_SEGMENT_INDEX_ENTRIES = MAX_SEGMENT_RECORDS / SEGMENT_INDEX_INTERVAL;
+
+// Sealed segments tracked by the manifest; the oldest is deleted beyond this
+static const size_t MAX_SEGMENTS = 64;
+
+// LittleFS backend: partition (see partitions.csv), mount point and write unit
+static constexpr const char* LOG_PARTITION_LABEL = "logfs";
+static constexpr const char* LOG_PARTITION_MOUNT = "/logfs";
+static const size_t FLASH_PAGE_SIZE = 4096;   // LittleFS block = flash erase sector
+static const uint32_t MAX_STAGED_MS = 300000; // flush() writes a partial page staged this long
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Segment file header (little-endian, written when the segment opens)
+ */
+struct SegmentHeader {
+    uint32_t magic;             // SEGMENT_MAGIC
+    uint16_t version;           // SEGMENT_VERSION
+    uint16_t header_size;       // sizeof(SegmentHeader)
+    uint16_t record_size;       // sizeof(SegmentRecord)
+    uint16_t index_interval;    // SEGMENT_INDEX_INTERVAL
+    uint32_t sequence;          // Segment number, increasing across boots
+    uint64_t base_time_ms;      // Log time SegmentRecord::offset_ms is relative to
+    float lux_scale;            // Lux per LSB of SegmentRecord::lux
+    float reference_voltage;    // voltage = raw_code / 65535 * reference_voltage
+    float dark_offset;          // Calibration dark offset (V)
+    float sensitivity;          // Calibration sensitivity
+};
+
+/**
+ * @brief Fixed-size reading record, so record i sits at header_size + i * record_size
+ */
+struct SegmentRecord {
+    uint32_t offset_ms;         // Log time - SegmentHeader::base_time_ms
+    uint16_t raw_code;          // raw_value quantised to 16 bits
+    uint32_t lux;               // lux_value / lux_scale
+    uint8_t quality;            // Signal quality (0-100)
+};
+
+/**
+ * @brief Every SEGMENT_INDEX_INTERVAL-th record: where it is and when it was taken
+ */
+struct SegmentIndexEntry {
+    uint32_t offset_ms;         // Record time relative to base_time_ms
+    uint32_t file_offset;       // Byte offset of the record in the file
+};
+
+/**
+ * @brief Time range and lux summary of one segment
+ */
+struct SegmentSummary {
+    uint32_t sequence;
+    uint32_t record_count;
+    uint64_t first_time_ms;
+    uint64_t last_time_ms;
+    float min_lux;
+    float max_lux;
+    float avg_lux;
+};
+
+/**
+ * @brief Written when a segment is sealed, after its index entries
+ *
+ * Layout from the end of the file: footer, then index_count entries
+ * immediately before it.
+ */
+struct SegmentFooter {
+    SegmentSummary summary;
+    uint16_t index_count;
+    uint16_t index_interval;
+    uint32_t magic;             // SEGMENT_FOOTER_MAGIC
+};
+
+/**
+ * @brief Manifest file header, followed by segment_count summaries (oldest first)
+ */
+struct SegmentManifestHeader {
+    uint32_t magic;             // SEGMENT_MANIFEST_MAGIC
+    uint16_t version;           // SEGMENT_VERSION
+    uint16_t segment_count;
+    uint32_t next_sequence;     // Sequence the next segment will get
+    uint32_t open_sequence;     // Segment being written when the manifest was saved (0 = none)
+    uint64_t last_time_ms;      // Newest log time stored, so time stays monotonic across boots
+};
+
+#pragma pack(pop)
+
+/**
+ * @brief Time-indexed segment store
+ *
+ * Readings are appended as fixed-size records to the open segment. After
+ * a fixed number of records (derived from max_file_size_bytes) it is sealed:
+ * the index and a footer with its time range and lux summary are appended,
+ * and the summary goes into the manifest. query() uses the manifest to
+ * pick segments and each index to seek straight to the first record of the
+ * range. Retention deletes whole segments older than max_log_days.
+ *
+ * Times are LogClock times, which stay monotonic across reboots and deep
+ * sleep; on initialize() the clock is moved past the newest stored record.
+ *
+ * With StorageBackend::LITTLEFS the segments live on their own LittleFS
+ * partition and bytes are staged in RAM until a whole FLASH_PAGE_SIZE page
+ * can be written, so LittleFS programs full blocks instead of copying a
+ * partly written block on every append. flush() leaves a partial page
+ * staged until it is MAX_STAGED_MS old; sync() (close, query, deep sleep)
+ * writes it at once. A reset loses what is staged, at most one page.
+ *
+ * Free space is read from the filesystem once, in initialize(), and kept
+ * up to date from then on: the full size of a segment is reserved when it
+ * opens, trued up when it is sealed and released when it is deleted.
+ *
+ * log_format and enable_compression do not apply to this backend.
+ */
+class SegmentDataStorage : public IDataStorage {
+public:
+    explicit SegmentDataStorage(const LoggerConfig& config);
+    ~SegmentDataStorage() override;
+
+    bool initialize() override;
+    bool write(const SensorReading& data) override;
+    bool writeBatch(const SensorReading* data, size_t count) override;
+    bool flush() override;
+    bool sync() override;
+    void close() override;
+    size_t getAvailableSpace() const override;
+    void setCalibration(const SensorConfig& sensor) override;
+    bool configure(const LoggerConfig& config) override;
+    size_t query(uint64_t from_ms, uint64_t to_ms, const QueryCallback& callback) override;
+
+    /**
+     * @brief Sealed segments, oldest first
+     */
+    size_t getSegmentCount() const;
+    bool getSegment(size_t index, SegmentSummary& summary) const;
+
+    /**
+     * @brief File path of a segment
+     */
+    void segmentPath(uint32_t sequence, char* buffer, size_t buffer_size) const;
+    static void formatSegmentPath(const char* directory, uint32_t sequence, char* buffer, size_t buffer_size);
+
+    /**
+     * @brief Filesystem the segment files of a backend live on
+     */
+    static fs::FS& filesystem(StorageBackend backend);
+
+    /**
+     * @brief Mount the filesystem of a backend (formatting it if the mount fails)
+     */
+    static bool mount(StorageBackend backend);
+
+    /**
+     * @brief Size of the flash partition a backend lives on, 0 when the table has none
+     */
+    static size_t partitionSize(StorageBackend backend);
+
+private:
+    static const size_t WRITE_CHUNK_RECORDS = 64;
+    static const size_t READ_CHUNK_RECORDS = 32;
+
+    LoggerConfig config_;
+    bool is_initialized_;
+    uint32_t segment_records_;     // Records before a segment is sealed
+    fs::FS& fs_;
+    bool paged_;                   // Write whole FLASH_PAGE_SIZE pages (LittleFS)
+
+    // Tracked free space (see getAvailableSpace)
+    size_t total_bytes_;
+    size_t used_bytes_;
+
+    // Calibration recorded in new segment headers
+    float reference_voltage_;
+    float dark_offset_;
+    float sensitivity_;
+
+    // Newest stored time; records are never written before it
+    uint64_t last_time_ms_;
+
+    // Manifest (sealed segments, oldest first)
+    SegmentSummary segments_[MAX_SEGMENTS];
+    size_t segment_count_;
+    uint32_t next_sequence_;
+
+    // Open segment
+    File file_;
+    SegmentHeader header_;
+    SegmentSummary open_;
+    float open_lux_sum_;
+    SegmentIndexEntry index_[MAX_SEGMENT_INDEX_ENTRIES];
+    size_t index_count_;
+    size_t open_bytes_;            // File size of the open segment, staged bytes included
+    size_t open_reserved_;         // Flash counted in used_bytes_ for the open segment
+
+    // Paged mode: the page being filled and how much of it is already on flash
+    uint8_t* page_;
+    size_t page_fill_;
+    size_t page_written_;
+    uint32_t staged_since_ms_;     // When the first unwritten byte of the page was staged
+
+    bool openSegment(uint64_t base_time_ms);
+    bool sealSegment();
+    bool appendRecords(const SensorReading* data, size_t count);
+    bool writeRecords(const SegmentRecord* records, size_t count);
+    bool writeBytes(const uint8_t* data, size_t length);
+    bool writePage();
+    void addToSummary(const SegmentRecord& record, uint64_t time_ms);
+    bool recoverSegment(uint32_t sequence);
+    void enforceRetention();
+    size_t segmentBytes() const;
+    size_t segmentFileBytes(uint32_t record_count) const;
+    size_t flashBytes(size_t file_bytes) const;
+    void readSpace();
+    void releaseSpace(size_t bytes);
+    void deleteOldestSegment();
+    bool loadManifest(uint32_t& open_sequence);
+    bool saveManifest(uint32_t open_sequence);
+
+    size_t querySegment(File& file, const SegmentHeader& header, const SegmentIndexEntry* index,
+                        size_t index_count, uint32_t record_count, uint64_t from_ms, uint64_t to_ms,
+                        const QueryCallback& callback, bool& stop);
+    bool readSealedIndex(File& file, SegmentFooter& footer, SegmentIndexEntry* index) const;
+
+    void manifestPath(char* buffer, size_t buffer_size, bool temporary) const;
+    SegmentRecord encodeRecord(const SensorReading& reading, uint64_t offset_ms) const;
+    static SensorReading decodeRecord(const SegmentRecord& record, uint64_t time_ms, float reference_voltage);
+};
+
+}  // namespace LightSensor
@@ -1,15 +1,39 @@
 #pragma once
 
 #include "light_sensor.h"
+#include "running_stats.h"
+#include "fixed_point.h"
+#include "spectral_analyzer.h"
+#include "static_arena.h"
 #include <cstdint>
 #include <cmath>
 #include <algorithm>
+#include <tuple>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 namespace LightSensor {
 
 // Maximum buffer sizes for ESP32 memory constraints
 static const size_t MAX_FILTER_WINDOW = 16;
 static const size_t MAX_RECENT_VALUES = 20;
+static const size_t MAX_MEDIAN_WINDOW = 63;
+static const size_t MAX_TREND_WINDOW = 64;
+static const size_t MAX_FILTER_STAGES = 4;
+
+/**
+ * @brief Digital filter types
+ */
+enum class FilterType {
+    MOVING_AVERAGE,
+    LOW_PASS,
+    HIGH_PASS,
+    MEDIAN,
+    ADAPTIVE
+};
 
 /**
  * @brief Signal processing configuration
@@ -37,6 +61,23 @@ struct SignalConfig {
     bool enable_adaptive_filter;
     float adaptation_rate;
     float noise_floor;
+    
+    // Filter chain order (stages run first to last)
+    FilterType filter_order[MAX_FILTER_STAGES];
+    uint8_t filter_stage_count;
+    
+    // Run the filter chain in Q16 fixed point on SensorReading::raw_q16
+    bool use_fixed_point;
+    
+    // FFT flicker analysis over blocks of SPECTRAL_BLOCK_SIZE readings
+    bool enable_spectral_analysis;
+    
+    // EventDetector: threshold crossings (0 = threshold unused), peaks,
+    // outliers and trend reversals
+    bool enable_events;
+    float event_low_lux;
+    float event_high_lux;
+    float event_hysteresis_lux;
 };
 
 /**
@@ -51,85 +92,632 @@ struct SignalAnalysis {
     float trend_slope;
     float trend_confidence;
     uint8_t quality_score;
-};
-
-/**
- * @brief Digital filter types
- */
-enum class FilterType {
-    MOVING_AVERAGE,
-    LOW_PASS,
-    HIGH_PASS,
-    MEDIAN,
-    ADAPTIVE
+    
+    // Last complete spectral block (0 while disabled or before the first block)
+    float dominant_frequency_hz;
+    float flicker_percent;
+    float flicker_index;
 };
 
 /**
  * @brief Moving average filter (fixed-size buffer)
+ *
+ * T is float or a Fixed<> type; the sum is kept in NumericTraits<T>::accum_type
+ * and scaled by a cached reciprocal, so a full window costs no division.
  */
-class MovingAverageFilter {
+template <typename T>
+class BasicMovingAverageFilter {
 public:
-    explicit MovingAverageFilter(uint8_t window_size);
-    float process(float input);
+    using value_type = T;
+    
+    explicit BasicMovingAverageFilter(uint8_t window_size);
+    T process(T input);
+    void processBlock(T* values, size_t count);
     void reset();
     
+    /**
+     * @brief Change the window (restarts the filter only if it differs)
+     */
+    void setWindowSize(uint8_t window_size);
+    
 private:
+    using Traits = NumericTraits<T>;
+    
     uint8_t window_size_;
-    float buffer_[MAX_FILTER_WINDOW];
+    T buffer_[MAX_FILTER_WINDOW];
     size_t buffer_index_;
     size_t buffer_count_;
-    float sum_;
+    typename Traits::accum_type sum_;
+    T reciprocal_;              // 1 / buffer_count_
 };
 
 /**
  * @brief Low-pass filter
  */
-class LowPassFilter {
+template <typename T>
+class BasicLowPassFilter {
 public:
-    LowPassFilter(float cutoff_freq, float sample_rate);
-    float process(float input);
+    using value_type = T;
+    
+    BasicLowPassFilter(float cutoff_freq, float sample_rate);
+    T process(T input);
+    void processBlock(T* values, size_t count);
     void reset();
     
+    /**
+     * @brief Retune the cutoff, keeping the current output
+     */
+    void setCutoff(float cutoff_freq, float sample_rate);
+    
 private:
-    float alpha_;
-    float prev_output_;
+    T alpha_;
+    T prev_output_;
 };
 
 /**
- * @brief Median filter (fixed-size buffer)
+ * @brief Sliding-window median filter (fixed-size buffer)
+ *
+ * Keeps the window sorted and updates it incrementally: each sample is
+ * located by binary search and replaces the value leaving the window with
+ * a single shift, instead of re-sorting the whole window.
  */
-class MedianFilter {
+template <typename T>
+class BasicMedianFilter {
 public:
-    explicit MedianFilter(uint8_t window_size);
-    float process(float input);
+    using value_type = T;
+    
+    explicit BasicMedianFilter(uint8_t window_size);
+    T process(T input);
+    void processBlock(T* values, size_t count);
     void reset();
     
+    /**
+     * @brief Change the window (restarts the filter only if it differs)
+     */
+    void setWindowSize(uint8_t window_size);
+    
 private:
+    using Traits = NumericTraits<T>;
+    
     uint8_t window_size_;
-    float buffer_[MAX_FILTER_WINDOW];
-    float sorted_buffer_[MAX_FILTER_WINDOW];
+    T buffer_[MAX_MEDIAN_WINDOW];
+    T sorted_buffer_[MAX_MEDIAN_WINDOW];
     size_t buffer_index_;
     size_t buffer_count_;
+    
+    void replaceSorted(T old_value, T new_value);
+    void insertSorted(T value);
 };
 
 /**
  * @brief Adaptive filter
  */
-class AdaptiveFilter {
+template <typename T>
+class BasicAdaptiveFilter {
 public:
-    AdaptiveFilter(float adaptation_rate, float noise_floor);
-    float process(float input);
+    using value_type = T;
+    
+    BasicAdaptiveFilter(float adaptation_rate, float noise_floor);
+    T process(T input);
+    void processBlock(T* values, size_t count);
     void reset();
     void updateParameters(float adaptation_rate, float noise_floor);
     
 private:
-    float adaptation_rate_;
-    float noise_floor_;
-    float filter_coefficient_;
-    float prev_output_;
-    float error_variance_;
+    using Traits = NumericTraits<T>;
+    
+    T adaptation_rate_;
+    typename Traits::square_type noise_floor_;
+    T coefficient_step_;        // adaptation_rate * 0.1
+    T filter_coefficient_;
+    T prev_output_;
+    typename Traits::square_type error_variance_;
+};
+
+// Float filters used by the default signal path
+using MovingAverageFilter = BasicMovingAverageFilter<float>;
+using LowPassFilter = BasicLowPassFilter<float>;
+using MedianFilter = BasicMedianFilter<float>;
+using AdaptiveFilter = BasicAdaptiveFilter<float>;
+
+/**
+ * @brief Filter chain composed at compile time
+ *
+ * Each stage is a filter with value_type, process(value_type) and
+ * processBlock(value_type*, size_t), e.g. FilterChain<MedianFilter, LowPassFilter>
+ * or FilterChain<BasicMedianFilter<Q16>, BasicLowPassFilter<Q16>>. Stages not
+ * listed are not compiled in, and the whole chain can be inlined.
+ */
+template <typename... Stages>
+class FilterChain {
+public:
+    using value_type = typename std::tuple_element<0, std::tuple<Stages...>>::type::value_type;
+    
+    explicit FilterChain(const Stages&... stages) : stages_(stages...) {}
+    
+    value_type process(value_type input) {
+        return processStages(input, std::index_sequence_for<Stages...>{});
+    }
+    
+    void processBlock(value_type* values, size_t count) {
+        processBlockStages(values, count, std::index_sequence_for<Stages...>{});
+    }
+    
+    void reset() {
+        resetStages(std::index_sequence_for<Stages...>{});
+    }
+    
+    template <size_t Index>
+    typename std::tuple_element<Index, std::tuple<Stages...>>::type& stage() {
+        return std::get<Index>(stages_);
+    }
+    
+    static constexpr size_t size() {
+        return sizeof...(Stages);
+    }
+    
+private:
+    std::tuple<Stages...> stages_;
+    
+    template <size_t... Index>
+    value_type processStages(value_type value, std::index_sequence<Index...>) {
+        ((value = std::get<Index>(stages_).process(value)), ...);
+        return value;
+    }
+    
+    template <size_t... Index>
+    void processBlockStages(value_type* values, size_t count, std::index_sequence<Index...>) {
+        (std::get<Index>(stages_).processBlock(values, count), ...);
+    }
+    
+    template <size_t... Index>
+    void resetStages(std::index_sequence<Index...>) {
+        (std::get<Index>(stages_).reset(), ...);
+    }
 };
 
+/**
+ * @brief Filter chain configured at runtime from SignalConfig
+ *
+ * Stage order comes from SignalConfig::filter_order so it can be changed
+ * in the field; stages disabled by the configuration are skipped.
+ * configure() retunes stages in place, so filter state survives a config
+ * update unless a window size changes or a stage is switched back on.
+ */
+template <typename T>
+class BasicRuntimeFilterChain {
+public:
+    explicit BasicRuntimeFilterChain(const SignalConfig& config);
+    
+    T process(T input);
+    void processBlock(T* values, size_t count);
+    void configure(const SignalConfig& config);
+    void reset();
+    void setStageEnabled(FilterType filter_type, bool enable);
+    bool isStageEnabled(FilterType filter_type) const;
+    
+private:
+    BasicMovingAverageFilter<T> ma_filter_;
+    BasicLowPassFilter<T> lp_filter_;
+    BasicMedianFilter<T> median_filter_;
+    BasicAdaptiveFilter<T> adaptive_filter_;
+    
+    FilterType order_[MAX_FILTER_STAGES];
+    size_t stage_count_;
+    
+    bool ma_enabled_;
+    bool lp_enabled_;
+    bool median_enabled_;
+    bool adaptive_enabled_;
+};
+
+using RuntimeFilterChain = BasicRuntimeFilterChain<float>;
+
+// Stage bodies live in the header so FilterChain (and any value_type) can inline them
+// MovingAverageFilter Implementation
+template <typename T>
+BasicMovingAverageFilter<T>::BasicMovingAverageFilter(uint8_t window_size)
+    : window_size_(window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW),
+      buffer_index_(0), buffer_count_(0), sum_(), reciprocal_() {
+    if (window_size_ == 0) {
+        window_size_ = 1;
+    }
+    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
+        buffer_[i] = T();
+    }
+}
+
+template <typename T>
+T BasicMovingAverageFilter<T>::process(T input) {
+    // Remove old value from sum if buffer is full
+    if (buffer_count_ >= window_size_) {
+        sum_ -= Traits::widen(buffer_[buffer_index_]);
+    } else {
+        // Window still filling: the only divisions, once per new length
+        buffer_count_++;
+        reciprocal_ = Traits::fromFloat(1.0f / buffer_count_);
+    }
+    
+    // Add new value
+    buffer_[buffer_index_] = input;
+    sum_ += Traits::widen(input);
+    
+    if (++buffer_index_ >= window_size_) {
+        buffer_index_ = 0;
+    }
+    
+    return Traits::scale(sum_, reciprocal_);
+}
+
+template <typename T>
+void BasicMovingAverageFilter<T>::processBlock(T* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = process(values[i]);
+    }
+}
+
+template <typename T>
+void BasicMovingAverageFilter<T>::reset() {
+    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
+        buffer_[i] = T();
+    }
+    buffer_index_ = 0;
+    buffer_count_ = 0;
+    sum_ = typename Traits::accum_type();
+    reciprocal_ = T();
+}
+
+template <typename T>
+void BasicMovingAverageFilter<T>::setWindowSize(uint8_t window_size) {
+    uint8_t clamped = window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW;
+    if (clamped == 0) {
+        clamped = 1;
+    }
+    if (clamped != window_size_) {
+        window_size_ = clamped;
+        reset();
+    }
+}
+
+// LowPassFilter Implementation
+template <typename T>
+BasicLowPassFilter<T>::BasicLowPassFilter(float cutoff_freq, float sample_rate)
+    : prev_output_() {
+    setCutoff(cutoff_freq, sample_rate);
+}
+
+template <typename T>
+void BasicLowPassFilter<T>::setCutoff(float cutoff_freq, float sample_rate) {
+    float rc = 1.0f / (2.0f * M_PI * cutoff_freq);
+    float dt = 1.0f / sample_rate;
+    alpha_ = NumericTraits<T>::fromFloat(dt / (rc + dt));
+}
+
+template <typename T>
+T BasicLowPassFilter<T>::process(T input) {
+    // alpha * x + (1 - alpha) * y with a single multiply
+    prev_output_ += alpha_ * (input - prev_output_);
+    return prev_output_;
+}
+
+template <typename T>
+void BasicLowPassFilter<T>::processBlock(T* values, size_t count) {
+    // Keep state in registers across the block
+    T output = prev_output_;
+    const T alpha = alpha_;
+    for (size_t i = 0; i < count; ++i) {
+        output += alpha * (values[i] - output);
+        values[i] = output;
+    }
+    prev_output_ = output;
+}
+
+template <typename T>
+void BasicLowPassFilter<T>::reset() {
+    prev_output_ = T();
+}
+
+// MedianFilter Implementation
+template <typename T>
+BasicMedianFilter<T>::BasicMedianFilter(uint8_t window_size)
+    : window_size_(window_size < MAX_MEDIAN_WINDOW ? window_size : MAX_MEDIAN_WINDOW),
+      buffer_index_(0), buffer_count_(0) {
+    if (window_size_ == 0) {
+        window_size_ = 1;
+    }
+    for (size_t i = 0; i < MAX_MEDIAN_WINDOW; ++i) {
+        buffer_[i] = T();
+        sorted_buffer_[i] = T();
+    }
+}
+
+template <typename T>
+T BasicMedianFilter<T>::process(T input) {
+    if (Traits::isNaN(input)) {
+        return input;  // NaN would break the sorted order
+    }
+    
+    if (buffer_count_ >= window_size_) {
+        replaceSorted(buffer_[buffer_index_], input);
+    } else {
+        insertSorted(input);
+        buffer_count_++;
+    }
+    
+    buffer_[buffer_index_] = input;
+    buffer_index_ = (buffer_index_ + 1) % window_size_;
+    
+    if (buffer_count_ < 3) {
+        return input;
+    }
+    
+    if (buffer_count_ % 2 == 0) {
+        typename Traits::accum_type pair = Traits::widen(sorted_buffer_[buffer_count_ / 2 - 1]) +
+                                           Traits::widen(sorted_buffer_[buffer_count_ / 2]);
+        return Traits::scale(pair, Traits::fromFloat(0.5f));
+    } else {
+        return sorted_buffer_[buffer_count_ / 2];
+    }
+}
+
+template <typename T>
+void BasicMedianFilter<T>::replaceSorted(T old_value, T new_value) {
+    T* begin = sorted_buffer_;
+    T* end = sorted_buffer_ + buffer_count_;
+    T* old_pos = std::lower_bound(begin, end, old_value);
+    
+    if (new_value >= old_value) {
+        // Slide the values between old and new one slot down
+        T* insert_pos = std::upper_bound(old_pos + 1, end, new_value);
+        std::copy(old_pos + 1, insert_pos, old_pos);
+        *(insert_pos - 1) = new_value;
+    } else {
+        // Slide the values between new and old one slot up
+        T* insert_pos = std::upper_bound(begin, old_pos, new_value);
+        std::copy_backward(insert_pos, old_pos, old_pos + 1);
+        *insert_pos = new_value;
+    }
+}
+
+template <typename T>
+void BasicMedianFilter<T>::insertSorted(T value) {
+    T* begin = sorted_buffer_;
+    T* end = sorted_buffer_ + buffer_count_;
+    T* insert_pos = std::upper_bound(begin, end, value);
+    std::copy_backward(insert_pos, end, end + 1);
+    *insert_pos = value;
+}
+
+template <typename T>
+void BasicMedianFilter<T>::processBlock(T* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = process(values[i]);
+    }
+}
+
+template <typename T>
+void BasicMedianFilter<T>::reset() {
+    for (size_t i = 0; i < MAX_MEDIAN_WINDOW; ++i) {
+        buffer_[i] = T();
+        sorted_buffer_[i] = T();
+    }
+    buffer_index_ = 0;
+    buffer_count_ = 0;
+}
+
+template <typename T>
+void BasicMedianFilter<T>::setWindowSize(uint8_t window_size) {
+    uint8_t clamped = window_size < MAX_MEDIAN_WINDOW ? window_size : MAX_MEDIAN_WINDOW;
+    if (clamped == 0) {
+        clamped = 1;
+    }
+    if (clamped != window_size_) {
+        window_size_ = clamped;
+        reset();
+    }
+}
+
+// AdaptiveFilter Implementation
+template <typename T>
+BasicAdaptiveFilter<T>::BasicAdaptiveFilter(float adaptation_rate, float noise_floor)
+    : filter_coefficient_(Traits::fromFloat(0.5f)), prev_output_(), error_variance_() {
+    updateParameters(adaptation_rate, noise_floor);
+}
+
+template <typename T>
+T BasicAdaptiveFilter<T>::process(T input) {
+    const T MIN_COEFFICIENT = Traits::fromFloat(0.1f);
+    const T MAX_COEFFICIENT = Traits::fromFloat(0.9f);
+    
+    T error = input - prev_output_;
+    error_variance_ = Traits::blend(error_variance_, Traits::square(error), adaptation_rate_);
+    
+    if (error_variance_ > noise_floor_) {
+        filter_coefficient_ += coefficient_step_;
+        if (filter_coefficient_ > MAX_COEFFICIENT) {
+            filter_coefficient_ = MAX_COEFFICIENT;
+        }
+    } else {
+        filter_coefficient_ -= coefficient_step_;
+        if (filter_coefficient_ < MIN_COEFFICIENT) {
+            filter_coefficient_ = MIN_COEFFICIENT;
+        }
+    }
+    
+    prev_output_ += filter_coefficient_ * (input - prev_output_);
+    return prev_output_;
+}
+
+template <typename T>
+void BasicAdaptiveFilter<T>::processBlock(T* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = process(values[i]);
+    }
+}
+
+template <typename T>
+void BasicAdaptiveFilter<T>::reset() {
+    filter_coefficient_ = Traits::fromFloat(0.5f);
+    prev_output_ = T();
+    error_variance_ = typename Traits::square_type();
+}
+
+template <typename T>
+void BasicAdaptiveFilter<T>::updateParameters(float adaptation_rate, float noise_floor) {
+    adaptation_rate_ = Traits::fromFloat(adaptation_rate);
+    noise_floor_ = Traits::squareFromFloat(noise_floor);
+    coefficient_step_ = Traits::fromFloat(adaptation_rate * 0.1f);
+}
+
+// RuntimeFilterChain Implementation
+static const FilterType DEFAULT_FILTER_ORDER[MAX_FILTER_STAGES] = {
+    FilterType::MOVING_AVERAGE,
+    FilterType::MEDIAN,
+    FilterType::LOW_PASS,
+    FilterType::ADAPTIVE
+};
+
+template <typename T>
+BasicRuntimeFilterChain<T>::BasicRuntimeFilterChain(const SignalConfig& config)
+    : ma_filter_(config.moving_average_window),
+      lp_filter_(config.low_pass_cutoff > 0 ? config.low_pass_cutoff : 0.5f, 1.0f),
+      median_filter_(config.median_window),
+      adaptive_filter_(config.adaptation_rate, config.noise_floor),
+      stage_count_(0),
+      ma_enabled_(false), lp_enabled_(false),
+      median_enabled_(false), adaptive_enabled_(false) {
+    configure(config);
+}
+
+template <typename T>
+T BasicRuntimeFilterChain<T>::process(T input) {
+    T value = input;
+    
+    for (size_t i = 0; i < stage_count_; ++i) {
+        switch (order_[i]) {
+            case FilterType::MOVING_AVERAGE:
+                if (ma_enabled_) value = ma_filter_.process(value);
+                break;
+            case FilterType::MEDIAN:
+                if (median_enabled_) value = median_filter_.process(value);
+                break;
+            case FilterType::LOW_PASS:
+                if (lp_enabled_) value = lp_filter_.process(value);
+                break;
+            case FilterType::ADAPTIVE:
+                if (adaptive_enabled_) value = adaptive_filter_.process(value);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    return value;
+}
+
+template <typename T>
+void BasicRuntimeFilterChain<T>::processBlock(T* values, size_t count) {
+    // Dispatch once per stage, then let each stage run a tight loop
+    for (size_t i = 0; i < stage_count_; ++i) {
+        switch (order_[i]) {
+            case FilterType::MOVING_AVERAGE:
+                if (ma_enabled_) ma_filter_.processBlock(values, count);
+                break;
+            case FilterType::MEDIAN:
+                if (median_enabled_) median_filter_.processBlock(values, count);
+                break;
+            case FilterType::LOW_PASS:
+                if (lp_enabled_) lp_filter_.processBlock(values, count);
+                break;
+            case FilterType::ADAPTIVE:
+                if (adaptive_enabled_) adaptive_filter_.processBlock(values, count);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+template <typename T>
+void BasicRuntimeFilterChain<T>::configure(const SignalConfig& config) {
+    // Retune in place; filter state carries over
+    ma_filter_.setWindowSize(config.moving_average_window);
+    lp_filter_.setCutoff(config.low_pass_cutoff > 0 ? config.low_pass_cutoff : 0.5f, 1.0f);
+    median_filter_.setWindowSize(config.median_window);
+    adaptive_filter_.updateParameters(config.adaptation_rate, config.noise_floor);
+    
+    bool ma_enabled = config.moving_average_window > 1;
+    bool lp_enabled = config.low_pass_cutoff > 0;
+    
+    // A stage switched back on restarts rather than resuming from stale state
+    if (ma_enabled && !ma_enabled_) ma_filter_.reset();
+    if (lp_enabled && !lp_enabled_) lp_filter_.reset();
+    if (config.enable_median_filter && !median_enabled_) median_filter_.reset();
+    if (config.enable_adaptive_filter && !adaptive_enabled_) adaptive_filter_.reset();
+    
+    ma_enabled_ = ma_enabled;
+    lp_enabled_ = lp_enabled;
+    median_enabled_ = config.enable_median_filter;
+    adaptive_enabled_ = config.enable_adaptive_filter;
+    
+    // An empty order keeps the original MA -> median -> low-pass -> adaptive chain
+    const FilterType* order = config.filter_order;
+    size_t count = config.filter_stage_count;
+    if (count == 0 || count > MAX_FILTER_STAGES) {
+        order = DEFAULT_FILTER_ORDER;
+        count = MAX_FILTER_STAGES;
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        order_[i] = order[i];
+    }
+    stage_count_ = count;
+}
+
+template <typename T>
+void BasicRuntimeFilterChain<T>::reset() {
+    ma_filter_.reset();
+    lp_filter_.reset();
+    median_filter_.reset();
+    adaptive_filter_.reset();
+}
+
+template <typename T>
+void BasicRuntimeFilterChain<T>::setStageEnabled(FilterType filter_type, bool enable) {
+    switch (filter_type) {
+        case FilterType::MOVING_AVERAGE:
+            ma_enabled_ = enable;
+            break;
+        case FilterType::LOW_PASS:
+            lp_enabled_ = enable;
+            break;
+        case FilterType::MEDIAN:
+            median_enabled_ = enable;
+            break;
+        case FilterType::ADAPTIVE:
+            adaptive_enabled_ = enable;
+            break;
+        default:
+            break;
+    }
+}
+
+template <typename T>
+bool BasicRuntimeFilterChain<T>::isStageEnabled(FilterType filter_type) const {
+    switch (filter_type) {
+        case FilterType::MOVING_AVERAGE:
+            return ma_enabled_;
+        case FilterType::LOW_PASS:
+            return lp_enabled_;
+        case FilterType::MEDIAN:
+            return median_enabled_;
+        case FilterType::ADAPTIVE:
+            return adaptive_enabled_;
+        default:
+            return false;
+    }
+}
+
 /**
  * @brief Trend analyzer result
  */
@@ -141,7 +729,7 @@ struct TrendResult {
 };
 
 /**
- * @brief Trend analyzer (fixed-size buffer)
+ * @brief Trend analyzer (incremental linear regression, fixed-size buffer)
  */
 class TrendAnalyzer {
 public:
@@ -151,10 +739,7 @@ public:
     void reset();
     
 private:
-    uint8_t window_size_;
-    float buffer_[MAX_FILTER_WINDOW];
-    size_t buffer_index_;
-    size_t buffer_count_;
+    RunningRegression<MAX_TREND_WINDOW> regression_;
 };
 
 /**
@@ -163,35 +748,71 @@ private:
 class SignalProcessor {
 public:
     explicit SignalProcessor(const SignalConfig& config);
-    ~SignalProcessor() = default;
+    ~SignalProcessor();
+    
+    // Prevent copying
+    SignalProcessor(const SignalProcessor&) = delete;
+    SignalProcessor& operator=(const SignalProcessor&) = delete;
     
     SignalAnalysis processReading(const SensorReading& reading);
+    
+    /**
+     * @brief Process a block of readings
+     * @param readings Input readings
+     * @param results Output analysis, one per reading
+     * @param count Number of readings
+     */
+    void processBlock(const SensorReading* readings, SignalAnalysis* results, size_t count);
+    
+    /**
+     * @brief Process a block held as separate value arrays (structure-of-arrays)
+     * @param raw_q16 Q16 fractions of full scale as in SensorReading::raw_q16 (read by the fixed-point path)
+     * @param lux_values Lux values (read by the float path and the analysis)
+     * @param filtered_values Output filtered lux, one per value
+     * @param count Number of values
+     * @return Analysis of the last value (all values update the running state)
+     */
+    SignalAnalysis processColumns(const uint16_t* raw_q16, const float* lux_values,
+                                  float* filtered_values, size_t count);
     void configure(const SignalConfig& config);
     void reset();
     uint8_t getSignalQuality() const;
     float getNoiseLevel() const;
     void setFilterEnabled(FilterType filter_type, bool enable);
     
+    /**
+     * @brief Set the sensor calibration used by the fixed-point path
+     * @param sensor Sensor configuration (reference voltage, dark offset, sensitivity)
+     */
+    void setCalibration(const SensorConfig& sensor);
+    
+    /**
+     * @brief Set the rate readings arrive at, for the spectral stage
+     * @param sample_rate_hz Readings per second (frequencies are 0 until set)
+     */
+    void setSampleRate(float sample_rate_hz);
+    
 private:
     SignalConfig config_;
     
-    // Fixed filter instances
-    MovingAverageFilter ma_filter_;
-    LowPassFilter lp_filter_;
-    MedianFilter median_filter_;
-    AdaptiveFilter adaptive_filter_;
+    // Only the chain use_fixed_point selects is built; the two share storage
+    static constexpr size_t CHAIN_BYTES = sizeof(RuntimeFilterChain) > sizeof(BasicRuntimeFilterChain<Q16>) ?
+                                          sizeof(RuntimeFilterChain) : sizeof(BasicRuntimeFilterChain<Q16>);
+    alignas(RuntimeFilterChain) alignas(BasicRuntimeFilterChain<Q16>) uint8_t chain_storage_[CHAIN_BYTES];
+    RuntimeFilterChain* filter_chain_;            // Float path, else nullptr
+    BasicRuntimeFilterChain<Q16>* fixed_chain_;   // Fixed-point path, else nullptr
     TrendAnalyzer trend_analyzer_;
     
-    // Filter enable flags
-    bool ma_enabled_;
-    bool lp_enabled_;
-    bool median_enabled_;
-    bool adaptive_enabled_;
+    // Constructed only while enable_spectral_analysis is set (about 11 KB, reserved either way)
+    StaticSlot<SpectralAnalyzer> spectral_;
+    float sample_rate_hz_;
+    
+    // raw_value -> lux for the fixed-point path: lux = raw * lux_per_unit_ - lux_offset_
+    float lux_per_unit_;
+    float lux_offset_;
     
-    // Recent values buffer
-    float recent_values_[MAX_RECENT_VALUES];
-    size_t recent_index_;
-    size_t recent_count_;
+    // Recent values window (running mean / standard deviation)
+    RunningStats<MAX_RECENT_VALUES> recent_stats_;
     
     float noise_level_estimate_;
     uint8_t signal_quality_;
@@ -201,13 +822,19 @@ private:
     bool rising_;
     
     void initializeFilters();
-    float applyFilters(float input);
+    void buildFilterChain();
+    void destroyFilterChain();
+    void updateSpectralStage();
+    float applyFilters(const SensorReading& reading);
+    void applyFiltersBlock(const SensorReading* readings, float* values, size_t count);
+    void applyFiltersColumns(const uint16_t* raw_q16, const float* lux_values, float* values, size_t count);
+    float fixedToLux(Q16 value) const;
+    SignalConfig fixedChainConfig() const;
+    SignalAnalysis analyzeValue(float lux_value, float filtered_value);
     void updateNoiseEstimate(float filtered_value, float raw_value);
     uint8_t calculateSignalQuality(const SignalAnalysis& analysis) const;
     bool isOutlier(float value) const;
     bool isPeak(float value);
-    float calculateMean() const;
-    float calculateStdDev(float mean) const;
 };
 
 }  // namespace LightSensor
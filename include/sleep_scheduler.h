@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+namespace LightSensor {
+
+/**
+ * @brief Function run by the scheduler when its deadline is due
+ */
+using ScheduledTask = std::function<void()>;
+
+/**
+ * @brief Deadline table for the periodic work in loop()
+ *
+ * Each task has a period and the time it is next due. runDue() runs the
+ * tasks whose deadline has passed and getTimeUntilNextMs() tells the caller
+ * how long it may sleep before the nearest one, so the CPU can sit in light
+ * sleep between samples instead of polling.
+ */
+class SleepScheduler {
+public:
+    static const size_t MAX_TASKS = 8;
+    static const uint32_t NO_DEADLINE = 0xFFFFFFFF;
+
+    SleepScheduler();
+
+    /**
+     * @brief Register a periodic task (first run is due immediately)
+     * @param name Task name (must outlive the scheduler)
+     * @param period_ms Run period
+     * @param task Function to run
+     * @return Task id, or -1 if the table is full
+     */
+    int addTask(const char* name, uint32_t period_ms, ScheduledTask task);
+
+    /**
+     * @brief Change a task's period (the pending deadline moves with it)
+     */
+    void setPeriod(int id, uint32_t period_ms);
+
+    /**
+     * @brief Enable or disable a task (enabling makes it due immediately)
+     */
+    void setEnabled(int id, bool enabled);
+
+    /**
+     * @brief Run every task whose deadline has passed
+     * @return Number of tasks run
+     */
+    size_t runDue();
+
+    /**
+     * @brief Time until the nearest deadline
+     * @return Milliseconds (0 if a task is already due, NO_DEADLINE if none)
+     */
+    uint32_t getTimeUntilNextMs() const;
+
+    size_t getTaskCount() const;
+
+private:
+    struct Task {
+        const char* name;
+        uint32_t period_ms;
+        uint32_t next_due_ms;
+        ScheduledTask run;
+        bool enabled;
+    };
+
+    Task tasks_[MAX_TASKS];
+    size_t task_count_;
+
+    bool isValid(int id) const;
+};
+
+}  // namespace LightSensor
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+// Samples per FFT block (power of two): 128 ms and 7.8 Hz bins at 4 kHz
+static const size_t SPECTRAL_BLOCK_SIZE = 512;
+
+/**
+ * @brief Flicker and frequency figures of the last complete block
+ */
+struct SpectralResult {
+    float dominant_frequency_hz;   // Strongest component above DC (0 if the block was flat)
+    float dominant_amplitude;      // Its amplitude, in input units
+    float flicker_percent;         // 100 * (max - min) / (max + min)
+    float flicker_index;           // Area above the mean / total area
+    uint32_t block_count;          // Blocks analysed since the last reset
+};
+
+/**
+ * @brief Flicker and frequency analysis over fixed blocks of samples
+ *
+ * Samples are collected into blocks of SPECTRAL_BLOCK_SIZE. A full block is
+ * Hann-windowed and transformed in place by a radix-2 FFT whose twiddles
+ * and bit-reversal order are computed once, at construction. With esp-dsp
+ * available the transform is dsps_fft2r_fc32, which uses the ESP32 and
+ * ESP32-S3 DSP instructions. Percent flicker and flicker index (IES RP-16)
+ * come from the same block in the time domain.
+ *
+ * A block takes well under a millisecond at 240 MHz, against 128 ms of
+ * samples at 4 kHz, so add() runs it inline on the caller's task.
+ */
+class SpectralAnalyzer {
+public:
+    SpectralAnalyzer();
+
+    /**
+     * @brief Set the rate samples arrive at (restarts the current block)
+     */
+    void setSampleRate(float sample_rate_hz);
+
+    /**
+     * @brief Add one sample
+     * @return true if it completed a block and getResult() changed
+     */
+    bool add(float value);
+
+    const SpectralResult& getResult() const;
+    void reset();
+
+private:
+    float sample_rate_hz_;
+    float samples_[SPECTRAL_BLOCK_SIZE];
+    size_t sample_count_;
+
+    // Interleaved re/im, transformed in place
+    float buffer_[2 * SPECTRAL_BLOCK_SIZE];
+
+    // Precomputed: Hann window, exp(-2*pi*i*k/N) as cos/sin pairs, bit-reversed indices
+    float window_[SPECTRAL_BLOCK_SIZE];
+    float twiddles_[SPECTRAL_BLOCK_SIZE];
+    uint16_t bit_reverse_[SPECTRAL_BLOCK_SIZE];
+
+    SpectralResult result_;
+
+    void analyzeBlock();
+    void transform();
+};
+
+}  // namespace LightSensor
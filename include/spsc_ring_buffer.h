@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffer
+ *
+ * One context (task or ISR) may push while another pops, on either core,
+ * without locks or critical sections. head_ and tail_ are free-running
+ * counters masked into the buffer, so Capacity must be a power of two and
+ * every slot is usable.
+ *
+ * Producer side: push(), full(). Consumer side: pop(), peekContiguous(),
+ * consume(). size() and empty() are safe from either side.
+ */
+template <typename T, size_t Capacity>
+class SpscRingBuffer {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRingBuffer capacity must be a power of two");
+    static_assert(std::atomic<size_t>::is_always_lock_free,
+                  "SpscRingBuffer needs lock-free size_t atomics");
+
+public:
+    static const size_t CAPACITY = Capacity;
+
+    SpscRingBuffer() : head_(0), tail_(0) {}
+
+    /**
+     * @brief Append an item (producer)
+     * @return false if the buffer is full
+     */
+    bool push(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+
+        buffer_[tail & MASK] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest item (consumer)
+     * @return false if the buffer is empty
+     */
+    bool pop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = buffer_[head & MASK];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Oldest run of items that is contiguous in memory (consumer)
+     * @param data Set to the first item of the run
+     * @return Number of items in the run (0 if empty)
+     */
+    size_t peekContiguous(const T*& data) const {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t available = tail_.load(std::memory_order_acquire) - head;
+        size_t offset = head & MASK;
+        size_t to_end = Capacity - offset;
+
+        data = &buffer_[offset];
+        return available < to_end ? available : to_end;
+    }
+
+    /**
+     * @brief Release items returned by peekContiguous() (consumer)
+     */
+    void consume(size_t count) {
+        head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief Drop all items (consumer, producer must be idle)
+     */
+    void clear() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const {
+        // Head first: tail can only have moved further ahead by the time it is read
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool full() const {
+        return size() >= Capacity;
+    }
+
+    size_t capacity() const {
+        return Capacity;
+    }
+
+private:
+    static const size_t MASK = Capacity - 1;
+
+    T buffer_[Capacity];
+    std::atomic<size_t> head_;  // Next slot to read (written by consumer)
+    std::atomic<size_t> tail_;  // Next slot to write (written by producer)
+};
+
+}  // namespace LightSensor
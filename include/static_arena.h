@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace LightSensor {
+
+/**
+ * @brief Storage for one object of type T, reserved at compile time
+ *
+ * Replaces new/delete for long-lived subsystems. The bytes are part of
+ * .bss, so creating, destroying and re-creating the object never touches
+ * the heap and its size is known at link time.
+ */
+template <typename T>
+class StaticSlot {
+public:
+    StaticSlot() : object_(nullptr) {}
+    ~StaticSlot() { destroy(); }
+
+    // Prevent copying
+    StaticSlot(const StaticSlot&) = delete;
+    StaticSlot& operator=(const StaticSlot&) = delete;
+
+    /**
+     * @brief Construct the object, destroying any previous one first
+     */
+    template <typename... Args>
+    T* emplace(Args&&... args) {
+        destroy();
+        object_ = new (storage_) T(std::forward<Args>(args)...);
+        return object_;
+    }
+
+    void destroy() {
+        if (object_) {
+            object_->~T();
+            object_ = nullptr;
+        }
+    }
+
+    T* get() const { return object_; }
+
+    static constexpr size_t bytes() { return sizeof(T); }
+
+private:
+    alignas(T) uint8_t storage_[sizeof(T)];
+    T* object_;
+};
+
+/**
+ * @brief Bump allocator over a fixed buffer
+ *
+ * Blocks are not freed one by one: release() drops everything allocated
+ * after a mark(), so scratch memory for one operation (such as a JSON
+ * document) always comes back in one piece and cannot fragment.
+ */
+class StaticArena {
+public:
+    static const size_t ALIGNMENT = 8;
+
+    StaticArena(void* buffer, size_t size);
+
+    /**
+     * @brief Allocate an aligned block
+     * @return nullptr if the arena is full (counted in getFailureCount())
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * @brief Grow or shrink the most recent block in place
+     * @return false if block is not the most recent one or does not fit
+     */
+    bool resize(void* block, size_t bytes);
+
+    bool owns(const void* pointer) const;
+
+    size_t mark() const { return used_; }
+    void release(size_t mark);
+    void reset() { release(0); }
+
+    size_t getUsed() const { return used_; }
+    size_t getCapacity() const { return size_; }
+    size_t getPeak() const { return peak_; }
+    uint32_t getFailureCount() const { return failures_; }
+
+private:
+    uint8_t* buffer_;
+    size_t size_;
+    size_t used_;
+    size_t last_;             // Offset of the most recent block
+    size_t peak_;
+    uint32_t failures_;
+
+    // Prevent copying
+    StaticArena(const StaticArena&) = delete;
+    StaticArena& operator=(const StaticArena&) = delete;
+};
+
+/**
+ * @brief Releases everything allocated from an arena during its lifetime
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(StaticArena& arena) : arena_(arena), mark_(arena.mark()) {}
+    ~ArenaScope() { arena_.release(mark_); }
+
+private:
+    StaticArena& arena_;
+    size_t mark_;
+};
+
+}  // namespace LightSensor
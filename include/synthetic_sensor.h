@@ -0,0 +1,114 @@
+#pragma once
+
+#include "light_sensor.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+/**
+ * @brief Base shape of a synthetic signal
+ */
+enum class SyntheticWaveform : uint8_t {
+    CONSTANT,       // base_lux
+    SQUARE,         // base_lux, then base_lux + amplitude_lux, each half a period (steps, PWM flicker)
+    SINE,           // base_lux + amplitude_lux * sin (mains flicker)
+    REPLAY          // Recorded lux values from setReplay(), looped
+};
+
+/**
+ * @brief Synthetic signal parameters
+ */
+struct SyntheticSignalConfig {
+    float rate_hz;                  // Readings per second of reading clock
+    SyntheticWaveform waveform;
+    float base_lux;
+    float amplitude_lux;
+    float frequency_hz;             // SQUARE and SINE period
+    float noise_lux;                // Uniform noise of +/- noise_lux on top
+    uint32_t spike_interval;        // Readings between single-reading spikes (0 = none)
+    float spike_lux;                // Added to a spike reading
+};
+
+/**
+ * @brief ILightSensor that generates or replays a waveform instead of reading the ADC
+ *
+ * Readings carry timestamps from their own clock, one every 1 / rate_hz
+ * seconds from initialize(), so read() and readBlock() can feed the rest
+ * of the system far faster than real light would while the timestamps
+ * still look like sampling at rate_hz. startSampling() plus process()
+ * instead delivers readings in real time, as the ADC driver does.
+ *
+ * Lux is turned into a raw ADC fraction and back through the sensor
+ * calibration, so readings clip and score quality like real ones. Noise
+ * comes from a fixed-seed generator, so a run is repeatable.
+ */
+class SyntheticLightSensor : public ILightSensor {
+public:
+    SyntheticLightSensor(const SensorConfig& config, const SyntheticSignalConfig& signal);
+    ~SyntheticLightSensor() override = default;
+
+    bool initialize() override;
+    SensorReading read() override;
+    size_t readBlock(SensorReading* readings, size_t max_count) override;
+    void startSampling(DataCallback callback) override;
+    void startBlockSampling(BlockCallback callback) override;
+    void stopSampling() override;
+    void configure(const SensorConfig& config) override;
+    void calibrate(float dark_value, float light_value) override;
+    void enterLowPower() override;
+    void wakeUp() override;
+    void process() override;
+
+    /**
+     * @brief Change the signal (the reading clock keeps running)
+     */
+    void setSignal(const SyntheticSignalConfig& signal);
+
+    /**
+     * @brief Values the REPLAY waveform plays back, one per reading
+     * @param lux Recorded lux values (not copied; must outlive the sensor)
+     * @param count Number of values
+     */
+    void setReplay(const float* lux, size_t count);
+
+    /**
+     * @brief Lux that maps to a raw ADC fraction under the current calibration
+     */
+    float luxForRaw(float raw_value) const;
+
+    uint32_t getReadingCount() const;
+
+private:
+    // Readings process() delivers per call at most, so a late call cannot stall the caller
+    static const size_t MAX_CATCH_UP = 4 * MAX_BLOCK_SIZE;
+
+    SensorConfig config_;
+    SyntheticSignalConfig signal_;
+    bool is_initialized_;
+    bool is_sampling_;
+    DataCallback data_callback_;
+    BlockCallback block_callback_;
+
+    const float* replay_;
+    size_t replay_count_;
+
+    uint32_t start_ms_;
+    uint32_t index_;                // Readings generated since initialize()
+    uint64_t rate_mhz_;             // rate_hz in millihertz
+    float phase_;                   // Waveform phase, 0..1
+    float phase_step_;              // frequency_hz / rate_hz
+    uint32_t seed_;
+
+    // Real-time delivery
+    uint64_t elapsed_us_;
+    uint32_t last_us_;
+    uint32_t delivered_;            // Readings process() has delivered since startSampling()
+
+    void updateRate();
+    float nextLux();
+    SensorReading makeReading(float lux, uint32_t timestamp_ms) const;
+    void startRealTime();
+};
+
+}  // namespace LightSensor
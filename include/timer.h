@@ -6,6 +6,10 @@ namespace LightSensor {
 
 /**
  * @brief Simple timer utility class for ESP32
+ *
+ * elapsedCycles() reads the CPU cycle counter, which wraps after 2^32
+ * cycles (about 17 s at 240 MHz) and counts slower when the clock is
+ * reduced.
  */
 class Timer {
 public:
@@ -16,10 +20,14 @@ public:
     uint32_t elapsedUs() const;
     float elapsedSeconds() const;
     bool hasElapsed(uint32_t timeout_ms) const;
+    uint32_t elapsedCycles() const;
+    
+    static uint32_t cycleCount();
     
 private:
     uint32_t start_time_ms_;
     uint32_t start_time_us_;
+    uint32_t start_cycles_;
 };
 
 }  // namespace LightSensor
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace LightSensor {
+
+// Samples the ULP can hold in RTC slow memory before it must wake the CPU
+static const size_t ULP_BUFFER_SIZE = 64;
+
+/**
+ * @brief Why the ULP program woke the main CPU
+ */
+enum class UlpWakeReason : uint8_t {
+    NONE = 0,           // Not woken by the ULP (timer, reset, or ULP not armed)
+    THRESHOLD = 1,      // Sample left the baseline +/- threshold band
+    BUFFER_FULL = 2     // RTC sample buffer filled up
+};
+
+/**
+ * @brief Light sampling on the ULP coprocessor during deep sleep
+ *
+ * A small ULP program converts the sensor's ADC1 channel on the ULP timer
+ * and appends the 12-bit code to a buffer in RTC slow memory. It wakes the
+ * main CPU only when a sample leaves the band around the pre-sleep light
+ * level, or when the buffer is full; otherwise the main cores stay off.
+ *
+ * Only the original ESP32 (FSM ULP with ADC access) is supported; on other
+ * targets isSupported() returns false and start() fails.
+ */
+class UlpSampler {
+public:
+    UlpSampler();
+
+    /**
+     * @brief Check if this target has a usable ULP
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Load and start the ULP program (call right before deep sleep)
+     * @param adc_pin ADC1 GPIO of the light sensor (32-39)
+     * @param period_ms ULP sample period
+     * @param baseline_code ADC code of the current light level
+     * @param threshold_codes Wake when a sample differs from baseline by at least this
+     * @return true if the ULP is running
+     */
+    bool start(uint8_t adc_pin, uint32_t period_ms, uint16_t baseline_code, uint16_t threshold_codes);
+
+    /**
+     * @brief Stop the ULP timer
+     */
+    void stop();
+
+    /**
+     * @brief Check if samples from the last deep sleep are waiting in RTC memory
+     */
+    bool hasSamples() const;
+
+    /**
+     * @brief Copy buffered samples out of RTC memory and reset the buffer
+     * @param codes Output 12-bit ADC codes, oldest first
+     * @param timestamps_ms Output sample times on the pre-sleep millis() timeline
+     * @param max_count Capacity of the output arrays
+     * @return Number of samples written
+     */
+    size_t collect(uint16_t* codes, uint32_t* timestamps_ms, size_t max_count);
+
+    /**
+     * @brief Reason the ULP woke the CPU on this boot
+     */
+    UlpWakeReason getWakeReason() const;
+
+private:
+    UlpWakeReason wake_reason_;
+};
+
+}  // namespace LightSensor
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "data_logger.h"
+#include "power_manager.h"
+#include "segment_storage.h"
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace LightSensor {
+
+class BatchStream;
+
+static const size_t MAX_WIFI_SSID_LEN = 33;
+static const size_t MAX_WIFI_PASSWORD_LEN = 65;
+static const size_t MAX_UPLINK_HOST_LEN = 64;
+static const size_t MAX_UPLINK_PATH_LEN = 64;
+
+static const uint32_t UPLINK_BATCH_MAGIC = 0x4255534C;   // "LSUB" little-endian
+static const uint16_t UPLINK_BATCH_VERSION = 1;
+
+/**
+ * @brief How batches leave the device
+ */
+enum class UplinkTransport {
+    HTTP,       // One POST per batch to http://host:port/path
+    MQTT        // One message per batch, published to topic path
+};
+
+/**
+ * @brief Uplink configuration
+ */
+struct UplinkConfig {
+    bool enabled;
+    UplinkTransport transport;
+    char wifi_ssid[MAX_WIFI_SSID_LEN];
+    char wifi_password[MAX_WIFI_PASSWORD_LEN];
+    char host[MAX_UPLINK_HOST_LEN];
+    uint16_t port;
+    char path[MAX_UPLINK_PATH_LEN];   // HTTP path or MQTT topic
+
+    // Batching
+    uint32_t batch_interval_ms;       // The radio comes up at most once per window
+    uint32_t min_batch_bytes;         // Windows with less pending data are skipped
+    uint32_t max_batch_bytes;         // Upper bound on one request / message
+    uint32_t connect_timeout_ms;      // WiFi association plus server connect
+};
+
+/**
+ * @brief Uplink statistics
+ */
+struct UplinkStats {
+    uint32_t batches_sent;
+    uint32_t segments_sent;
+    uint32_t bytes_sent;
+    uint32_t failed_batches;
+    uint32_t skipped_windows;         // Too little data to bring the radio up
+    uint32_t last_sent_sequence;      // Newest segment delivered
+    uint32_t radio_active_time_us;    // Radio on time (free-running, wraps)
+};
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Start of every batch, followed by segment_count UplinkSegmentEntry
+ *        and then the segment files back to back, byte for byte
+ */
+struct UplinkBatchHeader {
+    uint32_t magic;                   // UPLINK_BATCH_MAGIC
+    uint16_t version;                 // UPLINK_BATCH_VERSION
+    uint16_t segment_count;
+    char device_id[32];
+};
+
+struct UplinkSegmentEntry {
+    uint32_t sequence;
+    uint32_t length;                  // File size in bytes
+};
+
+#pragma pack(pop)
+
+/**
+ * @brief Sends sealed log segments off the device in batches
+ *
+ * Once per batch window the pending segments are sent as one HTTP POST or
+ * MQTT message, streamed from flash through a small buffer without being
+ * decoded. The radio is leased from PowerManager, brought up for the
+ * batch and switched off again, so radio-on time follows the amount of
+ * data rather than the number of readings. The send itself runs on a
+ * background task; process() only decides when a window is due.
+ *
+ * Needs the segment storage backend. The newest delivered sequence is
+ * kept in UPLINK_STATE_PATH so nothing is sent twice across reboots.
+ */
+class Uplink {
+public:
+    static const size_t MAX_BATCH_SEGMENTS = 16;
+    static const uint32_t TASK_STACK_SIZE = 6144;
+    static const UBaseType_t TASK_PRIORITY = 1;
+    static constexpr const char* UPLINK_STATE_PATH = "/uplink.dat";
+
+    Uplink(const UplinkConfig& config, const char* device_id, DataLogger& logger, PowerManager& power);
+    ~Uplink();
+
+    /**
+     * @brief Load the delivery cursor and start the send task
+     * @return false if the task could not be created
+     */
+    bool initialize();
+
+    /**
+     * @brief Start a batch if a new window has begun (call in main loop)
+     */
+    void process();
+
+    /**
+     * @brief Apply new settings (takes effect once no batch is in flight)
+     */
+    void configure(const UplinkConfig& config);
+
+    /**
+     * @brief Check if a batch is being sent
+     */
+    bool isBusy() const;
+
+    UplinkStats getStats() const;
+
+    /**
+     * @brief Time the radio has been on (for energy accounting)
+     * @return Free-running microsecond counter (wraps)
+     */
+    uint32_t getRadioActiveTimeUs() const;
+
+private:
+    UplinkConfig config_;
+    UplinkConfig pending_config_;
+    bool has_pending_config_;
+    char device_id_[32];
+    DataLogger& logger_;
+    PowerManager& power_;
+
+    std::atomic<uint32_t> cursor_;    // Newest delivered segment sequence
+
+    // Batch handed to the task by process()
+    UplinkSegmentEntry batch_[MAX_BATCH_SEGMENTS];
+    size_t batch_count_;
+    std::atomic<bool> busy_;
+    TaskHandle_t task_;
+
+    std::atomic<uint32_t> batches_sent_;
+    std::atomic<uint32_t> segments_sent_;
+    std::atomic<uint32_t> bytes_sent_;
+    std::atomic<uint32_t> failed_batches_;
+    std::atomic<uint32_t> skipped_windows_;
+    std::atomic<uint32_t> radio_active_us_;
+
+    void sendBatch();
+    size_t measureBatch();
+    bool connectWifi();
+    void disconnectWifi();
+    bool postHttp(BatchStream& stream, size_t length);
+    bool publishMqtt(BatchStream& stream, size_t length);
+    bool loadCursor();
+    bool saveCursor(uint32_t sequence);
+    void taskLoop();
+    static void taskEntry(void* arg);
+};
+
+}  // namespace LightSensor
@@ -0,0 +1,286 @@
+/**
+ * ESP32 Light Sensor - Benchmark Firmware
+ *
+ * Built by the esp32dev-bench environment in place of main.cpp:
+ *   pio run -e esp32dev-bench -t upload && pio device monitor
+ *
+ * Runs each benchmark once at 240 MHz and prints one CSV line per result:
+ *   bench,<name>,<iterations>,<cycles_per_op>,<ops_per_sec>,<bytes_per_sec>
+ * followed by "bench,done". bytes_per_sec is 0 where it does not apply.
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "light_sensor.h"
+#include "signal_processor.h"
+#include "data_logger.h"
+#include "log_compressor.h"
+#include "config_manager.h"
+#include "timer.h"
+#include <algorithm>
+
+using namespace LightSensor;
+
+static const uint32_t FILTER_ITERATIONS = 10000;
+static const uint32_t PROCESS_ITERATIONS = 2000;
+static const uint32_t FORMAT_ITERATIONS = 2000;
+static const uint32_t WRITE_READINGS = 2000;
+static const uint32_t END_TO_END_MS = 3000;
+static const size_t INPUT_COUNT = 256;       // Power of two for masked indexing
+static const char* BENCH_LOG_PATH = "/bench";
+
+static const char* const PRESETS[] = {"low_power", "balanced", "high_accuracy", "development"};
+
+static float inputs[INPUT_COUNT];
+static Q16 fixedInputs[INPUT_COUNT];
+static SensorReading readings[INPUT_COUNT];
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile float sink;
+
+static void report(const char* name, uint32_t iterations, uint32_t cycles, uint32_t elapsed_us,
+                   uint64_t bytes = 0) {
+    float seconds = elapsed_us / 1e6f;
+    Serial.printf("bench,%s,%lu,%lu,%.1f,%.0f\n", name,
+                  static_cast<unsigned long>(iterations),
+                  static_cast<unsigned long>(iterations > 0 ? cycles / iterations : 0),
+                  seconds > 0.0f ? iterations / seconds : 0.0f,
+                  seconds > 0.0f ? bytes / seconds : 0.0f);
+}
+
+template <typename Fn>
+static void runBench(const char* name, uint32_t iterations, Fn&& fn) {
+    Timer timer;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        fn(i);
+    }
+    uint32_t cycles = timer.elapsedCycles();
+    report(name, iterations, cycles, timer.elapsedUs());
+}
+
+template <typename Filter, typename Input>
+static void benchFilter(const char* name, Filter filter, const Input* values) {
+    runBench(name, FILTER_ITERATIONS, [&](uint32_t i) {
+        Input output = filter.process(values[i & (INPUT_COUNT - 1)]);
+        sink = static_cast<float>(output == values[0]);
+    });
+}
+
+static void makeInputs() {
+    // Slow ramp plus deterministic noise and an occasional spike
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < INPUT_COUNT; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        float noise = static_cast<float>((seed >> 16) & 0xFF) / 255.0f - 0.5f;
+        float value = 0.4f + 0.2f * i / INPUT_COUNT + 0.02f * noise + (i % 64 == 0 ? 0.3f : 0.0f);
+
+        inputs[i] = value;
+        fixedInputs[i] = Q16::fromFloat(value);
+        readings[i] = {static_cast<uint32_t>(i * 10), value, value * 1000.0f, value * 3.3f, true, 90,
+                       static_cast<uint16_t>(fixedInputs[i].raw())};
+    }
+}
+
+static void benchFilters() {
+    benchFilter("moving_average_f32", MovingAverageFilter(5), inputs);
+    benchFilter("moving_average_q16", BasicMovingAverageFilter<Q16>(5), fixedInputs);
+    benchFilter("low_pass_f32", LowPassFilter(0.1f, 1.0f), inputs);
+    benchFilter("low_pass_q16", BasicLowPassFilter<Q16>(0.1f, 1.0f), fixedInputs);
+    benchFilter("median_f32", MedianFilter(5), inputs);
+    benchFilter("median_q16", BasicMedianFilter<Q16>(5), fixedInputs);
+    benchFilter("adaptive_f32", AdaptiveFilter(0.1f, 0.01f), inputs);
+    benchFilter("adaptive_q16", BasicAdaptiveFilter<Q16>(0.1f, 0.01f), fixedInputs);
+
+    // The default four stages, composed at compile time and from SignalConfig
+    const SignalConfig signal = ConfigManager::getDefaultConfig().signal;
+    using StaticChain = FilterChain<MovingAverageFilter, MedianFilter, LowPassFilter, AdaptiveFilter>;
+    benchFilter("chain_static_f32",
+                StaticChain(MovingAverageFilter(signal.moving_average_window), MedianFilter(signal.median_window),
+                            LowPassFilter(signal.low_pass_cutoff, 1.0f),
+                            AdaptiveFilter(signal.adaptation_rate, signal.noise_floor)),
+                inputs);
+    benchFilter("chain_runtime_f32", RuntimeFilterChain(signal), inputs);
+}
+
+static void benchSignalProcessor() {
+    SystemConfig config = ConfigManager::getDefaultConfig();
+
+    for (bool fixed : {false, true}) {
+        config.signal.use_fixed_point = fixed;
+        SignalProcessor processor(config.signal);
+        processor.setCalibration(config.sensor);
+
+        runBench(fixed ? "process_reading_q16" : "process_reading_f32", PROCESS_ITERATIONS, [&](uint32_t i) {
+            sink = processor.processReading(readings[i & (INPUT_COUNT - 1)]).filtered_value;
+        });
+
+        static SignalAnalysis results[MAX_BLOCK_SIZE];
+        processor.reset();
+        runBench(fixed ? "process_block_q16" : "process_block_f32", PROCESS_ITERATIONS / MAX_BLOCK_SIZE,
+                 [&](uint32_t i) {
+            processor.processBlock(readings + (i * MAX_BLOCK_SIZE) % INPUT_COUNT, results, MAX_BLOCK_SIZE);
+            sink = results[0].filtered_value;
+        });
+    }
+}
+
+static LoggerConfig benchLoggerConfig(LogFormat format, bool compression) {
+    LoggerConfig config = ConfigManager::getDefaultConfig().logger;
+    strncpy(config.log_file_path, BENCH_LOG_PATH, MAX_LOG_PATH_LEN - 1);
+    config.log_file_path[MAX_LOG_PATH_LEN - 1] = '\0';
+    config.log_format = format;
+    config.enable_compression = compression;
+    config.enable_rotation = false;
+    return config;
+}
+
+static void benchFormatting() {
+    char buffer[128];
+
+    SPIFFSDataStorage csv(benchLoggerConfig(LogFormat::CSV, false));
+    runBench("format_csv", FORMAT_ITERATIONS, [&](uint32_t i) {
+        sink = csv.encodeReading(readings[i & (INPUT_COUNT - 1)], buffer, sizeof(buffer));
+    });
+
+    SPIFFSDataStorage binary(benchLoggerConfig(LogFormat::BINARY, false));
+    runBench("format_binary", FORMAT_ITERATIONS, [&](uint32_t i) {
+        sink = binary.encodeReading(readings[i & (INPUT_COUNT - 1)], buffer, sizeof(buffer));
+    });
+
+    uint8_t block[MAX_COMPRESSED_BLOCK_SIZE];
+    runBench("compress_block", FORMAT_ITERATIONS / COMPRESSION_BLOCK_SIZE, [&](uint32_t i) {
+        size_t offset = (i * COMPRESSION_BLOCK_SIZE) % INPUT_COUNT;
+        sink = BlockCompressor::compress(readings + offset, COMPRESSION_BLOCK_SIZE, block, sizeof(block));
+    });
+}
+
+static void removeBenchFiles() {
+    File root = SPIFFS.open("/");
+    File file = root.openNextFile();
+    while (file) {
+        char path[MAX_LOG_PATH_LEN + 32];
+        strncpy(path, file.path(), sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        file.close();
+
+        if (strncmp(path, BENCH_LOG_PATH, strlen(BENCH_LOG_PATH)) == 0) {
+            SPIFFS.remove(path);
+        }
+        file = root.openNextFile();
+    }
+}
+
+static void benchStorageWrite(const char* name, LogFormat format, bool compression) {
+    LoggerConfig config = benchLoggerConfig(format, compression);
+
+    // Byte count from a scratch encoder (compressed size from the compressor)
+    uint64_t bytes = 0;
+    if (compression) {
+        uint8_t block[MAX_COMPRESSED_BLOCK_SIZE];
+        for (uint32_t i = 0; i < WRITE_READINGS; i += COMPRESSION_BLOCK_SIZE) {
+            size_t offset = i % INPUT_COUNT;
+            size_t count = std::min<size_t>(COMPRESSION_BLOCK_SIZE, WRITE_READINGS - i);
+            bytes += BlockCompressor::compress(readings + offset, count, block, sizeof(block));
+        }
+    } else {
+        SPIFFSDataStorage scratch(config);
+        char buffer[128];
+        for (uint32_t i = 0; i < WRITE_READINGS; ++i) {
+            bytes += scratch.encodeReading(readings[i & (INPUT_COUNT - 1)], buffer, sizeof(buffer));
+        }
+    }
+
+    SPIFFSDataStorage storage(config);
+    if (!storage.initialize()) {
+        Serial.printf("bench,%s,error\n", name);
+        return;
+    }
+
+    Timer timer;
+    // The last block is short, so exactly WRITE_READINGS are written
+    for (uint32_t i = 0; i < WRITE_READINGS; i += MAX_BLOCK_SIZE) {
+        size_t offset = i % INPUT_COUNT;
+        storage.writeBatch(readings + offset, std::min<size_t>(MAX_BLOCK_SIZE, WRITE_READINGS - i));
+    }
+    storage.flush();
+    uint32_t cycles = timer.elapsedCycles();
+    uint32_t elapsed_us = timer.elapsedUs();
+    storage.close();
+
+    report(name, WRITE_READINGS, cycles, elapsed_us, bytes);
+    removeBenchFiles();
+}
+
+static void benchEndToEnd(const char* preset_name) {
+    SystemConfig config = ConfigPresets::getPreset(preset_name);
+
+    // Sample back to back; the preset's interval and sleep would only measure idle time
+    config.sensor.sampling_mode = SamplingMode::POLLED;
+    config.sensor.enable_adaptive_sampling = false;
+    config.logger = benchLoggerConfig(config.logger.log_format, config.logger.enable_compression);
+
+    ADCLightSensor sensor(config.sensor);
+    SignalProcessor processor(config.signal);
+    DataLogger logger(config.logger);
+    if (!sensor.initialize() || !logger.initialize()) {
+        Serial.printf("bench,end_to_end_%s,error\n", preset_name);
+        return;
+    }
+    processor.setCalibration(config.sensor);
+    logger.setCalibration(config.sensor);
+
+    uint32_t samples = 0;
+    Timer timer;
+    while (!timer.hasElapsed(END_TO_END_MS)) {
+        SensorReading reading = sensor.read();
+        sink = processor.processReading(reading).filtered_value;
+        logger.logReading(reading);
+        logger.process();
+        samples++;
+    }
+    logger.flush();
+    uint32_t elapsed_us = timer.elapsedUs();
+
+    // The cycle counter wraps after ~17 s; derive cycles from time instead
+    uint32_t cycles_per_sample = static_cast<uint32_t>(
+        static_cast<uint64_t>(elapsed_us) * getCpuFrequencyMhz() / (samples > 0 ? samples : 1));
+
+    char name[48];
+    snprintf(name, sizeof(name), "end_to_end_%s", preset_name);
+    report(name, samples, cycles_per_sample * samples, elapsed_us);
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial && millis() < 3000) {
+        delay(10);
+    }
+
+    setCpuFrequencyMhz(240);
+    if (!SPIFFS.begin(true)) {
+        Serial.println("bench,error,spiffs");
+    }
+    removeBenchFiles();
+    makeInputs();
+
+    Serial.println("bench,name,iterations,cycles_per_op,ops_per_sec,bytes_per_sec");
+
+    benchFilters();
+    benchSignalProcessor();
+    benchFormatting();
+
+    benchStorageWrite("spiffs_write_csv", LogFormat::CSV, false);
+    benchStorageWrite("spiffs_write_binary", LogFormat::BINARY, false);
+    benchStorageWrite("spiffs_write_compressed", LogFormat::BINARY, true);
+
+    for (const char* preset : PRESETS) {
+        benchEndToEnd(preset);
+        removeBenchFiles();
+    }
+
+    Serial.println("bench,done");
+}
+
+void loop() {
+    delay(1000);
+}
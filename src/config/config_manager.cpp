@@ -1,14 +1,525 @@
 #include "config_manager.h"
+#include "profiler.h"
+#include "rollup_store.h"
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
+#include <esp_rom_crc.h>
 #include <cstring>
+#include <cstddef>
+#include <cstdio>
 #include <cmath>
+#include <cstdlib>
 
 namespace LightSensor {
 
+// JSON documents live in a static arena instead of the heap
+alignas(8) static uint8_t json_arena_buffer[JSON_ARENA_SIZE];
+static StaticArena json_arena(json_arena_buffer, sizeof(json_arena_buffer));
+
+/**
+ * @brief ArduinoJson allocator over json_arena, falling back to the heap when it is full
+ *
+ * Each arena block is prefixed with its size so reallocate() can copy it.
+ */
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        uint8_t* block = static_cast<uint8_t*>(json_arena.allocate(size + StaticArena::ALIGNMENT));
+        if (!block) {
+            return malloc(size);
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+        return block + StaticArena::ALIGNMENT;
+    }
+    
+    void deallocate(void* pointer) override {
+        // Arena blocks come back all at once when the ArenaScope ends
+        if (!json_arena.owns(pointer)) {
+            free(pointer);
+        }
+    }
+    
+    void* reallocate(void* pointer, size_t size) override {
+        if (!pointer) {
+            return allocate(size);
+        }
+        if (!json_arena.owns(pointer)) {
+            return realloc(pointer, size);
+        }
+        
+        uint8_t* block = static_cast<uint8_t*>(pointer) - StaticArena::ALIGNMENT;
+        size_t old_size = *reinterpret_cast<size_t*>(block);
+        if (json_arena.resize(block, size + StaticArena::ALIGNMENT)) {
+            *reinterpret_cast<size_t*>(block) = size;
+            return pointer;
+        }
+        
+        void* moved = allocate(size);
+        if (moved) {
+            memcpy(moved, pointer, old_size < size ? old_size : size);
+        }
+        return moved;
+    }
+};
+
+static JsonArenaAllocator json_allocator;
+
+static const char* samplingModeToString(SamplingMode mode) {
+    return mode == SamplingMode::CONTINUOUS ? "continuous" : "polled";
+}
+
+static SamplingMode samplingModeFromString(const char* value) {
+    if (value && strcmp(value, "continuous") == 0) {
+        return SamplingMode::CONTINUOUS;
+    }
+    return SamplingMode::POLLED;
+}
+
+static const char* logFormatToString(LogFormat format) {
+    return format == LogFormat::BINARY ? "binary" : "csv";
+}
+
+static LogFormat logFormatFromString(const char* value) {
+    if (value && strcmp(value, "binary") == 0) {
+        return LogFormat::BINARY;
+    }
+    return LogFormat::CSV;
+}
+
+static const char* storageBackendToString(StorageBackend backend) {
+    switch (backend) {
+        case StorageBackend::SEGMENTS: return "segments";
+        case StorageBackend::LITTLEFS: return "littlefs";
+        default:                       return "files";
+    }
+}
+
+static StorageBackend storageBackendFromString(const char* value) {
+    if (value && strcmp(value, "segments") == 0) {
+        return StorageBackend::SEGMENTS;
+    }
+    if (value && strcmp(value, "littlefs") == 0) {
+        return StorageBackend::LITTLEFS;
+    }
+    return StorageBackend::FILES;
+}
+
+static const char* exceptionModeToString(ExceptionMode mode) {
+    switch (mode) {
+        case ExceptionMode::DEADBAND:      return "deadband";
+        case ExceptionMode::SWINGING_DOOR: return "swinging_door";
+        default:                           return "off";
+    }
+}
+
+static ExceptionMode exceptionModeFromString(const char* value) {
+    if (value && strcmp(value, "deadband") == 0) {
+        return ExceptionMode::DEADBAND;
+    }
+    if (value && strcmp(value, "swinging_door") == 0) {
+        return ExceptionMode::SWINGING_DOOR;
+    }
+    return ExceptionMode::OFF;
+}
+
+static const char* uplinkTransportToString(UplinkTransport transport) {
+    return transport == UplinkTransport::MQTT ? "mqtt" : "http";
+}
+
+static UplinkTransport uplinkTransportFromString(const char* value) {
+    if (value && strcmp(value, "mqtt") == 0) {
+        return UplinkTransport::MQTT;
+    }
+    return UplinkTransport::HTTP;
+}
+
+static const char* filterTypeToString(FilterType type) {
+    switch (type) {
+        case FilterType::MOVING_AVERAGE: return "moving_average";
+        case FilterType::LOW_PASS:       return "low_pass";
+        case FilterType::HIGH_PASS:      return "high_pass";
+        case FilterType::MEDIAN:         return "median";
+        case FilterType::ADAPTIVE:       return "adaptive";
+        default:                         return "unknown";
+    }
+}
+
+static bool filterTypeFromString(const char* value, FilterType& type) {
+    if (!value) {
+        return false;
+    }
+    
+    if (strcmp(value, "moving_average") == 0) {
+        type = FilterType::MOVING_AVERAGE;
+    } else if (strcmp(value, "low_pass") == 0) {
+        type = FilterType::LOW_PASS;
+    } else if (strcmp(value, "median") == 0) {
+        type = FilterType::MEDIAN;
+    } else if (strcmp(value, "adaptive") == 0) {
+        type = FilterType::ADAPTIVE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Field table for diffConfig(): how each SystemConfig member is compared
+// and reported. Keep in step with the structs and with saveConfig().
+enum class FieldType : uint8_t {
+    BOOL,
+    UINT,
+    FLOAT,
+    STRING,
+    SECRET,         // STRING that is never printed
+    SAMPLING_MODE,
+    LOG_FORMAT,
+    STORAGE_BACKEND,
+    EXCEPTION_MODE,
+    FILTER_ORDER,
+    PIN_LIST,
+    UPLINK_TRANSPORT
+};
+
+struct ConfigField {
+    ConfigSection section;
+    const char* key;
+    size_t offset;
+    size_t size;
+    FieldType type;
+};
+
+#define SYSTEM_FIELD(field, type) \
+    {ConfigSection::SYSTEM, #field, offsetof(SystemConfig, field), \
+     sizeof(decltype(SystemConfig::field)), FieldType::type}
+
+#define SECTION_FIELD(section, member, Struct, field, type) \
+    {ConfigSection::section, #member "." #field, \
+     offsetof(SystemConfig, member) + offsetof(Struct, field), \
+     sizeof(decltype(Struct::field)), FieldType::type}
+
+#define SENSOR_FIELD(field, type)   SECTION_FIELD(SENSOR, sensor, SensorConfig, field, type)
+#define POWER_FIELD(field, type)    SECTION_FIELD(POWER, power, PowerConfig, field, type)
+#define LOGGER_FIELD(field, type)   SECTION_FIELD(LOGGER, logger, LoggerConfig, field, type)
+#define SIGNAL_FIELD(field, type)   SECTION_FIELD(SIGNAL, signal, SignalConfig, field, type)
+#define PIPELINE_FIELD(field, type) SECTION_FIELD(PIPELINE, pipeline, PipelineConfig, field, type)
+#define UPLINK_FIELD(field, type)   SECTION_FIELD(UPLINK, uplink, UplinkConfig, field, type)
+
+// At most 32 fields per section (one ConfigDiff bit each)
+static const ConfigField CONFIG_FIELDS[] = {
+    SYSTEM_FIELD(device_id, STRING),
+    SYSTEM_FIELD(firmware_version, STRING),
+    SYSTEM_FIELD(enable_debug_mode, BOOL),
+    SYSTEM_FIELD(enable_async_logging, BOOL),
+    SYSTEM_FIELD(system_timeout_ms, UINT),
+    SYSTEM_FIELD(enable_watchdog, BOOL),
+    SYSTEM_FIELD(watchdog_timeout_ms, UINT),
+    
+    SENSOR_FIELD(adc_pin, UINT),
+    SENSOR_FIELD(array_pins, PIN_LIST),
+    SENSOR_FIELD(array_channel_count, UINT),
+    SENSOR_FIELD(adc_resolution, UINT),
+    SENSOR_FIELD(reference_voltage, FLOAT),
+    SENSOR_FIELD(dark_offset, FLOAT),
+    SENSOR_FIELD(sensitivity, FLOAT),
+    SENSOR_FIELD(noise_threshold, FLOAT),
+    SENSOR_FIELD(sample_rate_ms, UINT),
+    SENSOR_FIELD(oversampling, UINT),
+    SENSOR_FIELD(auto_gain, BOOL),
+    SENSOR_FIELD(sampling_mode, SAMPLING_MODE),
+    SENSOR_FIELD(continuous_sample_rate_hz, UINT),
+    SENSOR_FIELD(block_size, UINT),
+    SENSOR_FIELD(enable_adaptive_sampling, BOOL),
+    SENSOR_FIELD(max_sample_rate_ms, UINT),
+    SENSOR_FIELD(min_oversampling, UINT),
+    SENSOR_FIELD(adaptive_change_threshold, FLOAT),
+    SENSOR_FIELD(low_power_mode, BOOL),
+    SENSOR_FIELD(sleep_duration_ms, UINT),
+    
+    POWER_FIELD(sleep_timeout_ms, UINT),
+    POWER_FIELD(deep_sleep_timeout_ms, UINT),
+    POWER_FIELD(enable_wake_on_light, BOOL),
+    POWER_FIELD(light_threshold, FLOAT),
+    POWER_FIELD(enable_ulp_sampling, BOOL),
+    POWER_FIELD(ulp_sample_period_ms, UINT),
+    POWER_FIELD(disable_unused_peripherals, BOOL),
+    POWER_FIELD(reduce_clock_speed, BOOL),
+    POWER_FIELD(adc_sample_delay_ms, UINT),
+    POWER_FIELD(enable_sleep_scheduler, BOOL),
+    POWER_FIELD(min_light_sleep_ms, UINT),
+    POWER_FIELD(low_battery_threshold, FLOAT),
+    POWER_FIELD(critical_battery_threshold, FLOAT),
+    POWER_FIELD(enable_battery_monitoring, BOOL),
+    POWER_FIELD(battery_capacity_mah, FLOAT),
+    
+    LOGGER_FIELD(log_file_path, STRING),
+    LOGGER_FIELD(buffer_size, UINT),
+    LOGGER_FIELD(flush_threshold, UINT),
+    LOGGER_FIELD(enable_compression, BOOL),
+    LOGGER_FIELD(enable_timestamp, BOOL),
+    LOGGER_FIELD(log_format, LOG_FORMAT),
+    LOGGER_FIELD(enable_async_flush, BOOL),
+    LOGGER_FIELD(storage_backend, STORAGE_BACKEND),
+    LOGGER_FIELD(min_lux_threshold, FLOAT),
+    LOGGER_FIELD(max_lux_threshold, FLOAT),
+    LOGGER_FIELD(filter_noise, BOOL),
+    LOGGER_FIELD(min_quality_threshold, UINT),
+    LOGGER_FIELD(max_file_size_bytes, UINT),
+    LOGGER_FIELD(max_log_days, UINT),
+    LOGGER_FIELD(enable_rotation, BOOL),
+    LOGGER_FIELD(history_size, UINT),
+    LOGGER_FIELD(enable_rollups, BOOL),
+    LOGGER_FIELD(rollup_minute_days, UINT),
+    LOGGER_FIELD(rollup_hour_days, UINT),
+    LOGGER_FIELD(exception_mode, EXCEPTION_MODE),
+    LOGGER_FIELD(exception_deviation_lux, FLOAT),
+    LOGGER_FIELD(exception_max_interval_ms, UINT),
+    
+    SIGNAL_FIELD(moving_average_window, UINT),
+    SIGNAL_FIELD(low_pass_cutoff, FLOAT),
+    SIGNAL_FIELD(high_pass_cutoff, FLOAT),
+    SIGNAL_FIELD(enable_median_filter, BOOL),
+    SIGNAL_FIELD(median_window, UINT),
+    SIGNAL_FIELD(noise_threshold, FLOAT),
+    SIGNAL_FIELD(enable_outlier_removal, BOOL),
+    SIGNAL_FIELD(outlier_threshold, FLOAT),
+    SIGNAL_FIELD(enable_trend_detection, BOOL),
+    SIGNAL_FIELD(trend_window, UINT),
+    SIGNAL_FIELD(enable_peak_detection, BOOL),
+    SIGNAL_FIELD(peak_threshold, FLOAT),
+    SIGNAL_FIELD(enable_adaptive_filter, BOOL),
+    SIGNAL_FIELD(adaptation_rate, FLOAT),
+    SIGNAL_FIELD(noise_floor, FLOAT),
+    SIGNAL_FIELD(filter_order, FILTER_ORDER),
+    SIGNAL_FIELD(filter_stage_count, UINT),
+    SIGNAL_FIELD(use_fixed_point, BOOL),
+    SIGNAL_FIELD(enable_spectral_analysis, BOOL),
+    SIGNAL_FIELD(enable_events, BOOL),
+    SIGNAL_FIELD(event_low_lux, FLOAT),
+    SIGNAL_FIELD(event_high_lux, FLOAT),
+    SIGNAL_FIELD(event_hysteresis_lux, FLOAT),
+    
+    PIPELINE_FIELD(enabled, BOOL),
+    PIPELINE_FIELD(acquisition_core, UINT),
+    PIPELINE_FIELD(processing_core, UINT),
+    PIPELINE_FIELD(acquisition_priority, UINT),
+    PIPELINE_FIELD(processing_priority, UINT),
+    PIPELINE_FIELD(acquisition_stack_size, UINT),
+    PIPELINE_FIELD(processing_stack_size, UINT),
+    
+    UPLINK_FIELD(enabled, BOOL),
+    UPLINK_FIELD(transport, UPLINK_TRANSPORT),
+    UPLINK_FIELD(wifi_ssid, STRING),
+    UPLINK_FIELD(wifi_password, SECRET),
+    UPLINK_FIELD(host, STRING),
+    UPLINK_FIELD(port, UINT),
+    UPLINK_FIELD(path, STRING),
+    UPLINK_FIELD(batch_interval_ms, UINT),
+    UPLINK_FIELD(min_batch_bytes, UINT),
+    UPLINK_FIELD(max_batch_bytes, UINT),
+    UPLINK_FIELD(connect_timeout_ms, UINT)
+};
+
+static const size_t CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+// Position of each field within its section, used as its ConfigDiff bit
+static uint8_t fieldBit(size_t field_index) {
+    uint8_t bit = 0;
+    for (size_t i = 0; i < field_index; ++i) {
+        if (CONFIG_FIELDS[i].section == CONFIG_FIELDS[field_index].section) {
+            bit++;
+        }
+    }
+    return bit;
+}
+
+static bool fieldEquals(const ConfigField& field, const SystemConfig& a, const SystemConfig& b) {
+    const char* lhs = reinterpret_cast<const char*>(&a) + field.offset;
+    const char* rhs = reinterpret_cast<const char*>(&b) + field.offset;
+    
+    if (field.type == FieldType::STRING || field.type == FieldType::SECRET) {
+        return strncmp(lhs, rhs, field.size) == 0;  // Ignore bytes after the terminator
+    }
+    return memcmp(lhs, rhs, field.size) == 0;
+}
+
+static void formatFieldValue(const ConfigField& field, const SystemConfig& config,
+                             char* buffer, size_t buffer_size) {
+    const char* value = reinterpret_cast<const char*>(&config) + field.offset;
+    
+    switch (field.type) {
+        case FieldType::BOOL:
+            snprintf(buffer, buffer_size, "%s", *reinterpret_cast<const bool*>(value) ? "true" : "false");
+            break;
+        case FieldType::UINT: {
+            uint32_t number = 0;
+            if (field.size == sizeof(uint8_t)) {
+                number = *reinterpret_cast<const uint8_t*>(value);
+            } else if (field.size == sizeof(uint16_t)) {
+                number = *reinterpret_cast<const uint16_t*>(value);
+            } else {
+                number = *reinterpret_cast<const uint32_t*>(value);
+            }
+            snprintf(buffer, buffer_size, "%lu", static_cast<unsigned long>(number));
+            break;
+        }
+        case FieldType::FLOAT:
+            snprintf(buffer, buffer_size, "%.4f", *reinterpret_cast<const float*>(value));
+            break;
+        case FieldType::STRING:
+            snprintf(buffer, buffer_size, "%.*s", static_cast<int>(field.size), value);
+            break;
+        case FieldType::SECRET:
+            snprintf(buffer, buffer_size, "%s", value[0] != '\0' ? "********" : "");
+            break;
+        case FieldType::SAMPLING_MODE:
+            snprintf(buffer, buffer_size, "%s", samplingModeToString(config.sensor.sampling_mode));
+            break;
+        case FieldType::LOG_FORMAT:
+            snprintf(buffer, buffer_size, "%s", logFormatToString(config.logger.log_format));
+            break;
+        case FieldType::STORAGE_BACKEND:
+            snprintf(buffer, buffer_size, "%s", storageBackendToString(config.logger.storage_backend));
+            break;
+        case FieldType::EXCEPTION_MODE:
+            snprintf(buffer, buffer_size, "%s", exceptionModeToString(config.logger.exception_mode));
+            break;
+        case FieldType::UPLINK_TRANSPORT:
+            snprintf(buffer, buffer_size, "%s", uplinkTransportToString(config.uplink.transport));
+            break;
+        case FieldType::FILTER_ORDER: {
+            size_t used = 0;
+            buffer[0] = '\0';
+            for (uint8_t i = 0; i < config.signal.filter_stage_count && i < MAX_FILTER_STAGES; ++i) {
+                int written = snprintf(buffer + used, buffer_size - used, "%s%s", i > 0 ? "," : "",
+                                       filterTypeToString(config.signal.filter_order[i]));
+                if (written < 0 || used + written >= buffer_size) {
+                    break;
+                }
+                used += written;
+            }
+            break;
+        }
+        case FieldType::PIN_LIST: {
+            size_t used = 0;
+            buffer[0] = '\0';
+            for (uint8_t i = 0; i < config.sensor.array_channel_count && i < MAX_ADC_CHANNELS; ++i) {
+                int written = snprintf(buffer + used, buffer_size - used, "%s%u", i > 0 ? "," : "",
+                                       config.sensor.array_pins[i]);
+                if (written < 0 || used + written >= buffer_size) {
+                    break;
+                }
+                used += written;
+            }
+            break;
+        }
+    }
+}
+
+bool ConfigDiff::any() const {
+    for (size_t i = 0; i < CONFIG_SECTION_COUNT; ++i) {
+        if (fields[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ConfigDiff::changed(ConfigSection section) const {
+    return fields[static_cast<size_t>(section)] != 0;
+}
+
+bool ConfigDiff::changed(const char* key) const {
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; ++i) {
+        if (strcmp(CONFIG_FIELDS[i].key, key) == 0) {
+            return (fields[static_cast<size_t>(CONFIG_FIELDS[i].section)] >> fieldBit(i)) & 1;
+        }
+    }
+    return false;
+}
+
+uint8_t ConfigDiff::count() const {
+    uint8_t total = 0;
+    for (size_t i = 0; i < CONFIG_SECTION_COUNT; ++i) {
+        total += __builtin_popcount(fields[i]);
+    }
+    return total;
+}
+
+static const uint32_t CONFIG_SNAPSHOT_MAGIC = 0x43534E50;  // "CSNP"
+static const uint16_t CONFIG_SNAPSHOT_VERSION = 2;
+
+/**
+ * @brief Parsed configuration carried across deep sleep in RTC memory
+ *
+ * Valid while both JSON files still hash to the values it was built from
+ * and the firmware is the build that wrote it. Secrets are not kept: RTC
+ * memory survives a soft reset and can be read out, so SECRET fields are
+ * zeroed here and read back from config.json on restore.
+ */
+struct ConfigSnapshot {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // sizeof(ConfigSnapshot), catches layout changes
+    uint32_t build_id;          // snapshotBuildId(), catches same-size layout changes
+    bool has_secrets;           // config.json had SECRET fields to read back
+    uint32_t config_hash;       // CRC32 of config.json
+    uint32_t calibration_hash;  // CRC32 of calibration.json
+    SystemConfig config;
+    CalibrationData calibration;
+    uint32_t crc;               // CRC32 of the fields above
+};
+
+static RTC_DATA_ATTR ConfigSnapshot s_config_snapshot;
+
+static uint32_t snapshotCrc(const ConfigSnapshot& snapshot) {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&snapshot),
+                            offsetof(ConfigSnapshot, crc));
+}
+
+// Differs between builds, so a snapshot never outlives the firmware that wrote it
+static uint32_t snapshotBuildId() {
+    static const char BUILD[] = __DATE__ " " __TIME__;
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(BUILD), sizeof(BUILD) - 1);
+}
+
+// Zero every SECRET field; returns true if any was set
+static bool clearSecrets(SystemConfig& config) {
+    bool had_secrets = false;
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; ++i) {
+        if (CONFIG_FIELDS[i].type == FieldType::SECRET) {
+            char* value = reinterpret_cast<char*>(&config) + CONFIG_FIELDS[i].offset;
+            had_secrets |= value[0] != '\0';
+            memset(value, 0, CONFIG_FIELDS[i].size);
+        }
+    }
+    return had_secrets;
+}
+
+// CRC32 of a file's contents (0 if missing)
+static uint32_t hashFile(const char* path) {
+    if (!SPIFFS.exists(path)) {
+        return 0;
+    }
+    
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return 0;
+    }
+    
+    uint8_t chunk[256];
+    uint32_t crc = 0;
+    size_t bytes_read;
+    while ((bytes_read = file.read(chunk, sizeof(chunk))) > 0) {
+        crc = esp_rom_crc32_le(crc, chunk, bytes_read);
+    }
+    file.close();
+    
+    return crc;
+}
+
 ConfigManager::ConfigManager(const char* config_file_path)
-    : spiffs_initialized_(false) {
+    : spiffs_initialized_(false), restored_from_snapshot_(false) {
     
     strncpy(config_file_path_, config_file_path, MAX_PATH_LEN - 1);
     config_file_path_[MAX_PATH_LEN - 1] = '\0';
@@ -27,6 +538,12 @@ bool ConfigManager::initialize() {
         return false;
     }
     
+    // Hashing the files is much cheaper than parsing them; on a wake from
+    // deep sleep the snapshot is reused while neither file has changed
+    if (restoreSnapshot(hashFile(config_file_path_), hashFile(calibration_file_path_))) {
+        return true;
+    }
+    
     // Try to load existing configuration
     if (!loadConfig()) {
         // If loading fails, save default configuration
@@ -38,6 +555,7 @@ bool ConfigManager::initialize() {
     // Try to load calibration data
     loadCalibration();
     
+    storeSnapshot();
     return true;
 }
 
@@ -58,43 +576,100 @@ bool ConfigManager::isStorageAvailable() const {
     return spiffs_initialized_;
 }
 
-bool ConfigManager::loadConfig() {
-    if (!spiffs_initialized_) {
+bool ConfigManager::isRestoredFromSnapshot() const {
+    return restored_from_snapshot_;
+}
+
+bool ConfigManager::restoreSnapshot(uint32_t config_hash, uint32_t calibration_hash) {
+    const ConfigSnapshot& snapshot = s_config_snapshot;
+    if (snapshot.magic != CONFIG_SNAPSHOT_MAGIC ||
+        snapshot.version != CONFIG_SNAPSHOT_VERSION ||
+        snapshot.size != sizeof(ConfigSnapshot) ||
+        snapshot.build_id != snapshotBuildId() ||
+        snapshot.crc != snapshotCrc(snapshot)) {
         return false;
     }
     
+    // A missing config.json always goes through the JSON path (and is re-created)
+    if (config_hash == 0 || snapshot.config_hash != config_hash ||
+        snapshot.calibration_hash != calibration_hash) {
+        return false;
+    }
+    
+    config_ = snapshot.config;
+    calibration_data_ = snapshot.calibration;
+    if (snapshot.has_secrets && !loadSecrets()) {
+        return false;  // The full parse below reads them with everything else
+    }
+    restored_from_snapshot_ = true;
+    return true;
+}
+
+bool ConfigManager::loadSecrets() {
     File config_file = SPIFFS.open(config_file_path_, FILE_READ);
     if (!config_file) {
         return false;
     }
     
-    // Read file content
-    size_t file_size = config_file.size();
-    if (file_size > 4096) {  // Sanity check
-        config_file.close();
+    // Only the SECRET fields are kept from the parse; keep in step with CONFIG_FIELDS
+    ArenaScope json_scope(json_arena);
+    JsonDocument filter(&json_allocator);
+    filter["uplink"]["wifi_password"] = true;
+    JsonDocument doc(&json_allocator);
+    DeserializationError error = deserializeJson(doc, config_file, DeserializationOption::Filter(filter));
+    config_file.close();
+    if (error) {
         return false;
     }
     
-    char* json_buffer = new char[file_size + 1];
-    if (!json_buffer) {
+    strncpy(config_.uplink.wifi_password, doc["uplink"]["wifi_password"] | "", MAX_WIFI_PASSWORD_LEN - 1);
+    config_.uplink.wifi_password[MAX_WIFI_PASSWORD_LEN - 1] = '\0';
+    return true;
+}
+
+void ConfigManager::storeSnapshot() {
+    ConfigSnapshot& snapshot = s_config_snapshot;
+    snapshot.magic = CONFIG_SNAPSHOT_MAGIC;
+    snapshot.version = CONFIG_SNAPSHOT_VERSION;
+    snapshot.size = sizeof(ConfigSnapshot);
+    snapshot.build_id = snapshotBuildId();
+    snapshot.config_hash = hashFile(config_file_path_);
+    snapshot.calibration_hash = hashFile(calibration_file_path_);
+    snapshot.config = config_;
+    snapshot.has_secrets = clearSecrets(snapshot.config);
+    snapshot.calibration = calibration_data_;
+    snapshot.crc = snapshotCrc(snapshot);
+}
+
+bool ConfigManager::loadConfig() {
+    LS_PROFILE_SCOPE(CONFIG_LOAD);
+    
+    if (!spiffs_initialized_) {
+        return false;
+    }
+    
+    File config_file = SPIFFS.open(config_file_path_, FILE_READ);
+    if (!config_file) {
+        return false;
+    }
+    
+    if (config_file.size() > 4096) {  // Sanity check
         config_file.close();
         return false;
     }
     
-    size_t bytes_read = config_file.readBytes(json_buffer, file_size);
-    json_buffer[bytes_read] = '\0';
+    bool result = parseJsonConfig(config_file);
     config_file.close();
     
-    bool result = parseJsonConfig(json_buffer);
-    delete[] json_buffer;
-    
     return result;
 }
 
-bool ConfigManager::parseJsonConfig(const char* json) {
-    JsonDocument doc;
+bool ConfigManager::parseJsonConfig(File& input) {
+    ArenaScope json_scope(json_arena);
+    JsonDocument doc(&json_allocator);
     
-    DeserializationError error = deserializeJson(doc, json);
+    // Parse straight from the file rather than a heap copy of it
+    DeserializationError error = deserializeJson(doc, input);
     if (error) {
         return false;
     }
@@ -107,6 +682,7 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         strncpy(config_.firmware_version, doc["firmware_version"] | "1.0.0", MAX_VERSION_LEN - 1);
     }
     config_.enable_debug_mode = doc["enable_debug_mode"] | false;
+    config_.enable_async_logging = doc["enable_async_logging"] | true;
     config_.system_timeout_ms = doc["system_timeout_ms"] | 300000;
     config_.enable_watchdog = doc["enable_watchdog"] | true;
     config_.watchdog_timeout_ms = doc["watchdog_timeout_ms"] | 8000;
@@ -115,6 +691,17 @@ bool ConfigManager::parseJsonConfig(const char* json) {
     JsonObject sensor = doc["sensor"];
     if (!sensor.isNull()) {
         config_.sensor.adc_pin = sensor["adc_pin"] | 34;
+        
+        // Unused slots stay zero so the config diff only sees listed pins
+        memset(config_.sensor.array_pins, 0, sizeof(config_.sensor.array_pins));
+        config_.sensor.array_channel_count = 0;
+        JsonArray array_pins = sensor["array_pins"];
+        for (JsonVariant pin : array_pins) {
+            if (config_.sensor.array_channel_count < MAX_ADC_CHANNELS) {
+                config_.sensor.array_pins[config_.sensor.array_channel_count++] = pin.as<uint8_t>();
+            }
+        }
+        
         config_.sensor.adc_resolution = sensor["adc_resolution"] | 12;
         config_.sensor.reference_voltage = sensor["reference_voltage"] | 3.3f;
         config_.sensor.dark_offset = sensor["dark_offset"] | 0.0f;
@@ -123,6 +710,13 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         config_.sensor.sample_rate_ms = sensor["sample_rate_ms"] | 1000;
         config_.sensor.oversampling = sensor["oversampling"] | 4;
         config_.sensor.auto_gain = sensor["auto_gain"] | false;
+        config_.sensor.sampling_mode = samplingModeFromString(sensor["sampling_mode"] | "polled");
+        config_.sensor.continuous_sample_rate_hz = sensor["continuous_sample_rate_hz"] | 2000;
+        config_.sensor.block_size = sensor["block_size"] | 32;
+        config_.sensor.enable_adaptive_sampling = sensor["enable_adaptive_sampling"] | false;
+        config_.sensor.max_sample_rate_ms = sensor["max_sample_rate_ms"] | 10000;
+        config_.sensor.min_oversampling = sensor["min_oversampling"] | 1;
+        config_.sensor.adaptive_change_threshold = sensor["adaptive_change_threshold"] | 0.05f;
         config_.sensor.low_power_mode = sensor["low_power_mode"] | true;
         config_.sensor.sleep_duration_ms = sensor["sleep_duration_ms"] | 100;
     }
@@ -134,12 +728,17 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         config_.power.deep_sleep_timeout_ms = power["deep_sleep_timeout_ms"] | 300000;
         config_.power.enable_wake_on_light = power["enable_wake_on_light"] | true;
         config_.power.light_threshold = power["light_threshold"] | 0.1f;
+        config_.power.enable_ulp_sampling = power["enable_ulp_sampling"] | false;
+        config_.power.ulp_sample_period_ms = power["ulp_sample_period_ms"] | 1000;
         config_.power.disable_unused_peripherals = power["disable_unused_peripherals"] | true;
         config_.power.reduce_clock_speed = power["reduce_clock_speed"] | true;
         config_.power.adc_sample_delay_ms = power["adc_sample_delay_ms"] | 1;
+        config_.power.enable_sleep_scheduler = power["enable_sleep_scheduler"] | false;
+        config_.power.min_light_sleep_ms = power["min_light_sleep_ms"] | 5;
         config_.power.low_battery_threshold = power["low_battery_threshold"] | 3.2f;
         config_.power.critical_battery_threshold = power["critical_battery_threshold"] | 3.0f;
         config_.power.enable_battery_monitoring = power["enable_battery_monitoring"] | true;
+        config_.power.battery_capacity_mah = power["battery_capacity_mah"] | 2000.0f;
     }
     
     // Parse logger configuration
@@ -150,6 +749,9 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         config_.logger.flush_threshold = logger["flush_threshold"] | 50;
         config_.logger.enable_compression = logger["enable_compression"] | false;
         config_.logger.enable_timestamp = logger["enable_timestamp"] | true;
+        config_.logger.log_format = logFormatFromString(logger["log_format"] | "csv");
+        config_.logger.enable_async_flush = logger["enable_async_flush"] | false;
+        config_.logger.storage_backend = storageBackendFromString(logger["storage_backend"] | "files");
         config_.logger.min_lux_threshold = logger["min_lux_threshold"] | 0.0f;
         config_.logger.max_lux_threshold = logger["max_lux_threshold"] | 100000.0f;
         config_.logger.filter_noise = logger["filter_noise"] | true;
@@ -157,6 +759,13 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         config_.logger.max_file_size_bytes = logger["max_file_size_bytes"] | 1048576;
         config_.logger.max_log_days = logger["max_log_days"] | 30;
         config_.logger.enable_rotation = logger["enable_rotation"] | true;
+        config_.logger.history_size = logger["history_size"] | 0;
+        config_.logger.enable_rollups = logger["enable_rollups"] | true;
+        config_.logger.rollup_minute_days = logger["rollup_minute_days"] | 2;
+        config_.logger.rollup_hour_days = logger["rollup_hour_days"] | 60;
+        config_.logger.exception_mode = exceptionModeFromString(logger["exception_mode"] | "off");
+        config_.logger.exception_deviation_lux = logger["exception_deviation_lux"] | 1.0f;
+        config_.logger.exception_max_interval_ms = logger["exception_max_interval_ms"] | 600000;
     }
     
     // Parse signal configuration
@@ -177,6 +786,52 @@ bool ConfigManager::parseJsonConfig(const char* json) {
         config_.signal.enable_adaptive_filter = signal["enable_adaptive_filter"] | true;
         config_.signal.adaptation_rate = signal["adaptation_rate"] | 0.1f;
         config_.signal.noise_floor = signal["noise_floor"] | 0.001f;
+        config_.signal.use_fixed_point = signal["use_fixed_point"] | false;
+        config_.signal.enable_spectral_analysis = signal["enable_spectral_analysis"] | false;
+        config_.signal.enable_events = signal["enable_events"] | false;
+        config_.signal.event_low_lux = signal["event_low_lux"] | 0.0f;
+        config_.signal.event_high_lux = signal["event_high_lux"] | 0.0f;
+        config_.signal.event_hysteresis_lux = signal["event_hysteresis_lux"] | 5.0f;
+        
+        JsonArray filter_order = signal["filter_order"];
+        if (!filter_order.isNull()) {
+            config_.signal.filter_stage_count = 0;
+            for (JsonVariant stage : filter_order) {
+                FilterType type;
+                if (config_.signal.filter_stage_count < MAX_FILTER_STAGES &&
+                    filterTypeFromString(stage.as<const char*>(), type)) {
+                    config_.signal.filter_order[config_.signal.filter_stage_count++] = type;
+                }
+            }
+        }
+    }
+    
+    // Parse pipeline configuration
+    JsonObject pipeline = doc["pipeline"];
+    if (!pipeline.isNull()) {
+        config_.pipeline.enabled = pipeline["enabled"] | false;
+        config_.pipeline.acquisition_core = pipeline["acquisition_core"] | 1;
+        config_.pipeline.processing_core = pipeline["processing_core"] | 0;
+        config_.pipeline.acquisition_priority = pipeline["acquisition_priority"] | 5;
+        config_.pipeline.processing_priority = pipeline["processing_priority"] | 3;
+        config_.pipeline.acquisition_stack_size = pipeline["acquisition_stack_size"] | 4096;
+        config_.pipeline.processing_stack_size = pipeline["processing_stack_size"] | 8192;
+    }
+    
+    // Parse uplink configuration
+    JsonObject uplink = doc["uplink"];
+    if (!uplink.isNull()) {
+        config_.uplink.enabled = uplink["enabled"] | false;
+        config_.uplink.transport = uplinkTransportFromString(uplink["transport"] | "http");
+        strncpy(config_.uplink.wifi_ssid, uplink["wifi_ssid"] | "", MAX_WIFI_SSID_LEN - 1);
+        strncpy(config_.uplink.wifi_password, uplink["wifi_password"] | "", MAX_WIFI_PASSWORD_LEN - 1);
+        strncpy(config_.uplink.host, uplink["host"] | "", MAX_UPLINK_HOST_LEN - 1);
+        config_.uplink.port = uplink["port"] | 80;
+        strncpy(config_.uplink.path, uplink["path"] | "/ingest", MAX_UPLINK_PATH_LEN - 1);
+        config_.uplink.batch_interval_ms = uplink["batch_interval_ms"] | 900000;
+        config_.uplink.min_batch_bytes = uplink["min_batch_bytes"] | 0;
+        config_.uplink.max_batch_bytes = uplink["max_batch_bytes"] | 262144;
+        config_.uplink.connect_timeout_ms = uplink["connect_timeout_ms"] | 10000;
     }
     
     return true;
@@ -187,12 +842,14 @@ bool ConfigManager::saveConfig() {
         return false;
     }
     
-    JsonDocument doc;
+    ArenaScope json_scope(json_arena);
+    JsonDocument doc(&json_allocator);
     
     // Device info
     doc["device_id"] = config_.device_id;
     doc["firmware_version"] = config_.firmware_version;
     doc["enable_debug_mode"] = config_.enable_debug_mode;
+    doc["enable_async_logging"] = config_.enable_async_logging;
     doc["system_timeout_ms"] = config_.system_timeout_ms;
     doc["enable_watchdog"] = config_.enable_watchdog;
     doc["watchdog_timeout_ms"] = config_.watchdog_timeout_ms;
@@ -200,6 +857,10 @@ bool ConfigManager::saveConfig() {
     // Sensor configuration
     JsonObject sensor = doc["sensor"].to<JsonObject>();
     sensor["adc_pin"] = config_.sensor.adc_pin;
+    JsonArray array_pins = sensor["array_pins"].to<JsonArray>();
+    for (uint8_t i = 0; i < config_.sensor.array_channel_count && i < MAX_ADC_CHANNELS; ++i) {
+        array_pins.add(config_.sensor.array_pins[i]);
+    }
     sensor["adc_resolution"] = config_.sensor.adc_resolution;
     sensor["reference_voltage"] = config_.sensor.reference_voltage;
     sensor["dark_offset"] = config_.sensor.dark_offset;
@@ -208,6 +869,13 @@ bool ConfigManager::saveConfig() {
     sensor["sample_rate_ms"] = config_.sensor.sample_rate_ms;
     sensor["oversampling"] = config_.sensor.oversampling;
     sensor["auto_gain"] = config_.sensor.auto_gain;
+    sensor["sampling_mode"] = samplingModeToString(config_.sensor.sampling_mode);
+    sensor["continuous_sample_rate_hz"] = config_.sensor.continuous_sample_rate_hz;
+    sensor["block_size"] = config_.sensor.block_size;
+    sensor["enable_adaptive_sampling"] = config_.sensor.enable_adaptive_sampling;
+    sensor["max_sample_rate_ms"] = config_.sensor.max_sample_rate_ms;
+    sensor["min_oversampling"] = config_.sensor.min_oversampling;
+    sensor["adaptive_change_threshold"] = config_.sensor.adaptive_change_threshold;
     sensor["low_power_mode"] = config_.sensor.low_power_mode;
     sensor["sleep_duration_ms"] = config_.sensor.sleep_duration_ms;
     
@@ -217,12 +885,17 @@ bool ConfigManager::saveConfig() {
     power["deep_sleep_timeout_ms"] = config_.power.deep_sleep_timeout_ms;
     power["enable_wake_on_light"] = config_.power.enable_wake_on_light;
     power["light_threshold"] = config_.power.light_threshold;
+    power["enable_ulp_sampling"] = config_.power.enable_ulp_sampling;
+    power["ulp_sample_period_ms"] = config_.power.ulp_sample_period_ms;
     power["disable_unused_peripherals"] = config_.power.disable_unused_peripherals;
     power["reduce_clock_speed"] = config_.power.reduce_clock_speed;
     power["adc_sample_delay_ms"] = config_.power.adc_sample_delay_ms;
+    power["enable_sleep_scheduler"] = config_.power.enable_sleep_scheduler;
+    power["min_light_sleep_ms"] = config_.power.min_light_sleep_ms;
     power["low_battery_threshold"] = config_.power.low_battery_threshold;
     power["critical_battery_threshold"] = config_.power.critical_battery_threshold;
     power["enable_battery_monitoring"] = config_.power.enable_battery_monitoring;
+    power["battery_capacity_mah"] = config_.power.battery_capacity_mah;
     
     // Logger configuration
     JsonObject logger = doc["logger"].to<JsonObject>();
@@ -231,6 +904,9 @@ bool ConfigManager::saveConfig() {
     logger["flush_threshold"] = config_.logger.flush_threshold;
     logger["enable_compression"] = config_.logger.enable_compression;
     logger["enable_timestamp"] = config_.logger.enable_timestamp;
+    logger["log_format"] = logFormatToString(config_.logger.log_format);
+    logger["enable_async_flush"] = config_.logger.enable_async_flush;
+    logger["storage_backend"] = storageBackendToString(config_.logger.storage_backend);
     logger["min_lux_threshold"] = config_.logger.min_lux_threshold;
     logger["max_lux_threshold"] = config_.logger.max_lux_threshold;
     logger["filter_noise"] = config_.logger.filter_noise;
@@ -238,6 +914,13 @@ bool ConfigManager::saveConfig() {
     logger["max_file_size_bytes"] = config_.logger.max_file_size_bytes;
     logger["max_log_days"] = config_.logger.max_log_days;
     logger["enable_rotation"] = config_.logger.enable_rotation;
+    logger["history_size"] = config_.logger.history_size;
+    logger["enable_rollups"] = config_.logger.enable_rollups;
+    logger["rollup_minute_days"] = config_.logger.rollup_minute_days;
+    logger["rollup_hour_days"] = config_.logger.rollup_hour_days;
+    logger["exception_mode"] = exceptionModeToString(config_.logger.exception_mode);
+    logger["exception_deviation_lux"] = config_.logger.exception_deviation_lux;
+    logger["exception_max_interval_ms"] = config_.logger.exception_max_interval_ms;
     
     // Signal configuration
     JsonObject signal = doc["signal"].to<JsonObject>();
@@ -256,6 +939,41 @@ bool ConfigManager::saveConfig() {
     signal["enable_adaptive_filter"] = config_.signal.enable_adaptive_filter;
     signal["adaptation_rate"] = config_.signal.adaptation_rate;
     signal["noise_floor"] = config_.signal.noise_floor;
+    signal["use_fixed_point"] = config_.signal.use_fixed_point;
+    signal["enable_spectral_analysis"] = config_.signal.enable_spectral_analysis;
+    signal["enable_events"] = config_.signal.enable_events;
+    signal["event_low_lux"] = config_.signal.event_low_lux;
+    signal["event_high_lux"] = config_.signal.event_high_lux;
+    signal["event_hysteresis_lux"] = config_.signal.event_hysteresis_lux;
+    
+    JsonArray filter_order = signal["filter_order"].to<JsonArray>();
+    for (uint8_t i = 0; i < config_.signal.filter_stage_count && i < MAX_FILTER_STAGES; ++i) {
+        filter_order.add(filterTypeToString(config_.signal.filter_order[i]));
+    }
+    
+    // Pipeline configuration
+    JsonObject pipeline = doc["pipeline"].to<JsonObject>();
+    pipeline["enabled"] = config_.pipeline.enabled;
+    pipeline["acquisition_core"] = config_.pipeline.acquisition_core;
+    pipeline["processing_core"] = config_.pipeline.processing_core;
+    pipeline["acquisition_priority"] = config_.pipeline.acquisition_priority;
+    pipeline["processing_priority"] = config_.pipeline.processing_priority;
+    pipeline["acquisition_stack_size"] = config_.pipeline.acquisition_stack_size;
+    pipeline["processing_stack_size"] = config_.pipeline.processing_stack_size;
+    
+    // Uplink configuration
+    JsonObject uplink = doc["uplink"].to<JsonObject>();
+    uplink["enabled"] = config_.uplink.enabled;
+    uplink["transport"] = uplinkTransportToString(config_.uplink.transport);
+    uplink["wifi_ssid"] = config_.uplink.wifi_ssid;
+    uplink["wifi_password"] = config_.uplink.wifi_password;
+    uplink["host"] = config_.uplink.host;
+    uplink["port"] = config_.uplink.port;
+    uplink["path"] = config_.uplink.path;
+    uplink["batch_interval_ms"] = config_.uplink.batch_interval_ms;
+    uplink["min_batch_bytes"] = config_.uplink.min_batch_bytes;
+    uplink["max_batch_bytes"] = config_.uplink.max_batch_bytes;
+    uplink["connect_timeout_ms"] = config_.uplink.connect_timeout_ms;
     
     // Write to file
     File config_file = SPIFFS.open(config_file_path_, FILE_WRITE);
@@ -266,7 +984,13 @@ bool ConfigManager::saveConfig() {
     size_t bytes_written = serializeJsonPretty(doc, config_file);
     config_file.close();
     
-    return bytes_written > 0;
+    if (bytes_written == 0) {
+        return false;
+    }
+    
+    // Keep the next wake on the fast path
+    storeSnapshot();
+    return true;
 }
 
 bool ConfigManager::loadCalibration() {
@@ -279,7 +1003,8 @@ bool ConfigManager::loadCalibration() {
         return false;
     }
     
-    JsonDocument doc;
+    ArenaScope json_scope(json_arena);
+    JsonDocument doc(&json_allocator);
     DeserializationError error = deserializeJson(doc, cal_file);
     cal_file.close();
     
@@ -305,7 +1030,8 @@ bool ConfigManager::saveCalibration() {
         return false;
     }
     
-    JsonDocument doc;
+    ArenaScope json_scope(json_arena);
+    JsonDocument doc(&json_allocator);
     
     doc["dark_reference"] = calibration_data_.dark_reference;
     doc["light_reference"] = calibration_data_.light_reference;
@@ -323,7 +1049,13 @@ bool ConfigManager::saveCalibration() {
     size_t bytes_written = serializeJsonPretty(doc, cal_file);
     cal_file.close();
     
-    return bytes_written > 0;
+    if (bytes_written == 0) {
+        return false;
+    }
+    
+    // Keep the next wake on the fast path
+    storeSnapshot();
+    return true;
 }
 
 const SystemConfig& ConfigManager::getConfig() const {
@@ -336,8 +1068,44 @@ bool ConfigManager::updateConfig(const SystemConfig& config) {
         return false;
     }
     
+    ConfigDiff diff = diffConfig(config_, config);
+    if (!diff.any()) {
+        return true;  // Nothing to save or apply
+    }
+    
     config_ = config;
-    return saveConfig();
+    bool saved = saveConfig();
+    
+    if (config_change_callback_) {
+        char value[64];
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; ++i) {
+            if ((diff.fields[static_cast<size_t>(CONFIG_FIELDS[i].section)] >> fieldBit(i)) & 1) {
+                formatFieldValue(CONFIG_FIELDS[i], config_, value, sizeof(value));
+                notifyConfigChange(CONFIG_FIELDS[i].key, value);
+            }
+        }
+    }
+    
+    if (config_apply_callback_) {
+        config_apply_callback_(config_, diff);
+    }
+    
+    return saved;
+}
+
+ConfigDiff ConfigManager::diffConfig(const SystemConfig& from, const SystemConfig& to) {
+    ConfigDiff diff = {};
+    uint8_t bits[CONFIG_SECTION_COUNT] = {0};
+    
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; ++i) {
+        size_t section = static_cast<size_t>(CONFIG_FIELDS[i].section);
+        if (!fieldEquals(CONFIG_FIELDS[i], from, to)) {
+            diff.fields[section] |= 1UL << bits[section];
+        }
+        bits[section]++;
+    }
+    
+    return diff;
 }
 
 ConfigValidation ConfigManager::validateConfig(const SystemConfig& config) const {
@@ -379,6 +1147,34 @@ ConfigValidation ConfigManager::validateConfig(const SystemConfig& config) const
     }
     result.warning_count += signal_val.warning_count;
     
+    // Validate pipeline configuration
+    ConfigValidation pipeline_val = validatePipelineConfig(config.pipeline);
+    if (!pipeline_val.is_valid) {
+        result.is_valid = false;
+        result.error_count += pipeline_val.error_count;
+        strncpy(result.last_error, pipeline_val.last_error, sizeof(result.last_error) - 1);
+    }
+    result.warning_count += pipeline_val.warning_count;
+    
+    // Validate uplink configuration
+    ConfigValidation uplink_val = validateUplinkConfig(config.uplink);
+    if (!uplink_val.is_valid) {
+        result.is_valid = false;
+        result.error_count += uplink_val.error_count;
+        strncpy(result.last_error, uplink_val.last_error, sizeof(result.last_error) - 1);
+    }
+    result.warning_count += uplink_val.warning_count;
+    
+    if (config.uplink.enabled && config.logger.storage_backend == StorageBackend::FILES) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Uplink needs the segments or littlefs storage backend", sizeof(result.last_warning) - 1);
+    }
+    
+    if (config.signal.enable_spectral_analysis && config.sensor.sampling_mode != SamplingMode::CONTINUOUS) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Spectral analysis expects continuous sampling", sizeof(result.last_warning) - 1);
+    }
+    
     return result;
 }
 
@@ -392,6 +1188,21 @@ ConfigValidation ConfigManager::validateSensorConfig(const SensorConfig& sensor_
         strncpy(result.last_error, "ADC pin must be GPIO 32-39", sizeof(result.last_error) - 1);
     }
     
+    if (sensor_config.array_channel_count > MAX_ADC_CHANNELS) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Sensor array has at most 8 channels", sizeof(result.last_error) - 1);
+    }
+    
+    for (uint8_t i = 0; i < sensor_config.array_channel_count && i < MAX_ADC_CHANNELS; ++i) {
+        if (sensor_config.array_pins[i] < 32 || sensor_config.array_pins[i] > 39) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "Sensor array pins must be GPIO 32-39", sizeof(result.last_error) - 1);
+            break;
+        }
+    }
+    
     if (sensor_config.adc_resolution == 0 || sensor_config.adc_resolution > 12) {
         result.is_valid = false;
         result.error_count++;
@@ -410,6 +1221,39 @@ ConfigValidation ConfigManager::validateSensorConfig(const SensorConfig& sensor_
         strncpy(result.last_error, "Sample rate cannot be zero", sizeof(result.last_error) - 1);
     }
     
+    if (sensor_config.enable_adaptive_sampling) {
+        if (sensor_config.max_sample_rate_ms < sensor_config.sample_rate_ms) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "Max sample rate must be >= sample rate", sizeof(result.last_error) - 1);
+        }
+        
+        if (sensor_config.adaptive_change_threshold <= 0.0f) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "Adaptive change threshold must be positive", sizeof(result.last_error) - 1);
+        }
+        
+        if (sensor_config.sampling_mode == SamplingMode::CONTINUOUS) {
+            result.warning_count++;
+            strncpy(result.last_warning, "Adaptive sampling only applies to polled mode", sizeof(result.last_warning) - 1);
+        }
+    }
+    
+    if (sensor_config.sampling_mode == SamplingMode::CONTINUOUS) {
+        if (sensor_config.continuous_sample_rate_hz == 0) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "Continuous sample rate cannot be zero", sizeof(result.last_error) - 1);
+        }
+        
+        if (sensor_config.block_size == 0 || sensor_config.block_size > MAX_BLOCK_SIZE) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "Block size must be 1-64 readings", sizeof(result.last_error) - 1);
+        }
+    }
+    
     if (sensor_config.oversampling == 0) {
         result.warning_count++;
         strncpy(result.last_warning, "Oversampling disabled", sizeof(result.last_warning) - 1);
@@ -432,6 +1276,30 @@ ConfigValidation ConfigManager::validatePowerConfig(const PowerConfig& power_con
         strncpy(result.last_error, "Low battery threshold must exceed critical", sizeof(result.last_error) - 1);
     }
     
+    if (power_config.battery_capacity_mah <= 0.0f) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Battery capacity must be positive", sizeof(result.last_error) - 1);
+    }
+    
+    if (power_config.enable_sleep_scheduler && power_config.min_light_sleep_ms < 2) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Light sleep gaps under 2 ms cost more than they save", sizeof(result.last_warning) - 1);
+    }
+    
+    if (power_config.enable_ulp_sampling) {
+        if (power_config.ulp_sample_period_ms == 0) {
+            result.is_valid = false;
+            result.error_count++;
+            strncpy(result.last_error, "ULP sample period cannot be zero", sizeof(result.last_error) - 1);
+        }
+        
+        if (!UlpSampler::isSupported()) {
+            result.warning_count++;
+            strncpy(result.last_warning, "ULP sampling not supported on this target", sizeof(result.last_warning) - 1);
+        }
+    }
+    
     return result;
 }
 
@@ -456,6 +1324,48 @@ ConfigValidation ConfigManager::validateLoggerConfig(const LoggerConfig& logger_
         strncpy(result.last_error, "Invalid lux threshold range", sizeof(result.last_error) - 1);
     }
     
+    // The littlefs backend runs on the logfs partition, only in partitions.csv builds
+    if (logger_config.storage_backend == StorageBackend::LITTLEFS &&
+        SegmentDataStorage::partitionSize(StorageBackend::LITTLEFS) == 0) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "No logfs partition for the littlefs backend", sizeof(result.last_error) - 1);
+    }
+    
+    // Per-boot files rotate at this size; past the partition size they never would
+    size_t partition_size = SegmentDataStorage::partitionSize(logger_config.storage_backend);
+    if (logger_config.storage_backend == StorageBackend::FILES && partition_size > 0 &&
+        logger_config.max_file_size_bytes > partition_size) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Max file size exceeds the spiffs partition", sizeof(result.last_error) - 1);
+    }
+    
+    if (logger_config.history_size > MemoryDataStorage::MAX_HISTORY_SIZE) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "History size exceeds 524288 readings", sizeof(result.last_error) - 1);
+    }
+    
+    if (logger_config.enable_rollups &&
+        (logger_config.rollup_minute_days == 0 || logger_config.rollup_hour_days == 0)) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Rollup tier with zero retention is not kept", sizeof(result.last_warning) - 1);
+    }
+    
+    // Each tier file is capped at MAX_ROLLUP_BUCKETS; past that the oldest days are not kept
+    if (logger_config.enable_rollups &&
+        (logger_config.rollup_minute_days * 1440ULL > MAX_ROLLUP_BUCKETS ||
+         logger_config.rollup_hour_days * 24ULL > MAX_ROLLUP_BUCKETS)) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Rollup retention over 8192 buckets is truncated", sizeof(result.last_warning) - 1);
+    }
+    
+    if (logger_config.exception_mode != ExceptionMode::OFF && logger_config.exception_deviation_lux <= 0.0f) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Zero exception deviation stores every change", sizeof(result.last_warning) - 1);
+    }
+    
     return result;
 }
 
@@ -467,11 +1377,108 @@ ConfigValidation ConfigManager::validateSignalConfig(const SignalConfig& signal_
         strncpy(result.last_warning, "Moving average disabled", sizeof(result.last_warning) - 1);
     }
     
+    if (signal_config.enable_median_filter && signal_config.median_window > MAX_MEDIAN_WINDOW) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Median window clamped to 63", sizeof(result.last_warning) - 1);
+    }
+    
+    if (signal_config.enable_trend_detection && signal_config.trend_window > MAX_TREND_WINDOW) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Trend window clamped to 64", sizeof(result.last_warning) - 1);
+    }
+    
+    if (signal_config.filter_stage_count > MAX_FILTER_STAGES) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Too many filter stages", sizeof(result.last_error) - 1);
+    }
+    
+    // Each stage is one filter instance; listing it twice would run its state twice per sample
+    for (uint8_t i = 0; i < signal_config.filter_stage_count && i < MAX_FILTER_STAGES; ++i) {
+        for (uint8_t j = 0; j < i; ++j) {
+            if (signal_config.filter_order[j] == signal_config.filter_order[i]) {
+                result.is_valid = false;
+                result.error_count++;
+                strncpy(result.last_error, "Filter stage listed twice in filter_order", sizeof(result.last_error) - 1);
+            }
+        }
+    }
+    
     if (signal_config.outlier_threshold <= 0.0f) {
         result.warning_count++;
         strncpy(result.last_warning, "Outlier detection threshold too low", sizeof(result.last_warning) - 1);
     }
     
+    if (signal_config.enable_events && signal_config.event_low_lux > 0.0f &&
+        signal_config.event_high_lux > 0.0f && signal_config.event_low_lux >= signal_config.event_high_lux) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Event low threshold must be below high", sizeof(result.last_error) - 1);
+    }
+    
+    return result;
+}
+
+ConfigValidation ConfigManager::validatePipelineConfig(const PipelineConfig& pipeline_config) const {
+    ConfigValidation result = {true, 0, 0, "", ""};
+    
+    if (!pipeline_config.enabled) {
+        return result;
+    }
+    
+    if (pipeline_config.acquisition_core >= portNUM_PROCESSORS ||
+        pipeline_config.processing_core >= portNUM_PROCESSORS) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Pipeline core out of range", sizeof(result.last_error) - 1);
+    }
+    
+    if (pipeline_config.acquisition_priority == 0 || pipeline_config.processing_priority == 0 ||
+        pipeline_config.acquisition_priority >= configMAX_PRIORITIES ||
+        pipeline_config.processing_priority >= configMAX_PRIORITIES) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Pipeline priority out of range", sizeof(result.last_error) - 1);
+    }
+    
+    if (pipeline_config.acquisition_stack_size < 2048 || pipeline_config.processing_stack_size < 4096) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Pipeline stack too small", sizeof(result.last_error) - 1);
+    }
+    
+    if (pipeline_config.acquisition_core == pipeline_config.processing_core) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Pipeline tasks share a core", sizeof(result.last_warning) - 1);
+    }
+    
+    return result;
+}
+
+ConfigValidation ConfigManager::validateUplinkConfig(const UplinkConfig& uplink_config) const {
+    ConfigValidation result = {true, 0, 0, "", ""};
+    
+    if (!uplink_config.enabled) {
+        return result;
+    }
+    
+    if (uplink_config.wifi_ssid[0] == '\0' || uplink_config.host[0] == '\0') {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Uplink needs a WiFi SSID and host", sizeof(result.last_error) - 1);
+    }
+    
+    if (uplink_config.batch_interval_ms == 0 || uplink_config.max_batch_bytes == 0) {
+        result.is_valid = false;
+        result.error_count++;
+        strncpy(result.last_error, "Uplink batch window and size must be non-zero", sizeof(result.last_error) - 1);
+    }
+    
+    if (uplink_config.min_batch_bytes > uplink_config.max_batch_bytes) {
+        result.warning_count++;
+        strncpy(result.last_warning, "Uplink min batch exceeds max batch", sizeof(result.last_warning) - 1);
+    }
+    
     return result;
 }
 
@@ -514,6 +1521,10 @@ void ConfigManager::setConfigChangeCallback(ConfigChangeCallback callback) {
     config_change_callback_ = callback;
 }
 
+void ConfigManager::setConfigApplyCallback(ConfigApplyCallback callback) {
+    config_apply_callback_ = callback;
+}
+
 void ConfigManager::notifyConfigChange(const char* key, const char* value) {
     if (config_change_callback_) {
         config_change_callback_(key, value);
@@ -525,6 +1536,8 @@ SystemConfig ConfigManager::getDefaultConfig() {
     
     // Default sensor configuration (ESP32 ADC1 on GPIO 34)
     config.sensor.adc_pin = 34;
+    memset(config.sensor.array_pins, 0, sizeof(config.sensor.array_pins));
+    config.sensor.array_channel_count = 0;
     config.sensor.adc_resolution = 12;
     config.sensor.reference_voltage = 3.3f;
     config.sensor.dark_offset = 0.0f;
@@ -533,6 +1546,13 @@ SystemConfig ConfigManager::getDefaultConfig() {
     config.sensor.sample_rate_ms = 1000;
     config.sensor.oversampling = 4;
     config.sensor.auto_gain = false;
+    config.sensor.sampling_mode = SamplingMode::POLLED;
+    config.sensor.continuous_sample_rate_hz = 2000;
+    config.sensor.block_size = 32;
+    config.sensor.enable_adaptive_sampling = false;
+    config.sensor.max_sample_rate_ms = 10000;
+    config.sensor.min_oversampling = 1;
+    config.sensor.adaptive_change_threshold = 0.05f;
     config.sensor.low_power_mode = true;
     config.sensor.sleep_duration_ms = 100;
     
@@ -541,12 +1561,17 @@ SystemConfig ConfigManager::getDefaultConfig() {
     config.power.deep_sleep_timeout_ms = 300000;
     config.power.enable_wake_on_light = true;
     config.power.light_threshold = 0.1f;
+    config.power.enable_ulp_sampling = false;
+    config.power.ulp_sample_period_ms = 1000;
     config.power.disable_unused_peripherals = true;
     config.power.reduce_clock_speed = true;
     config.power.adc_sample_delay_ms = 1;
+    config.power.enable_sleep_scheduler = false;
+    config.power.min_light_sleep_ms = 5;
     config.power.low_battery_threshold = 3.2f;
     config.power.critical_battery_threshold = 3.0f;
     config.power.enable_battery_monitoring = true;
+    config.power.battery_capacity_mah = 2000.0f;
     
     // Default logger configuration
     strncpy(config.logger.log_file_path, "/logs", MAX_PATH_LEN - 1);
@@ -554,6 +1579,9 @@ SystemConfig ConfigManager::getDefaultConfig() {
     config.logger.flush_threshold = 50;
     config.logger.enable_compression = false;
     config.logger.enable_timestamp = true;
+    config.logger.log_format = LogFormat::CSV;
+    config.logger.enable_async_flush = false;
+    config.logger.storage_backend = StorageBackend::FILES;
     config.logger.min_lux_threshold = 0.0f;
     config.logger.max_lux_threshold = 100000.0f;
     config.logger.filter_noise = true;
@@ -561,6 +1589,13 @@ SystemConfig ConfigManager::getDefaultConfig() {
     config.logger.max_file_size_bytes = 1024 * 1024;
     config.logger.max_log_days = 30;
     config.logger.enable_rotation = true;
+    config.logger.history_size = 0;
+    config.logger.enable_rollups = true;
+    config.logger.rollup_minute_days = 2;
+    config.logger.rollup_hour_days = 60;
+    config.logger.exception_mode = ExceptionMode::OFF;
+    config.logger.exception_deviation_lux = 1.0f;
+    config.logger.exception_max_interval_ms = 600000;
     
     // Default signal configuration
     config.signal.moving_average_window = 5;
@@ -578,11 +1613,45 @@ SystemConfig ConfigManager::getDefaultConfig() {
     config.signal.enable_adaptive_filter = true;
     config.signal.adaptation_rate = 0.1f;
     config.signal.noise_floor = 0.001f;
+    config.signal.use_fixed_point = false;
+    config.signal.enable_spectral_analysis = false;
+    config.signal.enable_events = false;
+    config.signal.event_low_lux = 0.0f;
+    config.signal.event_high_lux = 0.0f;
+    config.signal.event_hysteresis_lux = 5.0f;
+    config.signal.filter_order[0] = FilterType::MOVING_AVERAGE;
+    config.signal.filter_order[1] = FilterType::MEDIAN;
+    config.signal.filter_order[2] = FilterType::LOW_PASS;
+    config.signal.filter_order[3] = FilterType::ADAPTIVE;
+    config.signal.filter_stage_count = 4;
+    
+    // Default pipeline configuration (single loop() unless enabled)
+    config.pipeline.enabled = false;
+    config.pipeline.acquisition_core = 1;
+    config.pipeline.processing_core = 0;
+    config.pipeline.acquisition_priority = 5;
+    config.pipeline.processing_priority = 3;
+    config.pipeline.acquisition_stack_size = 4096;
+    config.pipeline.processing_stack_size = 8192;
+    
+    // Default uplink configuration (off until a network is configured)
+    config.uplink.enabled = false;
+    config.uplink.transport = UplinkTransport::HTTP;
+    memset(config.uplink.wifi_ssid, 0, sizeof(config.uplink.wifi_ssid));
+    memset(config.uplink.wifi_password, 0, sizeof(config.uplink.wifi_password));
+    memset(config.uplink.host, 0, sizeof(config.uplink.host));
+    config.uplink.port = 80;
+    strncpy(config.uplink.path, "/ingest", MAX_UPLINK_PATH_LEN - 1);
+    config.uplink.batch_interval_ms = 900000;
+    config.uplink.min_batch_bytes = 0;
+    config.uplink.max_batch_bytes = 256 * 1024;
+    config.uplink.connect_timeout_ms = 10000;
     
     // Default system settings
     strncpy(config.device_id, "light_sensor_001", MAX_DEVICE_ID_LEN - 1);
     strncpy(config.firmware_version, "1.0.0", MAX_VERSION_LEN - 1);
     config.enable_debug_mode = false;
+    config.enable_async_logging = true;
     config.system_timeout_ms = 300000;
     config.enable_watchdog = true;
     config.watchdog_timeout_ms = 8000;
@@ -602,6 +1671,10 @@ CalibrationData ConfigManager::getDefaultCalibrationData() {
     return calibration;
 }
 
+const StaticArena& ConfigManager::getJsonArena() {
+    return json_arena;
+}
+
 // ConfigPresets Implementation
 SystemConfig ConfigPresets::getLowPowerPreset() {
     SystemConfig config = ConfigManager::getDefaultConfig();
@@ -610,11 +1683,16 @@ SystemConfig ConfigPresets::getLowPowerPreset() {
     config.sensor.oversampling = 1;
     config.sensor.low_power_mode = true;
     config.sensor.sleep_duration_ms = 1000;
+    config.sensor.enable_adaptive_sampling = true;
+    config.sensor.max_sample_rate_ms = 60000;
     
     config.power.sleep_timeout_ms = 10000;
     config.power.deep_sleep_timeout_ms = 60000;
+    config.power.enable_ulp_sampling = true;
+    config.power.ulp_sample_period_ms = 5000;
     config.power.disable_unused_peripherals = true;
     config.power.reduce_clock_speed = true;
+    config.power.enable_sleep_scheduler = true;
     
     config.logger.buffer_size = 50;
     config.logger.flush_threshold = 25;
@@ -622,6 +1700,7 @@ SystemConfig ConfigPresets::getLowPowerPreset() {
     config.signal.moving_average_window = 3;
     config.signal.enable_median_filter = false;
     config.signal.enable_adaptive_filter = false;
+    config.signal.use_fixed_point = true;
     
     return config;
 }
@@ -657,6 +1736,7 @@ SystemConfig ConfigPresets::getDevelopmentPreset() {
     
     config.sensor.sample_rate_ms = 500;
     config.enable_debug_mode = true;
+    config.enable_async_logging = false;  // Messages are written before a crash
     
     config.logger.enable_timestamp = true;
     config.logger.min_quality_threshold = 0;
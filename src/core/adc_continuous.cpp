@@ -0,0 +1,186 @@
+#include "adc_continuous.h"
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <soc/soc_caps.h>
+#include <cstring>
+
+namespace LightSensor {
+
+// Internal driver ring size (bytes of raw conversion results)
+static const uint32_t DMA_RING_BYTES = 4096;
+
+#ifndef SOC_ADC_SAMPLE_FREQ_THRES_LOW
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW 20000
+#endif
+
+#ifndef SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH 2000000
+#endif
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+static const adc_digi_output_format_t OUTPUT_FORMAT = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+#else
+static const adc_digi_output_format_t OUTPUT_FORMAT = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+#endif
+
+ContinuousADC::ContinuousADC()
+    : is_running_(false), hardware_rate_hz_(0), pin_count_(0),
+      frame_len_(0), frame_pos_(0) {
+    memset(channel_to_slot_, 0xFF, sizeof(channel_to_slot_));
+}
+
+ContinuousADC::~ContinuousADC() {
+    end();
+}
+
+bool ContinuousADC::begin(const uint8_t* pins, size_t pin_count, uint32_t sample_rate_hz) {
+    if (is_running_) {
+        end();
+    }
+
+    if (pins == nullptr || pin_count == 0 || pin_count > MAX_ADC_CHANNELS || sample_rate_hz == 0) {
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern[MAX_ADC_CHANNELS];
+    uint32_t channel_mask = 0;
+    memset(channel_to_slot_, 0xFF, sizeof(channel_to_slot_));
+
+    for (size_t i = 0; i < pin_count; ++i) {
+        int8_t channel = digitalPinToAnalogChannel(pins[i]);
+        // ADC2 channels are reported with an offset of 10 and cannot run in continuous mode
+        if (channel < 0 || channel >= 10) {
+            return false;
+        }
+
+        pattern[i].atten = ADC_ATTEN_DB_11;  // Full range 0-3.3V, matches polled mode
+        pattern[i].channel = static_cast<uint8_t>(channel);
+        pattern[i].unit = 0;                 // ADC1
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+        channel_mask |= BIT(channel);
+        channel_to_slot_[channel] = static_cast<uint8_t>(i);
+    }
+
+    uint32_t total_rate = hardwareRateFor(sample_rate_hz, pin_count) * pin_count;
+
+    adc_digi_init_config_t init_config;
+    init_config.max_store_buf_size = DMA_RING_BYTES;
+    init_config.conv_num_each_intr = FRAME_BYTES;
+    init_config.adc1_chan_mask = channel_mask;
+    init_config.adc2_chan_mask = 0;
+
+    if (adc_digi_initialize(&init_config) != ESP_OK) {
+        return false;
+    }
+
+    adc_digi_configuration_t digi_config;
+    digi_config.conv_limit_en = true;   // Required on ESP32 (I2S-based controller)
+    digi_config.conv_limit_num = 250;
+    digi_config.pattern_num = pin_count;
+    digi_config.adc_pattern = pattern;
+    digi_config.sample_freq_hz = total_rate;
+    digi_config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    digi_config.format = OUTPUT_FORMAT;
+
+    if (adc_digi_controller_configure(&digi_config) != ESP_OK || adc_digi_start() != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+
+    pin_count_ = pin_count;
+    hardware_rate_hz_ = total_rate / pin_count;
+    frame_len_ = 0;
+    frame_pos_ = 0;
+    is_running_ = true;
+    return true;
+}
+
+void ContinuousADC::end() {
+    if (!is_running_) {
+        return;
+    }
+
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    is_running_ = false;
+    frame_len_ = 0;
+    frame_pos_ = 0;
+}
+
+size_t ContinuousADC::read(uint16_t* codes, uint8_t* slots, size_t max_samples) {
+    if (!is_running_ || codes == nullptr) {
+        return 0;
+    }
+
+    const size_t result_bytes = sizeof(adc_digi_output_data_t);
+    size_t count = 0;
+
+    while (count < max_samples) {
+        // Refill from the driver ring when the current frame is consumed
+        if (frame_pos_ + result_bytes > frame_len_) {
+            uint32_t bytes_read = 0;
+            esp_err_t err = adc_digi_read_bytes(frame_, FRAME_BYTES, &bytes_read, 0);
+            if (err != ESP_OK || bytes_read == 0) {
+                break;
+            }
+            frame_len_ = bytes_read;
+            frame_pos_ = 0;
+        }
+
+        adc_digi_output_data_t result;
+        memcpy(&result, frame_ + frame_pos_, result_bytes);
+        frame_pos_ += result_bytes;
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+        uint8_t channel = result.type1.channel;
+        uint16_t data = result.type1.data;
+#else
+        uint8_t channel = result.type2.channel;
+        uint16_t data = result.type2.data;
+#endif
+
+        if (channel >= sizeof(channel_to_slot_) || channel_to_slot_[channel] == 0xFF) {
+            continue;  // Stale result from a previous pattern
+        }
+
+        codes[count] = data;
+        if (slots) {
+            slots[count] = channel_to_slot_[channel];
+        }
+        count++;
+    }
+
+    return count;
+}
+
+bool ContinuousADC::isRunning() const {
+    return is_running_;
+}
+
+uint32_t ContinuousADC::getHardwareRateHz() const {
+    return hardware_rate_hz_;
+}
+
+uint32_t ContinuousADC::hardwareRateFor(uint32_t sample_rate_hz, size_t pin_count) {
+    if (pin_count == 0) {
+        return 0;
+    }
+
+    // The controller converts one pattern entry per tick, so the total
+    // rate is the per-channel rate times the pattern length
+    uint32_t total_rate = sample_rate_hz * pin_count;
+    if (total_rate < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+        total_rate = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    } else if (total_rate > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+        total_rate = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+    }
+    return total_rate / pin_count;
+}
+
+uint32_t ContinuousADC::decimationFor(uint32_t hardware_rate_hz, uint32_t sample_rate_hz) {
+    uint32_t decimation = sample_rate_hz > 0 ? hardware_rate_hz / sample_rate_hz : 1;
+    return decimation > 0 ? decimation : 1;
+}
+
+}  // namespace LightSensor
@@ -1,4 +1,5 @@
 #include "light_sensor.h"
+#include "profiler.h"
 #include <Arduino.h>
 #include <algorithm>
 #include <cmath>
@@ -8,15 +9,24 @@ namespace LightSensor {
 // ESP32 ADC configuration
 static const uint8_t ADC_WIDTH = 12;  // 12-bit ADC
 static const uint16_t ADC_MAX_VALUE = 4095;
+static const float ADC_SCALE = 1.0f / ADC_MAX_VALUE;
 
 ADCLightSensor::ADCLightSensor(const SensorConfig& config)
     : config_(config), is_sampling_(false), is_initialized_(false),
-      last_sample_time_ms_(0), was_sampling_before_sleep_(false) {
+      last_sample_time_ms_(0), sample_rate_ms_(config.sample_rate_ms),
+      oversampling_(config.oversampling > 0 ? config.oversampling : 1),
+      was_sampling_before_sleep_(false),
+      block_count_(0), decimation_(1), decimation_sum_(0), decimation_count_(0),
+      reading_index_(0), stream_start_ms_(0), decimation_scale_(ADC_SCALE), decimation_q16_scale_(q16Scale(1)),
+      adc_active_us_(0), continuous_start_us_(0), inv_sensitivity_(1.0f) {
     // Initialize filter buffer
     for (size_t i = 0; i < FILTER_BUFFER_SIZE; ++i) {
         filter_buffer_[i] = 0.0f;
+        q16_filter_buffer_[i] = 0;
     }
     filter_buffer_index_ = 0;
+    
+    updateConversion();
 }
 
 bool ADCLightSensor::initialize() {
@@ -52,33 +62,46 @@ bool ADCLightSensor::initialize() {
 }
 
 SensorReading ADCLightSensor::read() {
-    SensorReading reading = {0, 0.0f, 0.0f, 0.0f, false, 0};
+    LS_PROFILE_SCOPE(SENSOR_READ);
+    
+    SensorReading reading = {0, 0.0f, 0.0f, 0.0f, false, 0, 0};
     
     if (!is_initialized_) {
         return reading;
     }
     
-    reading.timestamp_ms = millis();
+    uint32_t timestamp_ms = millis();
+    uint32_t start_us = micros();
     
     // Perform oversampling for noise reduction
-    float sum = 0.0f;
-    for (uint8_t i = 0; i < config_.oversampling; ++i) {
+    uint8_t oversampling = oversampling_.load();
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < oversampling; ++i) {
         sum += readRawADC();
-        if (i < config_.oversampling - 1) {
+        if (i < oversampling - 1) {
             delayMicroseconds(100);  // Small delay between samples
         }
     }
+    adc_active_us_ += micros() - start_us;
     
-    reading.raw_value = sum / config_.oversampling;
-    reading.voltage = adcToVoltage(reading.raw_value);
-    reading.lux_value = voltageToLux(reading.voltage);
-    reading.is_valid = (reading.raw_value >= 0.0f && reading.raw_value <= 1.0f);
-    reading.quality = calculateQuality(reading);
+    return makeReading(static_cast<float>(sum) * ADC_SCALE / oversampling,
+                       q16FromSum(sum, q16Scale(oversampling)), timestamp_ms);
+}
+
+size_t ADCLightSensor::readBlock(SensorReading* readings, size_t max_count) {
+    if (!is_initialized_ || readings == nullptr) {
+        return 0;
+    }
     
-    // Apply noise filtering
-    reading.lux_value = applyNoiseFilter(reading.lux_value);
+    // Continuous mode returns whatever the DMA ring already holds
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS) {
+        if (!startContinuous()) {
+            return 0;
+        }
+        return convertContinuous(readings, max_count);
+    }
     
-    return reading;
+    return ILightSensor::readBlock(readings, max_count);
 }
 
 void ADCLightSensor::startSampling(DataCallback callback) {
@@ -86,23 +109,72 @@ void ADCLightSensor::startSampling(DataCallback callback) {
         return;
     }
     
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS && !startContinuous()) {
+        return;
+    }
+    
     data_callback_ = callback;
+    block_callback_ = nullptr;
+    is_sampling_ = true;
+    last_sample_time_ms_ = millis();
+}
+
+void ADCLightSensor::startBlockSampling(BlockCallback callback) {
+    if (!is_initialized_ || callback == nullptr) {
+        return;
+    }
+    
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS && !startContinuous()) {
+        return;
+    }
+    
+    block_callback_ = callback;
+    data_callback_ = nullptr;
     is_sampling_ = true;
     last_sample_time_ms_ = millis();
 }
 
 void ADCLightSensor::stopSampling() {
+    stopContinuous();
     is_sampling_ = false;
     data_callback_ = nullptr;
+    block_callback_ = nullptr;
 }
 
 void ADCLightSensor::configure(const SensorConfig& config) {
+    // Only a pin or resolution change needs the ADC set up again, and only a
+    // change to what the DMA converts needs the continuous stream restarted;
+    // everything else applies in place without a sampling gap
+    bool hardware_changed = config.adc_pin != config_.adc_pin ||
+                            config.adc_resolution != config_.adc_resolution;
+    bool stream_changed = hardware_changed ||
+                          config.sampling_mode != config_.sampling_mode ||
+                          config.continuous_sample_rate_hz != config_.continuous_sample_rate_hz;
+    
+    bool restart_continuous = continuous_adc_.isRunning() && stream_changed;
+    if (stream_changed) {
+        stopContinuous();
+    }
+    
+    // Hand over a partial block that a smaller block size would strand
+    size_t block_size = config.block_size == 0 || config.block_size > MAX_BLOCK_SIZE ?
+                        MAX_BLOCK_SIZE : config.block_size;
+    if (block_count_ >= block_size) {
+        deliverBlock();
+    }
+    
     config_ = config;
-    // Re-initialize if already initialized
-    if (is_initialized_) {
+    updateConversion();
+    setSamplingParameters(config_.sample_rate_ms, config_.oversampling);
+    
+    if (is_initialized_ && hardware_changed) {
         is_initialized_ = false;
         initialize();
     }
+    
+    if (restart_continuous && config_.sampling_mode == SamplingMode::CONTINUOUS) {
+        startContinuous();
+    }
 }
 
 void ADCLightSensor::calibrate(float dark_value, float light_value) {
@@ -116,14 +188,16 @@ void ADCLightSensor::calibrate(float dark_value, float light_value) {
     
     // Adjust noise threshold based on signal range
     config_.noise_threshold = (light_value - dark_value) * 0.01f;  // 1% of signal range
+    
+    updateConversion();
 }
 
 void ADCLightSensor::enterLowPower() {
     was_sampling_before_sleep_ = is_sampling_;
     
-    if (is_sampling_) {
-        stopSampling();
-    }
+    // Pause without dropping callbacks so wakeUp() can resume
+    stopContinuous();
+    is_sampling_ = false;
     
     // Disable ADC to save power
     adc_power_off();
@@ -137,28 +211,206 @@ void ADCLightSensor::wakeUp() {
     delay(10);
     
     // Resume sampling if it was active before sleep
-    if (was_sampling_before_sleep_ && data_callback_) {
+    if (was_sampling_before_sleep_ && (data_callback_ || block_callback_)) {
+        if (config_.sampling_mode == SamplingMode::CONTINUOUS && !startContinuous()) {
+            return;
+        }
         is_sampling_ = true;
         last_sample_time_ms_ = millis();
     }
 }
 
 void ADCLightSensor::process() {
-    if (!is_sampling_ || !data_callback_) {
+    if (!is_sampling_ || (!data_callback_ && !block_callback_)) {
+        return;
+    }
+    
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS) {
+        drainContinuous();
         return;
     }
     
     uint32_t now = millis();
-    if (now - last_sample_time_ms_ >= config_.sample_rate_ms) {
+    if (now - last_sample_time_ms_ >= sample_rate_ms_.load()) {
         SensorReading reading = read();
-        data_callback_(reading);
+        if (data_callback_) {
+            data_callback_(reading);
+        } else {
+            block_callback_(&reading, 1);
+        }
         last_sample_time_ms_ = now;
     }
 }
 
-float ADCLightSensor::readRawADC() {
-    int raw_value = analogRead(config_.adc_pin);
-    return static_cast<float>(raw_value) / ADC_MAX_VALUE;
+bool ADCLightSensor::startContinuous() {
+    if (continuous_adc_.isRunning()) {
+        return true;
+    }
+    
+    if (config_.continuous_sample_rate_hz == 0) {
+        return false;
+    }
+    
+    // Set before the stream runs so a concurrent query never folds in the stopped time
+    continuous_start_us_ = micros();
+    if (!continuous_adc_.begin(&config_.adc_pin, 1, config_.continuous_sample_rate_hz)) {
+        return false;
+    }
+    
+    // The hardware has a minimum conversion rate; average the surplus
+    // codes down to (about) the requested reading rate
+    decimation_ = ContinuousADC::decimationFor(continuous_adc_.getHardwareRateHz(),
+                                               config_.continuous_sample_rate_hz);
+    decimation_scale_ = 1.0f / (decimation_ * ADC_MAX_VALUE);
+    decimation_q16_scale_ = q16Scale(decimation_);
+    decimation_sum_ = 0;
+    decimation_count_ = 0;
+    block_count_ = 0;
+    reading_index_ = 0;
+    stream_start_ms_ = millis();
+    return true;
+}
+
+void ADCLightSensor::stopContinuous() {
+    if (continuous_adc_.isRunning()) {
+        uint32_t now_us = micros();
+        adc_active_us_ += now_us - continuous_start_us_.exchange(now_us);
+    }
+    continuous_adc_.end();
+    block_count_ = 0;
+}
+
+void ADCLightSensor::drainContinuous() {
+    size_t block_size = config_.block_size;
+    if (block_size == 0 || block_size > MAX_BLOCK_SIZE) {
+        block_size = MAX_BLOCK_SIZE;
+    }
+    
+    while (true) {
+        size_t wanted = block_size - block_count_;
+        size_t produced = convertContinuous(block_ + block_count_, wanted);
+        block_count_ += produced;
+        
+        if (block_count_ >= block_size) {
+            deliverBlock();
+        }
+        
+        if (produced < wanted) {
+            break;  // Driver ring drained
+        }
+    }
+}
+
+size_t ADCLightSensor::convertContinuous(SensorReading* readings, size_t max_count) {
+    uint16_t codes[RAW_CHUNK_SIZE];
+    size_t produced = 0;
+    
+    while (produced < max_count) {
+        // Never pull more codes than the remaining readings need, so
+        // nothing is left stranded between calls
+        size_t needed = (max_count - produced) * decimation_ - decimation_count_;
+        size_t count = continuous_adc_.read(codes, nullptr, needed < RAW_CHUNK_SIZE ? needed : RAW_CHUNK_SIZE);
+        if (count == 0) {
+            break;
+        }
+        
+        for (size_t i = 0; i < count; ++i) {
+            decimation_sum_ += codes[i];
+            if (++decimation_count_ < decimation_) {
+                continue;
+            }
+            
+            float raw_value = static_cast<float>(decimation_sum_) * decimation_scale_;
+            uint16_t raw_q16 = q16FromSum(decimation_sum_, decimation_q16_scale_);
+            decimation_sum_ = 0;
+            decimation_count_ = 0;
+            
+            // Timestamps follow the hardware sample clock, not the drain time;
+            // a reading spans decimation_ hardware periods
+            uint32_t timestamp_ms = stream_start_ms_ + static_cast<uint32_t>(
+                (static_cast<uint64_t>(reading_index_) * decimation_ * 1000ULL) /
+                continuous_adc_.getHardwareRateHz());
+            reading_index_++;
+            
+            readings[produced++] = makeReading(raw_value, raw_q16, timestamp_ms);
+        }
+    }
+    
+    return produced;
+}
+
+void ADCLightSensor::deliverBlock() {
+    if (block_callback_) {
+        block_callback_(block_, block_count_);
+    } else if (data_callback_) {
+        for (size_t i = 0; i < block_count_; ++i) {
+            data_callback_(block_[i]);
+        }
+    }
+    block_count_ = 0;
+}
+
+SensorReading ADCLightSensor::convertCode(uint16_t code, uint32_t timestamp_ms) {
+    return makeReading(static_cast<float>(code) * ADC_SCALE, q16FromSum(code, q16Scale(1)), timestamp_ms);
+}
+
+uint32_t ADCLightSensor::getAdcActiveTimeUs() {
+    // The DMA ADC converts the whole time it runs
+    if (continuous_adc_.isRunning()) {
+        uint32_t now_us = micros();
+        adc_active_us_ += now_us - continuous_start_us_.exchange(now_us);
+    }
+    return adc_active_us_.load();
+}
+
+void ADCLightSensor::setSamplingParameters(uint32_t sample_rate_ms, uint8_t oversampling) {
+    sample_rate_ms_ = sample_rate_ms;
+    oversampling_ = oversampling > 0 ? oversampling : 1;
+}
+
+uint32_t ADCLightSensor::getSampleRateMs() const {
+    return sample_rate_ms_.load();
+}
+
+uint8_t ADCLightSensor::getOversampling() const {
+    return oversampling_.load();
+}
+
+float ADCLightSensor::getReadingRateHz() const {
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS) {
+        uint32_t hardware_rate_hz = continuous_adc_.isRunning() ? continuous_adc_.getHardwareRateHz() :
+                                    ContinuousADC::hardwareRateFor(config_.continuous_sample_rate_hz, 1);
+        return static_cast<float>(hardware_rate_hz) /
+               ContinuousADC::decimationFor(hardware_rate_hz, config_.continuous_sample_rate_hz);
+    }
+    
+    uint32_t sample_rate_ms = sample_rate_ms_.load();
+    return sample_rate_ms > 0 ? 1000.0f / sample_rate_ms : 0.0f;
+}
+
+bool ADCLightSensor::isSampling() const {
+    return is_sampling_;
+}
+
+SensorReading ADCLightSensor::makeReading(float raw_value, uint16_t raw_q16, uint32_t timestamp_ms) {
+    SensorReading reading;
+    reading.timestamp_ms = timestamp_ms;
+    reading.raw_value = raw_value;
+    reading.voltage = adcToVoltage(reading.raw_value);
+    reading.lux_value = voltageToLux(reading.voltage);
+    reading.is_valid = (reading.raw_value >= 0.0f && reading.raw_value <= 1.0f);
+    reading.quality = calculateQuality(reading);
+    
+    // Apply noise filtering
+    reading.lux_value = applyNoiseFilter(reading.lux_value);
+    reading.raw_q16 = applyQ16NoiseFilter(raw_q16);
+    filter_buffer_index_ = (filter_buffer_index_ + 1) % FILTER_BUFFER_SIZE;
+    
+    return reading;
+}
+
+uint16_t ADCLightSensor::readRawADC() {
+    return static_cast<uint16_t>(analogRead(config_.adc_pin));
 }
 
 float ADCLightSensor::adcToVoltage(float raw_value) {
@@ -174,19 +426,29 @@ float ADCLightSensor::voltageToLux(float voltage) {
     }
     
     // Convert to lux using calibrated sensitivity
-    return compensated_voltage / config_.sensitivity;
+    return compensated_voltage * inv_sensitivity_;
 }
 
 float ADCLightSensor::applyNoiseFilter(float reading) {
     filter_buffer_[filter_buffer_index_] = reading;
-    filter_buffer_index_ = (filter_buffer_index_ + 1) % FILTER_BUFFER_SIZE;
     
     float sum = 0.0f;
     for (size_t i = 0; i < FILTER_BUFFER_SIZE; ++i) {
         sum += filter_buffer_[i];
     }
     
-    return sum / FILTER_BUFFER_SIZE;
+    return sum * (1.0f / FILTER_BUFFER_SIZE);
+}
+
+uint16_t ADCLightSensor::applyQ16NoiseFilter(uint16_t raw_q16) {
+    q16_filter_buffer_[filter_buffer_index_] = raw_q16;
+    
+    uint32_t sum = 0;
+    for (size_t i = 0; i < FILTER_BUFFER_SIZE; ++i) {
+        sum += q16_filter_buffer_[i];
+    }
+    
+    return static_cast<uint16_t>(sum / FILTER_BUFFER_SIZE);
 }
 
 uint8_t ADCLightSensor::calculateQuality(const SensorReading& reading) {
@@ -194,8 +456,12 @@ uint8_t ADCLightSensor::calculateQuality(const SensorReading& reading) {
         return 0;
     }
     
+    return qualityFromRaw(reading.raw_value);
+}
+
+uint8_t ADCLightSensor::qualityFromRaw(float raw_value) {
     // Calculate quality based on signal strength and stability
-    float signal_strength = reading.raw_value;
+    float signal_strength = raw_value;
     float quality = signal_strength * 100.0f;
     
     // Reduce quality if signal is too low (noise dominated)
@@ -211,4 +477,18 @@ uint8_t ADCLightSensor::calculateQuality(const SensorReading& reading) {
     return static_cast<uint8_t>(std::min(100.0f, std::max(0.0f, quality)));
 }
 
+uint32_t ADCLightSensor::q16Scale(uint32_t code_count) {
+    return code_count > 0 ? static_cast<uint32_t>((1ULL << 32) / (code_count * ADC_MAX_VALUE)) : 0;
+}
+
+uint16_t ADCLightSensor::q16FromSum(uint32_t code_sum, uint32_t code_scale) {
+    // Full scale is 65536 in Q16; the top step is clipped to fit 16 bits
+    uint64_t code = (static_cast<uint64_t>(code_sum) * code_scale) >> 16;
+    return static_cast<uint16_t>(std::min<uint64_t>(code, 0xFFFF));
+}
+
+void ADCLightSensor::updateConversion() {
+    inv_sensitivity_ = config_.sensitivity > 0.0f ? 1.0f / config_.sensitivity : 0.0f;
+}
+
 }  // namespace LightSensor
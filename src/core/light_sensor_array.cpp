@@ -0,0 +1,352 @@
+#include "light_sensor_array.h"
+#include <Arduino.h>
+#include <cstring>
+
+namespace LightSensor {
+
+static const uint8_t ADC_WIDTH = 12;
+static const uint16_t ADC_MAX_VALUE = 4095;
+static const float ADC_SCALE = 1.0f / ADC_MAX_VALUE;
+
+LightSensorArray::LightSensorArray(const SensorConfig& config, const SignalConfig& signal_config)
+    : config_(config), signal_config_(signal_config), channel_count_(0), is_initialized_(false),
+      decimation_(1), stream_start_ms_(0), decimation_scale_(ADC_SCALE),
+      decimation_q16_scale_(ADCLightSensor::q16Scale(1)),
+      adc_active_us_(0), continuous_start_us_(0) {
+    for (size_t i = 0; i < MAX_CHANNELS; ++i) {
+        count_[i] = 0;
+        decimation_sum_[i] = 0;
+        decimation_count_[i] = 0;
+        reading_index_[i] = 0;
+        analysis_[i] = {0.0f, 0.0f, 0.0f, false, false, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f};
+    }
+    resetCalibration();
+}
+
+LightSensorArray::~LightSensorArray() {
+    end();
+}
+
+bool LightSensorArray::initialize() {
+    if (is_initialized_) {
+        return true;
+    }
+
+    if (config_.array_channel_count == 0 || config_.array_channel_count > MAX_CHANNELS ||
+        config_.reference_voltage <= 0.0f) {
+        return false;
+    }
+
+    // Only ADC1 (GPIO 32-39) can be converted together by the DMA controller
+    for (size_t i = 0; i < config_.array_channel_count; ++i) {
+        if (config_.array_pins[i] < 32 || config_.array_pins[i] > 39) {
+            return false;
+        }
+    }
+
+    channel_count_ = config_.array_channel_count;
+
+    analogReadResolution(ADC_WIDTH);
+    analogSetAttenuation(ADC_11db);
+
+    for (size_t i = 0; i < channel_count_; ++i) {
+        pinMode(config_.array_pins[i], INPUT);
+
+        if (!processors_[i].get()) {
+            processors_[i].emplace(signal_config_);
+        }
+        applyCalibration(i);
+        count_[i] = 0;
+    }
+
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS && !startContinuous()) {
+        return false;
+    }
+
+    is_initialized_ = true;
+    return true;
+}
+
+void LightSensorArray::end() {
+    stopContinuous();
+    is_initialized_ = false;
+}
+
+size_t LightSensorArray::sweep() {
+    if (!is_initialized_) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < channel_count_; ++i) {
+        count_[i] = 0;
+    }
+
+    if (config_.sampling_mode == SamplingMode::CONTINUOUS) {
+        sweepContinuous();
+    } else {
+        sweepPolled();
+    }
+
+    // One filter pass per channel over its whole column
+    size_t total = 0;
+    for (size_t i = 0; i < channel_count_; ++i) {
+        if (count_[i] > 0) {
+            analysis_[i] = processors_[i].get()->processColumns(raw_q16_[i], lux_[i], filtered_[i], count_[i]);
+            total += count_[i];
+        }
+    }
+
+    return total;
+}
+
+void LightSensorArray::configure(const SensorConfig& config) {
+    bool stream_changed = config.array_channel_count != config_.array_channel_count ||
+                          memcmp(config.array_pins, config_.array_pins, sizeof(config.array_pins)) != 0 ||
+                          config.sampling_mode != config_.sampling_mode ||
+                          config.continuous_sample_rate_hz != config_.continuous_sample_rate_hz;
+    bool calibration_changed = config.reference_voltage != config_.reference_voltage ||
+                               config.dark_offset != config_.dark_offset ||
+                               config.sensitivity != config_.sensitivity;
+
+    bool was_initialized = is_initialized_;
+    if (stream_changed) {
+        end();
+    }
+
+    config_ = config;
+
+    if (calibration_changed || stream_changed) {
+        resetCalibration();
+        for (size_t i = 0; i < channel_count_; ++i) {
+            applyCalibration(i);
+        }
+    }
+
+    if (was_initialized && stream_changed) {
+        initialize();
+    }
+}
+
+void LightSensorArray::configureSignal(const SignalConfig& signal_config) {
+    signal_config_ = signal_config;
+    for (size_t i = 0; i < channel_count_; ++i) {
+        processors_[i].get()->configure(signal_config_);
+        applyCalibration(i);
+    }
+}
+
+void LightSensorArray::setChannelCalibration(size_t channel, float dark_offset, float sensitivity) {
+    if (channel >= MAX_CHANNELS) {
+        return;
+    }
+
+    dark_offset_[channel] = dark_offset;
+    sensitivity_[channel] = sensitivity;
+    if (channel < channel_count_) {
+        applyCalibration(channel);
+    }
+}
+
+size_t LightSensorArray::getChannelCount() const {
+    return channel_count_;
+}
+
+uint8_t LightSensorArray::getPin(size_t channel) const {
+    return channel < channel_count_ ? config_.array_pins[channel] : 0;
+}
+
+int LightSensorArray::findChannel(uint8_t pin) const {
+    for (size_t i = 0; i < channel_count_; ++i) {
+        if (config_.array_pins[i] == pin) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+size_t LightSensorArray::getCount(size_t channel) const {
+    return channel < channel_count_ ? count_[channel] : 0;
+}
+
+const uint32_t* LightSensorArray::getTimestamps(size_t channel) const {
+    return timestamps_[channel];
+}
+
+const float* LightSensorArray::getRawValues(size_t channel) const {
+    return raw_[channel];
+}
+
+const float* LightSensorArray::getLuxValues(size_t channel) const {
+    return lux_[channel];
+}
+
+const float* LightSensorArray::getFilteredValues(size_t channel) const {
+    return filtered_[channel];
+}
+
+const uint8_t* LightSensorArray::getQuality(size_t channel) const {
+    return quality_[channel];
+}
+
+const SignalAnalysis& LightSensorArray::getAnalysis(size_t channel) const {
+    return analysis_[channel];
+}
+
+SensorReading LightSensorArray::getReading(size_t channel, size_t index) const {
+    SensorReading reading;
+    reading.timestamp_ms = timestamps_[channel][index];
+    reading.raw_value = raw_[channel][index];
+    reading.raw_q16 = raw_q16_[channel][index];
+    reading.lux_value = lux_[channel][index];
+    reading.voltage = raw_[channel][index] * config_.reference_voltage;
+    reading.is_valid = true;
+    reading.quality = quality_[channel][index];
+    return reading;
+}
+
+uint32_t LightSensorArray::getAdcActiveTimeUs() {
+    if (continuous_adc_.isRunning()) {
+        uint32_t now_us = micros();
+        adc_active_us_ += now_us - continuous_start_us_.exchange(now_us);
+    }
+    return adc_active_us_.load();
+}
+
+bool LightSensorArray::startContinuous() {
+    if (continuous_adc_.isRunning()) {
+        return true;
+    }
+
+    continuous_start_us_ = micros();
+    if (config_.continuous_sample_rate_hz == 0 ||
+        !continuous_adc_.begin(config_.array_pins, channel_count_, config_.continuous_sample_rate_hz)) {
+        return false;
+    }
+
+    // Same decimation as ADCLightSensor, applied to each channel's codes
+    decimation_ = ContinuousADC::decimationFor(continuous_adc_.getHardwareRateHz(),
+                                               config_.continuous_sample_rate_hz);
+    decimation_scale_ = 1.0f / (decimation_ * ADC_MAX_VALUE);
+    decimation_q16_scale_ = ADCLightSensor::q16Scale(decimation_);
+    for (size_t i = 0; i < MAX_CHANNELS; ++i) {
+        decimation_sum_[i] = 0;
+        decimation_count_[i] = 0;
+        reading_index_[i] = 0;
+    }
+
+    // Spectral bins follow each channel's decimated rate
+    float reading_rate_hz = static_cast<float>(continuous_adc_.getHardwareRateHz()) / decimation_;
+    for (size_t i = 0; i < channel_count_; ++i) {
+        processors_[i].get()->setSampleRate(reading_rate_hz);
+    }
+    stream_start_ms_ = millis();
+    return true;
+}
+
+void LightSensorArray::stopContinuous() {
+    if (continuous_adc_.isRunning()) {
+        uint32_t now_us = micros();
+        adc_active_us_ += now_us - continuous_start_us_.exchange(now_us);
+    }
+    continuous_adc_.end();
+}
+
+void LightSensorArray::sweepContinuous() {
+    uint16_t codes[RAW_CHUNK_SIZE];
+    uint8_t slots[RAW_CHUNK_SIZE];
+
+    while (true) {
+        size_t room = CHANNEL_CAPACITY;
+        for (size_t i = 0; i < channel_count_; ++i) {
+            if (CHANNEL_CAPACITY - count_[i] < room) {
+                room = CHANNEL_CAPACITY - count_[i];
+            }
+        }
+        if (room == 0) {
+            break;  // A row is full; the rest stays in the DMA ring
+        }
+
+        // No channel can receive more codes than were read in total, so
+        // this never completes more readings than the fullest row has room for
+        size_t wanted = room * decimation_;
+        size_t count = continuous_adc_.read(codes, slots, wanted < RAW_CHUNK_SIZE ? wanted : RAW_CHUNK_SIZE);
+        if (count == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t channel = slots[i];
+            decimation_sum_[channel] += codes[i];
+            if (++decimation_count_[channel] < decimation_) {
+                continue;
+            }
+
+            float raw_value = static_cast<float>(decimation_sum_[channel]) * decimation_scale_;
+            uint16_t raw_q16 = ADCLightSensor::q16FromSum(decimation_sum_[channel], decimation_q16_scale_);
+            decimation_sum_[channel] = 0;
+            decimation_count_[channel] = 0;
+
+            uint32_t timestamp_ms = stream_start_ms_ + static_cast<uint32_t>(
+                (static_cast<uint64_t>(reading_index_[channel]) * decimation_ * 1000ULL) /
+                continuous_adc_.getHardwareRateHz());
+            reading_index_[channel]++;
+
+            store(channel, raw_value, raw_q16, timestamp_ms);
+        }
+    }
+}
+
+void LightSensorArray::sweepPolled() {
+    uint32_t sums[MAX_CHANNELS] = {0};
+    uint8_t oversampling = config_.oversampling > 0 ? config_.oversampling : 1;
+    uint32_t timestamp_ms = millis();
+    uint32_t start_us = micros();
+
+    // Interleave the channels so every pass sees the same light
+    for (uint8_t pass = 0; pass < oversampling; ++pass) {
+        for (size_t i = 0; i < channel_count_; ++i) {
+            sums[i] += analogRead(config_.array_pins[i]);
+        }
+        if (pass < oversampling - 1) {
+            delayMicroseconds(100);
+        }
+    }
+    adc_active_us_ += micros() - start_us;
+
+    float scale = ADC_SCALE / oversampling;
+    uint32_t code_scale = ADCLightSensor::q16Scale(oversampling);
+    for (size_t i = 0; i < channel_count_; ++i) {
+        store(i, static_cast<float>(sums[i]) * scale, ADCLightSensor::q16FromSum(sums[i], code_scale), timestamp_ms);
+    }
+}
+
+void LightSensorArray::store(size_t channel, float raw_value, uint16_t raw_q16, uint32_t timestamp_ms) {
+    size_t index = count_[channel]++;
+    float voltage = raw_value * config_.reference_voltage - dark_offset_[channel];
+
+    timestamps_[channel][index] = timestamp_ms;
+    raw_[channel][index] = raw_value;
+    raw_q16_[channel][index] = raw_q16;
+    lux_[channel][index] = voltage > 0.0f ? voltage * inv_sensitivity_[channel] : 0.0f;
+    quality_[channel][index] = ADCLightSensor::qualityFromRaw(raw_value);
+}
+
+void LightSensorArray::resetCalibration() {
+    for (size_t i = 0; i < MAX_CHANNELS; ++i) {
+        dark_offset_[i] = config_.dark_offset;
+        sensitivity_[i] = config_.sensitivity;
+    }
+}
+
+void LightSensorArray::applyCalibration(size_t channel) {
+    inv_sensitivity_[channel] = sensitivity_[channel] > 0.0f ? 1.0f / sensitivity_[channel] : 0.0f;
+
+    if (SignalProcessor* processor = processors_[channel].get()) {
+        SensorConfig calibration = config_;
+        calibration.dark_offset = dark_offset_[channel];
+        calibration.sensitivity = sensitivity_[channel];
+        processor->setCalibration(calibration);
+    }
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,198 @@
+#include "synthetic_sensor.h"
+#include <Arduino.h>
+#include <cmath>
+#include <algorithm>
+
+namespace LightSensor {
+
+static const float TWO_PI_F = 6.28318530718f;
+
+SyntheticLightSensor::SyntheticLightSensor(const SensorConfig& config, const SyntheticSignalConfig& signal)
+    : config_(config), signal_(signal), is_initialized_(false), is_sampling_(false),
+      data_callback_(nullptr), block_callback_(nullptr), replay_(nullptr), replay_count_(0),
+      start_ms_(0), index_(0), rate_mhz_(0), phase_(0.0f), phase_step_(0.0f), seed_(12345),
+      elapsed_us_(0), last_us_(0), delivered_(0) {
+    updateRate();
+}
+
+bool SyntheticLightSensor::initialize() {
+    start_ms_ = millis();
+    index_ = 0;
+    phase_ = 0.0f;
+    seed_ = 12345;
+    is_initialized_ = rate_mhz_ > 0;
+    return is_initialized_;
+}
+
+SensorReading SyntheticLightSensor::read() {
+    // Reading n is stamped n / rate_hz after initialize(), however fast it is pulled
+    uint32_t offset_ms = rate_mhz_ > 0 ? static_cast<uint32_t>(static_cast<uint64_t>(index_) * 1000000ull / rate_mhz_) : 0;
+    float lux = nextLux();
+    index_++;
+    return makeReading(lux, start_ms_ + offset_ms);
+}
+
+size_t SyntheticLightSensor::readBlock(SensorReading* readings, size_t max_count) {
+    for (size_t i = 0; i < max_count; ++i) {
+        readings[i] = read();
+    }
+    return max_count;
+}
+
+void SyntheticLightSensor::startSampling(DataCallback callback) {
+    if (!is_initialized_ || callback == nullptr) {
+        return;
+    }
+
+    data_callback_ = callback;
+    block_callback_ = nullptr;
+    startRealTime();
+}
+
+void SyntheticLightSensor::startBlockSampling(BlockCallback callback) {
+    if (!is_initialized_ || callback == nullptr) {
+        return;
+    }
+
+    block_callback_ = callback;
+    data_callback_ = nullptr;
+    startRealTime();
+}
+
+void SyntheticLightSensor::stopSampling() {
+    is_sampling_ = false;
+    data_callback_ = nullptr;
+    block_callback_ = nullptr;
+}
+
+void SyntheticLightSensor::configure(const SensorConfig& config) {
+    config_ = config;
+}
+
+void SyntheticLightSensor::calibrate(float dark_value, float light_value) {
+    if (dark_value >= light_value) {
+        return;
+    }
+
+    // Same reference as ADCLightSensor::calibrate()
+    config_.dark_offset = dark_value;
+    config_.sensitivity = (light_value - dark_value) / 1000.0f;
+}
+
+void SyntheticLightSensor::enterLowPower() {
+}
+
+void SyntheticLightSensor::wakeUp() {
+}
+
+void SyntheticLightSensor::process() {
+    if (!is_sampling_ || (!data_callback_ && !block_callback_)) {
+        return;
+    }
+
+    uint32_t now_us = micros();
+    elapsed_us_ += now_us - last_us_;
+    last_us_ = now_us;
+
+    uint64_t due = (elapsed_us_ / 1000) * rate_mhz_ / 1000000ull;
+    size_t pending = static_cast<size_t>(std::min<uint64_t>(due - std::min<uint64_t>(due, delivered_), MAX_CATCH_UP));
+
+    SensorReading block[MAX_BLOCK_SIZE];
+    while (pending > 0) {
+        size_t count = std::min(pending, MAX_BLOCK_SIZE);
+        readBlock(block, count);
+        if (block_callback_) {
+            block_callback_(block, count);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                data_callback_(block[i]);
+            }
+        }
+        delivered_ += count;
+        pending -= count;
+    }
+}
+
+void SyntheticLightSensor::setSignal(const SyntheticSignalConfig& signal) {
+    signal_ = signal;
+    updateRate();
+}
+
+void SyntheticLightSensor::setReplay(const float* lux, size_t count) {
+    replay_ = lux;
+    replay_count_ = lux ? count : 0;
+}
+
+float SyntheticLightSensor::luxForRaw(float raw_value) const {
+    if (config_.sensitivity <= 0.0f) {
+        return 0.0f;
+    }
+    return std::max(0.0f, (raw_value * config_.reference_voltage - config_.dark_offset) / config_.sensitivity);
+}
+
+uint32_t SyntheticLightSensor::getReadingCount() const {
+    return index_;
+}
+
+void SyntheticLightSensor::updateRate() {
+    rate_mhz_ = signal_.rate_hz > 0.0f ? static_cast<uint64_t>(lroundf(signal_.rate_hz * 1000.0f)) : 0;
+    phase_step_ = signal_.rate_hz > 0.0f ? signal_.frequency_hz / signal_.rate_hz : 0.0f;
+}
+
+float SyntheticLightSensor::nextLux() {
+    float lux = signal_.base_lux;
+    switch (signal_.waveform) {
+        case SyntheticWaveform::SQUARE:
+            lux += phase_ < 0.5f ? 0.0f : signal_.amplitude_lux;
+            break;
+        case SyntheticWaveform::SINE:
+            lux += signal_.amplitude_lux * sinf(TWO_PI_F * phase_);
+            break;
+        case SyntheticWaveform::REPLAY:
+            lux = replay_count_ > 0 ? replay_[index_ % replay_count_] : signal_.base_lux;
+            break;
+        default:
+            break;
+    }
+
+    phase_ += phase_step_;
+    phase_ -= floorf(phase_);
+
+    if (signal_.noise_lux > 0.0f) {
+        // Same LCG as the benchmark inputs; the top 16 bits are used
+        seed_ = seed_ * 1103515245u + 12345u;
+        float unit = static_cast<float>(seed_ >> 16) / 65535.0f;
+        lux += signal_.noise_lux * (2.0f * unit - 1.0f);
+    }
+
+    if (signal_.spike_interval > 0 && index_ % signal_.spike_interval == signal_.spike_interval - 1) {
+        lux += signal_.spike_lux;
+    }
+    return lux;
+}
+
+SensorReading SyntheticLightSensor::makeReading(float lux, uint32_t timestamp_ms) const {
+    // Through the calibration and back, so the ADC range clips the signal
+    float voltage = config_.dark_offset + std::max(0.0f, lux) * config_.sensitivity;
+    float raw_value = config_.reference_voltage > 0.0f ? voltage / config_.reference_voltage : 0.0f;
+    raw_value = std::min(1.0f, std::max(0.0f, raw_value));
+
+    SensorReading reading;
+    reading.timestamp_ms = timestamp_ms;
+    reading.raw_value = raw_value;
+    reading.raw_q16 = static_cast<uint16_t>(std::min(65535.0f, raw_value * 65536.0f));
+    reading.voltage = raw_value * config_.reference_voltage;
+    reading.lux_value = luxForRaw(raw_value);
+    reading.is_valid = true;
+    reading.quality = ADCLightSensor::qualityFromRaw(raw_value);
+    return reading;
+}
+
+void SyntheticLightSensor::startRealTime() {
+    is_sampling_ = true;
+    elapsed_us_ = 0;
+    last_us_ = micros();
+    delivered_ = 0;
+}
+
+}  // namespace LightSensor
@@ -13,30 +13,97 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include "light_sensor.h"
+#include "light_sensor_array.h"
 #include "power_manager.h"
 #include "data_logger.h"
 #include "signal_processor.h"
+#include "event_detector.h"
 #include "config_manager.h"
 #include "logger.h"
 #include "timer.h"
+#include "spsc_ring_buffer.h"
+#include "sleep_scheduler.h"
+#include "adaptive_sampling.h"
+#include "profiler.h"
+#include "uplink.h"
+#include "static_arena.h"
+#include "memory_report.h"
+#include <atomic>
 
 using namespace LightSensor;
 
 // Global instances
 ConfigManager* configManager = nullptr;
 ADCLightSensor* sensor = nullptr;
+LightSensorArray* sensorArray = nullptr;
 PowerManager* powerManager = nullptr;
 DataLogger* dataLogger = nullptr;
 SignalProcessor* signalProcessor = nullptr;
+EventDetector* eventDetector = nullptr;
+AdaptiveSamplingController* adaptiveSampling = nullptr;
+Uplink* uplink = nullptr;
 Logger& logger = Logger::getInstance();
 
+// Subsystems are built in static slots, never on the heap, so months of
+// re-configuration cannot fragment it
+static StaticSlot<ConfigManager> configManagerSlot;
+static StaticSlot<ADCLightSensor> sensorSlot;
+static StaticSlot<LightSensorArray> sensorArraySlot;
+static StaticSlot<PowerManager> powerManagerSlot;
+static StaticSlot<DataLogger> dataLoggerSlot;
+static StaticSlot<SignalProcessor> signalProcessorSlot;
+static StaticSlot<EventDetector> eventDetectorSlot;
+static StaticSlot<AdaptiveSamplingController> adaptiveSamplingSlot;
+static StaticSlot<Uplink> uplinkSlot;
+static MemoryReport& memoryReport = MemoryReport::getInstance();
+
 // Battery monitoring pin (optional)
 static const uint8_t BATTERY_PIN = 35;
+static const uint32_t BATTERY_CHECK_INTERVAL_MS = 10000;
+static const uint32_t POWER_CHECK_INTERVAL_MS = 1000;
+static const uint32_t PROFILE_DUMP_INTERVAL_MS = 60000;
+static const uint32_t UPLINK_CHECK_INTERVAL_MS = 1000;
+
+// Scheduler mode: run each job at its deadline and light-sleep in between
+static SleepScheduler scheduler;
+static bool schedulerRunning = false;
+static int sampleTaskId = -1;
+
+// Pipeline mode: acquisition task -> lock-free queue -> processing task
+static const size_t PIPELINE_QUEUE_SIZE = 128;
+static SpscRingBuffer<SensorReading, PIPELINE_QUEUE_SIZE> pipelineQueue;
+static TaskHandle_t acquisitionTask = nullptr;
+static TaskHandle_t processingTask = nullptr;
+static std::atomic<uint32_t> pipelineDropCount(0);
+static bool pipelineRunning = false;
+
+// The processing task and loop() both use DataLogger, PowerManager and the
+// uplink; each holds this while it does. The processing task reads no live
+// config, so updateConfig() rewriting it needs no lock.
+static SemaphoreHandle_t pipelineMutex = nullptr;
+static std::atomic<bool> debugMode(false);
 
 // Forward declarations
 void initializeSystem();
 void processReading();
+void processArray();
+void handleReading(const SensorReading& reading);
+void handleReadingBlock(const SensorReading* readings, size_t count);
+void reportAnalysis(const SensorReading& reading, const SignalAnalysis& analysis);
+size_t logEvents(const SensorReading& reading, const SignalAnalysis& analysis);
+void logDetectedEvents(const LightEvent* events, size_t count, const SensorReading& reading);
 void checkBattery();
+void ingestUlpSamples();
+void processPower();
+void adaptSampling(const SignalAnalysis& analysis);
+bool startPipeline(const PipelineConfig& pipeline);
+void enqueueReadingBlock(const SensorReading* readings, size_t count);
+void acquisitionTaskLoop(void* arg);
+void processingTaskLoop(void* arg);
+void lockPipeline();
+void unlockPipeline();
+bool startScheduler(const SystemConfig& config);
+void applyConfig(const SystemConfig& config, const ConfigDiff& diff);
 
 void setup() {
     // Initialize serial
@@ -56,6 +123,13 @@ void setup() {
 }
 
 void loop() {
+    if (schedulerRunning) {
+        scheduler.runDue();
+        logger.flush();  // Queued log lines would otherwise wait out the sleep
+        powerManager->idle(scheduler.getTimeUntilNextMs());
+        return;
+    }
+    
     static uint32_t last_reading_time = 0;
     static uint32_t last_battery_check = 0;
     const uint32_t now = millis();
@@ -63,26 +137,60 @@ void loop() {
     // Get current config
     const SystemConfig& config = configManager->getConfig();
     
-    // Take sensor readings at configured rate
-    if (now - last_reading_time >= config.sensor.sample_rate_ms) {
-        processReading();
-        last_reading_time = now;
+    // Pipeline mode samples and processes in its own tasks
+    if (!pipelineRunning) {
+        // Take sensor readings at configured rate (continuous mode delivers blocks via process())
+        if (config.sensor.sampling_mode == SamplingMode::POLLED &&
+            now - last_reading_time >= sensor->getSampleRateMs()) {
+            if (sensorArray) {
+                processArray();
+            } else {
+                processReading();
+            }
+            last_reading_time = now;
+        } else if (sensorArray && config.sensor.sampling_mode == SamplingMode::CONTINUOUS) {
+            processArray();
+        }
     }
     
+    lockPipeline();
+    
     // Check battery every 10 seconds
-    if (config.power.enable_battery_monitoring && now - last_battery_check >= 10000) {
+    if (config.power.enable_battery_monitoring && now - last_battery_check >= BATTERY_CHECK_INTERVAL_MS) {
         checkBattery();
         last_battery_check = now;
+        
+        uint32_t dropped = pipelineDropCount.exchange(0);
+        if (dropped > 0) {
+            LS_LOG_WARNING("Pipeline queue full: %lu readings dropped", dropped);
+        }
     }
     
-    // Process sensor (handles continuous sampling if enabled)
-    sensor->process();
+    if (!pipelineRunning) {
+        // Process sensor (handles continuous sampling if enabled)
+        sensor->process();
+        
+        // Process data logger
+        dataLogger->process();
+    }
     
-    // Process data logger
-    dataLogger->process();
+    // Start an upload when a new batch window begins
+    if (uplink) {
+        uplink->process();
+    }
     
     // Process power management
-    powerManager->process();
+    processPower();
+    
+    unlockPipeline();
+    
+#if LS_ENABLE_PROFILING
+    static uint32_t last_profile_dump = 0;
+    if (now - last_profile_dump >= PROFILE_DUMP_INTERVAL_MS) {
+        Profiler::getInstance().dump();
+        last_profile_dump = now;
+    }
+#endif
     
     // Small delay to prevent tight loop
     delay(10);
@@ -92,15 +200,20 @@ void initializeSystem() {
     // Set up logger
     logger.setLevel(LogLevel::INFO);
     logger.setOutput(LogOutput::SERIAL);
-    logger.info("Initializing system...");
+    LS_LOG_INFO("Initializing system...");
     
     // Initialize configuration manager
-    configManager = new ConfigManager("/config.json");
-    if (!configManager->initialize()) {
-        logger.error("Failed to initialize config manager!");
-        logger.info("Using default configuration");
+    memoryReport.begin("config", configManagerSlot.bytes());
+    configManager = configManagerSlot.emplace("/config.json");
+    bool config_loaded = configManager->initialize();
+    memoryReport.end();
+    if (!config_loaded) {
+        LS_LOG_ERROR("Failed to initialize config manager!");
+        LS_LOG_INFO("Using default configuration");
+    } else if (configManager->isRestoredFromSnapshot()) {
+        LS_LOG_INFO("Configuration restored from RTC snapshot");
     } else {
-        logger.info("Configuration loaded from SPIFFS");
+        LS_LOG_INFO("Configuration loaded from SPIFFS");
     }
     
     const SystemConfig& config = configManager->getConfig();
@@ -108,100 +221,582 @@ void initializeSystem() {
     // Enable debug logging if configured
     if (config.enable_debug_mode) {
         logger.setLevel(LogLevel::DEBUG);
-        logger.debug("Debug mode enabled");
+        LS_LOG_DEBUG("Debug mode enabled");
+    }
+    debugMode = config.enable_debug_mode;
+    
+    // Format and write log messages off the sampling path
+    if (config.enable_async_logging && !logger.startAsync()) {
+        LS_LOG_WARNING("Async logging unavailable - writing synchronously");
     }
     
     // Initialize sensor
-    sensor = new ADCLightSensor(config.sensor);
-    if (!sensor->initialize()) {
-        logger.critical("Failed to initialize light sensor!");
-        logger.error("Check that GPIO 34 is connected to a light sensor");
+    memoryReport.begin("sensor", sensorSlot.bytes());
+    sensor = sensorSlot.emplace(config.sensor);
+    bool sensor_ready = sensor->initialize();
+    memoryReport.end();
+    if (!sensor_ready) {
+        LS_LOG_CRITICAL("Failed to initialize light sensor!");
+        LS_LOG_ERROR("Check that GPIO 34 is connected to a light sensor");
         
         // Blink LED to indicate error (if available)
         while (true) {
             delay(500);
         }
     }
-    logger.info("Light sensor initialized on GPIO 34");
+    LS_LOG_INFO("Light sensor initialized on GPIO 34");
     
     // Initialize power manager
-    powerManager = new PowerManager(config.power);
-    if (!powerManager->initialize()) {
-        logger.error("Failed to initialize power manager");
+    memoryReport.begin("power", powerManagerSlot.bytes());
+    powerManager = powerManagerSlot.emplace(config.power);
+    powerManager->setLightSensorPin(config.sensor.adc_pin);
+    bool power_ready = powerManager->initialize();
+    memoryReport.end();
+    if (!power_ready) {
+        LS_LOG_ERROR("Failed to initialize power manager");
     } else {
-        logger.info("Power manager initialized");
+        LS_LOG_INFO("Power manager initialized");
     }
     
     // Initialize data logger
-    dataLogger = new DataLogger(config.logger);
-    if (!dataLogger->initialize()) {
-        logger.warning("Failed to initialize data logger - logging disabled");
+    memoryReport.begin("logger", dataLoggerSlot.bytes());
+    dataLogger = dataLoggerSlot.emplace(config.logger);
+    dataLogger->setCalibration(config.sensor);
+    bool logger_ready = dataLogger->initialize();
+    memoryReport.end();
+    if (!logger_ready) {
+        LS_LOG_WARNING("Failed to initialize data logger - logging disabled");
     } else {
-        logger.info("Data logger initialized");
+        LS_LOG_INFO("Data logger initialized");
+    }
+    
+    // Deep sleep loses RAM: get buffered readings onto flash first
+    powerManager->setPowerEventCallback([](PowerMode mode, WakeSource) {
+        if (mode == PowerMode::DEEP_SLEEP) {
+            dataLogger->sync();
+            logger.flush();
+        }
+    });
+    
+    // Sealed segments leave the device in batches, one radio session per window
+    if (config.uplink.enabled) {
+        memoryReport.begin("uplink", uplinkSlot.bytes());
+        uplink = uplinkSlot.emplace(config.uplink, config.device_id, *dataLogger, *powerManager);
+        bool uplink_ready = uplink->initialize();
+        memoryReport.end();
+        if (uplink_ready) {
+            LS_LOG_INFO("Uplink: %s batches every %lu s", config.uplink.transport == UplinkTransport::MQTT ?
+                        "MQTT" : "HTTP", config.uplink.batch_interval_ms / 1000);
+        } else {
+            LS_LOG_ERROR("Failed to start uplink task - uplink disabled");
+            uplinkSlot.destroy();
+            uplink = nullptr;
+        }
+    }
+    
+    // Readings the ULP took while the main cores were in deep sleep
+    if (powerManager->getUlpSampler().hasSamples()) {
+        ingestUlpSamples();
     }
     
     // Initialize signal processor
-    signalProcessor = new SignalProcessor(config.signal);
-    logger.info("Signal processor initialized");
+    memoryReport.begin("signal", signalProcessorSlot.bytes() + eventDetectorSlot.bytes());
+    signalProcessor = signalProcessorSlot.emplace(config.signal);
+    signalProcessor->setCalibration(config.sensor);
+    signalProcessor->setSampleRate(sensor->getReadingRateHz());
+    eventDetector = eventDetectorSlot.emplace(config.signal);
+    memoryReport.end();
+    LS_LOG_INFO("Signal processor initialized");
+    
+    if (config.sensor.enable_adaptive_sampling && config.sensor.sampling_mode == SamplingMode::POLLED) {
+        memoryReport.begin("adaptive", adaptiveSamplingSlot.bytes());
+        adaptiveSampling = adaptiveSamplingSlot.emplace(config.sensor);
+        memoryReport.end();
+        LS_LOG_INFO("Adaptive sampling enabled");
+    }
+    
+    // Several photodiodes: one sweep per sample covers every channel
+    if (config.sensor.array_channel_count > 0) {
+        if (config.pipeline.enabled) {
+            LS_LOG_WARNING("Sensor array not supported with the pipeline - using GPIO %u only",
+                           config.sensor.adc_pin);
+        } else {
+            memoryReport.begin("array", sensorArraySlot.bytes());
+            sensorArray = sensorArraySlot.emplace(config.sensor, config.signal);
+            bool array_ready = sensorArray->initialize();
+            memoryReport.end();
+            if (array_ready) {
+                LS_LOG_INFO("Sensor array: %u channels", static_cast<unsigned>(sensorArray->getChannelCount()));
+            } else {
+                LS_LOG_ERROR("Failed to initialize sensor array - using GPIO %u only", config.sensor.adc_pin);
+                sensorArraySlot.destroy();
+                sensorArray = nullptr;
+            }
+        }
+    }
+    
+    // Pipeline tasks start blocked until initialization is complete
+    if (config.pipeline.enabled) {
+        pipelineRunning = startPipeline(config.pipeline);
+        if (!pipelineRunning) {
+            LS_LOG_ERROR("Failed to start pipeline tasks - using loop()");
+        }
+    }
+    
+    // Continuous mode: the ADC runs in the background and process() hands over whole blocks
+    if (config.sensor.sampling_mode == SamplingMode::CONTINUOUS && !sensorArray) {
+        sensor->startBlockSampling(pipelineRunning ? enqueueReadingBlock : handleReadingBlock);
+        if (sensor->isSampling()) {
+            LS_LOG_INFO("Continuous sampling at %.1f Hz", sensor->getReadingRateHz());
+        } else {
+            LS_LOG_ERROR("Failed to start continuous ADC at %lu Hz", config.sensor.continuous_sample_rate_hz);
+        }
+    }
     
     // Check if calibration is valid
     const CalibrationData& calibration = configManager->getCalibrationData();
     if (!calibration.is_valid) {
-        logger.warning("Sensor not calibrated - readings may be inaccurate");
-        logger.info("Run calibration procedure for accurate lux readings");
+        LS_LOG_WARNING("Sensor not calibrated - readings may be inaccurate");
+        LS_LOG_INFO("Run calibration procedure for accurate lux readings");
     } else {
-        char msg[64];
-        snprintf(msg, sizeof(msg), "Calibration: dark=%.2f, sensitivity=%.4f", 
-                 calibration.dark_reference, calibration.sensitivity);
-        logger.info(msg);
+        LS_LOG_INFO("Calibration: dark=%.2f, sensitivity=%.4f", 
+                    calibration.dark_reference, calibration.sensitivity);
     }
     
-    logger.info("System initialization complete");
+    if (pipelineRunning) {
+        xTaskNotifyGive(processingTask);
+        xTaskNotifyGive(acquisitionTask);
+        LS_LOG_INFO("Pipeline: acquisition on core %u, processing on core %u",
+                    config.pipeline.acquisition_core, config.pipeline.processing_core);
+    }
+    
+    if (config.power.enable_sleep_scheduler) {
+        schedulerRunning = startScheduler(config);
+        if (schedulerRunning) {
+            LS_LOG_INFO("Sleep scheduler active: light sleep between deadlines");
+        } else {
+            LS_LOG_WARNING("Sleep scheduler needs polled sampling without pipeline or async flush");
+        }
+    }
+    
+    // Later config updates retune the running components in place
+    configManager->setConfigApplyCallback(applyConfig);
+    
+    // Per-subsystem RAM at boot, so a config change that grows a buffer shows up here
+    memoryReport.addArena("json", ConfigManager::getJsonArena());
+    memoryReport.print();
+    
+    LS_LOG_INFO("System initialization complete");
     Serial.println();
 }
 
+bool startScheduler(const SystemConfig& config) {
+    // Background tasks and the DMA ADC keep running between deadlines,
+    // so light sleep would stall them
+    if (pipelineRunning || config.sensor.sampling_mode != SamplingMode::POLLED ||
+        config.logger.enable_async_flush) {
+        return false;
+    }
+    
+    sampleTaskId = scheduler.addTask("sample", sensor->getSampleRateMs(),
+                                     sensorArray ? processArray : processReading);
+    if (config.power.enable_battery_monitoring) {
+        scheduler.addTask("battery", BATTERY_CHECK_INTERVAL_MS, checkBattery);
+    }
+    scheduler.addTask("logger", DataLogger::LOG_INTERVAL_MS, [] { dataLogger->process(); });
+    scheduler.addTask("power", POWER_CHECK_INTERVAL_MS, processPower);
+    if (uplink) {
+        scheduler.addTask("uplink", UPLINK_CHECK_INTERVAL_MS, [] { uplink->process(); });
+    }
+#if LS_ENABLE_PROFILING
+    scheduler.addTask("profile", PROFILE_DUMP_INTERVAL_MS, [] { Profiler::getInstance().dump(); });
+#endif
+    return true;
+}
+
+bool startPipeline(const PipelineConfig& pipeline) {
+    pipelineMutex = xSemaphoreCreateMutex();
+    if (pipelineMutex == nullptr) {
+        return false;
+    }
+    
+    if (xTaskCreatePinnedToCore(processingTaskLoop, "processing", pipeline.processing_stack_size,
+                                nullptr, pipeline.processing_priority, &processingTask,
+                                pipeline.processing_core) != pdPASS) {
+        return false;
+    }
+    
+    if (xTaskCreatePinnedToCore(acquisitionTaskLoop, "acquisition", pipeline.acquisition_stack_size,
+                                nullptr, pipeline.acquisition_priority, &acquisitionTask,
+                                pipeline.acquisition_core) != pdPASS) {
+        vTaskDelete(processingTask);
+        processingTask = nullptr;
+        return false;
+    }
+    
+    return true;
+}
+
+void enqueueReadingBlock(const SensorReading* readings, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!pipelineQueue.push(readings[i])) {
+            pipelineDropCount++;
+        }
+    }
+    xTaskNotifyGive(processingTask);
+}
+
+void acquisitionTaskLoop(void* arg) {
+    // Wait for initializeSystem() to finish with the sensor
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    // Fixed at boot; the live config may be rewritten from another task
+    const SamplingMode sampling_mode = configManager->getConfig().sensor.sampling_mode;
+    TickType_t last_wake = xTaskGetTickCount();
+    
+    while (true) {
+        if (sampling_mode == SamplingMode::POLLED) {
+            SensorReading reading = sensor->read();
+            enqueueReadingBlock(&reading, 1);
+            
+            // Fixed cadence regardless of how long the read took
+            TickType_t period = pdMS_TO_TICKS(sensor->getSampleRateMs());
+            vTaskDelayUntil(&last_wake, period > 0 ? period : 1);
+        } else {
+            // Continuous mode: drain DMA frames, blocks go to enqueueReadingBlock()
+            sensor->process();
+            vTaskDelay(1);
+        }
+    }
+}
+
+void processingTaskLoop(void* arg) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    while (true) {
+        // Wake on new readings, or periodically for logger housekeeping
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        
+        lockPipeline();
+        const SensorReading* run;
+        size_t run_length;
+        while ((run_length = pipelineQueue.peekContiguous(run)) > 0) {
+            handleReadingBlock(run, run_length);
+            pipelineQueue.consume(run_length);
+        }
+        
+        dataLogger->process();
+        unlockPipeline();
+    }
+}
+
+void lockPipeline() {
+    if (pipelineRunning) {
+        xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+    }
+}
+
+void unlockPipeline() {
+    if (pipelineRunning) {
+        xSemaphoreGive(pipelineMutex);
+    }
+}
+
 void processReading() {
     // Read sensor
     SensorReading reading = sensor->read();
     
     if (!reading.is_valid) {
-        logger.warning("Invalid sensor reading");
+        LS_LOG_WARNING("Invalid sensor reading");
         return;
     }
     
+    handleReading(reading);
+}
+
+void processArray() {
+    static SensorReading readings[LightSensorArray::CHANNEL_CAPACITY];
+    
+    if (sensorArray->sweep() == 0) {
+        return;
+    }
+    
+    const SystemConfig& config = configManager->getConfig();
+    int primary = sensorArray->findChannel(config.sensor.adc_pin);
+    
+    for (size_t channel = 0; channel < sensorArray->getChannelCount(); ++channel) {
+        size_t count = sensorArray->getCount(channel);
+        if (count == 0) {
+            continue;
+        }
+        
+        const SignalAnalysis& analysis = sensorArray->getAnalysis(channel);
+        if (config.enable_debug_mode) {
+            LS_LOG_DEBUG("Channel %u (GPIO %u): %.2f lux (filtered: %.2f), Quality: %u",
+                         static_cast<unsigned>(channel), sensorArray->getPin(channel),
+                         sensorArray->getLuxValues(channel)[count - 1], analysis.filtered_value,
+                         analysis.quality_score);
+        }
+        
+        // The channel on adc_pin feeds the data logger and power manager
+        if (static_cast<int>(channel) != primary) {
+            continue;
+        }
+        
+        for (size_t i = 0; i < count; ++i) {
+            readings[i] = sensorArray->getReading(channel, i);
+        }
+        
+        // The analysis is of the last reading, so its events go just before it
+        size_t last = count - 1;
+        dataLogger->logBlock(readings, last);
+        logEvents(readings[last], analysis);
+        dataLogger->logBlock(readings + last, 1);
+        
+        powerManager->updateLightLevel(readings[count - 1].raw_value);
+        adaptSampling(analysis);
+    }
+    
+    powerManager->recordActivity();
+}
+
+void handleReadingBlock(const SensorReading* readings, size_t count) {
+    static SignalAnalysis analyses[MAX_BLOCK_SIZE];
+    
+    // Push each run of valid readings through the pipeline in one call per stage
+    size_t start = 0;
+    while (start < count) {
+        while (start < count && !readings[start].is_valid) {
+            start++;
+        }
+        
+        size_t end = start;
+        while (end < count && end - start < MAX_BLOCK_SIZE && readings[end].is_valid) {
+            end++;
+        }
+        
+        size_t run = end - start;
+        if (run == 0) {
+            break;
+        }
+        
+        signalProcessor->processBlock(readings + start, analyses, run);
+        
+        // Readings before an event go out first, then the event, then its reading,
+        // so events land in order and the event reading is kept whatever the exception mode
+        LightEvent events[EventDetector::MAX_EVENTS];
+        size_t logged = start;
+        for (size_t i = start; i < end; ++i) {
+            size_t event_count = eventDetector->update(readings[i], analyses[i - start], events);
+            if (event_count > 0) {
+                dataLogger->logBlock(readings + logged, i - logged);
+                logged = i;
+                logDetectedEvents(events, event_count, readings[i]);
+            }
+        }
+        dataLogger->logBlock(readings + logged, end - logged);
+        
+        for (size_t i = 0; i < run; ++i) {
+            reportAnalysis(readings[start + i], analyses[i]);
+            adaptSampling(analyses[i]);
+        }
+        
+        start = end;
+    }
+    
+    if (count > 0) {
+        powerManager->updateLightLevel(readings[count - 1].raw_value);
+    }
+    powerManager->recordActivity();
+}
+
+void handleReading(const SensorReading& reading) {
     // Process signal
     SignalAnalysis analysis = signalProcessor->processReading(reading);
     
-    // Log the reading
+    // Log the reading (events first, so it is kept whatever the exception mode)
+    logEvents(reading, analysis);
     dataLogger->logReading(reading);
     
     // Record activity for power management
+    powerManager->updateLightLevel(reading.raw_value);
     powerManager->recordActivity();
     
+    reportAnalysis(reading, analysis);
+    adaptSampling(analysis);
+}
+
+void adaptSampling(const SignalAnalysis& analysis) {
+    if (!adaptiveSampling || !adaptiveSampling->update(analysis)) {
+        return;
+    }
+    
+    uint32_t rate_ms = adaptiveSampling->getSampleRateMs();
+    sensor->setSamplingParameters(rate_ms, adaptiveSampling->getOversampling());
+    signalProcessor->setSampleRate(sensor->getReadingRateHz());  // Spectral bins follow the new rate
+    if (schedulerRunning) {
+        scheduler.setPeriod(sampleTaskId, rate_ms);
+    }
+    
+    LS_LOG_DEBUG("Sampling every %lu ms, oversampling %u",
+                 rate_ms, adaptiveSampling->getOversampling());
+}
+
+size_t logEvents(const SensorReading& reading, const SignalAnalysis& analysis) {
+    LightEvent events[EventDetector::MAX_EVENTS];
+    size_t count = eventDetector->update(reading, analysis, events);
+    logDetectedEvents(events, count, reading);
+    return count;
+}
+
+void logDetectedEvents(const LightEvent* events, size_t count, const SensorReading& reading) {
+    for (size_t i = 0; i < count; ++i) {
+        dataLogger->logEvent(events[i], reading);
+        LS_LOG_DEBUG("Event %s at %.2f lux (%.2f)", EventDetector::typeToString(events[i].type),
+                     events[i].lux, events[i].value);
+    }
+}
+
+void reportAnalysis(const SensorReading& reading, const SignalAnalysis& analysis) {
     // Output reading
-    const SystemConfig& config = configManager->getConfig();
-    if (config.enable_debug_mode) {
-        char msg[128];
-        snprintf(msg, sizeof(msg), 
-                 "Lux: %.2f (filtered: %.2f), Quality: %u, SNR: %.2f",
-                 reading.lux_value, analysis.filtered_value, 
-                 analysis.quality_score, analysis.signal_to_noise_ratio);
-        logger.debug(msg);
+    if (debugMode) {
+        LS_LOG_DEBUG("Lux: %.2f (filtered: %.2f), Quality: %u, SNR: %.2f",
+                     reading.lux_value, analysis.filtered_value, 
+                     analysis.quality_score, analysis.signal_to_noise_ratio);
     }
     
     // Check for trends
     if (analysis.trend_confidence > 0.8f) {
         if (analysis.trend_slope > 0) {
-            logger.debug("Light level increasing");
+            LS_LOG_DEBUG("Light level increasing");
         } else if (analysis.trend_slope < 0) {
-            logger.debug("Light level decreasing");
+            LS_LOG_DEBUG("Light level decreasing");
         }
     }
     
     // Check for outliers
     if (analysis.is_outlier) {
-        logger.warning("Outlier detected in reading");
+        LS_LOG_WARNING("Outlier detected in reading");
+    }
+}
+
+void ingestUlpSamples() {
+    static uint16_t codes[ULP_BUFFER_SIZE];
+    static uint32_t timestamps[ULP_BUFFER_SIZE];
+    static SensorReading readings[ULP_BUFFER_SIZE];
+    
+    UlpSampler& ulp = powerManager->getUlpSampler();
+    size_t count = ulp.collect(codes, timestamps, ULP_BUFFER_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        readings[i] = sensor->convertCode(codes[i], timestamps[i]);
     }
+    
+    dataLogger->logBlock(readings, count);
+    dataLogger->flush();
+    
+    const char* reason = ulp.getWakeReason() == UlpWakeReason::THRESHOLD ? "light change" :
+                         ulp.getWakeReason() == UlpWakeReason::BUFFER_FULL ? "buffer full" : "timer";
+    LS_LOG_INFO("Ingested %u ULP samples from deep sleep (wake: %s)",
+                static_cast<unsigned>(count), reason);
+}
+
+void applyConfig(const SystemConfig& config, const ConfigDiff& diff) {
+    // Task layout, sampling mode, the scheduler and whether a sensor array runs are fixed at boot
+    bool array_toggled = diff.changed("sensor.array_channel_count") &&
+                         (sensorArray != nullptr) != (config.sensor.array_channel_count > 0);
+    if (diff.changed(ConfigSection::PIPELINE) || diff.changed("sensor.sampling_mode") || array_toggled ||
+        diff.changed("power.enable_sleep_scheduler") || diff.changed("logger.enable_async_flush") ||
+        (diff.changed("uplink.enabled") && !uplink)) {
+        LS_LOG_WARNING("Config change takes effect after restart");
+    }
+    
+    if (diff.changed("enable_debug_mode")) {
+        logger.setLevel(config.enable_debug_mode ? LogLevel::DEBUG : LogLevel::INFO);
+        debugMode = config.enable_debug_mode;
+    }
+    
+    if (diff.changed("enable_async_logging")) {
+        if (config.enable_async_logging) {
+            logger.startAsync();
+        } else {
+            logger.stopAsync();
+        }
+    }
+    
+    lockPipeline();
+    if (diff.changed(ConfigSection::POWER)) {
+        powerManager->configure(config.power);
+    }
+    
+    if (diff.changed(ConfigSection::UPLINK) && uplink) {
+        uplink->configure(config.uplink);
+    }
+    unlockPipeline();
+    
+    // The processing task owns the data path while the pipeline runs
+    if (pipelineRunning) {
+        if (diff.changed(ConfigSection::SENSOR) || diff.changed(ConfigSection::LOGGER) ||
+            diff.changed(ConfigSection::SIGNAL)) {
+            LS_LOG_WARNING("Pipeline running: sensor/logger/signal changes need restart");
+        }
+        return;
+    }
+    
+    if (diff.changed(ConfigSection::SENSOR)) {
+        sensor->configure(config.sensor);
+        powerManager->setLightSensorPin(config.sensor.adc_pin);
+        if (sensorArray) {
+            sensorArray->configure(config.sensor);
+        }
+        
+        if (diff.changed("sensor.reference_voltage") || diff.changed("sensor.dark_offset") ||
+            diff.changed("sensor.sensitivity")) {
+            signalProcessor->setCalibration(config.sensor);
+            dataLogger->setCalibration(config.sensor);
+        }
+        signalProcessor->setSampleRate(sensor->getReadingRateHz());
+        
+        // configure() restored the full rate, so the controller starts over
+        bool adaptive = config.sensor.enable_adaptive_sampling &&
+                        config.sensor.sampling_mode == SamplingMode::POLLED;
+        if (adaptive && adaptiveSampling) {
+            adaptiveSampling->configure(config.sensor);
+        } else if (adaptive) {
+            adaptiveSampling = adaptiveSamplingSlot.emplace(config.sensor);
+        } else {
+            adaptiveSamplingSlot.destroy();
+            adaptiveSampling = nullptr;
+        }
+        
+        if (schedulerRunning) {
+            scheduler.setPeriod(sampleTaskId, sensor->getSampleRateMs());
+        }
+    }
+    
+    if (diff.changed(ConfigSection::LOGGER)) {
+        dataLogger->configure(config.logger);
+    }
+    
+    if (diff.changed(ConfigSection::SIGNAL)) {
+        signalProcessor->configure(config.signal);
+        eventDetector->configure(config.signal);
+        if (sensorArray) {
+            sensorArray->configureSignal(config.signal);
+        }
+    }
+    
+    LS_LOG_INFO("Applied %u config changes", diff.count());
+}
+
+void processPower() {
+    // Charge ADC and flash busy time to their subsystems
+    uint32_t adc_us = sensor->getAdcActiveTimeUs() + (sensorArray ? sensorArray->getAdcActiveTimeUs() : 0);
+    powerManager->updateSubsystemTime(PowerSubsystem::ADC, adc_us);
+    powerManager->updateSubsystemTime(PowerSubsystem::FLASH, dataLogger->getStats().storage_write_time_us);
+    if (uplink) {
+        powerManager->updateSubsystemTime(PowerSubsystem::RADIO, uplink->getRadioActiveTimeUs());
+    }
+    powerManager->process();
 }
 
 void checkBattery() {
@@ -212,12 +807,23 @@ void checkBattery() {
     powerManager->updateBatteryVoltage(voltage);
     
     if (powerManager->isBatteryCritical()) {
-        char msg[48];
-        snprintf(msg, sizeof(msg), "CRITICAL: Battery at %.2fV!", voltage);
-        logger.critical(msg);
+        LS_LOG_CRITICAL("CRITICAL: Battery at %.2fV!", voltage);
     } else if (powerManager->isBatteryLow()) {
-        char msg[48];
-        snprintf(msg, sizeof(msg), "Low battery: %.2fV", voltage);
-        logger.warning(msg);
+        LS_LOG_WARNING("Low battery: %.2fV", voltage);
+    }
+    
+    if (configManager->getConfig().enable_debug_mode) {
+        PowerStats stats = powerManager->getPowerStats();
+        LS_LOG_DEBUG("Energy: %.3f mAh (cpu %.3f/%.3f, sleep %.3f, ulp %.3f, adc %.3f, flash %.3f, radio %.3f), "
+                     "avg %.2f mA, %.0f h left",
+                     stats.total_mah,
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::CPU_240MHZ)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::CPU_80MHZ)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::SLEEP)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::ULP)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::ADC)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::FLASH)],
+                     stats.subsystem_mah[static_cast<size_t>(PowerSubsystem::RADIO)],
+                     stats.average_current_ma, stats.projected_runtime_hours);
     }
 }
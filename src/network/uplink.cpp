@@ -0,0 +1,404 @@
+#include "uplink.h"
+#include "log_clock.h"
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <PubSubClient.h>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace LightSensor {
+
+static const uint32_t UPLINK_STATE_MAGIC = 0x4355534C;   // "LSUC"
+static const size_t SEND_CHUNK_SIZE = 1024;
+static const uint32_t WIFI_POLL_MS = 50;
+
+/**
+ * @brief Delivery cursor persisted in Uplink::UPLINK_STATE_PATH
+ */
+struct UplinkState {
+    uint32_t magic;
+    uint32_t last_sequence;
+};
+
+// Window index of the last batch attempt; survives deep sleep so a wake
+// inside the same window does not bring the radio up again
+static RTC_DATA_ATTR uint64_t s_last_window = 0;
+
+/**
+ * @brief Reads a batch (header, entry table, segment files) as one Stream
+ *
+ * The transport pulls bytes straight from the segment files into its own
+ * send buffer; nothing is decoded or staged in RAM.
+ */
+class BatchStream : public Stream {
+public:
+    BatchStream(const uint8_t* prefix, size_t prefix_length, const UplinkSegmentEntry* entries,
+                size_t entry_count, const DataLogger& logger)
+        : prefix_(prefix), prefix_length_(prefix_length), prefix_position_(0),
+          entries_(entries), entry_count_(entry_count), next_entry_(0), logger_(logger),
+          remaining_(prefix_length) {
+        for (size_t i = 0; i < entry_count; ++i) {
+            remaining_ += entries[i].length;
+        }
+    }
+
+    ~BatchStream() override {
+        file_.close();
+    }
+
+    int available() override {
+        return static_cast<int>(remaining_);
+    }
+
+    int read() override {
+        uint8_t value;
+        return readBytes(reinterpret_cast<char*>(&value), 1) == 1 ? value : -1;
+    }
+
+    int peek() override {
+        if (prefix_position_ < prefix_length_) {
+            return prefix_[prefix_position_];
+        }
+        return file_ ? file_.peek() : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t total = 0;
+        while (total < length && remaining_ > 0) {
+            size_t count = 0;
+            if (prefix_position_ < prefix_length_) {
+                count = std::min(length - total, prefix_length_ - prefix_position_);
+                memcpy(buffer + total, prefix_ + prefix_position_, count);
+                prefix_position_ += count;
+            } else if (file_ || openNext()) {
+                count = file_.read(reinterpret_cast<uint8_t*>(buffer + total), length - total);
+                if (count == 0) {
+                    file_.close();
+                    continue;
+                }
+            } else {
+                break;  // A segment went missing after it was measured
+            }
+            total += count;
+            remaining_ -= count;
+        }
+        return total;
+    }
+
+    size_t write(uint8_t) override {
+        return 0;
+    }
+
+private:
+    const uint8_t* prefix_;
+    size_t prefix_length_;
+    size_t prefix_position_;
+    const UplinkSegmentEntry* entries_;
+    size_t entry_count_;
+    size_t next_entry_;
+    const DataLogger& logger_;
+    size_t remaining_;
+    File file_;
+
+    bool openNext() {
+        if (next_entry_ >= entry_count_) {
+            return false;
+        }
+        file_ = logger_.openSegment(entries_[next_entry_++].sequence);
+        return static_cast<bool>(file_);
+    }
+};
+
+Uplink::Uplink(const UplinkConfig& config, const char* device_id, DataLogger& logger, PowerManager& power)
+    : config_(config), pending_config_(config), has_pending_config_(false),
+      logger_(logger), power_(power), cursor_(0), batch_count_(0), busy_(false), task_(nullptr),
+      batches_sent_(0), segments_sent_(0), bytes_sent_(0), failed_batches_(0),
+      skipped_windows_(0), radio_active_us_(0) {
+    strncpy(device_id_, device_id ? device_id : "", sizeof(device_id_) - 1);
+    device_id_[sizeof(device_id_) - 1] = '\0';
+}
+
+Uplink::~Uplink() {
+    if (task_) {
+        // Let an upload in flight finish and hand the radio back
+        while (busy_.load()) {
+            vTaskDelay(1);
+        }
+        vTaskDelete(task_);
+        task_ = nullptr;
+    }
+}
+
+bool Uplink::initialize() {
+    if (task_) {
+        return true;
+    }
+
+    loadCursor();
+
+    // WiFi runs on core 0; keep the send work next to it
+    BaseType_t core = portNUM_PROCESSORS > 1 ? 0 : tskNO_AFFINITY;
+    if (xTaskCreatePinnedToCore(taskEntry, "uplink", TASK_STACK_SIZE, this, TASK_PRIORITY,
+                                &task_, core) != pdPASS) {
+        task_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Uplink::process() {
+    if (!task_ || busy_.load()) {
+        return;
+    }
+
+    if (has_pending_config_) {
+        config_ = pending_config_;
+        has_pending_config_ = false;
+    }
+
+    if (!config_.enabled || config_.batch_interval_ms == 0) {
+        return;
+    }
+
+    uint64_t window = LogClock::getInstance().nowMs() / config_.batch_interval_ms;
+    if (window == s_last_window) {
+        return;
+    }
+    s_last_window = window;
+
+    SegmentSummary segments[MAX_BATCH_SEGMENTS];
+    size_t count = logger_.getSealedSegments(cursor_.load(), segments, MAX_BATCH_SEGMENTS);
+    if (count == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        batch_[i].sequence = segments[i].sequence;
+        batch_[i].length = 0;
+    }
+    batch_count_ = count;
+
+    busy_.store(true);
+    xTaskNotifyGive(task_);
+}
+
+void Uplink::configure(const UplinkConfig& config) {
+    // The task reads config_ while a batch is in flight
+    pending_config_ = config;
+    has_pending_config_ = true;
+}
+
+bool Uplink::isBusy() const {
+    return busy_.load();
+}
+
+UplinkStats Uplink::getStats() const {
+    UplinkStats stats;
+    stats.batches_sent = batches_sent_.load();
+    stats.segments_sent = segments_sent_.load();
+    stats.bytes_sent = bytes_sent_.load();
+    stats.failed_batches = failed_batches_.load();
+    stats.skipped_windows = skipped_windows_.load();
+    stats.last_sent_sequence = cursor_.load();
+    stats.radio_active_time_us = radio_active_us_.load();
+    return stats;
+}
+
+uint32_t Uplink::getRadioActiveTimeUs() const {
+    return radio_active_us_.load();
+}
+
+void Uplink::sendBatch() {
+    size_t length = measureBatch();
+    if (batch_count_ == 0) {
+        return;
+    }
+
+    // Small windows wait for more data rather than paying for a connection
+    if (length < config_.min_batch_bytes || !power_.acquireRadio()) {
+        skipped_windows_++;
+        return;
+    }
+
+    uint8_t prefix[sizeof(UplinkBatchHeader) + MAX_BATCH_SEGMENTS * sizeof(UplinkSegmentEntry)];
+    UplinkBatchHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = UPLINK_BATCH_MAGIC;
+    header.version = UPLINK_BATCH_VERSION;
+    header.segment_count = static_cast<uint16_t>(batch_count_);
+    memcpy(header.device_id, device_id_, sizeof(header.device_id));
+    memcpy(prefix, &header, sizeof(header));
+    memcpy(prefix + sizeof(header), batch_, batch_count_ * sizeof(UplinkSegmentEntry));
+    size_t prefix_length = sizeof(header) + batch_count_ * sizeof(UplinkSegmentEntry);
+
+    uint32_t start_us = micros();
+    bool ok = connectWifi();
+    if (ok) {
+        BatchStream stream(prefix, prefix_length, batch_, batch_count_, logger_);
+        ok = config_.transport == UplinkTransport::MQTT ?
+             publishMqtt(stream, prefix_length + length) : postHttp(stream, prefix_length + length);
+    }
+    disconnectWifi();
+    radio_active_us_ += micros() - start_us;
+    power_.releaseRadio();
+
+    if (!ok) {
+        failed_batches_++;
+        return;
+    }
+
+    uint32_t last_sequence = batch_[batch_count_ - 1].sequence;
+    saveCursor(last_sequence);
+    cursor_.store(last_sequence);
+    batches_sent_++;
+    segments_sent_ += batch_count_;
+    bytes_sent_ += prefix_length + length;
+}
+
+size_t Uplink::measureBatch() {
+    // Keep the oldest segments that fit in one batch (always at least one)
+    size_t total = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < batch_count_; ++i) {
+        File file = logger_.openSegment(batch_[i].sequence);
+        if (!file) {
+            continue;  // Deleted by retention since it was listed
+        }
+        size_t size = file.size();
+        file.close();
+
+        if (kept > 0 && total + size > config_.max_batch_bytes) {
+            break;
+        }
+        batch_[kept].sequence = batch_[i].sequence;
+        batch_[kept].length = static_cast<uint32_t>(size);
+        kept++;
+        total += size;
+    }
+    batch_count_ = kept;
+    return total;
+}
+
+bool Uplink::connectWifi() {
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(config_.wifi_ssid, config_.wifi_password);
+
+    uint32_t start_ms = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start_ms >= config_.connect_timeout_ms) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WIFI_POLL_MS));
+    }
+    return true;
+}
+
+void Uplink::disconnectWifi() {
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+}
+
+bool Uplink::postHttp(BatchStream& stream, size_t length) {
+    WiFiClient client;
+    HTTPClient http;
+    http.setConnectTimeout(static_cast<int32_t>(config_.connect_timeout_ms));
+    if (!http.begin(client, config_.host, config_.port, config_.path)) {
+        return false;
+    }
+
+    http.addHeader("Content-Type", "application/octet-stream");
+    int status = http.sendRequest("POST", &stream, length);
+    http.end();
+    return status >= 200 && status < 300;
+}
+
+bool Uplink::publishMqtt(BatchStream& stream, size_t length) {
+    WiFiClient client;
+    PubSubClient mqtt(client);
+    mqtt.setServer(config_.host, config_.port);
+    if (!mqtt.connect(device_id_)) {
+        return false;
+    }
+
+    // beginPublish() streams the payload, so it is not limited by the client buffer
+    bool ok = mqtt.beginPublish(config_.path, static_cast<unsigned int>(length), false);
+    char chunk[SEND_CHUNK_SIZE];
+    size_t sent = 0;
+    while (ok && sent < length) {
+        size_t count = stream.readBytes(chunk, sizeof(chunk));
+        if (count == 0) {
+            break;
+        }
+        ok = mqtt.write(reinterpret_cast<const uint8_t*>(chunk), count) == count;
+        sent += count;
+    }
+    ok = mqtt.endPublish() && ok && sent == length;
+    mqtt.disconnect();
+    return ok;
+}
+
+bool Uplink::loadCursor() {
+    char path[32];
+    snprintf(path, sizeof(path), "%s", UPLINK_STATE_PATH);
+
+    // A reset between remove and rename in saveCursor() leaves only the new copy
+    if (!SPIFFS.exists(path)) {
+        snprintf(path, sizeof(path), "%s.tmp", UPLINK_STATE_PATH);
+    }
+
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    UplinkState state;
+    bool ok = file.read(reinterpret_cast<uint8_t*>(&state), sizeof(state)) == sizeof(state) &&
+              state.magic == UPLINK_STATE_MAGIC;
+    file.close();
+
+    if (ok) {
+        cursor_.store(state.last_sequence);
+    }
+    return ok;
+}
+
+bool Uplink::saveCursor(uint32_t sequence) {
+    char temp_path[32];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", UPLINK_STATE_PATH);
+
+    // Replace the old cursor only once the new one is complete
+    UplinkState state = {UPLINK_STATE_MAGIC, sequence};
+    File file = SPIFFS.open(temp_path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&state), sizeof(state)) == sizeof(state);
+    file.close();
+
+    if (!ok) {
+        SPIFFS.remove(temp_path);
+        return false;
+    }
+
+    SPIFFS.remove(UPLINK_STATE_PATH);
+    return SPIFFS.rename(temp_path, UPLINK_STATE_PATH);
+}
+
+void Uplink::taskLoop() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (busy_.load()) {
+            sendBatch();
+            busy_.store(false);
+        }
+    }
+}
+
+void Uplink::taskEntry(void* arg) {
+    static_cast<Uplink*>(arg)->taskLoop();
+}
+
+}  // namespace LightSensor
@@ -3,17 +3,64 @@
 #include <esp_sleep.h>
 #include <esp_wifi.h>
 #include <driver/adc.h>
+#include <sys/time.h>
 #include <algorithm>
 
 namespace LightSensor {
 
+// Typical currents (uA) from the ESP32 datasheet and common SPI flash parts
+static const uint32_t CPU_240MHZ_CURRENT_UA = 80000;   // WiFi off
+static const uint32_t CPU_80MHZ_CURRENT_UA = 20000;
+static const uint32_t LIGHT_SLEEP_CURRENT_UA = 800;
+static const uint32_t DEEP_SLEEP_CURRENT_UA = 10;
+static const uint32_t ULP_CURRENT_UA = 150;            // ULP timer + ADC, duty-cycled
+static const uint32_t ADC_CURRENT_UA = 1500;           // SAR ADC while converting
+static const uint32_t FLASH_WRITE_CURRENT_UA = 20000;  // Program / erase
+static const uint32_t RADIO_CURRENT_UA = 100000;       // WiFi associated, mixed TX/RX
+
+// 1 mAh expressed in the accounting unit (uA * us)
+static const float CHARGE_PER_MAH = 3.6e12f;
+
+static const uint32_t ENERGY_STATE_MAGIC = 0x45535441;  // "ESTA"
+
+/**
+ * @brief Accounting state carried across deep sleep in RTC memory
+ */
+struct RtcEnergyState {
+    uint32_t magic;
+    uint32_t wake_count;
+    float peak_current_ma;
+    bool ulp_running;
+    int64_t sleep_start_us;
+    uint64_t mode_time_ms[POWER_MODE_COUNT];
+    uint64_t subsystem_charge[POWER_SUBSYSTEM_COUNT];
+};
+
+static RTC_DATA_ATTR RtcEnergyState s_rtc_energy;
+
+// RTC-backed wall clock; keeps counting through deep sleep
+static int64_t rtcTimeUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000LL + tv.tv_usec;
+}
+
 PowerManager::PowerManager(const PowerConfig& config)
     : config_(config), current_mode_(PowerMode::ACTIVE), 
-      wake_on_light_enabled_(false), last_light_level_(0.0f),
+      wake_on_light_enabled_(config.enable_wake_on_light), last_light_level_(0.0f),
+      light_sensor_pin_(34), radio_leases_(0), last_account_ms_(0), cpu_freq_mhz_(getCpuFrequencyMhz()),
       last_activity_time_ms_(0), sleep_start_time_ms_(0) {
     
     // Initialize power statistics
-    stats_ = {0, 0, 0, 0.0f, 0.0f, 0.0f, 100};
+    stats_ = {0, 0, 0, 0.0f, 0.0f, 0.0f, 100, {0}, {0.0f}, 0.0f, 0.0f};
+    
+    for (size_t i = 0; i < POWER_MODE_COUNT; ++i) {
+        mode_time_ms_[i] = 0;
+    }
+    for (size_t i = 0; i < POWER_SUBSYSTEM_COUNT; ++i) {
+        subsystem_charge_[i] = 0;
+        last_subsystem_us_[i] = 0;
+    }
 }
 
 bool PowerManager::initialize() {
@@ -22,9 +69,11 @@ bool PowerManager::initialize() {
     // Check wake reason
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     if (wakeup_reason != ESP_SLEEP_WAKEUP_UNDEFINED) {
+        restoreEnergyState();
         stats_.wake_count++;
     }
     
+    updatePowerStats();
     return true;
 }
 
@@ -33,6 +82,7 @@ void PowerManager::setPowerMode(PowerMode mode) {
         return;
     }
     
+    accountElapsed();
     current_mode_ = mode;
     configureHardwareForMode(mode);
     
@@ -65,18 +115,63 @@ void PowerManager::sleep(uint32_t duration_ms, WakeSource wake_source) {
     }
     
     // Enter light sleep (maintains RAM, faster wake)
+    accountElapsed();
     esp_light_sleep_start();
+    accountSleep(PowerMode::SLEEP, millis() - sleep_start_time_ms_, false);
     
     // Execution resumes here after wake-up
     wakeUp(wake_source);
 }
 
+void PowerManager::idle(uint32_t duration_ms) {
+    if (duration_ms == 0) {
+        return;
+    }
+    
+    // Light sleep would drop the WiFi association mid-transfer
+    if (!config_.enable_sleep_scheduler || duration_ms < config_.min_light_sleep_ms || isRadioActive()) {
+        delay(duration_ms);
+        return;
+    }
+    
+    // The UART clock stops in light sleep; let pending output drain first
+    Serial.flush();
+    
+    accountElapsed();
+    uint32_t start_ms = millis();
+    esp_sleep_enable_timer_wakeup(duration_ms * 1000ULL);
+    esp_light_sleep_start();
+    
+    accountSleep(PowerMode::SLEEP, millis() - start_ms, false);
+}
+
 void PowerManager::deepSleep(uint32_t duration_ms) {
     setPowerMode(PowerMode::DEEP_SLEEP);
     sleep_start_time_ms_ = millis();
     
-    // Configure timer wake-up
-    esp_sleep_enable_timer_wakeup(duration_ms * 1000ULL);
+    // Keep sampling on the ULP; it wakes us on a light change or a full buffer
+    bool ulp_running = false;
+    if (isUlpSamplingEnabled()) {
+        const float full_scale = 4095.0f;
+        float level = std::min(1.0f, std::max(0.0f, last_light_level_));
+        bool threshold_wake = wake_on_light_enabled_ && config_.enable_wake_on_light;
+        uint16_t baseline = static_cast<uint16_t>(level * full_scale);
+        uint16_t band = threshold_wake ? static_cast<uint16_t>(config_.light_threshold * full_scale) : 4096;
+        
+        ulp_running = ulp_sampler_.start(light_sensor_pin_, config_.ulp_sample_period_ms, baseline, band);
+        if (ulp_running) {
+            esp_sleep_enable_ulp_wakeup();
+        }
+    }
+    
+    // Configure timer wake-up (without the ULP, always set one)
+    if (duration_ms > 0 || !ulp_running) {
+        esp_sleep_enable_timer_wakeup((duration_ms > 0 ? duration_ms : config_.deep_sleep_timeout_ms) * 1000ULL);
+    }
+    
+    // RAM is lost; carry the energy totals over in RTC memory
+    accountElapsed();
+    saveEnergyState(ulp_running);
     
     // Enter deep sleep (RAM lost, slower wake but lowest power)
     esp_deep_sleep_start();
@@ -109,8 +204,10 @@ void PowerManager::optimizePowerConsumption() {
         } else if (current_mode_ == PowerMode::LOW_POWER) {
             uint32_t time_since_activity = millis() - last_activity_time_ms_;
             
-            if (time_since_activity > config_.deep_sleep_timeout_ms) {
-                setPowerMode(PowerMode::DEEP_SLEEP);
+            // An upload in progress finishes before the deep sleep. The ULP keeps
+            // watching the light level while asleep, otherwise the timer wakes us
+            if (time_since_activity > config_.deep_sleep_timeout_ms && !isRadioActive()) {
+                deepSleep(0);
             }
         }
     }
@@ -120,6 +217,45 @@ PowerStats PowerManager::getPowerStats() const {
     return stats_;
 }
 
+void PowerManager::updateSubsystemTime(PowerSubsystem subsystem, uint32_t total_active_us) {
+    size_t index = static_cast<size_t>(subsystem);
+    uint32_t delta_us = total_active_us - last_subsystem_us_[index];
+    last_subsystem_us_[index] = total_active_us;
+    
+    switch (subsystem) {
+        case PowerSubsystem::ADC:
+            chargeSubsystem(subsystem, ADC_CURRENT_UA, delta_us);
+            break;
+        case PowerSubsystem::FLASH:
+            chargeSubsystem(subsystem, FLASH_WRITE_CURRENT_UA, delta_us);
+            break;
+        case PowerSubsystem::RADIO:
+            chargeSubsystem(subsystem, RADIO_CURRENT_UA, delta_us);
+            break;
+        default:
+            break;  // CPU, sleep and ULP are charged from mode residency
+    }
+}
+
+bool PowerManager::acquireRadio() {
+    if (isBatteryCritical()) {
+        return false;
+    }
+    
+    radio_leases_++;
+    return true;
+}
+
+void PowerManager::releaseRadio() {
+    if (radio_leases_.load() > 0) {
+        radio_leases_--;
+    }
+}
+
+bool PowerManager::isRadioActive() const {
+    return radio_leases_.load() > 0;
+}
+
 void PowerManager::setPowerEventCallback(PowerEventCallback callback) {
     event_callback_ = callback;
 }
@@ -151,11 +287,36 @@ bool PowerManager::isBatteryCritical() const {
            stats_.battery_voltage < config_.critical_battery_threshold;
 }
 
+void PowerManager::configure(const PowerConfig& config) {
+    // Charge the time so far under the old settings
+    accountElapsed();
+    
+    bool peripherals_changed = config.disable_unused_peripherals != config_.disable_unused_peripherals;
+    config_ = config;
+    wake_on_light_enabled_ = config.enable_wake_on_light;
+    
+    if (peripherals_changed) {
+        configureHardwareForMode(current_mode_);
+    }
+}
+
 void PowerManager::setWakeOnLight(bool enable, float threshold) {
     wake_on_light_enabled_ = enable;
     config_.light_threshold = threshold;
 }
 
+void PowerManager::updateLightLevel(float raw_value) {
+    last_light_level_ = raw_value;
+}
+
+void PowerManager::setLightSensorPin(uint8_t adc_pin) {
+    light_sensor_pin_ = adc_pin;
+}
+
+UlpSampler& PowerManager::getUlpSampler() {
+    return ulp_sampler_;
+}
+
 void PowerManager::recordActivity() {
     last_activity_time_ms_ = millis();
 }
@@ -198,19 +359,30 @@ void PowerManager::configureHardwareForMode(PowerMode mode) {
         case PowerMode::DEEP_SLEEP:
             // Deep sleep preparation - disable everything possible
             disableUnusedPeripherals();
-            adc_power_off();
+            if (!isUlpSamplingEnabled()) {
+                adc_power_off();  // The ULP needs the ADC while asleep
+            }
             break;
     }
 }
 
 void PowerManager::setCpuFrequency(uint32_t freq_mhz) {
+    if (freq_mhz == cpu_freq_mhz_) {
+        return;
+    }
+    
+    // Close the interval at the old clock before switching
+    accountElapsed();
     setCpuFrequencyMhz(freq_mhz);
+    cpu_freq_mhz_ = getCpuFrequencyMhz();
 }
 
 void PowerManager::disableUnusedPeripherals() {
     if (config_.disable_unused_peripherals) {
-        // Disable WiFi if not needed
-        esp_wifi_stop();
+        // Disable WiFi if not needed (the uplink turns it off itself when done)
+        if (!isRadioActive()) {
+            esp_wifi_stop();
+        }
         
         // Disable Bluetooth if not needed
         // btStop();  // Uncomment if using Bluetooth
@@ -222,37 +394,125 @@ void PowerManager::enableEssentialPeripherals() {
 }
 
 void PowerManager::updatePowerStats() {
-    uint32_t current_time_ms = millis();
+    accountElapsed();
     
-    // Update active/sleep time based on current mode
-    if (current_mode_ == PowerMode::ACTIVE || current_mode_ == PowerMode::LOW_POWER) {
-        stats_.total_active_time_ms = current_time_ms;
-    } else {
-        stats_.total_sleep_time_ms = current_time_ms;
+    uint64_t total_ms = 0;
+    for (size_t i = 0; i < POWER_MODE_COUNT; ++i) {
+        stats_.mode_time_ms[i] = static_cast<uint32_t>(mode_time_ms_[i]);
+        total_ms += mode_time_ms_[i];
+    }
+    stats_.total_active_time_ms = static_cast<uint32_t>(
+        mode_time_ms_[static_cast<size_t>(PowerMode::ACTIVE)] +
+        mode_time_ms_[static_cast<size_t>(PowerMode::LOW_POWER)]);
+    stats_.total_sleep_time_ms = static_cast<uint32_t>(
+        mode_time_ms_[static_cast<size_t>(PowerMode::SLEEP)] +
+        mode_time_ms_[static_cast<size_t>(PowerMode::DEEP_SLEEP)]);
+    
+    uint64_t total_charge = 0;
+    for (size_t i = 0; i < POWER_SUBSYSTEM_COUNT; ++i) {
+        stats_.subsystem_mah[i] = static_cast<float>(subsystem_charge_[i]) / CHARGE_PER_MAH;
+        total_charge += subsystem_charge_[i];
     }
+    stats_.total_mah = static_cast<float>(total_charge) / CHARGE_PER_MAH;
     
-    // Update current consumption estimate
-    stats_.average_current_ma = calculateCurrentConsumption();
+    // uA*us over ms -> mA
+    if (total_ms > 0) {
+        stats_.average_current_ma = static_cast<float>(total_charge / total_ms) / 1.0e6f;
+    }
     
-    if (stats_.average_current_ma > stats_.peak_current_ma) {
-        stats_.peak_current_ma = stats_.average_current_ma;
+    float current_ma = calculateCurrentConsumption();
+    if (current_ma > stats_.peak_current_ma) {
+        stats_.peak_current_ma = current_ma;
     }
+    
+    // Project from the measured battery level when we have one
+    float remaining_mah = config_.battery_capacity_mah - stats_.total_mah;
+    if (config_.enable_battery_monitoring && stats_.battery_voltage > 0.0f) {
+        remaining_mah = config_.battery_capacity_mah * stats_.battery_percentage / 100.0f;
+    }
+    stats_.projected_runtime_hours = stats_.average_current_ma > 0.0f ?
+        std::max(0.0f, remaining_mah) / stats_.average_current_ma : 0.0f;
 }
 
 float PowerManager::calculateCurrentConsumption() const {
-    // ESP32 typical current consumption by mode
-    switch (current_mode_) {
-        case PowerMode::ACTIVE:
-            return 80.0f;   // ~80mA at 240MHz with WiFi off
-        case PowerMode::LOW_POWER:
-            return 20.0f;   // ~20mA at 80MHz
-        case PowerMode::SLEEP:
-            return 0.8f;    // ~0.8mA in light sleep
-        case PowerMode::DEEP_SLEEP:
-            return 0.01f;   // ~10uA in deep sleep
-        default:
-            return 0.0f;
+    // Current while awake follows the CPU clock
+    uint32_t current_ua = cpu_freq_mhz_ >= 160 ? CPU_240MHZ_CURRENT_UA : CPU_80MHZ_CURRENT_UA;
+    return current_ua / 1000.0f;
+}
+
+void PowerManager::accountElapsed() {
+    uint32_t now = millis();
+    uint32_t elapsed_ms = now - last_account_ms_;
+    last_account_ms_ = now;
+    
+    mode_time_ms_[static_cast<size_t>(current_mode_)] += elapsed_ms;
+    if (cpu_freq_mhz_ >= 160) {
+        chargeSubsystem(PowerSubsystem::CPU_240MHZ, CPU_240MHZ_CURRENT_UA, elapsed_ms * 1000ULL);
+    } else {
+        chargeSubsystem(PowerSubsystem::CPU_80MHZ, CPU_80MHZ_CURRENT_UA, elapsed_ms * 1000ULL);
+    }
+}
+
+void PowerManager::accountSleep(PowerMode mode, uint32_t duration_ms, bool ulp_running) {
+    mode_time_ms_[static_cast<size_t>(mode)] += duration_ms;
+    
+    uint32_t sleep_ua = mode == PowerMode::DEEP_SLEEP ? DEEP_SLEEP_CURRENT_UA : LIGHT_SLEEP_CURRENT_UA;
+    chargeSubsystem(PowerSubsystem::SLEEP, sleep_ua, duration_ms * 1000ULL);
+    if (ulp_running) {
+        chargeSubsystem(PowerSubsystem::ULP, ULP_CURRENT_UA, duration_ms * 1000ULL);
+    }
+    
+    // millis() kept running through light sleep; don't count it again as awake
+    last_account_ms_ = millis();
+}
+
+void PowerManager::chargeSubsystem(PowerSubsystem subsystem, uint32_t current_ua, uint64_t duration_us) {
+    subsystem_charge_[static_cast<size_t>(subsystem)] += static_cast<uint64_t>(current_ua) * duration_us;
+}
+
+void PowerManager::saveEnergyState(bool ulp_running) {
+    s_rtc_energy.magic = ENERGY_STATE_MAGIC;
+    s_rtc_energy.wake_count = stats_.wake_count;
+    s_rtc_energy.peak_current_ma = stats_.peak_current_ma;
+    s_rtc_energy.ulp_running = ulp_running;
+    s_rtc_energy.sleep_start_us = rtcTimeUs();
+    
+    for (size_t i = 0; i < POWER_MODE_COUNT; ++i) {
+        s_rtc_energy.mode_time_ms[i] = mode_time_ms_[i];
     }
+    for (size_t i = 0; i < POWER_SUBSYSTEM_COUNT; ++i) {
+        s_rtc_energy.subsystem_charge[i] = subsystem_charge_[i];
+    }
+}
+
+void PowerManager::restoreEnergyState() {
+    if (s_rtc_energy.magic != ENERGY_STATE_MAGIC) {
+        return;
+    }
+    s_rtc_energy.magic = 0;  // Use once; a later reset must not replay it
+    
+    stats_.wake_count = s_rtc_energy.wake_count;
+    stats_.peak_current_ma = s_rtc_energy.peak_current_ma;
+    for (size_t i = 0; i < POWER_MODE_COUNT; ++i) {
+        mode_time_ms_[i] = s_rtc_energy.mode_time_ms[i];
+    }
+    for (size_t i = 0; i < POWER_SUBSYSTEM_COUNT; ++i) {
+        subsystem_charge_[i] = s_rtc_energy.subsystem_charge[i];
+    }
+    
+    // Time since boot is charged as awake by the next accountElapsed()
+    int64_t asleep_us = rtcTimeUs() - s_rtc_energy.sleep_start_us - static_cast<int64_t>(millis()) * 1000LL;
+    if (asleep_us > 0) {
+        mode_time_ms_[static_cast<size_t>(PowerMode::DEEP_SLEEP)] += static_cast<uint64_t>(asleep_us / 1000);
+        chargeSubsystem(PowerSubsystem::SLEEP, DEEP_SLEEP_CURRENT_UA, static_cast<uint64_t>(asleep_us));
+        if (s_rtc_energy.ulp_running) {
+            chargeSubsystem(PowerSubsystem::ULP, ULP_CURRENT_UA, static_cast<uint64_t>(asleep_us));
+        }
+    }
+}
+
+bool PowerManager::isUlpSamplingEnabled() const {
+    return config_.enable_ulp_sampling && UlpSampler::isSupported();
 }
 
 }  // namespace LightSensor
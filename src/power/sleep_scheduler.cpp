@@ -0,0 +1,104 @@
+#include "sleep_scheduler.h"
+#include <Arduino.h>
+
+namespace LightSensor {
+
+// Wrap-safe "now is at or after deadline" on the millis() timeline
+static bool reached(uint32_t now, uint32_t deadline) {
+    return static_cast<int32_t>(now - deadline) >= 0;
+}
+
+SleepScheduler::SleepScheduler() : task_count_(0) {
+    for (size_t i = 0; i < MAX_TASKS; ++i) {
+        tasks_[i] = {nullptr, 0, 0, nullptr, false};
+    }
+}
+
+int SleepScheduler::addTask(const char* name, uint32_t period_ms, ScheduledTask task) {
+    if (task_count_ >= MAX_TASKS || task == nullptr || period_ms == 0) {
+        return -1;
+    }
+
+    tasks_[task_count_] = {name, period_ms, millis(), task, true};
+    return static_cast<int>(task_count_++);
+}
+
+void SleepScheduler::setPeriod(int id, uint32_t period_ms) {
+    if (!isValid(id) || period_ms == 0) {
+        return;
+    }
+
+    // Rebase the pending deadline on the last run so a shorter period
+    // takes effect now rather than after the old one expires
+    Task& task = tasks_[id];
+    task.next_due_ms = task.next_due_ms - task.period_ms + period_ms;
+    task.period_ms = period_ms;
+}
+
+void SleepScheduler::setEnabled(int id, bool enabled) {
+    if (!isValid(id)) {
+        return;
+    }
+
+    if (enabled && !tasks_[id].enabled) {
+        tasks_[id].next_due_ms = millis();
+    }
+    tasks_[id].enabled = enabled;
+}
+
+size_t SleepScheduler::runDue() {
+    size_t run_count = 0;
+
+    for (size_t i = 0; i < task_count_; ++i) {
+        Task& task = tasks_[i];
+        uint32_t now = millis();
+        if (!task.enabled || !reached(now, task.next_due_ms)) {
+            continue;
+        }
+
+        // Keep the cadence fixed; after a long stall restart from now
+        // rather than running a burst of missed periods
+        task.next_due_ms += task.period_ms;
+        if (reached(now, task.next_due_ms)) {
+            task.next_due_ms = now + task.period_ms;
+        }
+
+        task.run();
+        run_count++;
+    }
+
+    return run_count;
+}
+
+uint32_t SleepScheduler::getTimeUntilNextMs() const {
+    uint32_t now = millis();
+    uint32_t nearest = NO_DEADLINE;
+
+    for (size_t i = 0; i < task_count_; ++i) {
+        const Task& task = tasks_[i];
+        if (!task.enabled) {
+            continue;
+        }
+
+        if (reached(now, task.next_due_ms)) {
+            return 0;
+        }
+
+        uint32_t remaining = task.next_due_ms - now;
+        if (remaining < nearest) {
+            nearest = remaining;
+        }
+    }
+
+    return nearest;
+}
+
+size_t SleepScheduler::getTaskCount() const {
+    return task_count_;
+}
+
+bool SleepScheduler::isValid(int id) const {
+    return id >= 0 && static_cast<size_t>(id) < task_count_;
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,204 @@
+#include "ulp_sampler.h"
+#include <Arduino.h>
+#include <esp_sleep.h>
+
+#if CONFIG_IDF_TARGET_ESP32 && CONFIG_ESP32_ULP_COPROC_ENABLED
+#define ULP_SAMPLER_SUPPORTED 1
+#include <esp32/ulp.h>
+#include <driver/adc.h>
+#include <soc/rtc_cntl_reg.h>
+#include <soc/soc.h>
+#else
+#define ULP_SAMPLER_SUPPORTED 0
+#endif
+
+namespace LightSensor {
+
+// Survive deep sleep; cleared on power-on
+static RTC_DATA_ATTR bool s_armed = false;
+static RTC_DATA_ATTR uint32_t s_sleep_start_ms = 0;
+static RTC_DATA_ATTR uint32_t s_period_ms = 0;
+
+#if ULP_SAMPLER_SUPPORTED
+
+// RTC slow memory layout, in 32-bit words (the ULP only uses the low 16 bits)
+enum : uint32_t {
+    VAR_COUNT = 0,          // Samples stored in the buffer
+    VAR_LAST = 1,           // Most recent sample
+    VAR_REASON = 2,         // UlpWakeReason of the last wake
+    BUFFER_START = 4,
+    PROGRAM_START = BUFFER_START + ULP_BUFFER_SIZE
+};
+
+static const uint32_t RESERVED_WORDS = CONFIG_ESP32_ULP_COPROC_RESERVE_MEM / sizeof(uint32_t);
+static const uint16_t ULP_ADC_MAX_CODE = 4095;
+
+enum {
+    LBL_FULL,
+    LBL_THRESHOLD,
+    LBL_WAKE,
+    LBL_WAIT_READY
+};
+
+static uint16_t rtcWord(uint32_t index) {
+    return static_cast<uint16_t>(RTC_SLOW_MEM[index] & 0xFFFF);
+}
+
+#endif  // ULP_SAMPLER_SUPPORTED
+
+UlpSampler::UlpSampler() : wake_reason_(UlpWakeReason::NONE) {
+#if ULP_SAMPLER_SUPPORTED
+    if (s_armed && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_ULP) {
+        wake_reason_ = static_cast<UlpWakeReason>(rtcWord(VAR_REASON));
+    }
+#endif
+}
+
+bool UlpSampler::isSupported() {
+    return ULP_SAMPLER_SUPPORTED != 0;
+}
+
+bool UlpSampler::start(uint8_t adc_pin, uint32_t period_ms, uint16_t baseline_code, uint16_t threshold_codes) {
+#if ULP_SAMPLER_SUPPORTED
+    int8_t channel = digitalPinToAnalogChannel(adc_pin);
+    if (channel < 0 || channel >= 8 || period_ms == 0) {
+        return false;  // ULP reads ADC1 only
+    }
+
+    // Band outside of which a sample wakes the CPU; an out-of-range edge never fires
+    uint16_t low_code = baseline_code > threshold_codes ? baseline_code - threshold_codes : 0;
+    uint32_t high_code = static_cast<uint32_t>(baseline_code) + threshold_codes;
+    if (high_code > ULP_ADC_MAX_CODE + 1) {
+        high_code = ULP_ADC_MAX_CODE + 1;
+    }
+
+    const ulp_insn_t program[] = {
+        // R1 = sample; buffer[count++] = R1
+        I_ADC(R1, 0, channel),
+        I_MOVI(R2, VAR_LAST),
+        I_ST(R1, R2, 0),
+        I_MOVI(R2, VAR_COUNT),
+        I_LD(R0, R2, 0),
+        I_MOVI(R3, BUFFER_START),
+        I_ADDR(R3, R3, R0),
+        I_ST(R1, R3, 0),
+        I_ADDI(R0, R0, 1),
+        I_ST(R0, R2, 0),
+        M_BGE(LBL_FULL, ULP_BUFFER_SIZE),
+
+        // Stay asleep while the sample is inside [low, high)
+        I_MOVR(R0, R1),
+        M_BL(LBL_THRESHOLD, low_code),
+        M_BGE(LBL_THRESHOLD, high_code),
+        I_HALT(),
+
+        M_LABEL(LBL_FULL),
+        I_MOVI(R0, static_cast<uint16_t>(UlpWakeReason::BUFFER_FULL)),
+        M_BX(LBL_WAKE),
+
+        M_LABEL(LBL_THRESHOLD),
+        I_MOVI(R0, static_cast<uint16_t>(UlpWakeReason::THRESHOLD)),
+
+        M_LABEL(LBL_WAKE),
+        I_MOVI(R2, VAR_REASON),
+        I_ST(R0, R2, 0),
+
+        // The SoC must be fully asleep before it can take a wake request
+        M_LABEL(LBL_WAIT_READY),
+        I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+        M_BL(LBL_WAIT_READY, 1),
+        I_WAKE(),
+        I_END(),    // Stop the ULP timer until the next start()
+        I_HALT()
+    };
+
+    size_t size = sizeof(program) / sizeof(ulp_insn_t);
+    if (PROGRAM_START + size > RESERVED_WORDS) {
+        return false;
+    }
+
+    stop();
+    RTC_SLOW_MEM[VAR_COUNT] = 0;
+    RTC_SLOW_MEM[VAR_LAST] = baseline_code;
+    RTC_SLOW_MEM[VAR_REASON] = static_cast<uint32_t>(UlpWakeReason::NONE);
+
+    if (ulp_process_macros_and_load(PROGRAM_START, program, &size) != ESP_OK) {
+        return false;
+    }
+
+    // Hand ADC1 to the ULP; it keeps the SAR powered between conversions
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(static_cast<adc1_channel_t>(channel), ADC_ATTEN_DB_11);
+    adc1_ulp_enable();
+
+    if (ulp_set_wakeup_period(0, period_ms * 1000UL) != ESP_OK ||
+        ulp_run(PROGRAM_START) != ESP_OK) {
+        return false;
+    }
+
+    s_armed = true;
+    s_sleep_start_ms = millis();
+    s_period_ms = period_ms;
+    return true;
+#else
+    (void)adc_pin;
+    (void)period_ms;
+    (void)baseline_code;
+    (void)threshold_codes;
+    return false;
+#endif
+}
+
+void UlpSampler::stop() {
+#if ULP_SAMPLER_SUPPORTED
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+#endif
+}
+
+bool UlpSampler::hasSamples() const {
+#if ULP_SAMPLER_SUPPORTED
+    return s_armed && rtcWord(VAR_COUNT) > 0;
+#else
+    return false;
+#endif
+}
+
+size_t UlpSampler::collect(uint16_t* codes, uint32_t* timestamps_ms, size_t max_count) {
+#if ULP_SAMPLER_SUPPORTED
+    if (!s_armed || codes == nullptr || timestamps_ms == nullptr) {
+        return 0;
+    }
+
+    // A timer wake leaves the ULP running; freeze the buffer before reading it
+    stop();
+
+    size_t count = rtcWord(VAR_COUNT);
+    if (count > ULP_BUFFER_SIZE) {
+        count = ULP_BUFFER_SIZE;
+    }
+    if (count > max_count) {
+        count = max_count;
+    }
+
+    // The first conversion runs one period after start()
+    for (size_t i = 0; i < count; ++i) {
+        codes[i] = rtcWord(BUFFER_START + i) & ULP_ADC_MAX_CODE;
+        timestamps_ms[i] = s_sleep_start_ms + static_cast<uint32_t>(i + 1) * s_period_ms;
+    }
+
+    RTC_SLOW_MEM[VAR_COUNT] = 0;
+    s_armed = false;
+    return count;
+#else
+    (void)codes;
+    (void)timestamps_ms;
+    (void)max_count;
+    return 0;
+#endif
+}
+
+UlpWakeReason UlpSampler::getWakeReason() const {
+    return wake_reason_;
+}
+
+}  // namespace LightSensor
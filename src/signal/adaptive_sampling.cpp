@@ -0,0 +1,99 @@
+#include "adaptive_sampling.h"
+#include <algorithm>
+#include <cmath>
+
+namespace LightSensor {
+
+// A trend this confident counts as a change in light level
+static const float CHANGE_TREND_CONFIDENCE = 0.8f;
+
+// Never treat movements smaller than this (or than 3 sigma of noise) as change
+static const float MIN_CHANGE_BAND_LUX = 0.5f;
+
+AdaptiveSamplingController::AdaptiveSamplingController(const SensorConfig& config) {
+    configure(config);
+}
+
+void AdaptiveSamplingController::configure(const SensorConfig& config) {
+    fast_rate_ms_ = config.sample_rate_ms > 0 ? config.sample_rate_ms : 1;
+    slow_rate_ms_ = std::max(config.max_sample_rate_ms, fast_rate_ms_);
+    max_oversampling_ = config.oversampling > 0 ? config.oversampling : 1;
+    min_oversampling_ = std::min(std::max<uint8_t>(config.min_oversampling, 1), max_oversampling_);
+    change_threshold_ = config.adaptive_change_threshold;
+    reset();
+}
+
+bool AdaptiveSamplingController::update(const SignalAnalysis& analysis) {
+    if (isChange(analysis)) {
+        settled_value_ = analysis.filtered_value;
+        has_settled_value_ = true;
+        stable_count_ = 0;
+
+        bool changed = isRelaxed();
+        sample_rate_ms_ = fast_rate_ms_;
+        oversampling_ = max_oversampling_;
+        return changed;
+    }
+
+    if (!has_settled_value_) {
+        settled_value_ = analysis.filtered_value;
+        has_settled_value_ = true;
+    }
+
+    if (++stable_count_ < STABLE_READINGS_TO_RELAX) {
+        return false;
+    }
+    stable_count_ = 0;
+
+    // Exponential back-off: halve the rate, shed one oversampling step
+    uint32_t rate_ms = sample_rate_ms_ > slow_rate_ms_ / 2 ? slow_rate_ms_ : sample_rate_ms_ * 2;
+    uint8_t oversampling = oversampling_ > min_oversampling_ ? oversampling_ - 1 : min_oversampling_;
+
+    bool changed = rate_ms != sample_rate_ms_ || oversampling != oversampling_;
+    sample_rate_ms_ = rate_ms;
+    oversampling_ = oversampling;
+    return changed;
+}
+
+void AdaptiveSamplingController::reset() {
+    sample_rate_ms_ = fast_rate_ms_;
+    oversampling_ = max_oversampling_;
+    stable_count_ = 0;
+    settled_value_ = 0.0f;
+    has_settled_value_ = false;
+}
+
+uint32_t AdaptiveSamplingController::getSampleRateMs() const {
+    return sample_rate_ms_;
+}
+
+uint8_t AdaptiveSamplingController::getOversampling() const {
+    return oversampling_;
+}
+
+bool AdaptiveSamplingController::isRelaxed() const {
+    return sample_rate_ms_ != fast_rate_ms_ || oversampling_ != max_oversampling_;
+}
+
+bool AdaptiveSamplingController::isChange(const SignalAnalysis& analysis) const {
+    if (analysis.is_peak || analysis.is_outlier) {
+        return true;
+    }
+
+    if (!has_settled_value_) {
+        return false;
+    }
+
+    float band = std::max(fabsf(settled_value_) * change_threshold_,
+                          std::max(3.0f * analysis.noise_level, MIN_CHANGE_BAND_LUX));
+
+    if (fabsf(analysis.filtered_value - settled_value_) > band) {
+        return true;
+    }
+
+    // A confident slope that would leave the band within one relax window
+    return analysis.trend_confidence >= CHANGE_TREND_CONFIDENCE &&
+           fabsf(analysis.trend_slope) * STABLE_READINGS_TO_RELAX > band;
+}
+
+}  // namespace LightSensor
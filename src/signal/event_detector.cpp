@@ -0,0 +1,97 @@
+#include "event_detector.h"
+
+namespace LightSensor {
+
+EventDetector::EventDetector(const SignalConfig& config)
+    : config_(config), event_count_(0) {
+    configure(config);
+}
+
+size_t EventDetector::update(const SensorReading& reading, const SignalAnalysis& analysis, LightEvent* events) {
+    if (!config_.enable_events || !reading.is_valid) {
+        return 0;
+    }
+
+    size_t count = 0;
+    auto raise = [&](LightEventType type, float value) {
+        events[count].timestamp_ms = reading.timestamp_ms;
+        events[count].type = type;
+        events[count].lux = reading.lux_value;
+        events[count].value = value;
+        count++;
+    };
+
+    float value = analysis.filtered_value;
+    for (size_t i = 0; i < THRESHOLD_COUNT && count < MAX_EVENTS; ++i) {
+        float threshold = thresholds_[i];
+        if (threshold <= 0.0f) {
+            continue;
+        }
+
+        // The first reading only establishes which side the signal is on
+        if (value > threshold + config_.event_hysteresis_lux) {
+            if (side_[i] < 0) {
+                raise(LightEventType::THRESHOLD_RISE, threshold);
+            }
+            side_[i] = 1;
+        } else if (value < threshold - config_.event_hysteresis_lux) {
+            if (side_[i] > 0) {
+                raise(LightEventType::THRESHOLD_FALL, threshold);
+            }
+            side_[i] = -1;
+        }
+    }
+
+    if (analysis.is_peak && count < MAX_EVENTS) {
+        raise(LightEventType::PEAK, analysis.filtered_value);
+    }
+
+    if (analysis.is_outlier && count < MAX_EVENTS) {
+        raise(LightEventType::OUTLIER, analysis.filtered_value);
+    }
+
+    if (analysis.trend_confidence >= TREND_CONFIDENCE && analysis.trend_slope != 0.0f) {
+        int8_t direction = analysis.trend_slope > 0.0f ? 1 : -1;
+        if (trend_direction_ != 0 && direction != trend_direction_ && count < MAX_EVENTS) {
+            raise(LightEventType::TREND_CHANGE, analysis.trend_slope);
+        }
+        trend_direction_ = direction;
+    }
+
+    event_count_ += count;
+    return count;
+}
+
+void EventDetector::configure(const SignalConfig& config) {
+    config_ = config;
+    if (config_.event_hysteresis_lux < 0.0f) {
+        config_.event_hysteresis_lux = 0.0f;
+    }
+    thresholds_[0] = config_.event_low_lux;
+    thresholds_[1] = config_.event_high_lux;
+    reset();
+}
+
+void EventDetector::reset() {
+    for (size_t i = 0; i < THRESHOLD_COUNT; ++i) {
+        side_[i] = 0;
+    }
+    trend_direction_ = 0;
+}
+
+uint32_t EventDetector::getEventCount() const {
+    return event_count_;
+}
+
+const char* EventDetector::typeToString(LightEventType type) {
+    switch (type) {
+        case LightEventType::THRESHOLD_RISE: return "threshold_rise";
+        case LightEventType::THRESHOLD_FALL: return "threshold_fall";
+        case LightEventType::PEAK:           return "peak";
+        case LightEventType::OUTLIER:        return "outlier";
+        case LightEventType::TREND_CHANGE:   return "trend_change";
+        default:                             return "unknown";
+    }
+}
+
+}  // namespace LightSensor
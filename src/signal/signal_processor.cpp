@@ -1,201 +1,36 @@
 #include "signal_processor.h"
+#include "profiler.h"
 #include <Arduino.h>
 #include <cmath>
 #include <algorithm>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include <cstring>
+#include <new>
 
 namespace LightSensor {
 
-// MovingAverageFilter Implementation
-MovingAverageFilter::MovingAverageFilter(uint8_t window_size)
-    : window_size_(window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW),
-      buffer_index_(0), buffer_count_(0), sum_(0.0f) {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-    }
-}
-
-float MovingAverageFilter::process(float input) {
-    // Remove old value from sum if buffer is full
-    if (buffer_count_ >= window_size_) {
-        sum_ -= buffer_[buffer_index_];
-    }
-    
-    // Add new value
-    buffer_[buffer_index_] = input;
-    sum_ += input;
-    
-    buffer_index_ = (buffer_index_ + 1) % window_size_;
-    if (buffer_count_ < window_size_) {
-        buffer_count_++;
-    }
-    
-    return sum_ / buffer_count_;
-}
-
-void MovingAverageFilter::reset() {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-    }
-    buffer_index_ = 0;
-    buffer_count_ = 0;
-    sum_ = 0.0f;
-}
-
-// LowPassFilter Implementation
-LowPassFilter::LowPassFilter(float cutoff_freq, float sample_rate)
-    : prev_output_(0.0f) {
-    float rc = 1.0f / (2.0f * M_PI * cutoff_freq);
-    float dt = 1.0f / sample_rate;
-    alpha_ = dt / (rc + dt);
-}
-
-float LowPassFilter::process(float input) {
-    prev_output_ = alpha_ * input + (1.0f - alpha_) * prev_output_;
-    return prev_output_;
-}
-
-void LowPassFilter::reset() {
-    prev_output_ = 0.0f;
-}
-
-// MedianFilter Implementation
-MedianFilter::MedianFilter(uint8_t window_size)
-    : window_size_(window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW),
-      buffer_index_(0), buffer_count_(0) {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-        sorted_buffer_[i] = 0.0f;
-    }
-}
-
-float MedianFilter::process(float input) {
-    buffer_[buffer_index_] = input;
-    buffer_index_ = (buffer_index_ + 1) % window_size_;
-    if (buffer_count_ < window_size_) {
-        buffer_count_++;
-    }
-    
-    if (buffer_count_ < 3) {
-        return input;
-    }
-    
-    // Copy to sorted buffer
-    for (size_t i = 0; i < buffer_count_; ++i) {
-        sorted_buffer_[i] = buffer_[i];
-    }
-    
-    // Simple bubble sort (efficient for small arrays)
-    for (size_t i = 0; i < buffer_count_ - 1; ++i) {
-        for (size_t j = 0; j < buffer_count_ - i - 1; ++j) {
-            if (sorted_buffer_[j] > sorted_buffer_[j + 1]) {
-                float temp = sorted_buffer_[j];
-                sorted_buffer_[j] = sorted_buffer_[j + 1];
-                sorted_buffer_[j + 1] = temp;
-            }
-        }
-    }
-    
-    if (buffer_count_ % 2 == 0) {
-        return (sorted_buffer_[buffer_count_ / 2 - 1] + sorted_buffer_[buffer_count_ / 2]) / 2.0f;
-    } else {
-        return sorted_buffer_[buffer_count_ / 2];
-    }
-}
-
-void MedianFilter::reset() {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-        sorted_buffer_[i] = 0.0f;
-    }
-    buffer_index_ = 0;
-    buffer_count_ = 0;
-}
-
-// AdaptiveFilter Implementation
-AdaptiveFilter::AdaptiveFilter(float adaptation_rate, float noise_floor)
-    : adaptation_rate_(adaptation_rate), noise_floor_(noise_floor),
-      filter_coefficient_(0.5f), prev_output_(0.0f), error_variance_(0.0f) {
-}
-
-float AdaptiveFilter::process(float input) {
-    float error = input - prev_output_;
-    error_variance_ = (1.0f - adaptation_rate_) * error_variance_ + 
-                     adaptation_rate_ * error * error;
-    
-    if (error_variance_ > noise_floor_) {
-        filter_coefficient_ = std::min(0.9f, filter_coefficient_ + adaptation_rate_ * 0.1f);
-    } else {
-        filter_coefficient_ = std::max(0.1f, filter_coefficient_ - adaptation_rate_ * 0.1f);
-    }
-    
-    prev_output_ = filter_coefficient_ * input + (1.0f - filter_coefficient_) * prev_output_;
-    return prev_output_;
-}
-
-void AdaptiveFilter::reset() {
-    filter_coefficient_ = 0.5f;
-    prev_output_ = 0.0f;
-    error_variance_ = 0.0f;
-}
-
-void AdaptiveFilter::updateParameters(float adaptation_rate, float noise_floor) {
-    adaptation_rate_ = adaptation_rate;
-    noise_floor_ = noise_floor;
-}
-
 // TrendAnalyzer Implementation
 TrendAnalyzer::TrendAnalyzer(uint8_t window_size)
-    : window_size_(window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW),
-      buffer_index_(0), buffer_count_(0) {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-    }
+    : regression_(window_size) {
 }
 
 TrendResult TrendAnalyzer::analyzeTrend(float value) {
-    buffer_[buffer_index_] = value;
-    buffer_index_ = (buffer_index_ + 1) % window_size_;
-    if (buffer_count_ < window_size_) {
-        buffer_count_++;
-    }
+    regression_.add(value);
     
     TrendResult result = {0.0f, 0.0f, false, false};
     
-    if (buffer_count_ < 3) {
+    if (regression_.count() < 3) {
         return result;
     }
     
-    // Calculate means
-    float x_mean = (buffer_count_ - 1) / 2.0f;
-    float y_mean = 0.0f;
-    for (size_t i = 0; i < buffer_count_; ++i) {
-        y_mean += buffer_[i];
-    }
-    y_mean /= buffer_count_;
-    
-    // Calculate slope and correlation using linear regression
-    float numerator = 0.0f;
-    float x_denominator = 0.0f;
-    float y_denominator = 0.0f;
-    
-    for (size_t i = 0; i < buffer_count_; ++i) {
-        float x_diff = static_cast<float>(i) - x_mean;
-        float y_diff = buffer_[(buffer_index_ + i) % window_size_] - y_mean;
-        
-        numerator += x_diff * y_diff;
-        x_denominator += x_diff * x_diff;
-        y_denominator += y_diff * y_diff;
-    }
+    float numerator = regression_.numerator();
+    float x_denominator = regression_.xDenominator();
+    float y_denominator = regression_.yDenominator();
     
     if (x_denominator > 0.001f) {
         result.slope = numerator / x_denominator;
         
         if (y_denominator > 0.001f) {
-            result.confidence = fabsf(numerator / sqrtf(x_denominator * y_denominator));
+            result.confidence = std::min(1.0f, fabsf(numerator / sqrtf(x_denominator * y_denominator)));
         }
     }
     
@@ -206,64 +41,95 @@ TrendResult TrendAnalyzer::analyzeTrend(float value) {
 }
 
 void TrendAnalyzer::setWindowSize(uint8_t window_size) {
-    window_size_ = window_size < MAX_FILTER_WINDOW ? window_size : MAX_FILTER_WINDOW;
-    reset();
+    regression_.setWindowSize(window_size);
 }
 
 void TrendAnalyzer::reset() {
-    for (size_t i = 0; i < MAX_FILTER_WINDOW; ++i) {
-        buffer_[i] = 0.0f;
-    }
-    buffer_index_ = 0;
-    buffer_count_ = 0;
+    regression_.reset();
 }
 
 // SignalProcessor Implementation
 SignalProcessor::SignalProcessor(const SignalConfig& config)
     : config_(config),
-      ma_filter_(config.moving_average_window),
-      lp_filter_(config.low_pass_cutoff > 0 ? config.low_pass_cutoff : 0.5f, 1.0f),
-      median_filter_(config.median_window),
-      adaptive_filter_(config.adaptation_rate, config.noise_floor),
+      filter_chain_(nullptr),
+      fixed_chain_(nullptr),
       trend_analyzer_(config.trend_window),
-      ma_enabled_(config.moving_average_window > 1),
-      lp_enabled_(config.low_pass_cutoff > 0),
-      median_enabled_(config.enable_median_filter),
-      adaptive_enabled_(config.enable_adaptive_filter),
-      recent_index_(0), recent_count_(0),
+      sample_rate_hz_(0.0f),
+      lux_per_unit_(3.3f), lux_offset_(0.0f),
+      recent_stats_(MAX_RECENT_VALUES),
       noise_level_estimate_(0.0f), signal_quality_(50),
       prev_value_(0.0f), rising_(false) {
+    buildFilterChain();
+    updateSpectralStage();
+}
+
+SignalProcessor::~SignalProcessor() {
+    destroyFilterChain();
+}
+
+SignalAnalysis SignalProcessor::processReading(const SensorReading& reading) {
+    LS_PROFILE_SCOPE(SIGNAL_PROCESS);
+    
+    return analyzeValue(reading.lux_value, applyFilters(reading));
+}
+
+void SignalProcessor::processBlock(const SensorReading* readings, SignalAnalysis* results, size_t count) {
+    LS_PROFILE_SCOPE(SIGNAL_PROCESS_BLOCK);
+    
+    float filtered[MAX_BLOCK_SIZE];
+    
+    for (size_t offset = 0; offset < count; offset += MAX_BLOCK_SIZE) {
+        size_t chunk = count - offset < MAX_BLOCK_SIZE ? count - offset : MAX_BLOCK_SIZE;
+        
+        // Filter stages are independent, so running each stage over the
+        // whole chunk gives the same result as the per-sample chain
+        applyFiltersBlock(readings + offset, filtered, chunk);
+        
+        for (size_t i = 0; i < chunk; ++i) {
+            results[offset + i] = analyzeValue(readings[offset + i].lux_value, filtered[i]);
+        }
+    }
+}
+
+SignalAnalysis SignalProcessor::processColumns(const uint16_t* raw_q16, const float* lux_values,
+                                               float* filtered_values, size_t count) {
+    LS_PROFILE_SCOPE(SIGNAL_PROCESS_BLOCK);
+    
+    SignalAnalysis analysis = {0.0f, noise_level_estimate_, 0.0f, false, false, 0.0f, 0.0f, signal_quality_,
+                               0.0f, 0.0f, 0.0f};
     
-    for (size_t i = 0; i < MAX_RECENT_VALUES; ++i) {
-        recent_values_[i] = 0.0f;
+    for (size_t offset = 0; offset < count; offset += MAX_BLOCK_SIZE) {
+        size_t chunk = count - offset < MAX_BLOCK_SIZE ? count - offset : MAX_BLOCK_SIZE;
+        applyFiltersColumns(raw_q16 + offset, lux_values + offset, filtered_values + offset, chunk);
+        
+        for (size_t i = 0; i < chunk; ++i) {
+            analysis = analyzeValue(lux_values[offset + i], filtered_values[offset + i]);
+        }
     }
+    
+    return analysis;
 }
 
-SignalAnalysis SignalProcessor::processReading(const SensorReading& reading) {
+SignalAnalysis SignalProcessor::analyzeValue(float lux_value, float filtered_value) {
     SignalAnalysis analysis;
     
     // Store recent values
-    recent_values_[recent_index_] = reading.lux_value;
-    recent_index_ = (recent_index_ + 1) % MAX_RECENT_VALUES;
-    if (recent_count_ < MAX_RECENT_VALUES) {
-        recent_count_++;
-    }
+    recent_stats_.add(lux_value);
     
-    // Apply filters
-    analysis.filtered_value = applyFilters(reading.lux_value);
+    analysis.filtered_value = filtered_value;
     
     // Update noise estimate
-    updateNoiseEstimate(analysis.filtered_value, reading.lux_value);
+    updateNoiseEstimate(analysis.filtered_value, lux_value);
     
     // Outlier detection
-    analysis.is_outlier = config_.enable_outlier_removal && isOutlier(reading.lux_value);
+    analysis.is_outlier = config_.enable_outlier_removal && isOutlier(lux_value);
     
     // Peak detection
-    analysis.is_peak = config_.enable_peak_detection && isPeak(reading.lux_value);
+    analysis.is_peak = config_.enable_peak_detection && isPeak(lux_value);
     
     // Trend analysis
     if (config_.enable_trend_detection) {
-        TrendResult trend = trend_analyzer_.analyzeTrend(reading.lux_value);
+        TrendResult trend = trend_analyzer_.analyzeTrend(lux_value);
         analysis.trend_slope = trend.slope;
         analysis.trend_confidence = trend.confidence;
     } else {
@@ -271,6 +137,20 @@ SignalAnalysis SignalProcessor::processReading(const SensorReading& reading) {
         analysis.trend_confidence = 0.0f;
     }
     
+    // Flicker is in the unfiltered light; figures hold until the next block completes
+    SpectralAnalyzer* spectral = spectral_.get();
+    if (spectral) {
+        spectral->add(lux_value);
+        const SpectralResult& spectrum = spectral->getResult();
+        analysis.dominant_frequency_hz = spectrum.dominant_frequency_hz;
+        analysis.flicker_percent = spectrum.flicker_percent;
+        analysis.flicker_index = spectrum.flicker_index;
+    } else {
+        analysis.dominant_frequency_hz = 0.0f;
+        analysis.flicker_percent = 0.0f;
+        analysis.flicker_index = 0.0f;
+    }
+    
     // Calculate signal quality metrics
     analysis.noise_level = noise_level_estimate_;
     analysis.signal_to_noise_ratio = (analysis.filtered_value > 0.001f) ? 
@@ -283,31 +163,33 @@ SignalAnalysis SignalProcessor::processReading(const SensorReading& reading) {
 }
 
 void SignalProcessor::configure(const SignalConfig& config) {
+    bool trend_window_changed = config.trend_window != config_.trend_window;
+    bool path_changed = config.use_fixed_point != config_.use_fixed_point;
     config_ = config;
-    
-    ma_enabled_ = config.moving_average_window > 1;
-    lp_enabled_ = config.low_pass_cutoff > 0;
-    median_enabled_ = config.enable_median_filter;
-    adaptive_enabled_ = config.enable_adaptive_filter;
-    
-    trend_analyzer_.setWindowSize(config.trend_window);
-    adaptive_filter_.updateParameters(config.adaptation_rate, config.noise_floor);
-    
-    reset();
+    updateSpectralStage();
+    
+    // Filters and statistics keep their state across a config update; a
+    // chain taking over from the other path starts empty
+    if (path_changed) {
+        buildFilterChain();
+    } else if (fixed_chain_) {
+        fixed_chain_->configure(fixedChainConfig());
+    } else {
+        filter_chain_->configure(config);
+    }
+    if (trend_window_changed) {
+        trend_analyzer_.setWindowSize(config.trend_window);
+    }
 }
 
 void SignalProcessor::reset() {
-    ma_filter_.reset();
-    lp_filter_.reset();
-    median_filter_.reset();
-    adaptive_filter_.reset();
+    initializeFilters();
     trend_analyzer_.reset();
     
-    for (size_t i = 0; i < MAX_RECENT_VALUES; ++i) {
-        recent_values_[i] = 0.0f;
+    recent_stats_.reset();
+    if (spectral_.get()) {
+        spectral_.get()->reset();
     }
-    recent_index_ = 0;
-    recent_count_ = 0;
     
     noise_level_estimate_ = 0.0f;
     signal_quality_ = 50;
@@ -324,51 +206,124 @@ float SignalProcessor::getNoiseLevel() const {
 }
 
 void SignalProcessor::setFilterEnabled(FilterType filter_type, bool enable) {
-    switch (filter_type) {
-        case FilterType::MOVING_AVERAGE:
-            ma_enabled_ = enable;
-            break;
-        case FilterType::LOW_PASS:
-            lp_enabled_ = enable;
-            break;
-        case FilterType::MEDIAN:
-            median_enabled_ = enable;
-            break;
-        case FilterType::ADAPTIVE:
-            adaptive_enabled_ = enable;
-            break;
-        default:
-            break;
+    if (fixed_chain_) {
+        fixed_chain_->setStageEnabled(filter_type, enable);
+    } else {
+        filter_chain_->setStageEnabled(filter_type, enable);
+    }
+}
+
+void SignalProcessor::setCalibration(const SensorConfig& sensor) {
+    // Same conversion as ADCLightSensor, folded into one multiply-add
+    float sensitivity = sensor.sensitivity > 0.0f ? sensor.sensitivity : 1.0f;
+    lux_per_unit_ = sensor.reference_voltage / sensitivity;
+    lux_offset_ = sensor.dark_offset / sensitivity;
+    
+    if (fixed_chain_) {
+        fixed_chain_->configure(fixedChainConfig());
+        fixed_chain_->reset();
+    }
+}
+
+void SignalProcessor::setSampleRate(float sample_rate_hz) {
+    sample_rate_hz_ = sample_rate_hz;
+    if (spectral_.get()) {
+        spectral_.get()->setSampleRate(sample_rate_hz);
+    }
+}
+
+void SignalProcessor::updateSpectralStage() {
+    if (config_.enable_spectral_analysis && !spectral_.get()) {
+        spectral_.emplace()->setSampleRate(sample_rate_hz_);
+    } else if (!config_.enable_spectral_analysis) {
+        spectral_.destroy();
     }
 }
 
 void SignalProcessor::initializeFilters() {
-    ma_filter_.reset();
-    lp_filter_.reset();
-    median_filter_.reset();
-    adaptive_filter_.reset();
+    if (fixed_chain_) {
+        fixed_chain_->reset();
+    } else {
+        filter_chain_->reset();
+    }
 }
 
-float SignalProcessor::applyFilters(float input) {
-    float value = input;
-    
-    if (ma_enabled_) {
-        value = ma_filter_.process(value);
+void SignalProcessor::buildFilterChain() {
+    destroyFilterChain();
+    if (config_.use_fixed_point) {
+        fixed_chain_ = new (chain_storage_) BasicRuntimeFilterChain<Q16>(fixedChainConfig());
+    } else {
+        filter_chain_ = new (chain_storage_) RuntimeFilterChain(config_);
     }
-    
-    if (median_enabled_) {
-        value = median_filter_.process(value);
+}
+
+void SignalProcessor::destroyFilterChain() {
+    if (fixed_chain_) {
+        fixed_chain_->~BasicRuntimeFilterChain<Q16>();
+        fixed_chain_ = nullptr;
     }
-    
-    if (lp_enabled_) {
-        value = lp_filter_.process(value);
+    if (filter_chain_) {
+        filter_chain_->~RuntimeFilterChain();
+        filter_chain_ = nullptr;
+    }
+}
+
+float SignalProcessor::applyFilters(const SensorReading& reading) {
+    // The code is integer all the way from the ADC; no float enters the chain
+    if (fixed_chain_) {
+        return fixedToLux(fixed_chain_->process(Q16::fromRaw(reading.raw_q16)));
+    }
+    return filter_chain_->process(reading.lux_value);
+}
+
+void SignalProcessor::applyFiltersBlock(const SensorReading* readings, float* values, size_t count) {
+    if (fixed_chain_) {
+        Q16 fixed[MAX_BLOCK_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            fixed[i] = Q16::fromRaw(readings[i].raw_q16);
+        }
+        fixed_chain_->processBlock(fixed, count);
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = fixedToLux(fixed[i]);
+        }
+        return;
     }
     
-    if (adaptive_enabled_) {
-        value = adaptive_filter_.process(value);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = readings[i].lux_value;
+    }
+    filter_chain_->processBlock(values, count);
+}
+
+void SignalProcessor::applyFiltersColumns(const uint16_t* raw_q16, const float* lux_values,
+                                          float* values, size_t count) {
+    if (fixed_chain_) {
+        Q16 fixed[MAX_BLOCK_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            fixed[i] = Q16::fromRaw(raw_q16[i]);
+        }
+        fixed_chain_->processBlock(fixed, count);
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = fixedToLux(fixed[i]);
+        }
+        return;
     }
     
-    return value;
+    memcpy(values, lux_values, count * sizeof(float));
+    filter_chain_->processBlock(values, count);
+}
+
+float SignalProcessor::fixedToLux(Q16 value) const {
+    float lux = value.toFloat() * lux_per_unit_ - lux_offset_;
+    return lux > 0.0f ? lux : 0.0f;
+}
+
+SignalConfig SignalProcessor::fixedChainConfig() const {
+    // The fixed-point chain filters the [0, 1] ADC fraction, so the lux^2
+    // noise floor is rescaled into that domain
+    SignalConfig fixed_config = config_;
+    fixed_config.noise_floor = config_.noise_floor / (lux_per_unit_ * lux_per_unit_);
+    return fixed_config;
 }
 
 void SignalProcessor::updateNoiseEstimate(float filtered_value, float raw_value) {
@@ -401,12 +356,12 @@ uint8_t SignalProcessor::calculateSignalQuality(const SignalAnalysis& analysis)
 }
 
 bool SignalProcessor::isOutlier(float value) const {
-    if (recent_count_ < 3) {
+    if (recent_stats_.count() < 3) {
         return false;
     }
     
-    float mean = calculateMean();
-    float std_dev = calculateStdDev(mean);
+    float mean = recent_stats_.mean();
+    float std_dev = recent_stats_.stdDev();
     
     if (std_dev < 0.001f) {
         return false;
@@ -420,8 +375,8 @@ bool SignalProcessor::isPeak(float value) {
     bool current_rising = value > prev_value_;
     bool is_peak = rising_ && !current_rising;
     
-    if (is_peak && recent_count_ > 0) {
-        float avg = calculateMean();
+    if (is_peak && recent_stats_.count() > 0) {
+        float avg = recent_stats_.mean();
         float change = fabsf(value - prev_value_);
         is_peak = change > (avg * config_.peak_threshold);
     }
@@ -432,30 +387,4 @@ bool SignalProcessor::isPeak(float value) {
     return is_peak;
 }
 
-float SignalProcessor::calculateMean() const {
-    if (recent_count_ == 0) {
-        return 0.0f;
-    }
-    
-    float sum = 0.0f;
-    for (size_t i = 0; i < recent_count_; ++i) {
-        sum += recent_values_[i];
-    }
-    return sum / recent_count_;
-}
-
-float SignalProcessor::calculateStdDev(float mean) const {
-    if (recent_count_ < 2) {
-        return 0.0f;
-    }
-    
-    float sum_squared_diff = 0.0f;
-    for (size_t i = 0; i < recent_count_; ++i) {
-        float diff = recent_values_[i] - mean;
-        sum_squared_diff += diff * diff;
-    }
-    
-    return sqrtf(sum_squared_diff / (recent_count_ - 1));
-}
-
 }  // namespace LightSensor
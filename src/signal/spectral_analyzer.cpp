@@ -0,0 +1,213 @@
+#include "spectral_analyzer.h"
+#include "profiler.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__has_include)
+#if __has_include(<esp_dsp.h>)
+#include <esp_dsp.h>
+#define LS_HAVE_ESP_DSP 1
+#endif
+#endif
+
+#ifndef LS_HAVE_ESP_DSP
+#define LS_HAVE_ESP_DSP 0
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace LightSensor {
+
+static_assert((SPECTRAL_BLOCK_SIZE & (SPECTRAL_BLOCK_SIZE - 1)) == 0,
+              "SPECTRAL_BLOCK_SIZE must be a power of two");
+
+#if LS_HAVE_ESP_DSP
+// esp-dsp keeps one twiddle table for every caller
+static bool dsp_initialized = false;
+#endif
+
+SpectralAnalyzer::SpectralAnalyzer()
+    : sample_rate_hz_(0.0f), sample_count_(0) {
+    const size_t n = SPECTRAL_BLOCK_SIZE;
+
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < n) {
+        bits++;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        // Periodic Hann: coherent gain of exactly 1/2
+        window_[i] = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * i / n);
+
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = static_cast<uint16_t>(reversed);
+    }
+
+    for (size_t k = 0; k < n / 2; ++k) {
+        float angle = 2.0f * static_cast<float>(M_PI) * k / n;
+        twiddles_[2 * k] = cosf(angle);
+        twiddles_[2 * k + 1] = -sinf(angle);
+    }
+
+#if LS_HAVE_ESP_DSP
+    if (!dsp_initialized) {
+        dsp_initialized = dsps_fft2r_init_fc32(nullptr, SPECTRAL_BLOCK_SIZE) == ESP_OK;
+    }
+#endif
+
+    reset();
+}
+
+void SpectralAnalyzer::setSampleRate(float sample_rate_hz) {
+    if (sample_rate_hz != sample_rate_hz_) {
+        sample_rate_hz_ = sample_rate_hz;
+        sample_count_ = 0;
+    }
+}
+
+bool SpectralAnalyzer::add(float value) {
+    samples_[sample_count_++] = value;
+    if (sample_count_ < SPECTRAL_BLOCK_SIZE) {
+        return false;
+    }
+
+    analyzeBlock();
+    sample_count_ = 0;
+    return true;
+}
+
+const SpectralResult& SpectralAnalyzer::getResult() const {
+    return result_;
+}
+
+void SpectralAnalyzer::reset() {
+    sample_count_ = 0;
+    memset(&result_, 0, sizeof(result_));
+}
+
+void SpectralAnalyzer::analyzeBlock() {
+    LS_PROFILE_SCOPE(SPECTRAL_ANALYSIS);
+
+    const size_t n = SPECTRAL_BLOCK_SIZE;
+
+    // Time domain: modulation depth and the share of light above the mean
+    float min_value = samples_[0];
+    float max_value = samples_[0];
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        min_value = samples_[i] < min_value ? samples_[i] : min_value;
+        max_value = samples_[i] > max_value ? samples_[i] : max_value;
+        sum += samples_[i];
+    }
+    float mean = sum / n;
+
+    float above = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        above += samples_[i] > mean ? samples_[i] - mean : 0.0f;
+    }
+
+    result_.flicker_percent = max_value + min_value > 0.0f ?
+                              100.0f * (max_value - min_value) / (max_value + min_value) : 0.0f;
+    result_.flicker_index = sum > 0.0f ? above / sum : 0.0f;
+    result_.block_count++;
+
+    // Without a known rate, or with nothing to find, there is no frequency
+    result_.dominant_frequency_hz = 0.0f;
+    result_.dominant_amplitude = 0.0f;
+    if (sample_rate_hz_ <= 0.0f || max_value <= min_value) {
+        return;
+    }
+
+    // Removing the mean first keeps DC leakage out of the lowest bins
+    for (size_t i = 0; i < n; ++i) {
+        buffer_[2 * i] = (samples_[i] - mean) * window_[i];
+        buffer_[2 * i + 1] = 0.0f;
+    }
+    transform();
+
+    // Real input: bins above n/2 mirror the ones below
+    size_t peak_bin = 1;
+    float peak_power = 0.0f;
+    for (size_t k = 1; k < n / 2; ++k) {
+        float power = buffer_[2 * k] * buffer_[2 * k] + buffer_[2 * k + 1] * buffer_[2 * k + 1];
+        if (power > peak_power) {
+            peak_power = power;
+            peak_bin = k;
+        }
+    }
+
+    // Parabolic fit over the neighbouring magnitudes places the peak between bins
+    float offset = 0.0f;
+    if (peak_bin > 1 && peak_bin < n / 2 - 1) {
+        float left = sqrtf(buffer_[2 * (peak_bin - 1)] * buffer_[2 * (peak_bin - 1)] +
+                           buffer_[2 * (peak_bin - 1) + 1] * buffer_[2 * (peak_bin - 1) + 1]);
+        float centre = sqrtf(peak_power);
+        float right = sqrtf(buffer_[2 * (peak_bin + 1)] * buffer_[2 * (peak_bin + 1)] +
+                            buffer_[2 * (peak_bin + 1) + 1] * buffer_[2 * (peak_bin + 1) + 1]);
+        float denominator = left - 2.0f * centre + right;
+        if (denominator < 0.0f) {
+            offset = 0.5f * (left - right) / denominator;
+        }
+    }
+
+    // Single-sided amplitude, undoing the Hann gain of 1/2 and its
+    // response at offset bins from the centre of the main lobe
+    float response = 1.0f;
+    if (fabsf(offset) > 1e-4f) {
+        float x = static_cast<float>(M_PI) * offset;
+        response = sinf(x) / x / (1.0f - offset * offset);
+    }
+    result_.dominant_frequency_hz = (peak_bin + offset) * sample_rate_hz_ / n;
+    result_.dominant_amplitude = 4.0f * sqrtf(peak_power) / n / response;
+}
+
+void SpectralAnalyzer::transform() {
+    const size_t n = SPECTRAL_BLOCK_SIZE;
+
+#if LS_HAVE_ESP_DSP
+    if (dsp_initialized) {
+        dsps_fft2r_fc32(buffer_, n);
+        dsps_bit_rev_fc32(buffer_, n);
+        return;
+    }
+#endif
+
+    // Bit-reversal permutation, then iterative decimation-in-time butterflies
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = bit_reverse_[i];
+        if (j > i) {
+            float re = buffer_[2 * i];
+            float im = buffer_[2 * i + 1];
+            buffer_[2 * i] = buffer_[2 * j];
+            buffer_[2 * i + 1] = buffer_[2 * j + 1];
+            buffer_[2 * j] = re;
+            buffer_[2 * j + 1] = im;
+        }
+    }
+
+    for (size_t size = 2; size <= n; size <<= 1) {
+        size_t half = size / 2;
+        size_t step = n / size;
+        for (size_t start = 0; start < n; start += size) {
+            for (size_t k = 0; k < half; ++k) {
+                float wr = twiddles_[2 * k * step];
+                float wi = twiddles_[2 * k * step + 1];
+                float* a = &buffer_[2 * (start + k)];
+                float* b = &buffer_[2 * (start + k + half)];
+                float tr = wr * b[0] - wi * b[1];
+                float ti = wr * b[1] + wi * b[0];
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+}  // namespace LightSensor
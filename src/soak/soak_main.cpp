@@ -0,0 +1,438 @@
+/**
+ * ESP32 Light Sensor - Soak Test Firmware
+ *
+ * Built by the esp32dev-soak environment in place of main.cpp:
+ *   pio run -e esp32dev-soak -t upload && pio device monitor -e esp32dev-soak
+ *
+ * For each ConfigPresets preset, a SyntheticLightSensor feeds the signal
+ * processor and data logger through the same producer/consumer split as
+ * the pipeline, at a rate that rises step by step until a step loses
+ * readings (DataStats::buffer_overflow_count rises or the input queue
+ * drops). One CSV line per step:
+ *   soak,<preset>,<rate_hz>,<ok|fail>,<readings>,<readings_per_sec>,<p50_us>,<p99_us>,<max_us>,<overflows>,<drops>,<write_errors>
+ * then one line per preset for the last sustained step:
+ *   soak_max,<preset>,<rate_hz>,<readings_per_sec>,<p50_us>,<p99_us>,<max_us>,<heap_peak_bytes>
+ * and "soak,done". Latency runs from a reading entering the input queue to
+ * logBlock() returning for it. heap_peak_bytes is the largest drop in free
+ * heap seen during the preset's steps.
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <esp_heap_caps.h>
+#include "light_sensor.h"
+#include "synthetic_sensor.h"
+#include "signal_processor.h"
+#include "event_detector.h"
+#include "data_logger.h"
+#include "segment_storage.h"
+#include "config_manager.h"
+#include "spsc_ring_buffer.h"
+#include "static_arena.h"
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+using namespace LightSensor;
+
+static const uint32_t STEP_MS = 2000;
+static const uint32_t DRAIN_TIMEOUT_MS = 2000;
+static const float START_RATE_HZ = 100.0f;
+static const float RAMP_FACTOR = 1.25f;
+static const float MAX_RATE_HZ = 100000.0f;
+static const size_t SOAK_QUEUE_SIZE = 1024;     // Power of two (SpscRingBuffer)
+static const uint32_t TASK_STACK_SIZE = 8192;
+static const char* SOAK_LOG_PATH = "/soak";
+
+static const char* const PRESETS[] = {"low_power", "balanced", "high_accuracy", "development"};
+
+/**
+ * @brief Reading plus the time it entered the input queue
+ */
+struct SoakItem {
+    SensorReading reading;
+    uint32_t queued_us;
+};
+
+/**
+ * @brief Log-linear latency histogram (four buckets per power of two, as in Profiler)
+ */
+class LatencyHistogram {
+public:
+    static const uint8_t SUB_BUCKET_BITS = 2;
+    static const size_t BUCKETS = (32 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    void reset() {
+        memset(buckets_, 0, sizeof(buckets_));
+        count_ = 0;
+        max_us_ = 0;
+    }
+
+    void record(uint32_t us) {
+        buckets_[bucketOf(us)]++;
+        count_++;
+        max_us_ = us > max_us_ ? us : max_us_;
+    }
+
+    /**
+     * @brief Upper edge of the bucket holding a percentile
+     */
+    uint32_t percentile(float fraction) const {
+        uint64_t target = static_cast<uint64_t>(count_ * fraction);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets_[i];
+            if (seen > target) {
+                uint32_t edge = upperEdge(i);
+                return edge < max_us_ ? edge : max_us_;
+            }
+        }
+        return max_us_;
+    }
+
+    uint32_t getMax() const { return max_us_; }
+
+private:
+    uint32_t buckets_[BUCKETS];
+    uint32_t count_;
+    uint32_t max_us_;
+
+    static size_t bucketOf(uint32_t value) {
+        if (value < (1u << SUB_BUCKET_BITS)) {
+            return value;
+        }
+        uint8_t msb = 31 - __builtin_clz(value);
+        uint32_t sub = (value >> (msb - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+        return ((msb - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub;
+    }
+
+    static uint32_t upperEdge(size_t bucket) {
+        if (bucket < (1u << SUB_BUCKET_BITS)) {
+            return static_cast<uint32_t>(bucket);
+        }
+        uint8_t msb = static_cast<uint8_t>((bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1);
+        uint32_t sub = bucket & ((1u << SUB_BUCKET_BITS) - 1);
+        uint64_t edge = (static_cast<uint64_t>((1u << SUB_BUCKET_BITS) + sub + 1) << (msb - SUB_BUCKET_BITS)) - 1;
+        return edge > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(edge);
+    }
+};
+
+/**
+ * @brief Outcome of one rate step
+ */
+struct StepResult {
+    float rate_hz;
+    bool sustained;
+    uint32_t readings;
+    float readings_per_sec;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t overflows;
+    uint32_t drops;
+    uint32_t write_errors;
+};
+
+// Subsystems of the preset under test, re-created for every step
+static StaticSlot<SyntheticLightSensor> sensorSlot;
+static StaticSlot<SignalProcessor> processorSlot;
+static StaticSlot<EventDetector> detectorSlot;
+static StaticSlot<DataLogger> loggerSlot;
+
+static SpscRingBuffer<SoakItem, SOAK_QUEUE_SIZE> inputQueue;
+static LatencyHistogram latency;
+static TaskHandle_t producerTask = nullptr;
+static TaskHandle_t consumerTask = nullptr;
+static TaskHandle_t controlTask = nullptr;       // runStep(); both tasks notify it once idle
+static std::atomic<bool> producing(false);
+static std::atomic<bool> consuming(false);
+static std::atomic<uint32_t> stepCount(0);       // Steps started; the consumer acks each once
+static std::atomic<uint32_t> producedCount(0);
+static std::atomic<uint32_t> consumedCount(0);
+static std::atomic<uint32_t> dropCount(0);
+static std::atomic<uint32_t> minFreeHeap(UINT32_MAX);
+static float stepRateHz = 0.0f;
+
+static void sampleHeap() {
+    uint32_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t current = minFreeHeap.load();
+    while (free_bytes < current && !minFreeHeap.compare_exchange_weak(current, free_bytes)) {
+    }
+}
+
+static void producerLoop(void* arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Readings due so far at stepRateHz, generated once per tick
+        SyntheticLightSensor* sensor = sensorSlot.get();
+        uint32_t start_us = micros();
+        uint32_t produced = 0;
+        while (producing.load()) {
+            uint64_t elapsed_us = micros() - start_us;
+            uint32_t due = static_cast<uint32_t>(elapsed_us * stepRateHz / 1e6f);
+            while (produced < due) {
+                SoakItem item = {sensor->read(), micros()};
+                if (!inputQueue.push(item)) {
+                    dropCount++;
+                }
+                produced++;
+            }
+            producedCount.store(produced);
+            xTaskNotifyGive(consumerTask);
+            sampleHeap();
+            vTaskDelay(1);
+        }
+
+        // producedCount is final and the sensor is no longer read
+        xTaskNotifyGive(controlTask);
+    }
+}
+
+static void consumeRun() {
+    static SensorReading readings[MAX_BLOCK_SIZE];
+    static uint32_t queued_us[MAX_BLOCK_SIZE];
+    static SignalAnalysis analyses[MAX_BLOCK_SIZE];
+
+    SignalProcessor* processor = processorSlot.get();
+    EventDetector* detector = detectorSlot.get();
+    DataLogger* logger = loggerSlot.get();
+
+    size_t count = 0;
+    SoakItem item;
+    while (count < MAX_BLOCK_SIZE && inputQueue.pop(item)) {
+        readings[count] = item.reading;
+        queued_us[count] = item.queued_us;
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    // Same order as the firmware: analyse, events, then the readings
+    processor->processBlock(readings, analyses, count);
+    LightEvent events[EventDetector::MAX_EVENTS];
+    size_t logged = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t event_count = detector->update(readings[i], analyses[i], events);
+        if (event_count > 0) {
+            logger->logBlock(readings + logged, i - logged);
+            logged = i;
+            for (size_t e = 0; e < event_count; ++e) {
+                logger->logEvent(events[e], readings[i]);
+            }
+        }
+    }
+    logger->logBlock(readings + logged, count - logged);
+    logger->process();
+
+    uint32_t now_us = micros();
+    for (size_t i = 0; i < count; ++i) {
+        latency.record(now_us - queued_us[i]);
+    }
+    consumedCount += count;
+}
+
+static void consumerLoop(void* arg) {
+    uint32_t acked_steps = 0;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+        if (!consuming.load()) {
+            // stepCount moves only after consuming is set, so this is the end of a step
+            uint32_t steps = stepCount.load();
+            if (acked_steps != steps) {
+                acked_steps = steps;
+                xTaskNotifyGive(controlTask);
+            }
+            continue;
+        }
+        while (!inputQueue.empty()) {
+            consumeRun();
+        }
+    }
+}
+
+static void removeSoakFiles(fs::FS& fs) {
+    // SPIFFS paths are flat names under the prefix; LittleFS has a real directory
+    File dir = fs.open(SOAK_LOG_PATH);
+    bool is_directory = dir && dir.isDirectory();
+    File root = is_directory ? dir : fs.open("/");
+    File file = root.openNextFile();
+    while (file) {
+        char path[MAX_LOG_PATH_LEN + 32];
+        strncpy(path, file.path(), sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        file.close();
+
+        if (is_directory || strncmp(path, SOAK_LOG_PATH, strlen(SOAK_LOG_PATH)) == 0) {
+            fs.remove(path);
+        }
+        file = root.openNextFile();
+    }
+    root.close();
+}
+
+static SyntheticSignalConfig soakSignal(const SyntheticLightSensor& sensor, float rate_hz) {
+    // Mid-scale 0.5 Hz steps with 1% noise and a spike every 500 readings,
+    // kept above the logger's quality threshold
+    SyntheticSignalConfig signal;
+    signal.rate_hz = rate_hz;
+    signal.waveform = SyntheticWaveform::SQUARE;
+    signal.base_lux = sensor.luxForRaw(0.6f);
+    signal.amplitude_lux = sensor.luxForRaw(0.8f) - signal.base_lux;
+    signal.frequency_hz = 0.5f;
+    signal.noise_lux = 0.01f * signal.amplitude_lux;
+    signal.spike_interval = 500;
+    signal.spike_lux = 0.5f * signal.amplitude_lux;
+    return signal;
+}
+
+static SystemConfig soakConfig(const char* preset_name) {
+    SystemConfig config = ConfigPresets::getPreset(preset_name);
+
+    // The synthetic sensor sets the pace; the preset's own sampling would only add idle time
+    config.sensor.sampling_mode = SamplingMode::POLLED;
+    config.sensor.enable_adaptive_sampling = false;
+    strncpy(config.logger.log_file_path, SOAK_LOG_PATH, MAX_LOG_PATH_LEN - 1);
+    config.logger.log_file_path[MAX_LOG_PATH_LEN - 1] = '\0';
+    config.logger.enable_rotation = false;
+    return config;
+}
+
+static void destroyStep() {
+    loggerSlot.destroy();
+    detectorSlot.destroy();
+    processorSlot.destroy();
+    sensorSlot.destroy();
+}
+
+static bool runStep(const SystemConfig& config, float rate_hz, StepResult& result) {
+    SyntheticSignalConfig signal = {rate_hz, SyntheticWaveform::CONSTANT, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0.0f};
+    SyntheticLightSensor* sensor = sensorSlot.emplace(config.sensor, signal);
+    sensor->setSignal(soakSignal(*sensor, rate_hz));
+    SignalProcessor* processor = processorSlot.emplace(config.signal);
+    processor->setCalibration(config.sensor);
+    processor->setSampleRate(rate_hz);
+    detectorSlot.emplace(config.signal);
+    DataLogger* logger = loggerSlot.emplace(config.logger);
+    logger->setCalibration(config.sensor);
+    if (!sensor->initialize() || !logger->initialize()) {
+        destroyStep();
+        return false;
+    }
+
+    inputQueue.clear();
+    latency.reset();
+    producedCount.store(0);
+    consumedCount.store(0);
+    dropCount.store(0);
+    stepRateHz = rate_hz;
+
+    uint32_t start_us = micros();
+    consuming.store(true);
+    stepCount++;
+    producing.store(true);
+    xTaskNotifyGive(producerTask);
+    delay(STEP_MS);
+    producing.store(false);
+    ulTaskNotifyTake(pdFALSE, portMAX_DELAY);  // Producer idle
+
+    // Let the consumer catch up so its backlog counts against this step
+    uint32_t drain_start = millis();
+    while (consumedCount.load() + dropCount.load() < producedCount.load() &&
+           millis() - drain_start < DRAIN_TIMEOUT_MS) {
+        delay(1);
+    }
+    uint32_t elapsed_us = micros() - start_us;
+    consuming.store(false);
+    ulTaskNotifyTake(pdFALSE, portMAX_DELAY);  // Consumer idle: the logger and detector are ours
+    logger->flush();
+
+    DataStats stats = logger->getStats();
+    result.rate_hz = rate_hz;
+    result.readings = consumedCount.load();
+    result.readings_per_sec = elapsed_us > 0 ? result.readings * 1e6f / elapsed_us : 0.0f;
+    result.p50_us = latency.percentile(0.50f);
+    result.p99_us = latency.percentile(0.99f);
+    result.max_us = latency.getMax();
+    result.overflows = stats.buffer_overflow_count;
+    result.drops = producedCount.load() - consumedCount.load();  // Dropped or still queued
+    result.write_errors = stats.write_error_count;
+    result.sustained = result.overflows == 0 && result.drops == 0;
+
+    destroyStep();
+    removeSoakFiles(SegmentDataStorage::filesystem(config.logger.storage_backend));
+    return true;
+}
+
+static void report(const char* preset_name, const StepResult& step) {
+    Serial.printf("soak,%s,%.0f,%s,%lu,%.0f,%lu,%lu,%lu,%lu,%lu,%lu\n", preset_name, step.rate_hz,
+                  step.sustained ? "ok" : "fail",
+                  static_cast<unsigned long>(step.readings), step.readings_per_sec,
+                  static_cast<unsigned long>(step.p50_us), static_cast<unsigned long>(step.p99_us),
+                  static_cast<unsigned long>(step.max_us), static_cast<unsigned long>(step.overflows),
+                  static_cast<unsigned long>(step.drops), static_cast<unsigned long>(step.write_errors));
+}
+
+static void soakPreset(const char* preset_name) {
+    SystemConfig config = soakConfig(preset_name);
+
+    uint32_t start_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    minFreeHeap.store(start_free);
+
+    StepResult best;
+    memset(&best, 0, sizeof(best));
+    for (float rate = START_RATE_HZ; rate <= MAX_RATE_HZ; rate *= RAMP_FACTOR) {
+        StepResult step;
+        if (!runStep(config, rate, step)) {
+            Serial.printf("soak,%s,%.0f,error\n", preset_name, rate);
+            break;
+        }
+        report(preset_name, step);
+        if (!step.sustained) {
+            break;
+        }
+        best = step;
+    }
+
+    uint32_t heap_peak = start_free - std::min(start_free, minFreeHeap.load());
+    Serial.printf("soak_max,%s,%.0f,%.0f,%lu,%lu,%lu,%lu\n", preset_name, best.rate_hz,
+                  best.readings_per_sec, static_cast<unsigned long>(best.p50_us),
+                  static_cast<unsigned long>(best.p99_us), static_cast<unsigned long>(best.max_us),
+                  static_cast<unsigned long>(heap_peak));
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial && millis() < 3000) {
+        delay(10);
+    }
+
+    setCpuFrequencyMhz(240);
+    if (!SPIFFS.begin(true)) {
+        Serial.println("soak,error,spiffs");
+    }
+    removeSoakFiles(SPIFFS);
+
+    // Producer and consumer on different cores, as in the pipeline
+    controlTask = xTaskGetCurrentTaskHandle();
+    BaseType_t producer_core = portNUM_PROCESSORS > 1 ? 1 : tskNO_AFFINITY;
+    BaseType_t consumer_core = portNUM_PROCESSORS > 1 ? 0 : tskNO_AFFINITY;
+    xTaskCreatePinnedToCore(consumerLoop, "soak_consume", TASK_STACK_SIZE, nullptr, 4,
+                            &consumerTask, consumer_core);
+    xTaskCreatePinnedToCore(producerLoop, "soak_produce", TASK_STACK_SIZE, nullptr, 5,
+                            &producerTask, producer_core);
+
+    Serial.println("soak,preset,rate_hz,status,readings,readings_per_sec,p50_us,p99_us,max_us,"
+                   "overflows,drops,write_errors");
+
+    for (const char* preset : PRESETS) {
+        soakPreset(preset);
+    }
+
+    Serial.println("soak,done");
+}
+
+void loop() {
+    delay(1000);
+}
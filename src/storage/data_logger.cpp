@@ -1,15 +1,22 @@
 #include "data_logger.h"
+#include "segment_storage.h"
+#include "rollup_store.h"
+#include "profiler.h"
 #include <Arduino.h>
 #include <SPIFFS.h>
+#include <esp_heap_caps.h>
 #include <cmath>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 
 namespace LightSensor {
 
 // SPIFFSDataStorage Implementation
 SPIFFSDataStorage::SPIFFSDataStorage(const LoggerConfig& config)
-    : config_(config), current_file_size_(0), is_initialized_(false) {
+    : config_(config), current_file_size_(0), is_initialized_(false),
+      reference_voltage_(3.3f), dark_offset_(0.0f), sensitivity_(1.0f),
+      pending_count_(0), skipped_count_(0) {
     memset(current_file_path_, 0, sizeof(current_file_path_));
 }
 
@@ -31,39 +38,92 @@ bool SPIFFSDataStorage::initialize() {
 }
 
 bool SPIFFSDataStorage::write(const SensorReading& data) {
+    LS_PROFILE_SCOPE(STORAGE_WRITE);
+    
     if (!is_initialized_ || !log_file_) {
         return false;
     }
     
-    // Check if rotation is needed
-    if (needsRotation()) {
-        if (!rotateLogFile()) {
-            return false;
-        }
+    if (config_.enable_compression) {
+        return appendPending(data);
     }
     
-    char formatted_data[128];
-    formatReading(data, formatted_data, sizeof(formatted_data));
+    if (!rotateIfNeeded()) {
+        return false;
+    }
     
-    size_t bytes_written = log_file_.println(formatted_data);
-    if (bytes_written == 0) {
+    char encoded[128];
+    size_t length = encodeReading(data, encoded, sizeof(encoded));
+    if (length == 0) {
         return false;
     }
     
-    current_file_size_ += bytes_written;
+    return writeChunk(encoded, length);
+}
+
+bool SPIFFSDataStorage::writeBatch(const SensorReading* data, size_t count) {
+    LS_PROFILE_SCOPE(STORAGE_WRITE_BATCH);
+    
+    if (!is_initialized_ || !log_file_) {
+        return false;
+    }
+    
+    if (config_.enable_compression) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!appendPending(data[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Encode many readings into one chunk so each flash write covers a whole block
+    char chunk[WRITE_CHUNK_SIZE];
+    size_t chunk_len = 0;
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (chunk_len + 128 > sizeof(chunk)) {
+            if (!writeChunk(chunk, chunk_len)) {
+                return false;
+            }
+            chunk_len = 0;
+        }
+        
+        // Rotate before a chunk is encoded, not when it is written: binary
+        // records are deltas against the header of the file they land in
+        if (chunk_len == 0 && !rotateIfNeeded()) {
+            return false;
+        }
+        
+        size_t length = encodeReading(data[i], chunk + chunk_len, sizeof(chunk) - chunk_len);
+        if (length == 0) {
+            // Skip it rather than fail the batch: a retry would hit it again
+            skipped_count_++;
+            continue;
+        }
+        chunk_len += length;
+    }
+    
+    if (chunk_len > 0) {
+        return writeChunk(chunk, chunk_len);
+    }
+    
     return true;
 }
 
 bool SPIFFSDataStorage::flush() {
     if (log_file_) {
+        // A partial block is written as a shorter block
+        bool ok = compressPending();
         log_file_.flush();
-        return true;
+        return ok;
     }
     return true;
 }
 
 void SPIFFSDataStorage::close() {
     if (log_file_) {
+        compressPending();
         log_file_.close();
     }
     is_initialized_ = false;
@@ -73,11 +133,40 @@ size_t SPIFFSDataStorage::getAvailableSpace() const {
     return SPIFFS.totalBytes() - SPIFFS.usedBytes();
 }
 
+void SPIFFSDataStorage::setCalibration(const SensorConfig& sensor) {
+    reference_voltage_ = sensor.reference_voltage;
+    dark_offset_ = sensor.dark_offset;
+    sensitivity_ = sensor.sensitivity;
+}
+
+bool SPIFFSDataStorage::configure(const LoggerConfig& config) {
+    // Path and record format are baked into the open file
+    if (strcmp(config.log_file_path, config_.log_file_path) != 0 ||
+        config.storage_backend != config_.storage_backend ||
+        config.log_format != config_.log_format ||
+        config.enable_compression != config_.enable_compression ||
+        config.enable_timestamp != config_.enable_timestamp) {
+        return false;
+    }
+    
+    // Rotation limits are checked on every write
+    config_ = config;
+    return true;
+}
+
+uint32_t SPIFFSDataStorage::takeSkippedCount() {
+    uint32_t count = skipped_count_;
+    skipped_count_ = 0;
+    return count;
+}
+
 bool SPIFFSDataStorage::createNewLogFile() {
+    bool binary = config_.log_format == LogFormat::BINARY || config_.enable_compression;
+    
     // Generate timestamp-based filename
     uint32_t timestamp = millis();
     snprintf(current_file_path_, sizeof(current_file_path_), 
-             "%s/sensor_%lu.log", config_.log_file_path, timestamp);
+             "%s/sensor_%lu.%s", config_.log_file_path, timestamp, binary ? "bin" : "log");
     
     // Ensure directory exists (SPIFFS doesn't have directories, so just use the path)
     log_file_ = SPIFFS.open(current_file_path_, FILE_WRITE);
@@ -87,34 +176,116 @@ bool SPIFFSDataStorage::createNewLogFile() {
     }
     
     // Write header
-    log_file_.println("# Light Sensor Data Log");
-    log_file_.println("# Format: timestamp_ms,raw_value,lux_value,voltage,quality");
+    if (binary) {
+        BinaryLogHeader header;
+        initBinaryLogHeader(header, timestamp, reference_voltage_, dark_offset_, sensitivity_);
+        if (config_.enable_compression) {
+            // Variable-size blocks instead of fixed records
+            header.record_size = 0;
+            header.flags |= BINARY_LOG_FLAG_COMPRESSED;
+        }
+        log_file_.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        encoder_.reset(timestamp);
+    } else {
+        log_file_.println("# Light Sensor Data Log");
+        log_file_.println("# Format: timestamp_ms,raw_value,lux_value,voltage,quality");
+    }
     
     is_initialized_ = true;
     current_file_size_ = 0;
     return true;
 }
 
+bool SPIFFSDataStorage::writeChunk(const char* data, size_t length) {
+    // Encoded records have been rotated for already; this covers compressed
+    // blocks, which carry their own base timestamp
+    if (!rotateIfNeeded()) {
+        return false;
+    }
+    
+    size_t bytes_written = log_file_.write(reinterpret_cast<const uint8_t*>(data), length);
+    if (bytes_written != length) {
+        return false;
+    }
+    
+    current_file_size_ += bytes_written;
+    return true;
+}
+
+bool SPIFFSDataStorage::appendPending(const SensorReading& reading) {
+    pending_[pending_count_++] = reading;
+    
+    if (pending_count_ >= COMPRESSION_BLOCK_SIZE) {
+        return compressPending();
+    }
+    return true;
+}
+
+bool SPIFFSDataStorage::compressPending() {
+    if (pending_count_ == 0) {
+        return true;
+    }
+    
+    uint8_t block[MAX_COMPRESSED_BLOCK_SIZE];
+    size_t length = BlockCompressor::compress(pending_, pending_count_, block, sizeof(block));
+    
+    // Clear before writing: a rotation inside writeChunk() closes the file
+    pending_count_ = 0;
+    
+    if (length == 0) {
+        return false;
+    }
+    return writeChunk(reinterpret_cast<const char*>(block), length);
+}
+
+size_t SPIFFSDataStorage::encodeReading(const SensorReading& reading, char* buffer, size_t buffer_size) {
+    if (config_.log_format == LogFormat::BINARY) {
+        if (buffer_size < MAX_ENCODED_READING_SIZE) {
+            return 0;
+        }
+        return encoder_.encode(reading, reinterpret_cast<uint8_t*>(buffer));
+    }
+    
+    // CSV line terminated like Print::println()
+    if (buffer_size < 2) {
+        return 0;
+    }
+    int len = formatReading(reading, buffer, buffer_size - 2);
+    if (len < 0 || static_cast<size_t>(len) >= buffer_size - 2) {
+        return 0;
+    }
+    buffer[len++] = '\r';
+    buffer[len++] = '\n';
+    return static_cast<size_t>(len);
+}
+
 bool SPIFFSDataStorage::needsRotation() const {
     return config_.enable_rotation && 
            current_file_size_ > config_.max_file_size_bytes;
 }
 
+bool SPIFFSDataStorage::rotateIfNeeded() {
+    if (needsRotation()) {
+        return rotateLogFile();
+    }
+    return true;
+}
+
 bool SPIFFSDataStorage::rotateLogFile() {
     close();
     return createNewLogFile();
 }
 
-void SPIFFSDataStorage::formatReading(const SensorReading& reading, char* buffer, size_t buffer_size) const {
+int SPIFFSDataStorage::formatReading(const SensorReading& reading, char* buffer, size_t buffer_size) const {
     if (config_.enable_timestamp) {
-        snprintf(buffer, buffer_size, "%lu,%.6f,%.6f,%.6f,%u",
+        return snprintf(buffer, buffer_size, "%lu,%.6f,%.6f,%.6f,%u",
                  reading.timestamp_ms,
                  reading.raw_value,
                  reading.lux_value,
                  reading.voltage,
                  reading.quality);
     } else {
-        snprintf(buffer, buffer_size, "%.6f,%.6f,%.6f,%u",
+        return snprintf(buffer, buffer_size, "%.6f,%.6f,%.6f,%u",
                  reading.raw_value,
                  reading.lux_value,
                  reading.voltage,
@@ -122,12 +293,87 @@ void SPIFFSDataStorage::formatReading(const SensorReading& reading, char* buffer
     }
 }
 
+// HistoryView Implementation
+static_assert(sizeof(CompactReading) == 11, "CompactReading must stay packed");
+
+HistoryView::HistoryView()
+    : first_{nullptr, 0}, second_{nullptr, 0}, reference_voltage_(3.3f) {
+}
+
+HistoryView::HistoryView(const CompactSpan& first, const CompactSpan& second, float reference_voltage)
+    : first_(first), second_(second), reference_voltage_(reference_voltage) {
+    
+    // An empty second span starts where the first ends, so end() is reached without a jump
+    if (second_.size == 0) {
+        second_.data = first_.data + first_.size;
+    }
+}
+
+HistoryView::Iterator HistoryView::begin() const {
+    const CompactReading* first_end = first_.data + first_.size;
+    return Iterator(first_.size > 0 ? first_.data : second_.data, first_end, second_.data);
+}
+
+HistoryView::Iterator HistoryView::end() const {
+    const CompactReading* second_end = second_.data + second_.size;
+    return Iterator(second_end, second_end, second_end);
+}
+
+SensorReading HistoryView::decode(const CompactReading& reading) const {
+    SensorReading decoded;
+    decoded.timestamp_ms = reading.timestamp_ms;
+    decoded.raw_value = reading.raw_code / 65535.0f;
+    decoded.raw_q16 = reading.raw_code;
+    decoded.lux_value = reading.lux;
+    decoded.voltage = decoded.raw_value * reference_voltage_;
+    decoded.is_valid = (reading.quality & COMPACT_INVALID_FLAG) == 0;
+    decoded.quality = reading.quality & ~COMPACT_INVALID_FLAG;
+    return decoded;
+}
+
 // MemoryDataStorage Implementation
 MemoryDataStorage::MemoryDataStorage(const LoggerConfig& config)
-    : config_(config), buffer_head_(0), buffer_count_(0), is_initialized_(false) {
+    : config_(config), data_buffer_(nullptr), slots_(0), in_psram_(false),
+      write_index_(0), base_index_(0), is_initialized_(false), reference_voltage_(3.3f) {
+}
+
+MemoryDataStorage::~MemoryDataStorage() {
+    heap_caps_free(data_buffer_);
 }
 
 bool MemoryDataStorage::initialize() {
+    if (is_initialized_) {
+        return true;
+    }
+    
+    // The ring is kept across close(), so a reopen does not fragment PSRAM
+    if (!data_buffer_) {
+        // requestedCapacity() is bounded, so the shift cannot overflow
+        size_t requested = requestedCapacity(config_);
+        size_t slots = 1;
+        while (slots < requested && slots < MAX_HISTORY_SIZE) {
+            slots <<= 1;
+        }
+        
+        while (slots > 0) {
+            size_t bytes = slots * sizeof(CompactReading);
+            data_buffer_ = static_cast<CompactReading*>(heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+            in_psram_ = data_buffer_ != nullptr;
+            if (!data_buffer_ && slots <= MAX_INTERNAL_SIZE) {
+                data_buffer_ = static_cast<CompactReading*>(heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            }
+            if (data_buffer_) {
+                break;
+            }
+            slots >>= 1;
+        }
+        
+        if (!data_buffer_) {
+            return false;
+        }
+        slots_ = slots;
+    }
+    
     is_initialized_ = true;
     return true;
 }
@@ -137,15 +383,24 @@ bool MemoryDataStorage::write(const SensorReading& data) {
         return false;
     }
     
-    size_t actual_buffer_size = config_.buffer_size < MAX_BUFFER_SIZE ? 
-                                 config_.buffer_size : MAX_BUFFER_SIZE;
+    // Oldest entries are overwritten once capacity() readings are stored
+    size_t index = write_index_.load(std::memory_order_relaxed);
+    data_buffer_[index & (slots_ - 1)] = encode(data);
+    write_index_.store(index + 1, std::memory_order_release);
     
-    data_buffer_[buffer_head_] = data;
-    buffer_head_ = (buffer_head_ + 1) % actual_buffer_size;
+    return true;
+}
+
+bool MemoryDataStorage::writeBatch(const SensorReading* data, size_t count) {
+    if (!is_initialized_) {
+        return false;
+    }
     
-    if (buffer_count_ < actual_buffer_size) {
-        buffer_count_++;
+    size_t index = write_index_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        data_buffer_[(index + i) & (slots_ - 1)] = encode(data[i]);
     }
+    write_index_.store(index + count, std::memory_order_release);
     
     return true;
 }
@@ -160,46 +415,106 @@ void MemoryDataStorage::close() {
 }
 
 size_t MemoryDataStorage::getAvailableSpace() const {
-    size_t actual_buffer_size = config_.buffer_size < MAX_BUFFER_SIZE ? 
-                                 config_.buffer_size : MAX_BUFFER_SIZE;
-    return actual_buffer_size - buffer_count_;
+    return capacity() - getDataCount();
 }
 
-size_t MemoryDataStorage::getDataCount() const {
-    return buffer_count_;
+void MemoryDataStorage::setCalibration(const SensorConfig& sensor) {
+    // Applied when readings are decoded
+    reference_voltage_ = sensor.reference_voltage;
 }
 
-bool MemoryDataStorage::getData(size_t index, SensorReading& reading) const {
-    if (index >= buffer_count_) {
+bool MemoryDataStorage::configure(const LoggerConfig& config) {
+    // Growing past the allocated ring needs a new one
+    if (data_buffer_ && requestedCapacity(config) > slots_) {
         return false;
     }
     
-    size_t actual_buffer_size = config_.buffer_size < MAX_BUFFER_SIZE ? 
-                                 config_.buffer_size : MAX_BUFFER_SIZE;
-    size_t actual_index = (buffer_head_ - buffer_count_ + index + actual_buffer_size) % actual_buffer_size;
-    reading = data_buffer_[actual_index];
+    // Pin the retained count so a larger buffer does not resurrect
+    // readings that had already been evicted
+    base_index_ = write_index_.load(std::memory_order_acquire) - getDataCount();
+    config_ = config;
     return true;
 }
 
+size_t MemoryDataStorage::getDataCount() const {
+    size_t written = write_index_.load(std::memory_order_acquire) - base_index_;
+    size_t cap = capacity();
+    return written < cap ? written : cap;
+}
+
+HistoryView MemoryDataStorage::getHistory() const {
+    if (!data_buffer_) {
+        return HistoryView();
+    }
+    
+    size_t end = write_index_.load(std::memory_order_acquire);
+    size_t written = end - base_index_;
+    size_t count = written < capacity() ? written : capacity();
+    
+    // Split where the ring wraps
+    size_t start = (end - count) & (slots_ - 1);
+    size_t to_end = slots_ - start;
+    CompactSpan first = {data_buffer_ + start, count < to_end ? count : to_end};
+    CompactSpan second = {data_buffer_, count - first.size};
+    return HistoryView(first, second, reference_voltage_);
+}
+
 void MemoryDataStorage::clear() {
-    buffer_head_ = 0;
-    buffer_count_ = 0;
+    base_index_ = write_index_.load(std::memory_order_acquire);
+}
+
+size_t MemoryDataStorage::capacity() const {
+    // Keep the newest readings that fit; every slot index is still masked
+    size_t requested = requestedCapacity(config_);
+    return requested < slots_ ? requested : slots_;
+}
+
+bool MemoryDataStorage::isInPsram() const {
+    return in_psram_;
+}
+
+size_t MemoryDataStorage::requestedCapacity(const LoggerConfig& config) {
+    if (config.history_size > 0) {
+        return config.history_size < MAX_HISTORY_SIZE ? config.history_size : MAX_HISTORY_SIZE;
+    }
+    return config.buffer_size < MAX_BUFFER_SIZE ? config.buffer_size : MAX_BUFFER_SIZE;
+}
+
+CompactReading MemoryDataStorage::encode(const SensorReading& reading) {
+    float raw = reading.raw_value < 0.0f ? 0.0f : (reading.raw_value > 1.0f ? 1.0f : reading.raw_value);
+    
+    CompactReading compact;
+    compact.timestamp_ms = reading.timestamp_ms;
+    compact.raw_code = static_cast<uint16_t>(lroundf(raw * 65535.0f));
+    compact.lux = reading.lux_value;
+    compact.quality = (reading.quality & ~COMPACT_INVALID_FLAG) | (reading.is_valid ? 0 : COMPACT_INVALID_FLAG);
+    return compact;
 }
 
 // DataLogger Implementation
 DataLogger::DataLogger(const LoggerConfig& config)
     : config_(config), storage_(nullptr), owns_storage_(false),
-      buffer_head_(0), buffer_tail_(0), buffer_count_(0),
+      has_calibration_(false), rollups_(nullptr),
+      async_flush_(false), swap_buffers_{nullptr, nullptr},
+      fill_index_(0), fill_count_(0), drain_index_(0), drain_count_(0),
+      flush_task_stop_(false), flush_task_running_(false), write_error_count_(0),
+      storage_write_time_us_(0),
+      flush_task_(nullptr), storage_mutex_(nullptr),
       is_logging_(false), should_stop_(false),
       sensor_(nullptr), last_log_time_ms_(0) {
     
     // Initialize statistics
-    stats_ = {0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0};
+    stats_ = {0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0, 0, 0, 0, 0};
+    
+    exception_filter_.configure(config_.exception_mode, config_.exception_deviation_lux,
+                                config_.exception_max_interval_ms);
 }
 
 DataLogger::~DataLogger() {
     stopLogging();
+    stopFlushTask();
     flush();
+    stopRollups();
     
     if (owns_storage_ && storage_) {
         delete storage_;
@@ -208,12 +523,28 @@ DataLogger::~DataLogger() {
 
 bool DataLogger::initialize() {
     if (!storage_) {
-        // Create default SPIFFS storage
-        storage_ = new SPIFFSDataStorage(config_);
+        // Create the configured flash storage
+        storage_ = createStorage(config_);
         owns_storage_ = true;
     }
     
-    return storage_->initialize();
+    if (has_calibration_) {
+        storage_->setCalibration(calibration_);
+    }
+    
+    if (!storage_->initialize()) {
+        return false;
+    }
+    
+    // Rollups are optional; the raw log works without them
+    startRollups();
+    
+    // Fall back to synchronous flushing if the task cannot be created
+    if (config_.enable_async_flush) {
+        startFlushTask();
+    }
+    
+    return true;
 }
 
 bool DataLogger::logReading(const SensorReading& reading) {
@@ -222,17 +553,73 @@ bool DataLogger::logReading(const SensorReading& reading) {
         return true;  // Filtered out, but not an error
     }
     
-    if (!enqueue(reading)) {
-        stats_.buffer_overflow_count++;
+    rollUp(reading);
+    if (!enqueueFiltered(reading)) {
         return false;  // Buffer overflow
     }
     
+    // Counted even if the exception filter did not store it
     updateStats(reading);
     processBuffer();
     
     return true;
 }
 
+bool DataLogger::logBlock(const SensorReading* readings, size_t count) {
+    bool all_queued = true;
+    
+    for (size_t i = 0; i < count; ++i) {
+        const SensorReading& reading = readings[i];
+        
+        if (!shouldLogReading(reading)) {
+            stats_.filtered_readings++;
+            continue;
+        }
+        
+        rollUp(reading);
+        if (!enqueueFiltered(reading)) {
+            all_queued = false;
+            continue;
+        }
+        
+        updateStats(reading);
+        
+        // Drain early if the block is larger than the flush window
+        // (async mode swaps buffers inside enqueue() instead)
+        if (!async_flush_ && queue_.full()) {
+            flush();
+        }
+    }
+    
+    processBuffer();
+    return all_queued;
+}
+
+bool DataLogger::logEvent(const LightEvent& event, const SensorReading& reading) {
+    stats_.event_count++;
+    
+    bool ok = true;
+    if (!event_queue_.push(event)) {
+        // Write the waiting events out rather than lose the new one
+        if (async_flush_) {
+            xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+        }
+        writeEvents();
+        if (async_flush_) {
+            xSemaphoreGive(storage_mutex_);
+        }
+        ok = event_queue_.push(event);
+    }
+    
+    if (!shouldLogReading(reading)) {
+        return ok;
+    }
+    
+    SensorReading kept[ExceptionFilter::MAX_OUTPUT];
+    size_t count = exception_filter_.force(reading, kept);
+    return enqueueAll(kept, count) && ok;
+}
+
 void DataLogger::startLogging(ILightSensor* sensor) {
     if (is_logging_ || !sensor) {
         return;
@@ -257,37 +644,237 @@ void DataLogger::stopLogging() {
 }
 
 bool DataLogger::flush() {
+    LS_PROFILE_SCOPE(LOGGER_FLUSH);
+    
     if (!storage_) {
         return false;
     }
     
-    SensorReading reading;
-    while (dequeue(reading)) {
-        if (!storage_->write(reading)) {
+    // The reading held back by the swinging door goes out with this flush
+    SensorReading held;
+    if (exception_filter_.close(&held) == 1) {
+        enqueueAll(&held, 1);
+    }
+    
+    if (async_flush_) {
+        // Let the writer finish its buffer, then write ours in this task
+        waitForWriter();
+        xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+        uint32_t start_us = micros();
+        bool ok = fill_count_ == 0 || writeToStorage(swap_buffers_[fill_index_], fill_count_);
+        if (ok) {
+            fill_count_ = 0;
+        }
+        storage_->flush();
+        if (!writeEvents()) {
+            write_error_count_++;
+        }
+        storage_write_time_us_ += micros() - start_us;
+        xSemaphoreGive(storage_mutex_);
+        return ok;
+    }
+    
+    // Hand the queue to storage as at most two contiguous runs
+    uint32_t start_us = micros();
+    const SensorReading* run;
+    size_t run_length;
+    while ((run_length = queue_.peekContiguous(run)) > 0) {
+        if (!writeToStorage(run, run_length)) {
+            storage_write_time_us_ += micros() - start_us;
             return false;
         }
+        queue_.consume(run_length);
     }
     
     storage_->flush();
+    if (!writeEvents()) {
+        write_error_count_++;
+    }
+    storage_write_time_us_ += micros() - start_us;
     return true;
 }
 
+bool DataLogger::sync() {
+    bool ok = flush();
+    if (!storage_) {
+        return false;
+    }
+    
+    if (async_flush_) {
+        xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+    }
+    ok = storage_->sync() && ok;
+    if (async_flush_) {
+        xSemaphoreGive(storage_mutex_);
+    }
+    return ok;
+}
+
 DataStats DataLogger::getStats() const {
     DataStats current_stats = stats_;
-    current_stats.current_buffer_size = buffer_count_;
+    current_stats.current_buffer_size = async_flush_ ? fill_count_ + drain_count_.load() : queue_.size();
+    current_stats.write_error_count = write_error_count_.load();
+    current_stats.storage_write_time_us = storage_write_time_us_.load();
     return current_stats;
 }
 
 void DataLogger::configure(const LoggerConfig& config) {
-    config_ = config;
+    // Thresholds, filters and rotation limits apply in place; only a new
+    // file layout needs the storage re-created
+    bool recreate = false;
+    bool recreate_rollups = false;
+    if (storage_) {
+        if (async_flush_) {
+            xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+        }
+        recreate = !storage_->configure(config) && owns_storage_;
+        recreate_rollups = rollups_ ? !rollups_->configure(config) : config.enable_rollups;
+        if (async_flush_) {
+            xSemaphoreGive(storage_mutex_);
+        }
+    }
+    
+    // The writer task must not touch storage while it is replaced
+    bool restart_writer = recreate || config.enable_async_flush != config_.enable_async_flush;
+    if (restart_writer) {
+        stopFlushTask();
+    }
     
-    // Reinitialize storage if needed
-    if (storage_ && owns_storage_) {
+    if (recreate) {
+        // Pending readings belong in the old file
+        flush();
         storage_->close();
         delete storage_;
-        storage_ = new SPIFFSDataStorage(config_);
+        storage_ = createStorage(config);
+        if (has_calibration_) {
+            storage_->setCalibration(calibration_);
+        }
         storage_->initialize();
     }
+    
+    if (recreate_rollups) {
+        stopRollups();  // Readings are rolled up as they are logged; nothing is pending
+    }
+    
+    bool exception_changed = config.exception_mode != config_.exception_mode ||
+                             config.exception_deviation_lux != config_.exception_deviation_lux ||
+                             config.exception_max_interval_ms != config_.exception_max_interval_ms;
+    if (exception_changed) {
+        // Close the corridor under the old settings
+        flush();
+        exception_filter_.configure(config.exception_mode, config.exception_deviation_lux,
+                                    config.exception_max_interval_ms);
+    }
+    
+    config_ = config;
+    
+    if (recreate_rollups) {
+        startRollups();
+    }
+    
+    if (restart_writer && storage_ && config_.enable_async_flush) {
+        startFlushTask();
+    }
+}
+
+size_t DataLogger::query(uint64_t from_ms, uint64_t to_ms, const QueryCallback& callback) {
+    if (!storage_) {
+        return 0;
+    }
+    
+    // Queued readings would otherwise be missing from the result
+    flush();
+    
+    if (async_flush_) {
+        xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+    }
+    size_t delivered = storage_->query(from_ms, to_ms, callback);
+    if (async_flush_) {
+        xSemaphoreGive(storage_mutex_);
+    }
+    return delivered;
+}
+
+size_t DataLogger::queryRollups(RollupTier tier, uint64_t from_ms, uint64_t to_ms,
+                                const RollupCallback& callback) {
+    if (!rollups_) {
+        return 0;
+    }
+    
+    // Readings are rolled up as they are logged, so the open buckets are current
+    return rollups_->query(tier, from_ms, to_ms, callback);
+}
+
+size_t DataLogger::getSealedSegments(uint32_t after_sequence, SegmentSummary* segments, size_t max_count) {
+    if (!storage_ || !owns_storage_ || config_.storage_backend == StorageBackend::FILES) {
+        return 0;
+    }
+    
+    // The writer task seals segments and edits the manifest
+    if (async_flush_) {
+        xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+    }
+    const SegmentDataStorage* store = static_cast<const SegmentDataStorage*>(storage_);
+    size_t count = 0;
+    SegmentSummary summary;
+    for (size_t i = 0; i < store->getSegmentCount() && count < max_count; ++i) {
+        if (store->getSegment(i, summary) && summary.sequence > after_sequence) {
+            segments[count++] = summary;
+        }
+    }
+    if (async_flush_) {
+        xSemaphoreGive(storage_mutex_);
+    }
+    return count;
+}
+
+File DataLogger::openSegment(uint32_t sequence) const {
+    char path[MAX_LOG_PATH_LEN + 24];
+    SegmentDataStorage::formatSegmentPath(config_.log_file_path, sequence, path, sizeof(path));
+    return SegmentDataStorage::filesystem(config_.storage_backend).open(path, FILE_READ);
+}
+
+IDataStorage* DataLogger::createStorage(const LoggerConfig& config) {
+    if (config.storage_backend != StorageBackend::FILES) {
+        return new SegmentDataStorage(config);
+    }
+    return new SPIFFSDataStorage(config);
+}
+
+bool DataLogger::writeToStorage(const SensorReading* data, size_t count) {
+    if (!storage_->writeBatch(data, count)) {
+        return false;
+    }
+    write_error_count_ += storage_->takeSkippedCount();
+    return true;
+}
+
+void DataLogger::rollUp(const SensorReading& reading) {
+    // Ahead of the exception filter, so the summaries cover every accepted
+    // reading; only the logging side touches the rollups, never the writer task
+    if (rollups_) {
+        rollups_->addBatch(&reading, 1);
+    }
+}
+
+void DataLogger::startRollups() {
+    if (rollups_ || !config_.enable_rollups) {
+        return;
+    }
+    
+    rollups_ = new RollupStore(config_);
+    if (!rollups_->initialize()) {
+        delete rollups_;
+        rollups_ = nullptr;
+    }
+}
+
+void DataLogger::stopRollups() {
+    if (rollups_) {
+        rollups_->close();
+        delete rollups_;
+        rollups_ = nullptr;
+    }
 }
 
 void DataLogger::setStorage(IDataStorage* storage) {
@@ -295,6 +882,8 @@ void DataLogger::setStorage(IDataStorage* storage) {
         stopLogging();
     }
     
+    stopFlushTask();
+    
     if (owns_storage_ && storage_) {
         delete storage_;
     }
@@ -303,7 +892,24 @@ void DataLogger::setStorage(IDataStorage* storage) {
     owns_storage_ = false;
     
     if (storage_) {
+        if (has_calibration_) {
+            storage_->setCalibration(calibration_);
+        }
         storage_->initialize();
+        startRollups();
+        
+        if (config_.enable_async_flush) {
+            startFlushTask();
+        }
+    }
+}
+
+void DataLogger::setCalibration(const SensorConfig& sensor) {
+    calibration_ = sensor;
+    has_calibration_ = true;
+    
+    if (storage_) {
+        storage_->setCalibration(sensor);
     }
 }
 
@@ -312,7 +918,7 @@ void DataLogger::process() {
         uint32_t now = millis();
         
         // Check if it's time for next reading
-        if (now - last_log_time_ms_ >= 1000) {
+        if (now - last_log_time_ms_ >= LOG_INTERVAL_MS) {
             SensorReading reading = sensor_->read();
             logReading(reading);
             last_log_time_ms_ = now;
@@ -364,33 +970,231 @@ void DataLogger::updateStats(const SensorReading& reading) {
 }
 
 void DataLogger::processBuffer() {
-    if (buffer_count_ >= config_.flush_threshold) {
+    if (async_flush_) {
+        // Hand the buffer to the writer; if it is still busy keep filling
+        if (fill_count_ >= config_.flush_threshold) {
+            swapBuffers();
+        }
+        return;
+    }
+    
+    if (queue_.size() >= config_.flush_threshold) {
         flush();
     }
 }
 
+bool DataLogger::enqueueFiltered(const SensorReading& reading) {
+    SensorReading kept[ExceptionFilter::MAX_OUTPUT];
+    size_t count = exception_filter_.add(reading, kept);
+    stats_.exception_readings++;
+    return enqueueAll(kept, count);
+}
+
+bool DataLogger::enqueueAll(const SensorReading* readings, size_t count) {
+    // Readings in minus readings out of the exception filter
+    stats_.exception_readings -= count;
+    
+    bool all_queued = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (!enqueue(readings[i])) {
+            stats_.buffer_overflow_count++;
+            all_queued = false;
+        }
+    }
+    return all_queued;
+}
+
 bool DataLogger::enqueue(const SensorReading& reading) {
-    if (buffer_count_ >= MAX_QUEUE_SIZE) {
+    if (async_flush_) {
+        if (fill_count_ >= MAX_QUEUE_SIZE && !swapBuffers()) {
+            return false;
+        }
+        swap_buffers_[fill_index_][fill_count_++] = reading;
+        return true;
+    }
+    
+    return queue_.push(reading);
+}
+
+bool DataLogger::dequeue(SensorReading& reading) {
+    return queue_.pop(reading);
+}
+
+bool DataLogger::writeEvents() {
+    if (event_queue_.empty()) {
+        return true;
+    }
+    
+    fs::FS& fs = SegmentDataStorage::filesystem(config_.storage_backend);
+    char path[MAX_LOG_PATH_LEN + 16];
+    eventLogPath(EVENT_LOG_NAME, path, sizeof(path));
+    
+    // Keep one older generation once the log is full
+    if (fs.exists(path)) {
+        File existing = fs.open(path, FILE_READ);
+        size_t size = existing ? existing.size() : 0;
+        existing.close();
+        if (size >= MAX_EVENT_LOG_SIZE) {
+            char old_path[MAX_LOG_PATH_LEN + 16];
+            eventLogPath(EVENT_LOG_OLD_NAME, old_path, sizeof(old_path));
+            fs.remove(old_path);
+            fs.rename(path, old_path);
+        }
+    }
+    
+    bool created = !fs.exists(path);
+    File file = fs.open(path, FILE_APPEND);
+    if (!file) {
+        return false;
+    }
+    
+    bool ok = true;
+    if (created) {
+        EventLogHeader header = {EVENT_LOG_MAGIC, EVENT_LOG_VERSION, sizeof(EventLogRecord)};
+        ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+    }
+    
+    LightEvent event;
+    while (ok && event_queue_.pop(event)) {
+        EventLogRecord record;
+        record.timestamp_ms = event.timestamp_ms;
+        record.type = static_cast<uint8_t>(event.type);
+        record.lux = event.lux;
+        record.value = event.value;
+        ok = file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record)) == sizeof(record);
+    }
+    file.close();
+    return ok;
+}
+
+void DataLogger::eventLogPath(const char* name, char* buffer, size_t buffer_size) const {
+    snprintf(buffer, buffer_size, "%s/%s", config_.log_file_path, name);
+}
+
+bool DataLogger::startFlushTask() {
+    if (async_flush_ || !storage_) {
+        return async_flush_;
+    }
+    
+    swap_buffers_[0] = new SensorReading[MAX_QUEUE_SIZE];
+    swap_buffers_[1] = new SensorReading[MAX_QUEUE_SIZE];
+    storage_mutex_ = xSemaphoreCreateMutex();
+    if (!swap_buffers_[0] || !swap_buffers_[1] || !storage_mutex_) {
+        stopFlushTask();
         return false;
     }
     
-    buffer_[buffer_tail_] = reading;
-    buffer_tail_ = (buffer_tail_ + 1) % MAX_QUEUE_SIZE;
-    buffer_count_++;
+    // Readings already queued move into the first fill buffer
+    fill_index_ = 0;
+    fill_count_ = 0;
+    while (fill_count_ < MAX_QUEUE_SIZE && dequeue(swap_buffers_[0][fill_count_])) {
+        fill_count_++;
+    }
+    drain_count_.store(0);
+    flush_task_stop_.store(false);
+    flush_task_running_.store(true);
     
+    // Run the writer on the core the caller is NOT using
+    BaseType_t core = portNUM_PROCESSORS > 1 ? 1 - xPortGetCoreID() : tskNO_AFFINITY;
+    if (xTaskCreatePinnedToCore(flushTaskEntry, "log_flush", FLUSH_TASK_STACK_SIZE, this,
+                                FLUSH_TASK_PRIORITY, &flush_task_, core) != pdPASS) {
+        flush_task_running_.store(false);
+        flush_task_ = nullptr;
+        for (size_t i = 0; i < fill_count_; ++i) {
+            enqueue(swap_buffers_[0][i]);
+        }
+        fill_count_ = 0;
+        stopFlushTask();
+        return false;
+    }
+    
+    async_flush_ = true;
     return true;
 }
 
-bool DataLogger::dequeue(SensorReading& reading) {
-    if (buffer_count_ == 0) {
+void DataLogger::stopFlushTask() {
+    if (async_flush_) {
+        // Write out both buffers before the task goes away
+        flush();
+        
+        flush_task_stop_.store(true);
+        xTaskNotifyGive(flush_task_);
+        while (flush_task_running_.load()) {
+            vTaskDelay(1);
+        }
+        flush_task_ = nullptr;
+        async_flush_ = false;
+    }
+    
+    delete[] swap_buffers_[0];
+    delete[] swap_buffers_[1];
+    swap_buffers_[0] = nullptr;
+    swap_buffers_[1] = nullptr;
+    
+    if (storage_mutex_) {
+        vSemaphoreDelete(storage_mutex_);
+        storage_mutex_ = nullptr;
+    }
+}
+
+bool DataLogger::swapBuffers() {
+    if (fill_count_ == 0) {
+        return true;
+    }
+    
+    // Writer still busy with the other buffer
+    if (drain_count_.load() != 0) {
         return false;
     }
     
-    reading = buffer_[buffer_head_];
-    buffer_head_ = (buffer_head_ + 1) % MAX_QUEUE_SIZE;
-    buffer_count_--;
+    drain_index_ = fill_index_;
+    drain_count_.store(fill_count_);
+    fill_index_ ^= 1;
+    fill_count_ = 0;
     
+    xTaskNotifyGive(flush_task_);
     return true;
 }
 
+void DataLogger::waitForWriter() const {
+    while (drain_count_.load() != 0) {
+        vTaskDelay(1);
+    }
+}
+
+void DataLogger::flushTaskLoop() {
+    while (!flush_task_stop_.load()) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        size_t count = drain_count_.load();
+        if (count == 0) {
+            continue;
+        }
+        
+        xSemaphoreTake(storage_mutex_, portMAX_DELAY);
+        uint32_t start_us = micros();
+        bool written = writeToStorage(swap_buffers_[drain_index_], count);
+        bool flushed = storage_->flush();
+        storage_write_time_us_ += micros() - start_us;
+        xSemaphoreGive(storage_mutex_);
+        
+        // The buffer is released either way, so a failed write loses all of it
+        if (!written) {
+            write_error_count_ += count;
+        } else if (!flushed) {
+            write_error_count_++;
+        }
+        
+        // Releases the buffer back to the sampling side
+        drain_count_.store(0);
+    }
+    
+    flush_task_running_.store(false);
+    vTaskDelete(nullptr);
+}
+
+void DataLogger::flushTaskEntry(void* arg) {
+    static_cast<DataLogger*>(arg)->flushTaskLoop();
+}
+
 }  // namespace LightSensor
@@ -0,0 +1,131 @@
+#include "exception_filter.h"
+#include <cfloat>
+#include <cmath>
+
+namespace LightSensor {
+
+static bool sameReading(const SensorReading& a, const SensorReading& b) {
+    return a.timestamp_ms == b.timestamp_ms && a.lux_value == b.lux_value && a.raw_value == b.raw_value;
+}
+
+ExceptionFilter::ExceptionFilter()
+    : mode_(ExceptionMode::OFF), deviation_(0.0f), max_interval_ms_(0),
+      has_pivot_(false), pivot_(), has_held_(false), held_(),
+      upper_slope_(FLT_MAX), lower_slope_(-FLT_MAX) {
+}
+
+void ExceptionFilter::configure(ExceptionMode mode, float deviation_lux, uint32_t max_interval_ms) {
+    mode_ = mode;
+    deviation_ = deviation_lux > 0.0f ? deviation_lux : 0.0f;
+    max_interval_ms_ = max_interval_ms;
+    reset();
+}
+
+size_t ExceptionFilter::add(const SensorReading& reading, SensorReading* out) {
+    if (mode_ == ExceptionMode::OFF) {
+        out[0] = reading;
+        return 1;
+    }
+
+    if (!has_pivot_) {
+        return restart(reading, out);
+    }
+
+    if (isDuplicate(reading)) {
+        return 0;
+    }
+
+    uint32_t elapsed_ms = reading.timestamp_ms - pivot_.timestamp_ms;
+    if (max_interval_ms_ > 0 && elapsed_ms >= max_interval_ms_) {
+        return restart(reading, out);
+    }
+
+    if (mode_ == ExceptionMode::DEADBAND) {
+        if (fabsf(reading.lux_value - pivot_.lux_value) <= deviation_) {
+            return 0;
+        }
+        return restart(reading, out);
+    }
+
+    // Readings in the same millisecond as the pivot count as 1 ms apart
+    float dt = static_cast<float>(elapsed_ms > 0 ? elapsed_ms : 1);
+    float upper = fminf(upper_slope_, (reading.lux_value + deviation_ - pivot_.lux_value) / dt);
+    float lower = fmaxf(lower_slope_, (reading.lux_value - deviation_ - pivot_.lux_value) / dt);
+
+    // The line from the pivot to this reading must fit every reading since
+    // the pivot, or the previous reading ends the segment
+    float slope = (reading.lux_value - pivot_.lux_value) / dt;
+    if (slope >= lower && slope <= upper) {
+        upper_slope_ = upper;
+        lower_slope_ = lower;
+        held_ = reading;
+        has_held_ = true;
+        return 0;
+    }
+
+    out[0] = held_;
+    pivot_ = held_;
+    openDoors(reading);
+    return 1;
+}
+
+size_t ExceptionFilter::force(const SensorReading& reading, SensorReading* out) {
+    if (mode_ == ExceptionMode::OFF || (has_pivot_ && isDuplicate(reading))) {
+        return 0;
+    }
+    return restart(reading, out);
+}
+
+size_t ExceptionFilter::close(SensorReading* out) {
+    if (!has_held_) {
+        return 0;
+    }
+
+    out[0] = held_;
+    pivot_ = held_;
+    has_held_ = false;
+    upper_slope_ = FLT_MAX;
+    lower_slope_ = -FLT_MAX;
+    return 1;
+}
+
+void ExceptionFilter::reset() {
+    has_pivot_ = false;
+    has_held_ = false;
+    upper_slope_ = FLT_MAX;
+    lower_slope_ = -FLT_MAX;
+}
+
+bool ExceptionFilter::isEnabled() const {
+    return mode_ != ExceptionMode::OFF;
+}
+
+size_t ExceptionFilter::restart(const SensorReading& reading, SensorReading* out) {
+    size_t count = 0;
+    if (has_held_ && !sameReading(held_, reading)) {
+        out[count++] = held_;
+    }
+    out[count++] = reading;
+
+    pivot_ = reading;
+    has_pivot_ = true;
+    has_held_ = false;
+    upper_slope_ = FLT_MAX;
+    lower_slope_ = -FLT_MAX;
+    return count;
+}
+
+void ExceptionFilter::openDoors(const SensorReading& reading) {
+    uint32_t elapsed_ms = reading.timestamp_ms - pivot_.timestamp_ms;
+    float dt = static_cast<float>(elapsed_ms > 0 ? elapsed_ms : 1);
+    upper_slope_ = (reading.lux_value + deviation_ - pivot_.lux_value) / dt;
+    lower_slope_ = (reading.lux_value - deviation_ - pivot_.lux_value) / dt;
+    held_ = reading;
+    has_held_ = true;
+}
+
+bool ExceptionFilter::isDuplicate(const SensorReading& reading) const {
+    return sameReading(pivot_, reading);
+}
+
+}  // namespace LightSensor
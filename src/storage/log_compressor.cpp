@@ -0,0 +1,302 @@
+#include "log_compressor.h"
+#include <cstring>
+#include <cmath>
+
+namespace LightSensor {
+
+static inline uint32_t zigzagEncode(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+static inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bitsToFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint16_t quantiseRaw(float raw_value) {
+    float raw = raw_value < 0.0f ? 0.0f : (raw_value > 1.0f ? 1.0f : raw_value);
+    return static_cast<uint16_t>(lroundf(raw * 65535.0f));
+}
+
+static inline uint32_t quantiseLux(float lux_value) {
+    return floatBits(lux_value) & ~((1u << LUX_MANTISSA_DROP_BITS) - 1);
+}
+
+// BitWriter Implementation
+BitWriter::BitWriter(uint8_t* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity), bit_pos_(0), overflowed_(false) {
+}
+
+void BitWriter::write(uint32_t value, uint8_t bits) {
+    if (bits == 0) {
+        return;
+    }
+    if (bit_pos_ + bits > capacity_ * 8) {
+        overflowed_ = true;
+        return;
+    }
+
+    for (int8_t i = bits - 1; i >= 0; --i) {
+        size_t byte = bit_pos_ >> 3;
+        uint8_t shift = 7 - (bit_pos_ & 7);
+        if ((bit_pos_ & 7) == 0) {
+            buffer_[byte] = 0;
+        }
+        buffer_[byte] |= static_cast<uint8_t>(((value >> i) & 1u) << shift);
+        bit_pos_++;
+    }
+}
+
+bool BitWriter::overflowed() const {
+    return overflowed_;
+}
+
+size_t BitWriter::bytesUsed() const {
+    return (bit_pos_ + 7) >> 3;
+}
+
+// BitReader Implementation
+BitReader::BitReader(const uint8_t* buffer, size_t length)
+    : buffer_(buffer), length_(length), bit_pos_(0), exhausted_(false) {
+}
+
+uint32_t BitReader::read(uint8_t bits) {
+    if (bit_pos_ + bits > length_ * 8) {
+        exhausted_ = true;
+        return 0;
+    }
+
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < bits; ++i) {
+        uint8_t bit = (buffer_[bit_pos_ >> 3] >> (7 - (bit_pos_ & 7))) & 1u;
+        value = (value << 1) | bit;
+        bit_pos_++;
+    }
+    return value;
+}
+
+bool BitReader::exhausted() const {
+    return exhausted_;
+}
+
+// BlockCompressor Implementation
+size_t BlockCompressor::compress(const SensorReading* readings, size_t count, uint8_t* out, size_t capacity) {
+    if (count == 0 || count > COMPRESSION_BLOCK_SIZE || capacity < 4) {
+        return 0;
+    }
+
+    BitWriter writer(out + 4, capacity - 4);
+
+    // First reading verbatim
+    uint32_t prev_ts = readings[0].timestamp_ms;
+    int32_t prev_delta = 0;
+    uint16_t prev_raw = quantiseRaw(readings[0].raw_value);
+    uint32_t prev_lux = quantiseLux(readings[0].lux_value);
+    uint8_t prev_quality = readings[0].quality;
+    uint8_t prev_leading = 0xFF;
+    uint8_t prev_trailing = 0;
+
+    writer.write(prev_ts, 32);
+    writer.write(prev_raw, 16);
+    writer.write(prev_lux, 32);
+    writer.write(prev_quality, 8);
+
+    for (size_t i = 1; i < count; ++i) {
+        const SensorReading& reading = readings[i];
+
+        // Timestamp: delta-of-delta
+        int32_t delta = static_cast<int32_t>(reading.timestamp_ms - prev_ts);
+        uint32_t dod = zigzagEncode(delta - prev_delta);
+        if (dod == 0) {
+            writer.write(0x0, 1);
+        } else if (dod < (1u << 7)) {
+            writer.write(0x2, 2);
+            writer.write(dod, 7);
+        } else if (dod < (1u << 9)) {
+            writer.write(0x6, 3);
+            writer.write(dod, 9);
+        } else if (dod < (1u << 12)) {
+            writer.write(0xE, 4);
+            writer.write(dod, 12);
+        } else {
+            writer.write(0xF, 4);
+            writer.write(dod, 32);
+        }
+        prev_ts = reading.timestamp_ms;
+        prev_delta = delta;
+
+        // Lux: XOR against previous float bits
+        uint32_t lux = quantiseLux(reading.lux_value);
+        uint32_t x = lux ^ prev_lux;
+        if (x == 0) {
+            writer.write(0x0, 1);
+        } else {
+            uint8_t leading = static_cast<uint8_t>(__builtin_clz(x));
+            uint8_t trailing = static_cast<uint8_t>(__builtin_ctz(x));
+            if (leading > 31) {
+                leading = 31;
+            }
+
+            if (prev_leading != 0xFF && leading >= prev_leading && trailing >= prev_trailing) {
+                // Fits in the previous meaningful-bit window
+                uint8_t bits = 32 - prev_leading - prev_trailing;
+                writer.write(0x2, 2);
+                writer.write(x >> prev_trailing, bits);
+            } else {
+                uint8_t bits = 32 - leading - trailing;
+                writer.write(0x3, 2);
+                writer.write(leading, 5);
+                writer.write(bits, 6);
+                writer.write(x >> trailing, bits);
+                prev_leading = leading;
+                prev_trailing = trailing;
+            }
+        }
+        prev_lux = lux;
+
+        // Raw code: zig-zag delta (modulo 16 bits)
+        uint16_t raw = quantiseRaw(reading.raw_value);
+        uint32_t raw_delta = zigzagEncode(static_cast<int16_t>(static_cast<uint16_t>(raw - prev_raw)));
+        if (raw_delta == 0) {
+            writer.write(0x0, 1);
+        } else if (raw_delta < (1u << 5)) {
+            writer.write(0x2, 2);
+            writer.write(raw_delta, 5);
+        } else if (raw_delta < (1u << 8)) {
+            writer.write(0x6, 3);
+            writer.write(raw_delta, 8);
+        } else {
+            writer.write(0x7, 3);
+            writer.write(raw_delta, 16);
+        }
+        prev_raw = raw;
+
+        // Quality
+        if (reading.quality == prev_quality) {
+            writer.write(0x0, 1);
+        } else {
+            writer.write(0x1, 1);
+            writer.write(reading.quality, 8);
+            prev_quality = reading.quality;
+        }
+    }
+
+    if (writer.overflowed()) {
+        return 0;
+    }
+
+    uint16_t payload = static_cast<uint16_t>(writer.bytesUsed());
+    uint16_t block_count = static_cast<uint16_t>(count);
+    memcpy(out, &payload, sizeof(payload));
+    memcpy(out + 2, &block_count, sizeof(block_count));
+    return 4 + payload;
+}
+
+size_t BlockCompressor::decompress(const uint8_t* data, size_t length, SensorReading* readings,
+                                   float reference_voltage, size_t& consumed) {
+    consumed = 0;
+    if (length < 4) {
+        return 0;
+    }
+
+    uint16_t payload;
+    uint16_t count;
+    memcpy(&payload, data, sizeof(payload));
+    memcpy(&count, data + 2, sizeof(count));
+    if (count == 0 || count > COMPRESSION_BLOCK_SIZE || 4u + payload > length) {
+        return 0;
+    }
+
+    BitReader reader(data + 4, payload);
+
+    uint32_t ts = reader.read(32);
+    uint16_t raw = static_cast<uint16_t>(reader.read(16));
+    uint32_t lux = reader.read(32);
+    uint8_t quality = static_cast<uint8_t>(reader.read(8));
+    int32_t delta = 0;
+    uint8_t leading = 0;
+    uint8_t trailing = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            // Timestamp
+            uint32_t dod = 0;
+            if (reader.read(1)) {
+                if (!reader.read(1)) {
+                    dod = reader.read(7);
+                } else if (!reader.read(1)) {
+                    dod = reader.read(9);
+                } else if (!reader.read(1)) {
+                    dod = reader.read(12);
+                } else {
+                    dod = reader.read(32);
+                }
+            }
+            delta += zigzagDecode(dod);
+            ts += static_cast<uint32_t>(delta);
+
+            // Lux
+            if (reader.read(1)) {
+                if (!reader.read(1)) {
+                    uint8_t bits = 32 - leading - trailing;
+                    lux ^= reader.read(bits) << trailing;
+                } else {
+                    leading = static_cast<uint8_t>(reader.read(5));
+                    uint8_t bits = static_cast<uint8_t>(reader.read(6));
+                    if (bits == 0 || leading + bits > 32) {
+                        return 0;
+                    }
+                    trailing = 32 - leading - bits;
+                    lux ^= reader.read(bits) << trailing;
+                }
+            }
+
+            // Raw code
+            uint32_t raw_delta = 0;
+            if (reader.read(1)) {
+                if (!reader.read(1)) {
+                    raw_delta = reader.read(5);
+                } else if (!reader.read(1)) {
+                    raw_delta = reader.read(8);
+                } else {
+                    raw_delta = reader.read(16);
+                }
+            }
+            raw = static_cast<uint16_t>(raw + zigzagDecode(raw_delta));
+
+            // Quality
+            if (reader.read(1)) {
+                quality = static_cast<uint8_t>(reader.read(8));
+            }
+        }
+
+        if (reader.exhausted()) {
+            return 0;
+        }
+
+        SensorReading& reading = readings[i];
+        reading.timestamp_ms = ts;
+        reading.raw_value = raw / 65535.0f;
+        reading.raw_q16 = static_cast<uint16_t>(raw);
+        reading.lux_value = bitsToFloat(lux);
+        reading.voltage = reading.raw_value * reference_voltage;
+        reading.is_valid = true;
+        reading.quality = quality;
+    }
+
+    consumed = 4 + payload;
+    return count;
+}
+
+}  // namespace LightSensor
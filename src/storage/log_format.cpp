@@ -0,0 +1,89 @@
+#include "log_format.h"
+#include <cstring>
+#include <cmath>
+
+namespace LightSensor {
+
+// BinaryRecordEncoder Implementation
+BinaryRecordEncoder::BinaryRecordEncoder()
+    : last_timestamp_ms_(0) {
+}
+
+void BinaryRecordEncoder::reset(uint32_t base_timestamp_ms) {
+    last_timestamp_ms_ = base_timestamp_ms;
+}
+
+size_t BinaryRecordEncoder::encode(const SensorReading& reading, uint8_t* out) {
+    size_t written = 0;
+    uint32_t delta = reading.timestamp_ms - last_timestamp_ms_;
+
+    // Gaps that do not fit (or time going backwards) need a sync record
+    if (reading.timestamp_ms < last_timestamp_ms_ || delta >= BINARY_SYNC_DELTA) {
+        BinaryLogRecord sync;
+        sync.delta_ms = BINARY_SYNC_DELTA;
+        sync.raw_code = 0;
+        sync.lux = reading.timestamp_ms;
+        sync.quality = 0;
+        memcpy(out, &sync, sizeof(sync));
+        written += sizeof(sync);
+        delta = 0;
+    }
+
+    float raw = reading.raw_value < 0.0f ? 0.0f : (reading.raw_value > 1.0f ? 1.0f : reading.raw_value);
+    float lux = reading.lux_value < 0.0f ? 0.0f : reading.lux_value / BINARY_LUX_SCALE;
+
+    BinaryLogRecord record;
+    record.delta_ms = static_cast<uint16_t>(delta);
+    record.raw_code = static_cast<uint16_t>(lroundf(raw * 65535.0f));
+    record.lux = lux >= 4294967295.0f ? 0xFFFFFFFFu : static_cast<uint32_t>(lux + 0.5f);
+    record.quality = reading.quality;
+    memcpy(out + written, &record, sizeof(record));
+    written += sizeof(record);
+
+    last_timestamp_ms_ = reading.timestamp_ms;
+    return written;
+}
+
+// BinaryRecordDecoder Implementation
+BinaryRecordDecoder::BinaryRecordDecoder()
+    : timestamp_ms_(0), reference_voltage_(3.3f) {
+}
+
+void BinaryRecordDecoder::reset(uint32_t base_timestamp_ms, float reference_voltage) {
+    timestamp_ms_ = base_timestamp_ms;
+    reference_voltage_ = reference_voltage;
+}
+
+bool BinaryRecordDecoder::decode(const BinaryLogRecord& record, SensorReading& reading) {
+    if (record.delta_ms == BINARY_SYNC_DELTA) {
+        timestamp_ms_ = record.lux;
+        return false;
+    }
+
+    timestamp_ms_ += record.delta_ms;
+
+    reading.timestamp_ms = timestamp_ms_;
+    reading.raw_value = record.raw_code / 65535.0f;
+    reading.raw_q16 = record.raw_code;
+    reading.lux_value = record.lux * BINARY_LUX_SCALE;
+    reading.voltage = reading.raw_value * reference_voltage_;
+    reading.is_valid = true;
+    reading.quality = record.quality;
+    return true;
+}
+
+void initBinaryLogHeader(BinaryLogHeader& header, uint32_t base_timestamp_ms,
+                         float reference_voltage, float dark_offset, float sensitivity) {
+    header.magic = BINARY_LOG_MAGIC;
+    header.version = BINARY_LOG_VERSION;
+    header.header_size = sizeof(BinaryLogHeader);
+    header.record_size = sizeof(BinaryLogRecord);
+    header.flags = 0;
+    header.base_timestamp_ms = base_timestamp_ms;
+    header.lux_scale = BINARY_LUX_SCALE;
+    header.reference_voltage = reference_voltage;
+    header.dark_offset = dark_offset;
+    header.sensitivity = sensitivity;
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,350 @@
+#include "rollup_store.h"
+#include "log_clock.h"
+#include "segment_storage.h"
+#include <Arduino.h>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+
+namespace LightSensor {
+
+static const uint64_t MS_PER_DAY = 86400000ULL;
+static const uint32_t TIER_BUCKET_MS[ROLLUP_TIER_COUNT] = {60000, 3600000};
+static const char* const TIER_FILE_NAMES[ROLLUP_TIER_COUNT] = {"rollup_1m.dat", "rollup_1h.dat"};
+
+RollupStore::RollupStore(const LoggerConfig& config)
+    : config_(config), fs_(SegmentDataStorage::filesystem(config.storage_backend)), is_initialized_(false), last_time_ms_(0) {
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        tiers_[i].bucket_ms = TIER_BUCKET_MS[i];
+        tiers_[i].capacity = 0;
+        memset(&tiers_[i].open, 0, sizeof(tiers_[i].open));
+        tiers_[i].lux_sum = 0.0;
+    }
+}
+
+RollupStore::~RollupStore() {
+    close();
+}
+
+bool RollupStore::initialize() {
+    if (is_initialized_) {
+        return true;
+    }
+
+    if (!SegmentDataStorage::mount(config_.storage_backend)) {
+        return false;
+    }
+
+    // The tier files share the segment directory, which LittleFS needs created
+    if (config_.storage_backend == StorageBackend::LITTLEFS && !fs_.exists(config_.log_file_path)) {
+        fs_.mkdir(config_.log_file_path);
+    }
+
+    bool any_open = false;
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        RollupTier tier = static_cast<RollupTier>(i);
+        any_open = openTier(tier, retentionDays(config_, tier)) || any_open;
+    }
+    if (!any_open) {
+        return false;
+    }
+
+    // Buckets written before a power loss must stay in the past
+    LogClock::getInstance().advancePast(last_time_ms_);
+
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        resumeTier(tiers_[i]);
+    }
+
+    is_initialized_ = true;
+    return true;
+}
+
+void RollupStore::addBatch(const SensorReading* data, size_t count) {
+    if (!is_initialized_) {
+        return;
+    }
+
+    const LogClock& clock = LogClock::getInstance();
+    for (size_t i = 0; i < count; ++i) {
+        add(clock.fromMillis(data[i].timestamp_ms), data[i].lux_value);
+    }
+}
+
+void RollupStore::close() {
+    if (!is_initialized_) {
+        return;
+    }
+
+    // Partial buckets are resumed by the next initialize() if still current
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        Tier& tier = tiers_[i];
+        if (tier.open.count > 0) {
+            writeBucket(tier, tier.open);
+        }
+        tier.file.close();
+    }
+    is_initialized_ = false;
+}
+
+bool RollupStore::configure(const LoggerConfig& config) {
+    if (strcmp(config.log_file_path, config_.log_file_path) != 0 ||
+        config.storage_backend != config_.storage_backend) {
+        return false;
+    }
+
+    // A new retention changes the ring size, so the tier file is rebuilt
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        RollupTier tier = static_cast<RollupTier>(i);
+        if (retentionDays(config, tier) != retentionDays(config_, tier)) {
+            return false;
+        }
+    }
+
+    config_ = config;
+    return true;
+}
+
+size_t RollupStore::query(RollupTier tier, uint64_t from_ms, uint64_t to_ms, const RollupCallback& callback) {
+    size_t tier_index = static_cast<size_t>(tier);
+    if (!is_initialized_ || tier_index >= ROLLUP_TIER_COUNT || from_ms > to_ms || callback == nullptr) {
+        return 0;
+    }
+
+    Tier& t = tiers_[tier_index];
+    if (t.capacity == 0) {
+        return 0;
+    }
+
+    // The ring holds the newest capacity buckets only
+    uint64_t now_ms = LogClock::getInstance().nowMs();
+    uint64_t newest = (now_ms > last_time_ms_ ? now_ms : last_time_ms_) / t.bucket_ms;
+    uint64_t oldest = newest >= t.capacity ? newest - t.capacity + 1 : 0;
+    uint64_t first = from_ms / t.bucket_ms;
+    uint64_t last = to_ms / t.bucket_ms;
+    if (first < oldest) {
+        first = oldest;
+    }
+    if (last > newest) {
+        last = newest;
+    }
+
+    uint64_t open_index = t.open.count > 0 ? t.open.start_time_ms / t.bucket_ms : UINT64_MAX;
+    RollupBucket chunk[IO_CHUNK_BUCKETS];
+    size_t delivered = 0;
+
+    uint64_t index = first;
+    while (index <= last) {
+        // Contiguous slots up to the end of the ring
+        uint64_t slots_to_end = t.capacity - index % t.capacity;
+        uint64_t remaining = last - index + 1;
+        size_t count = IO_CHUNK_BUCKETS;
+        if (remaining < count) {
+            count = static_cast<size_t>(remaining);
+        }
+        if (slots_to_end < count) {
+            count = static_cast<size_t>(slots_to_end);
+        }
+
+        size_t bytes = count * sizeof(RollupBucket);
+        if (!t.file.seek(slotOffset(t, index)) ||
+            t.file.read(reinterpret_cast<uint8_t*>(chunk), bytes) != bytes) {
+            break;
+        }
+
+        for (size_t i = 0; i < count; ++i, ++index) {
+            // The open bucket is newer in RAM than on flash; a slot still
+            // holding an older lap of the ring has a different start time
+            const RollupBucket* bucket = &chunk[i];
+            if (index == open_index) {
+                bucket = &t.open;
+            } else if (bucket->count == 0 || bucket->start_time_ms != index * t.bucket_ms) {
+                continue;
+            }
+
+            delivered++;
+            if (!callback(*bucket)) {
+                return delivered;
+            }
+        }
+    }
+
+    return delivered;
+}
+
+void RollupStore::tierPath(RollupTier tier, char* buffer, size_t buffer_size) const {
+    snprintf(buffer, buffer_size, "%s/%s", config_.log_file_path,
+             TIER_FILE_NAMES[static_cast<size_t>(tier)]);
+}
+
+bool RollupStore::openTier(RollupTier rollup_tier, uint32_t retention_days) {
+    Tier& tier = tiers_[static_cast<size_t>(rollup_tier)];
+    uint64_t capacity = retention_days * MS_PER_DAY / tier.bucket_ms;
+    tier.capacity = static_cast<uint32_t>(capacity < MAX_ROLLUP_BUCKETS ? capacity : MAX_ROLLUP_BUCKETS);
+    if (tier.capacity == 0) {
+        return false;
+    }
+
+    RollupFileHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    expected.magic = ROLLUP_MAGIC;
+    expected.version = ROLLUP_VERSION;
+    expected.header_size = sizeof(RollupFileHeader);
+    expected.bucket_size = sizeof(RollupBucket);
+    expected.bucket_ms = tier.bucket_ms;
+    expected.capacity = tier.capacity;
+
+    char path[MAX_LOG_PATH_LEN + 24];
+    tierPath(rollup_tier, path, sizeof(path));
+
+    // Reuse the file only if its ring has the same shape
+    RollupFileHeader header;
+    bool reusable = false;
+    File existing = fs_.open(path, FILE_READ);
+    if (existing) {
+        reusable = existing.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+                   header.magic == expected.magic && header.version == expected.version &&
+                   header.header_size == expected.header_size && header.bucket_size == expected.bucket_size &&
+                   header.bucket_ms == expected.bucket_ms && header.capacity == expected.capacity &&
+                   existing.size() == sizeof(RollupFileHeader) + tier.capacity * sizeof(RollupBucket);
+        existing.close();
+    }
+
+    if (reusable) {
+        if (header.last_time_ms > last_time_ms_) {
+            last_time_ms_ = header.last_time_ms;
+        }
+    } else if (!createTierFile(path, expected)) {
+        tier.capacity = 0;
+        return false;
+    }
+
+    tier.file = fs_.open(path, "r+");
+    if (!tier.file) {
+        tier.capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+bool RollupStore::createTierFile(const char* path, const RollupFileHeader& header) {
+    File file = fs_.open(path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+
+    // Written out in full once, so later bucket writes never grow the file
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+
+    RollupBucket empty[IO_CHUNK_BUCKETS];
+    memset(empty, 0, sizeof(empty));
+    for (uint32_t written = 0; ok && written < header.capacity; written += IO_CHUNK_BUCKETS) {
+        size_t count = header.capacity - written < IO_CHUNK_BUCKETS ? header.capacity - written : IO_CHUNK_BUCKETS;
+        size_t bytes = count * sizeof(RollupBucket);
+        ok = file.write(reinterpret_cast<const uint8_t*>(empty), bytes) == bytes;
+    }
+    file.close();
+
+    if (!ok) {
+        fs_.remove(path);
+    }
+    return ok;
+}
+
+void RollupStore::resumeTier(Tier& tier) {
+    memset(&tier.open, 0, sizeof(tier.open));
+    tier.lux_sum = 0.0;
+    if (tier.capacity == 0) {
+        return;
+    }
+
+    // Pick up a partial bucket for the current period (written by close() or a checkpoint)
+    uint64_t index = LogClock::getInstance().nowMs() / tier.bucket_ms;
+    RollupBucket bucket;
+    if (tier.file.seek(slotOffset(tier, index)) &&
+        tier.file.read(reinterpret_cast<uint8_t*>(&bucket), sizeof(bucket)) == sizeof(bucket) &&
+        bucket.count > 0 && bucket.start_time_ms == index * tier.bucket_ms) {
+        tier.open = bucket;
+        tier.lux_sum = static_cast<double>(bucket.mean_lux) * bucket.count;
+    }
+}
+
+void RollupStore::add(uint64_t time_ms, float lux) {
+    for (size_t i = 0; i < ROLLUP_TIER_COUNT; ++i) {
+        Tier& tier = tiers_[i];
+        if (tier.capacity == 0) {
+            continue;
+        }
+
+        // Late readings (time stepped back) stay in the open bucket
+        uint64_t start_ms = time_ms - time_ms % tier.bucket_ms;
+        if (tier.open.count > 0 && start_ms > tier.open.start_time_ms) {
+            closeBucket(i);
+        }
+
+        RollupBucket& open = tier.open;
+        if (open.count == 0) {
+            open.start_time_ms = start_ms;
+            open.min_lux = lux;
+            open.max_lux = lux;
+            tier.lux_sum = 0.0;
+        } else {
+            if (lux < open.min_lux) {
+                open.min_lux = lux;
+            }
+            if (lux > open.max_lux) {
+                open.max_lux = lux;
+            }
+        }
+        open.count++;
+        tier.lux_sum += lux;
+        open.mean_lux = static_cast<float>(tier.lux_sum / open.count);
+    }
+
+    if (time_ms > last_time_ms_) {
+        last_time_ms_ = time_ms;
+    }
+}
+
+void RollupStore::closeBucket(size_t tier_index) {
+    Tier& tier = tiers_[tier_index];
+    writeBucket(tier, tier.open);
+    tier.open.count = 0;
+
+    // Checkpoint the coarser tiers so a reset costs them one finer bucket at most
+    for (size_t i = tier_index + 1; i < ROLLUP_TIER_COUNT; ++i) {
+        if (tiers_[i].capacity > 0 && tiers_[i].open.count > 0) {
+            writeBucket(tiers_[i], tiers_[i].open);
+        }
+    }
+}
+
+bool RollupStore::writeBucket(Tier& tier, const RollupBucket& bucket) {
+    if (!tier.file.seek(slotOffset(tier, bucket.start_time_ms / tier.bucket_ms)) ||
+        tier.file.write(reinterpret_cast<const uint8_t*>(&bucket), sizeof(bucket)) != sizeof(bucket)) {
+        return false;
+    }
+
+    bool ok = writeLastTime(tier);
+    tier.file.flush();
+    return ok;
+}
+
+bool RollupStore::writeLastTime(Tier& tier) {
+    return tier.file.seek(offsetof(RollupFileHeader, last_time_ms)) &&
+           tier.file.write(reinterpret_cast<const uint8_t*>(&last_time_ms_), sizeof(last_time_ms_)) ==
+               sizeof(last_time_ms_);
+}
+
+size_t RollupStore::slotOffset(const Tier& tier, uint64_t bucket_index) const {
+    return sizeof(RollupFileHeader) + static_cast<size_t>(bucket_index % tier.capacity) * sizeof(RollupBucket);
+}
+
+uint32_t RollupStore::retentionDays(const LoggerConfig& config, RollupTier tier) {
+    if (!config.enable_rollups) {
+        return 0;
+    }
+    return tier == RollupTier::MINUTE ? config.rollup_minute_days : config.rollup_hour_days;
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,785 @@
+#include "segment_storage.h"
+#include "profiler.h"
+#include "log_clock.h"
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <esp_partition.h>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+namespace LightSensor {
+
+static const uint64_t MS_PER_DAY = 86400000ULL;
+
+SegmentDataStorage::SegmentDataStorage(const LoggerConfig& config)
+    : config_(config), is_initialized_(false), segment_records_(MAX_SEGMENT_RECORDS),
+      fs_(filesystem(config.storage_backend)),
+      paged_(config.storage_backend == StorageBackend::LITTLEFS),
+      total_bytes_(0), used_bytes_(0),
+      reference_voltage_(3.3f), dark_offset_(0.0f), sensitivity_(1.0f),
+      last_time_ms_(0),
+      segment_count_(0), next_sequence_(1),
+      open_lux_sum_(0.0f), index_count_(0), open_bytes_(0), open_reserved_(0),
+      page_(nullptr), page_fill_(0), page_written_(0), staged_since_ms_(0) {
+    memset(&header_, 0, sizeof(header_));
+    memset(&open_, 0, sizeof(open_));
+}
+
+SegmentDataStorage::~SegmentDataStorage() {
+    close();
+    delete[] page_;
+}
+
+bool SegmentDataStorage::initialize() {
+    if (is_initialized_) {
+        return true;
+    }
+
+    if (!mount(config_.storage_backend)) {
+        return false;
+    }
+
+    // LittleFS does not create parent directories on open; SPIFFS names are flat
+    if (paged_ && !fs_.exists(config_.log_file_path)) {
+        fs_.mkdir(config_.log_file_path);
+    }
+
+    if (paged_ && !page_) {
+        page_ = new uint8_t[FLASH_PAGE_SIZE];
+    }
+
+    // Fixed segment length from the file size limit, whole index intervals only
+    size_t overhead = sizeof(SegmentHeader) + sizeof(SegmentFooter) +
+                      MAX_SEGMENT_INDEX_ENTRIES * sizeof(SegmentIndexEntry);
+    size_t records = config_.max_file_size_bytes > overhead ?
+                     (config_.max_file_size_bytes - overhead) / sizeof(SegmentRecord) : 0;
+    if (records > MAX_SEGMENT_RECORDS) {
+        records = MAX_SEGMENT_RECORDS;
+    }
+    records -= records % SEGMENT_INDEX_INTERVAL;
+    segment_records_ = records > 0 ? records : SEGMENT_INDEX_INTERVAL;
+
+    // The only full usage scan; from here on it is tracked per segment
+    readSpace();
+
+    uint32_t open_sequence = 0;
+    loadManifest(open_sequence);
+
+    // A segment left open by a reset is sealed from its records
+    if (open_sequence != 0) {
+        recoverSegment(open_sequence);
+    }
+
+    // System time survives deep sleep but restarts after a power loss
+    LogClock::getInstance().advancePast(last_time_ms_);
+
+    is_initialized_ = true;
+    enforceRetention();
+    saveManifest(0);
+    return true;
+}
+
+bool SegmentDataStorage::write(const SensorReading& data) {
+    LS_PROFILE_SCOPE(STORAGE_WRITE);
+
+    return appendRecords(&data, 1);
+}
+
+bool SegmentDataStorage::writeBatch(const SensorReading* data, size_t count) {
+    LS_PROFILE_SCOPE(STORAGE_WRITE_BATCH);
+
+    return appendRecords(data, count);
+}
+
+bool SegmentDataStorage::flush() {
+    if (!file_) {
+        return true;
+    }
+
+    // Programming a partial page makes LittleFS copy the block again on the
+    // next append, so a routine flush only writes one that has waited too long
+    bool ok = true;
+    if (page_fill_ != page_written_ && millis() - staged_since_ms_ >= MAX_STAGED_MS) {
+        ok = writePage();
+    }
+    file_.flush();
+    return ok;
+}
+
+bool SegmentDataStorage::sync() {
+    if (!file_) {
+        return true;
+    }
+
+    bool ok = writePage();
+    file_.flush();
+    return ok;
+}
+
+void SegmentDataStorage::close() {
+    // A closed store has no open segment, so a reopen never appends to a sealed file
+    if (is_initialized_) {
+        sealSegment();
+    }
+    is_initialized_ = false;
+}
+
+size_t SegmentDataStorage::getAvailableSpace() const {
+    return used_bytes_ < total_bytes_ ? total_bytes_ - used_bytes_ : 0;
+}
+
+void SegmentDataStorage::setCalibration(const SensorConfig& sensor) {
+    // Recorded in the next segment header
+    reference_voltage_ = sensor.reference_voltage;
+    dark_offset_ = sensor.dark_offset;
+    sensitivity_ = sensor.sensitivity;
+}
+
+bool SegmentDataStorage::configure(const LoggerConfig& config) {
+    if (strcmp(config.log_file_path, config_.log_file_path) != 0 ||
+        config.storage_backend != config_.storage_backend ||
+        config.max_file_size_bytes != config_.max_file_size_bytes) {
+        return false;
+    }
+
+    // Retention is checked whenever a segment is sealed
+    config_ = config;
+    return true;
+}
+
+size_t SegmentDataStorage::query(uint64_t from_ms, uint64_t to_ms, const QueryCallback& callback) {
+    if (!is_initialized_ || from_ms > to_ms || callback == nullptr) {
+        return 0;
+    }
+
+    SegmentIndexEntry index[MAX_SEGMENT_INDEX_ENTRIES];
+    char path[MAX_LOG_PATH_LEN + 24];
+    size_t delivered = 0;
+    bool stop = false;
+
+    // The manifest rules out segments without opening them
+    for (size_t i = 0; i < segment_count_ && !stop; ++i) {
+        const SegmentSummary& segment = segments_[i];
+        if (segment.last_time_ms < from_ms || segment.first_time_ms > to_ms) {
+            continue;
+        }
+
+        segmentPath(segment.sequence, path, sizeof(path));
+        File file = fs_.open(path, FILE_READ);
+        if (!file) {
+            continue;
+        }
+
+        SegmentHeader header;
+        SegmentFooter footer;
+        if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == SEGMENT_MAGIC && header.record_size == sizeof(SegmentRecord) &&
+            readSealedIndex(file, footer, index)) {
+            delivered += querySegment(file, header, index, footer.index_count,
+                                      footer.summary.record_count, from_ms, to_ms, callback, stop);
+        }
+        file.close();
+    }
+
+    // The open segment is read back through a second handle with the in-RAM index
+    if (!stop && file_ && open_.record_count > 0 &&
+        open_.last_time_ms >= from_ms && open_.first_time_ms <= to_ms) {
+        sync();
+        segmentPath(header_.sequence, path, sizeof(path));
+        File file = fs_.open(path, FILE_READ);
+        if (file) {
+            delivered += querySegment(file, header_, index_, index_count_, open_.record_count,
+                                      from_ms, to_ms, callback, stop);
+            file.close();
+        }
+    }
+
+    return delivered;
+}
+
+size_t SegmentDataStorage::getSegmentCount() const {
+    return segment_count_;
+}
+
+bool SegmentDataStorage::getSegment(size_t index, SegmentSummary& summary) const {
+    if (index >= segment_count_) {
+        return false;
+    }
+    summary = segments_[index];
+    return true;
+}
+
+void SegmentDataStorage::segmentPath(uint32_t sequence, char* buffer, size_t buffer_size) const {
+    formatSegmentPath(config_.log_file_path, sequence, buffer, buffer_size);
+}
+
+void SegmentDataStorage::formatSegmentPath(const char* directory, uint32_t sequence,
+                                           char* buffer, size_t buffer_size) {
+    snprintf(buffer, buffer_size, "%s/seg_%08lu.dat", directory, static_cast<unsigned long>(sequence));
+}
+
+fs::FS& SegmentDataStorage::filesystem(StorageBackend backend) {
+    if (backend == StorageBackend::LITTLEFS) {
+        return LittleFS;
+    }
+    return SPIFFS;
+}
+
+bool SegmentDataStorage::openSegment(uint64_t base_time_ms) {
+    // Make room for a full segment before starting one
+    enforceRetention();
+
+    header_.magic = SEGMENT_MAGIC;
+    header_.version = SEGMENT_VERSION;
+    header_.header_size = sizeof(SegmentHeader);
+    header_.record_size = sizeof(SegmentRecord);
+    header_.index_interval = SEGMENT_INDEX_INTERVAL;
+    header_.sequence = next_sequence_++;
+    header_.base_time_ms = base_time_ms;
+    header_.lux_scale = BINARY_LUX_SCALE;
+    header_.reference_voltage = reference_voltage_;
+    header_.dark_offset = dark_offset_;
+    header_.sensitivity = sensitivity_;
+
+    char path[MAX_LOG_PATH_LEN + 24];
+    segmentPath(header_.sequence, path, sizeof(path));
+    file_ = fs_.open(path, FILE_WRITE);
+    if (!file_) {
+        return false;
+    }
+
+    open_bytes_ = 0;
+    page_fill_ = 0;
+    page_written_ = 0;
+    if (!writeBytes(reinterpret_cast<const uint8_t*>(&header_), sizeof(header_))) {
+        file_.close();
+        fs_.remove(path);
+        return false;
+    }
+
+    // Count the segment at full length now, so retention makes room before it fills
+    open_reserved_ = flashBytes(segmentBytes());
+    used_bytes_ += open_reserved_;
+
+    memset(&open_, 0, sizeof(open_));
+    open_.sequence = header_.sequence;
+    open_lux_sum_ = 0.0f;
+    index_count_ = 0;
+
+    // Record the open segment so a reset can find and seal it
+    saveManifest(header_.sequence);
+    return true;
+}
+
+bool SegmentDataStorage::sealSegment() {
+    if (!file_) {
+        return true;
+    }
+
+    char path[MAX_LOG_PATH_LEN + 24];
+    segmentPath(header_.sequence, path, sizeof(path));
+
+    if (open_.record_count == 0) {
+        file_.close();
+        fs_.remove(path);
+        releaseSpace(open_reserved_);
+        open_reserved_ = 0;
+        saveManifest(0);
+        return true;
+    }
+
+    SegmentFooter footer;
+    open_.avg_lux = open_lux_sum_ / open_.record_count;
+    footer.summary = open_;
+    footer.index_count = static_cast<uint16_t>(index_count_);
+    footer.index_interval = SEGMENT_INDEX_INTERVAL;
+    footer.magic = SEGMENT_FOOTER_MAGIC;
+
+    size_t index_bytes = index_count_ * sizeof(SegmentIndexEntry);
+    bool ok = writeBytes(reinterpret_cast<const uint8_t*>(index_), index_bytes) &&
+              writeBytes(reinterpret_cast<const uint8_t*>(&footer), sizeof(footer)) &&
+              writePage();
+    file_.close();
+
+    // Replace the reservation with what the segment actually takes
+    releaseSpace(open_reserved_);
+    used_bytes_ += flashBytes(open_bytes_);
+    open_reserved_ = 0;
+
+    if (segment_count_ >= MAX_SEGMENTS) {
+        deleteOldestSegment();
+    }
+    segments_[segment_count_++] = open_;
+
+    saveManifest(0);
+    enforceRetention();
+    return ok;
+}
+
+bool SegmentDataStorage::appendRecords(const SensorReading* data, size_t count) {
+    if (!is_initialized_) {
+        return false;
+    }
+
+    SegmentRecord chunk[WRITE_CHUNK_RECORDS];
+    size_t chunk_count = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        // Log time never runs backwards, even if readings arrive out of order
+        uint64_t time_ms = LogClock::getInstance().fromMillis(data[i].timestamp_ms);
+        if (time_ms < last_time_ms_) {
+            time_ms = last_time_ms_;
+        }
+
+        // Seal when full, or when the offset would no longer fit 32 bits
+        if (file_ && (open_.record_count >= segment_records_ ||
+                      time_ms - header_.base_time_ms > 0xFFFFFFFFULL)) {
+            if (!writeRecords(chunk, chunk_count)) {
+                return false;
+            }
+            chunk_count = 0;
+            sealSegment();
+        }
+
+        if (!file_ && !openSegment(time_ms)) {
+            return false;
+        }
+
+        // The record about to be written is every SEGMENT_INDEX_INTERVAL-th one
+        if (open_.record_count % SEGMENT_INDEX_INTERVAL == 0 && index_count_ < MAX_SEGMENT_INDEX_ENTRIES) {
+            index_[index_count_].offset_ms = static_cast<uint32_t>(time_ms - header_.base_time_ms);
+            index_[index_count_].file_offset = sizeof(SegmentHeader) + open_.record_count * sizeof(SegmentRecord);
+            index_count_++;
+        }
+
+        chunk[chunk_count] = encodeRecord(data[i], time_ms - header_.base_time_ms);
+        addToSummary(chunk[chunk_count], time_ms);
+        chunk_count++;
+        last_time_ms_ = time_ms;
+
+        if (chunk_count == WRITE_CHUNK_RECORDS) {
+            if (!writeRecords(chunk, chunk_count)) {
+                return false;
+            }
+            chunk_count = 0;
+        }
+    }
+
+    return writeRecords(chunk, chunk_count);
+}
+
+bool SegmentDataStorage::writeRecords(const SegmentRecord* records, size_t count) {
+    if (count == 0) {
+        return true;
+    }
+
+    return writeBytes(reinterpret_cast<const uint8_t*>(records), count * sizeof(SegmentRecord));
+}
+
+bool SegmentDataStorage::writeBytes(const uint8_t* data, size_t length) {
+    open_bytes_ += length;
+    if (!paged_) {
+        return file_.write(data, length) == length;
+    }
+
+    // Stage into the page; a page goes to flash only once it is full
+    if (length > 0 && page_fill_ == page_written_) {
+        staged_since_ms_ = millis();
+    }
+    while (length > 0) {
+        size_t chunk = FLASH_PAGE_SIZE - page_fill_ < length ? FLASH_PAGE_SIZE - page_fill_ : length;
+        memcpy(page_ + page_fill_, data, chunk);
+        page_fill_ += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (page_fill_ == FLASH_PAGE_SIZE && !writePage()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SegmentDataStorage::writePage() {
+    if (!paged_ || page_fill_ == page_written_) {
+        return true;
+    }
+
+    // Continue where the last partial write stopped, never past the page end
+    size_t length = page_fill_ - page_written_;
+    bool ok = file_.write(page_ + page_written_, length) == length;
+    page_written_ = page_fill_;
+    if (page_fill_ == FLASH_PAGE_SIZE) {
+        page_fill_ = 0;
+        page_written_ = 0;
+    }
+    return ok;
+}
+
+void SegmentDataStorage::addToSummary(const SegmentRecord& record, uint64_t time_ms) {
+    float lux = record.lux * BINARY_LUX_SCALE;
+
+    if (open_.record_count == 0) {
+        open_.first_time_ms = time_ms;
+        open_.min_lux = lux;
+        open_.max_lux = lux;
+    } else {
+        open_.min_lux = lux < open_.min_lux ? lux : open_.min_lux;
+        open_.max_lux = lux > open_.max_lux ? lux : open_.max_lux;
+    }
+
+    open_.last_time_ms = time_ms;
+    open_.record_count++;
+    open_lux_sum_ += lux;
+}
+
+bool SegmentDataStorage::recoverSegment(uint32_t sequence) {
+    char path[MAX_LOG_PATH_LEN + 24];
+    segmentPath(sequence, path, sizeof(path));
+
+    File file = fs_.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    SegmentHeader header;
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != SEGMENT_MAGIC || header.record_size != sizeof(SegmentRecord)) {
+        releaseSpace(flashBytes(file.size()));
+        file.close();
+        fs_.remove(path);
+        return false;
+    }
+
+    // A reset between writing the footer and saving the manifest leaves a
+    // sealed segment marked open; adopt it rather than append a second footer
+    SegmentFooter footer;
+    if (readSealedIndex(file, footer, index_) && footer.summary.sequence == sequence) {
+        file.close();
+
+        if (footer.summary.last_time_ms > last_time_ms_) {
+            last_time_ms_ = footer.summary.last_time_ms;
+        }
+        if (segment_count_ >= MAX_SEGMENTS) {
+            deleteOldestSegment();
+        }
+        segments_[segment_count_++] = footer.summary;  // Space already counted by readSpace()
+        return true;
+    }
+    if (!file.seek(sizeof(SegmentHeader))) {
+        file.close();
+        return false;
+    }
+
+    // Rebuild the summary and index from the records (a torn last record is ignored)
+    size_t record_count = (file.size() - sizeof(SegmentHeader)) / sizeof(SegmentRecord);
+    if (record_count > MAX_SEGMENT_RECORDS) {
+        record_count = MAX_SEGMENT_RECORDS;
+    }
+
+    header_ = header;
+    memset(&open_, 0, sizeof(open_));
+    open_.sequence = sequence;
+    open_lux_sum_ = 0.0f;
+    index_count_ = 0;
+
+    SegmentRecord records[READ_CHUNK_RECORDS];
+    size_t scanned = 0;
+    while (scanned < record_count) {
+        size_t chunk = record_count - scanned < READ_CHUNK_RECORDS ? record_count - scanned : READ_CHUNK_RECORDS;
+        if (file.read(reinterpret_cast<uint8_t*>(records), chunk * sizeof(SegmentRecord)) !=
+            chunk * sizeof(SegmentRecord)) {
+            break;
+        }
+
+        for (size_t i = 0; i < chunk; ++i) {
+            if (open_.record_count % SEGMENT_INDEX_INTERVAL == 0 && index_count_ < MAX_SEGMENT_INDEX_ENTRIES) {
+                index_[index_count_].offset_ms = records[i].offset_ms;
+                index_[index_count_].file_offset = sizeof(SegmentHeader) + open_.record_count * sizeof(SegmentRecord);
+                index_count_++;
+            }
+            addToSummary(records[i], header.base_time_ms + records[i].offset_ms);
+        }
+        scanned += chunk;
+    }
+    file.close();
+
+    if (open_.last_time_ms > last_time_ms_) {
+        last_time_ms_ = open_.last_time_ms;
+    }
+
+    // Append the footer as sealSegment() would have
+    file_ = fs_.open(path, FILE_APPEND);
+    if (!file_) {
+        return false;
+    }
+
+    // Already counted by readSpace(); appends resume mid-page
+    open_bytes_ = file_.size();
+    open_reserved_ = flashBytes(open_bytes_);
+    page_fill_ = open_bytes_ % FLASH_PAGE_SIZE;
+    page_written_ = page_fill_;
+    return sealSegment();
+}
+
+void SegmentDataStorage::enforceRetention() {
+    bool changed = false;
+
+    // Whole segments past max_log_days
+    if (config_.max_log_days > 0) {
+        uint64_t now_ms = LogClock::getInstance().nowMs();
+        uint64_t keep_ms = config_.max_log_days * MS_PER_DAY;
+        while (segment_count_ > 0 && now_ms > keep_ms && segments_[0].last_time_ms < now_ms - keep_ms) {
+            deleteOldestSegment();
+            changed = true;
+        }
+    }
+
+    // Keep room for the open segment to grow to full length twice over
+    while (segment_count_ > 0 && getAvailableSpace() < 2 * segmentBytes()) {
+        deleteOldestSegment();
+        changed = true;
+    }
+
+    if (changed) {
+        saveManifest(file_ ? header_.sequence : 0);
+    }
+}
+
+size_t SegmentDataStorage::segmentBytes() const {
+    return sizeof(SegmentHeader) + segment_records_ * sizeof(SegmentRecord) +
+           MAX_SEGMENT_INDEX_ENTRIES * sizeof(SegmentIndexEntry) + sizeof(SegmentFooter);
+}
+
+size_t SegmentDataStorage::segmentFileBytes(uint32_t record_count) const {
+    size_t index_count = (record_count + SEGMENT_INDEX_INTERVAL - 1) / SEGMENT_INDEX_INTERVAL;
+    if (index_count > MAX_SEGMENT_INDEX_ENTRIES) {
+        index_count = MAX_SEGMENT_INDEX_ENTRIES;
+    }
+    return sizeof(SegmentHeader) + record_count * sizeof(SegmentRecord) +
+           index_count * sizeof(SegmentIndexEntry) + sizeof(SegmentFooter);
+}
+
+size_t SegmentDataStorage::flashBytes(size_t file_bytes) const {
+    // LittleFS hands out whole blocks
+    if (!paged_) {
+        return file_bytes;
+    }
+    return (file_bytes + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+}
+
+bool SegmentDataStorage::mount(StorageBackend backend) {
+    if (backend == StorageBackend::LITTLEFS) {
+        return LittleFS.begin(true, LOG_PARTITION_MOUNT, 10, LOG_PARTITION_LABEL);
+    }
+    return SPIFFS.begin(true);
+}
+
+size_t SegmentDataStorage::partitionSize(StorageBackend backend) {
+    const char* label = backend == StorageBackend::LITTLEFS ? LOG_PARTITION_LABEL : "spiffs";
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return partition ? partition->size : 0;
+}
+
+void SegmentDataStorage::readSpace() {
+    // usedBytes() walks the whole filesystem on LittleFS
+    if (paged_) {
+        total_bytes_ = LittleFS.totalBytes();
+        used_bytes_ = LittleFS.usedBytes();
+    } else {
+        total_bytes_ = SPIFFS.totalBytes();
+        used_bytes_ = SPIFFS.usedBytes();
+    }
+}
+
+void SegmentDataStorage::releaseSpace(size_t bytes) {
+    used_bytes_ = bytes < used_bytes_ ? used_bytes_ - bytes : 0;
+}
+
+void SegmentDataStorage::deleteOldestSegment() {
+    if (segment_count_ == 0) {
+        return;
+    }
+
+    char path[MAX_LOG_PATH_LEN + 24];
+    segmentPath(segments_[0].sequence, path, sizeof(path));
+    fs_.remove(path);
+    releaseSpace(flashBytes(segmentFileBytes(segments_[0].record_count)));
+
+    memmove(segments_, segments_ + 1, (segment_count_ - 1) * sizeof(SegmentSummary));
+    segment_count_--;
+}
+
+bool SegmentDataStorage::loadManifest(uint32_t& open_sequence) {
+    char path[MAX_LOG_PATH_LEN + 16];
+    manifestPath(path, sizeof(path), false);
+
+    // A reset between remove and rename leaves only the new copy
+    if (!fs_.exists(path)) {
+        manifestPath(path, sizeof(path), true);
+    }
+
+    File file = fs_.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    SegmentManifestHeader header;
+    bool ok = file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+              header.magic == SEGMENT_MANIFEST_MAGIC && header.version == SEGMENT_VERSION &&
+              header.segment_count <= MAX_SEGMENTS;
+    if (ok) {
+        size_t bytes = header.segment_count * sizeof(SegmentSummary);
+        ok = file.read(reinterpret_cast<uint8_t*>(segments_), bytes) == bytes;
+    }
+    file.close();
+
+    if (!ok) {
+        segment_count_ = 0;
+        return false;
+    }
+
+    segment_count_ = header.segment_count;
+    next_sequence_ = header.next_sequence > 0 ? header.next_sequence : 1;
+    open_sequence = header.open_sequence;
+    last_time_ms_ = header.last_time_ms;
+    return true;
+}
+
+bool SegmentDataStorage::saveManifest(uint32_t open_sequence) {
+    char path[MAX_LOG_PATH_LEN + 16];
+    char temp_path[MAX_LOG_PATH_LEN + 16];
+    manifestPath(path, sizeof(path), false);
+    manifestPath(temp_path, sizeof(temp_path), true);
+
+    SegmentManifestHeader header;
+    header.magic = SEGMENT_MANIFEST_MAGIC;
+    header.version = SEGMENT_VERSION;
+    header.segment_count = static_cast<uint16_t>(segment_count_);
+    header.next_sequence = next_sequence_;
+    header.open_sequence = open_sequence;
+    header.last_time_ms = last_time_ms_;
+
+    // Write the new copy in full before replacing the old one
+    File file = fs_.open(temp_path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    size_t bytes = segment_count_ * sizeof(SegmentSummary);
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+              file.write(reinterpret_cast<const uint8_t*>(segments_), bytes) == bytes;
+    file.close();
+
+    if (!ok) {
+        fs_.remove(temp_path);
+        return false;
+    }
+
+    fs_.remove(path);
+    return fs_.rename(temp_path, path);
+}
+
+size_t SegmentDataStorage::querySegment(File& file, const SegmentHeader& header, const SegmentIndexEntry* index,
+                                        size_t index_count, uint32_t record_count, uint64_t from_ms,
+                                        uint64_t to_ms, const QueryCallback& callback, bool& stop) {
+    // Start at the last indexed record taken at or before from_ms
+    uint32_t start_offset = header.header_size;
+    for (size_t i = 0; i < index_count; ++i) {
+        if (header.base_time_ms + index[i].offset_ms > from_ms) {
+            break;
+        }
+        start_offset = index[i].file_offset;
+    }
+
+    uint32_t end_offset = header.header_size + record_count * sizeof(SegmentRecord);
+    if (start_offset >= end_offset || !file.seek(start_offset)) {
+        return 0;
+    }
+
+    SegmentRecord records[READ_CHUNK_RECORDS];
+    size_t remaining = (end_offset - start_offset) / sizeof(SegmentRecord);
+    size_t delivered = 0;
+
+    while (remaining > 0) {
+        size_t chunk = remaining < READ_CHUNK_RECORDS ? remaining : READ_CHUNK_RECORDS;
+        if (file.read(reinterpret_cast<uint8_t*>(records), chunk * sizeof(SegmentRecord)) !=
+            chunk * sizeof(SegmentRecord)) {
+            break;
+        }
+        remaining -= chunk;
+
+        for (size_t i = 0; i < chunk; ++i) {
+            uint64_t time_ms = header.base_time_ms + records[i].offset_ms;
+            if (time_ms < from_ms) {
+                continue;
+            }
+
+            // Times only increase, so nothing later can match either
+            if (time_ms > to_ms) {
+                stop = true;
+                return delivered;
+            }
+
+            delivered++;
+            if (!callback(time_ms, decodeRecord(records[i], time_ms, header.reference_voltage))) {
+                stop = true;
+                return delivered;
+            }
+        }
+    }
+
+    return delivered;
+}
+
+bool SegmentDataStorage::readSealedIndex(File& file, SegmentFooter& footer, SegmentIndexEntry* index) const {
+    size_t size = file.size();
+    if (size < sizeof(SegmentHeader) + sizeof(SegmentFooter) ||
+        !file.seek(size - sizeof(SegmentFooter)) ||
+        file.read(reinterpret_cast<uint8_t*>(&footer), sizeof(footer)) != sizeof(footer) ||
+        footer.magic != SEGMENT_FOOTER_MAGIC || footer.index_count > MAX_SEGMENT_INDEX_ENTRIES) {
+        return false;
+    }
+
+    size_t index_bytes = footer.index_count * sizeof(SegmentIndexEntry);
+    if (size < sizeof(SegmentHeader) + sizeof(SegmentFooter) + index_bytes) {
+        return false;
+    }
+
+    return file.seek(size - sizeof(SegmentFooter) - index_bytes) &&
+           file.read(reinterpret_cast<uint8_t*>(index), index_bytes) == index_bytes;
+}
+
+void SegmentDataStorage::manifestPath(char* buffer, size_t buffer_size, bool temporary) const {
+    snprintf(buffer, buffer_size, "%s/manifest.%s", config_.log_file_path, temporary ? "tmp" : "dat");
+}
+
+SegmentRecord SegmentDataStorage::encodeRecord(const SensorReading& reading, uint64_t offset_ms) const {
+    // Same quantisation as BinaryLogRecord
+    float raw = reading.raw_value < 0.0f ? 0.0f : (reading.raw_value > 1.0f ? 1.0f : reading.raw_value);
+    float lux = reading.lux_value < 0.0f ? 0.0f : reading.lux_value / BINARY_LUX_SCALE;
+
+    SegmentRecord record;
+    record.offset_ms = static_cast<uint32_t>(offset_ms);
+    record.raw_code = static_cast<uint16_t>(lroundf(raw * 65535.0f));
+    record.lux = lux >= 4294967295.0f ? 0xFFFFFFFFu : static_cast<uint32_t>(lux + 0.5f);
+    record.quality = reading.quality;
+    return record;
+}
+
+SensorReading SegmentDataStorage::decodeRecord(const SegmentRecord& record, uint64_t time_ms,
+                                               float reference_voltage) {
+    SensorReading reading;
+    reading.timestamp_ms = static_cast<uint32_t>(time_ms);
+    reading.raw_value = record.raw_code / 65535.0f;
+    reading.raw_q16 = record.raw_code;
+    reading.lux_value = record.lux * BINARY_LUX_SCALE;
+    reading.voltage = reading.raw_value * reference_voltage;
+    reading.is_valid = true;
+    reading.quality = record.quality;
+    return reading;
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,39 @@
+#include "log_clock.h"
+#include <Arduino.h>
+#include <sys/time.h>
+
+namespace LightSensor {
+
+LogClock& LogClock::getInstance() {
+    static LogClock instance;
+    return instance;
+}
+
+LogClock::LogClock() : offset_ms_(0) {
+}
+
+uint64_t LogClock::nowMs() const {
+    return systemTimeMs() + offset_ms_.load();
+}
+
+uint64_t LogClock::fromMillis(uint32_t timestamp_ms) const {
+    // Age relative to millis() carries over to the 64-bit clock (wrap-safe)
+    uint64_t now_ms = nowMs();
+    uint32_t age_ms = millis() - timestamp_ms;
+    return now_ms > age_ms ? now_ms - age_ms : 0;
+}
+
+void LogClock::advancePast(uint64_t time_ms) {
+    uint64_t now_ms = nowMs();
+    if (now_ms <= time_ms) {
+        offset_ms_ += time_ms + 1 - now_ms;
+    }
+}
+
+uint64_t LogClock::systemTimeMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000ULL + tv.tv_usec / 1000;
+}
+
+}  // namespace LightSensor
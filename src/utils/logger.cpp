@@ -1,17 +1,27 @@
 #include "logger.h"
 #include <Arduino.h>
 #include <SPIFFS.h>
+#include <cstdio>
 
 namespace LightSensor {
 
+static_assert((Logger::ASYNC_BUFFER_SIZE & (Logger::ASYNC_BUFFER_SIZE - 1)) == 0,
+              "Logger::ASYNC_BUFFER_SIZE must be a power of two");
+
+static const uint32_t WRITER_STACK_SIZE = 4096;
+
 Logger& Logger::getInstance() {
     static Logger instance;
     return instance;
 }
 
-Logger::Logger() 
-    : level_(LogLevel::INFO), output_(LogOutput::SERIAL), 
-      file_is_open_(false) {
+Logger::Logger()
+    : level_(LogLevel::INFO), output_(LogOutput::SERIAL),
+      file_is_open_(false), last_file_flush_ms_(0), file_dirty_(false),
+      ring_head_(0), ring_tail_(0), ring_lock_(portMUX_INITIALIZER_UNLOCKED),
+      dropped_count_(0), writer_task_(nullptr), async_(false),
+      writer_stop_(false), writer_running_(false), writer_busy_(false),
+      active_producers_(0), batch_length_(0) {
 }
 
 void Logger::setLevel(LogLevel level) {
@@ -27,32 +37,12 @@ void Logger::log(LogLevel level, const char* message) {
         return;
     }
     
-    char formatted_message[256];
-    formatMessage(level, message, formatted_message, sizeof(formatted_message));
-    
-    switch (output_) {
-        case LogOutput::SERIAL:
-            Serial.println(formatted_message);
-            break;
-            
-        case LogOutput::FILE:
-            if (file_is_open_) {
-                log_file_.println(formatted_message);
-                log_file_.flush();
-            }
-            break;
-            
-        case LogOutput::BOTH:
-            Serial.println(formatted_message);
-            if (file_is_open_) {
-                log_file_.println(formatted_message);
-                log_file_.flush();
-            }
-            break;
-            
-        case LogOutput::NONE:
-            break;
+    if (async_.load(std::memory_order_acquire)) {
+        logf(level, "%s", message);
+        return;
     }
+    
+    writeMessage(level, millis(), message);
 }
 
 void Logger::debug(const char* message) {
@@ -75,10 +65,79 @@ void Logger::critical(const char* message) {
     log(LogLevel::CRITICAL, message);
 }
 
+bool Logger::startAsync(uint8_t core, uint8_t priority) {
+    if (async_.load()) {
+        return true;
+    }
+    
+    ring_head_.store(0);
+    ring_tail_.store(0);
+    batch_length_ = 0;
+    writer_stop_.store(false);
+    writer_running_.store(true);
+    
+    if (xTaskCreatePinnedToCore(writerTaskEntry, "log_writer", WRITER_STACK_SIZE, this,
+                                priority, &writer_task_, core) != pdPASS) {
+        writer_running_.store(false);
+        writer_task_ = nullptr;
+        return false;
+    }
+    
+    async_.store(true, std::memory_order_release);
+    return true;
+}
+
+void Logger::stopAsync() {
+    if (!async_.load()) {
+        return;
+    }
+    
+    // New messages go straight out; the writer drains what is queued. A
+    // producer that saw async_ set may still notify writer_task_, so the
+    // task outlives every one of them
+    async_.store(false);
+    while (active_producers_.load() != 0) {
+        vTaskDelay(1);
+    }
+    writer_stop_.store(true);
+    xTaskNotifyGive(writer_task_);
+    while (writer_running_.load()) {
+        vTaskDelay(1);
+    }
+    writer_task_ = nullptr;
+}
+
+void Logger::flush() {
+    active_producers_++;
+    if (async_.load()) {
+        xTaskNotifyGive(writer_task_);
+        while (ring_tail_.load(std::memory_order_acquire) != ring_head_.load(std::memory_order_acquire) ||
+               writer_busy_.load()) {
+            vTaskDelay(1);
+        }
+        active_producers_--;
+        return;
+    }
+    active_producers_--;
+    
+    if (file_is_open_) {
+        flushFileIfDue(true);
+    }
+}
+
+bool Logger::isAsync() const {
+    return async_.load();
+}
+
+uint32_t Logger::getDroppedCount() const {
+    return dropped_count_.load();
+}
+
 bool Logger::setLogFile(const char* filename) {
     if (file_is_open_) {
         log_file_.close();
         file_is_open_ = false;
+        file_dirty_ = false;
     }
     
     // Initialize SPIFFS if not already done
@@ -102,14 +161,303 @@ void Logger::closeLogFile() {
     if (file_is_open_) {
         log_file_.close();
         file_is_open_ = false;
+        file_dirty_ = false;
+    }
+}
+
+void Logger::enqueue(LogLevel level, const char* format, const PackedArgs& args) {
+    // Counted before async_ is re-read: either stopAsync() sees this producer
+    // and waits, or this producer sees async_ cleared and the writer may be gone
+    active_producers_++;
+    if (!async_.load()) {
+        active_producers_--;
+        dropped_count_++;
+        return;
+    }
+    
+    enqueueRecord(level, format, args);
+    active_producers_--;
+}
+
+void Logger::enqueueRecord(LogLevel level, const char* format, const PackedArgs& args) {
+    RecordHeader header;
+    header.format = format;
+    header.timestamp_ms = millis();
+    header.level = static_cast<uint8_t>(level);
+    header.arg_count = args.count;
+    
+    uint32_t values[MAX_ARGS];
+    size_t size = sizeof(RecordHeader) + args.count * sizeof(uint32_t);
+    for (uint8_t i = 0; i < args.count; ++i) {
+        header.types[i] = args.types[i];
+        values[i] = args.values[i];
+        if (args.types[i] == ArgType::STRING) {
+            values[i] = strnlen(args.strings[i], MAX_STRING_ARG_LEN - 1) + 1;
+            size += values[i];
+        }
+    }
+    header.size = static_cast<uint16_t>(size);
+    
+    portENTER_CRITICAL(&ring_lock_);
+    uint32_t head = ring_head_.load(std::memory_order_relaxed);
+    uint32_t tail = ring_tail_.load(std::memory_order_acquire);
+    bool fits = head - tail + size <= ASYNC_BUFFER_SIZE;
+    if (fits) {
+        uint32_t position = head;
+        copyIn(position, &header, sizeof(header));
+        position += sizeof(header);
+        copyIn(position, values, args.count * sizeof(uint32_t));
+        position += args.count * sizeof(uint32_t);
+        
+        for (uint8_t i = 0; i < args.count; ++i) {
+            if (args.types[i] == ArgType::STRING) {
+                copyIn(position, args.strings[i], values[i] - 1);
+                copyIn(position + values[i] - 1, "", 1);
+                position += values[i];
+            }
+        }
+        ring_head_.store(head + size, std::memory_order_release);
+    }
+    portEXIT_CRITICAL(&ring_lock_);
+    
+    if (!fits) {
+        dropped_count_++;
+        return;
+    }
+    
+    // The writer drains until empty, so only a record into an empty ring needs a wake-up
+    if (head == tail) {
+        xTaskNotifyGive(writer_task_);
     }
+    
+    if (level == LogLevel::CRITICAL) {
+        flush();  // Get it out before a likely reset
+    }
+}
+
+void Logger::writeMessage(LogLevel level, uint32_t timestamp_ms, const char* message) {
+    char formatted_message[256];
+    formatMessage(level, timestamp_ms, message, formatted_message, sizeof(formatted_message));
+    
+    size_t length = strlen(formatted_message);
+    if (length < sizeof(formatted_message) - 1) {
+        formatted_message[length++] = '\n';
+        formatted_message[length] = '\0';
+    }
+    
+    // Synchronous logging has no writer task to flush later; every message is committed
+    writeOut(formatted_message, length, true);
+}
+
+void Logger::writeOut(const char* text, size_t length, bool force_file_flush) {
+    bool to_serial = output_ == LogOutput::SERIAL || output_ == LogOutput::BOTH;
+    bool to_file = (output_ == LogOutput::FILE || output_ == LogOutput::BOTH) && file_is_open_;
+    
+    if (to_serial) {
+        Serial.write(reinterpret_cast<const uint8_t*>(text), length);
+    }
+    
+    if (to_file) {
+        log_file_.write(reinterpret_cast<const uint8_t*>(text), length);
+        file_dirty_ = true;
+        flushFileIfDue(force_file_flush);
+    }
+}
+
+void Logger::flushFileIfDue(bool force) {
+    // Flushing commits a flash page; do it on errors and at most once a second otherwise
+    uint32_t now = millis();
+    if (file_dirty_ && (force || now - last_file_flush_ms_ >= FILE_FLUSH_INTERVAL_MS)) {
+        log_file_.flush();
+        last_file_flush_ms_ = now;
+        file_dirty_ = false;
+    }
+}
+
+void Logger::writerTaskEntry(void* arg) {
+    static_cast<Logger*>(arg)->writerTaskLoop();
+}
+
+void Logger::writerTaskLoop() {
+    while (true) {
+        writer_busy_.store(true);
+        while (readRecord()) {
+            const RecordHeader* header = reinterpret_cast<const RecordHeader*>(record_);
+            char message[MAX_LINE_LEN];
+            formatRecord(message, sizeof(message));
+            appendToBatch(static_cast<LogLevel>(header->level), header->timestamp_ms, message);
+        }
+        flushBatch();
+        
+        // A quiet log still gets its last lines committed within the interval
+        if (file_is_open_) {
+            flushFileIfDue(false);
+        }
+        writer_busy_.store(false);
+        
+        if (writer_stop_.load()) {
+            break;
+        }
+        
+        // Periodic wake keeps the file flush interval when the log is quiet
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FILE_FLUSH_INTERVAL_MS));
+    }
+    
+    writer_running_.store(false);
+    vTaskDelete(nullptr);
+}
+
+bool Logger::readRecord() {
+    uint32_t tail = ring_tail_.load(std::memory_order_relaxed);
+    if (tail == ring_head_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    
+    RecordHeader header;
+    copyOut(tail, &header, sizeof(header));
+    copyOut(tail, record_, header.size <= MAX_RECORD_SIZE ? header.size : MAX_RECORD_SIZE);
+    ring_tail_.store(tail + header.size, std::memory_order_release);
+    return true;
+}
+
+void Logger::formatRecord(char* buffer, size_t buffer_size) const {
+    const RecordHeader* header = reinterpret_cast<const RecordHeader*>(record_);
+    const uint8_t* values = record_ + sizeof(RecordHeader);
+    const char* strings = reinterpret_cast<const char*>(values + header->arg_count * sizeof(uint32_t));
+    
+    size_t length = 0;
+    uint8_t arg = 0;
+    const char* p = header->format;
+    
+    while (*p && length < buffer_size - 1) {
+        if (*p != '%') {
+            buffer[length++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            buffer[length++] = '%';
+            p += 2;
+            continue;
+        }
+        
+        // Copy flags, width and precision; the length modifier is chosen from
+        // the recorded argument type instead of the format
+        char spec[16];
+        size_t spec_length = 0;
+        spec[spec_length++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && spec_length < sizeof(spec) - 3) {
+            spec[spec_length++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        if (!*p || arg >= header->arg_count) {
+            break;
+        }
+        char conversion = *p++;
+        
+        uint32_t value;
+        memcpy(&value, values + arg * sizeof(uint32_t), sizeof(value));
+        ArgType type = header->types[arg++];
+        
+        int written = 0;
+        switch (type) {
+            case ArgType::STRING:
+                spec[spec_length++] = 's';
+                spec[spec_length] = '\0';
+                written = snprintf(buffer + length, buffer_size - length, spec, strings);
+                strings += value;
+                break;
+            case ArgType::FLOAT: {
+                float number;
+                memcpy(&number, &value, sizeof(number));
+                spec[spec_length++] = strchr("fFeEgGaA", conversion) ? conversion : 'f';
+                spec[spec_length] = '\0';
+                written = snprintf(buffer + length, buffer_size - length, spec, static_cast<double>(number));
+                break;
+            }
+            case ArgType::INT:
+            case ArgType::UINT:
+                if (conversion == 'c') {
+                    spec[spec_length++] = 'c';
+                    spec[spec_length] = '\0';
+                    written = snprintf(buffer + length, buffer_size - length, spec, static_cast<int>(value));
+                } else if (type == ArgType::INT && (conversion == 'd' || conversion == 'i')) {
+                    spec[spec_length++] = 'l';
+                    spec[spec_length++] = 'd';
+                    spec[spec_length] = '\0';
+                    written = snprintf(buffer + length, buffer_size - length, spec,
+                                       static_cast<long>(static_cast<int32_t>(value)));
+                } else {
+                    spec[spec_length++] = 'l';
+                    spec[spec_length++] = strchr("ouxX", conversion) ? conversion : 'u';
+                    spec[spec_length] = '\0';
+                    written = snprintf(buffer + length, buffer_size - length, spec,
+                                       static_cast<unsigned long>(value));
+                }
+                break;
+        }
+        
+        if (written < 0) {
+            break;
+        }
+        length += static_cast<size_t>(written);
+        if (length >= buffer_size - 1) {
+            length = buffer_size - 1;
+            break;
+        }
+    }
+    
+    buffer[length] = '\0';
+}
+
+void Logger::appendToBatch(LogLevel level, uint32_t timestamp_ms, const char* message) {
+    char line[MAX_LINE_LEN + 32];
+    formatMessage(level, timestamp_ms, message, line, sizeof(line) - 1);
+    size_t length = strlen(line);
+    line[length++] = '\n';
+    
+    if (batch_length_ + length > BATCH_SIZE) {
+        flushBatch();
+    }
+    memcpy(batch_ + batch_length_, line, length);
+    batch_length_ += length;
+    
+    if (level >= LogLevel::ERROR) {
+        flushBatch(true);
+    }
+}
+
+void Logger::flushBatch(bool force_file_flush) {
+    if (batch_length_ == 0) {
+        return;
+    }
+    
+    writeOut(batch_, batch_length_, force_file_flush);
+    batch_length_ = 0;
+}
+
+void Logger::copyIn(uint32_t position, const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t offset = position & (ASYNC_BUFFER_SIZE - 1);
+    size_t first = length < ASYNC_BUFFER_SIZE - offset ? length : ASYNC_BUFFER_SIZE - offset;
+    memcpy(ring_ + offset, bytes, first);
+    memcpy(ring_, bytes + first, length - first);
+}
+
+void Logger::copyOut(uint32_t position, void* data, size_t length) const {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    size_t offset = position & (ASYNC_BUFFER_SIZE - 1);
+    size_t first = length < ASYNC_BUFFER_SIZE - offset ? length : ASYNC_BUFFER_SIZE - offset;
+    memcpy(bytes, ring_ + offset, first);
+    memcpy(bytes + first, ring_, length - first);
 }
 
-void Logger::formatMessage(LogLevel level, const char* message, char* buffer, size_t buffer_size) const {
-    uint32_t timestamp = millis();
+void Logger::formatMessage(LogLevel level, uint32_t timestamp_ms, const char* message,
+                           char* buffer, size_t buffer_size) const {
     const char* level_str = levelToString(level);
     
-    snprintf(buffer, buffer_size, "[%lu] [%s] %s", timestamp, level_str, message);
+    snprintf(buffer, buffer_size, "[%lu] [%s] %s", timestamp_ms, level_str, message);
 }
 
 const char* Logger::levelToString(LogLevel level) const {
@@ -0,0 +1,75 @@
+#include "memory_report.h"
+#include "logger.h"
+#include <esp_heap_caps.h>
+
+namespace LightSensor {
+
+MemoryReport& MemoryReport::getInstance() {
+    static MemoryReport instance;
+    return instance;
+}
+
+MemoryReport::MemoryReport()
+    : section_count_(0), arena_count_(0), internal_free_(0), psram_free_(0), is_open_(false) {
+}
+
+void MemoryReport::begin(const char* name, size_t static_bytes) {
+    if (is_open_ || section_count_ >= MAX_SECTIONS) {
+        return;
+    }
+
+    sections_[section_count_].name = name;
+    sections_[section_count_].static_bytes = static_bytes;
+    internal_free_ = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    psram_free_ = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    is_open_ = true;
+}
+
+void MemoryReport::end() {
+    if (!is_open_) {
+        return;
+    }
+
+    Section& section = sections_[section_count_++];
+    section.internal_bytes = static_cast<int32_t>(internal_free_) -
+                             static_cast<int32_t>(heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    section.psram_bytes = static_cast<int32_t>(psram_free_) -
+                          static_cast<int32_t>(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    is_open_ = false;
+}
+
+void MemoryReport::addArena(const char* name, const StaticArena& arena) {
+    if (arena_count_ < MAX_ARENAS) {
+        arenas_[arena_count_++] = {name, &arena};
+    }
+}
+
+void MemoryReport::print() const {
+    size_t static_total = 0;
+    int32_t heap_total = 0;
+
+    for (size_t i = 0; i < section_count_; ++i) {
+        const Section& section = sections_[i];
+        LS_LOG_INFO("Memory %-8s static %6u B, heap %6ld B, PSRAM %7ld B", section.name,
+                    static_cast<unsigned>(section.static_bytes), section.internal_bytes,
+                    section.psram_bytes);
+        static_total += section.static_bytes;
+        heap_total += section.internal_bytes;
+    }
+
+    for (size_t i = 0; i < arena_count_; ++i) {
+        const StaticArena& arena = *arenas_[i].arena;
+        LS_LOG_INFO("Arena  %-8s peak %6u of %6u B, %lu overflows to heap", arenas_[i].name,
+                    static_cast<unsigned>(arena.getPeak()), static_cast<unsigned>(arena.getCapacity()),
+                    arena.getFailureCount());
+        static_total += arena.getCapacity();
+    }
+
+    LS_LOG_INFO("Memory total static %u B, heap %ld B; free %u B (largest %u B, minimum %u B)",
+                static_cast<unsigned>(static_total), heap_total,
+                static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
+                static_cast<unsigned>(heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
+                static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)));
+}
+
+}  // namespace LightSensor
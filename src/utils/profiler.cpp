@@ -0,0 +1,146 @@
+#include "profiler.h"
+#include <Arduino.h>
+
+namespace LightSensor {
+
+static const char* const PROBE_NAMES[PROFILE_PROBE_COUNT] = {
+    "sensor_read",
+    "signal_process",
+    "signal_process_block",
+    "logger_flush",
+    "storage_write",
+    "storage_write_batch",
+    "config_load",
+    "spectral_analysis"
+};
+
+Profiler& Profiler::getInstance() {
+    static Profiler instance;
+    return instance;
+}
+
+Profiler::Profiler() : lock_(portMUX_INITIALIZER_UNLOCKED) {
+    reset();
+}
+
+void Profiler::record(ProfileProbe probe, uint32_t cycles) {
+    size_t index = static_cast<size_t>(probe);
+    if (index >= PROFILE_PROBE_COUNT) {
+        return;
+    }
+
+    size_t bucket = bucketIndex(cycles);
+
+    portENTER_CRITICAL(&lock_);
+    ProbeData& data = probes_[index];
+    data.count++;
+    data.total_cycles += cycles;
+    if (cycles < data.min_cycles) {
+        data.min_cycles = cycles;
+    }
+    if (cycles > data.max_cycles) {
+        data.max_cycles = cycles;
+    }
+    data.histogram[bucket]++;
+    portEXIT_CRITICAL(&lock_);
+}
+
+ProfileStats Profiler::getStats(ProfileProbe probe) const {
+    ProfileStats stats = {0, 0, 0, 0, 0};
+    size_t index = static_cast<size_t>(probe);
+    if (index >= PROFILE_PROBE_COUNT) {
+        return stats;
+    }
+
+    // Copy under the lock so the summary is consistent
+    ProbeData snapshot;
+    portENTER_CRITICAL(&lock_);
+    snapshot = probes_[index];
+    portEXIT_CRITICAL(&lock_);
+
+    if (snapshot.count == 0) {
+        return stats;
+    }
+
+    stats.count = snapshot.count;
+    stats.min_cycles = snapshot.min_cycles;
+    stats.max_cycles = snapshot.max_cycles;
+    stats.mean_cycles = static_cast<uint32_t>(snapshot.total_cycles / snapshot.count);
+
+    // Smallest bucket whose cumulative count reaches 99%
+    uint32_t target = snapshot.count - snapshot.count / 100;
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        cumulative += snapshot.histogram[i];
+        if (cumulative >= target) {
+            uint32_t upper = bucketUpperBound(i);
+            stats.p99_cycles = upper < snapshot.max_cycles ? upper : snapshot.max_cycles;
+            break;
+        }
+    }
+
+    return stats;
+}
+
+void Profiler::reset() {
+    portENTER_CRITICAL(&lock_);
+    for (size_t i = 0; i < PROFILE_PROBE_COUNT; ++i) {
+        probes_[i].count = 0;
+        probes_[i].min_cycles = UINT32_MAX;
+        probes_[i].max_cycles = 0;
+        probes_[i].total_cycles = 0;
+        memset(probes_[i].histogram, 0, sizeof(probes_[i].histogram));
+    }
+    portEXIT_CRITICAL(&lock_);
+}
+
+void Profiler::dump() const {
+    uint32_t cpu_mhz = getCpuFrequencyMhz();
+
+    for (size_t i = 0; i < PROFILE_PROBE_COUNT; ++i) {
+        ProfileProbe probe = static_cast<ProfileProbe>(i);
+        ProfileStats stats = getStats(probe);
+        if (stats.count == 0) {
+            continue;
+        }
+
+        Serial.printf("profile,%s,%lu,%lu,%lu,%lu,%lu,%lu\n", probeName(probe),
+                      static_cast<unsigned long>(stats.count),
+                      static_cast<unsigned long>(stats.min_cycles),
+                      static_cast<unsigned long>(stats.mean_cycles),
+                      static_cast<unsigned long>(stats.p99_cycles),
+                      static_cast<unsigned long>(stats.max_cycles),
+                      static_cast<unsigned long>(cpu_mhz));
+    }
+}
+
+const char* Profiler::probeName(ProfileProbe probe) {
+    size_t index = static_cast<size_t>(probe);
+    return index < PROFILE_PROBE_COUNT ? PROBE_NAMES[index] : "unknown";
+}
+
+size_t Profiler::bucketIndex(uint32_t cycles) {
+    // Values below 2^SUB_BUCKET_BITS get a bucket each; above that every
+    // power of two is split into 2^SUB_BUCKET_BITS equal buckets
+    if (cycles < (1U << SUB_BUCKET_BITS)) {
+        return cycles;
+    }
+
+    uint32_t exponent = 31 - __builtin_clz(cycles);
+    uint32_t sub_bucket = (cycles >> (exponent - SUB_BUCKET_BITS)) & ((1U << SUB_BUCKET_BITS) - 1);
+    return ((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub_bucket;
+}
+
+uint32_t Profiler::bucketUpperBound(size_t index) {
+    if (index < (1U << SUB_BUCKET_BITS)) {
+        return static_cast<uint32_t>(index);
+    }
+
+    uint32_t exponent = static_cast<uint32_t>(index >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+    uint32_t sub_bucket = index & ((1U << SUB_BUCKET_BITS) - 1);
+    uint32_t width = 1U << (exponent - SUB_BUCKET_BITS);
+    uint32_t lower = ((1U << SUB_BUCKET_BITS) + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+    return lower + (width - 1);
+}
+
+}  // namespace LightSensor
@@ -0,0 +1,46 @@
+#include "static_arena.h"
+
+namespace LightSensor {
+
+StaticArena::StaticArena(void* buffer, size_t size)
+    : buffer_(static_cast<uint8_t*>(buffer)), size_(size), used_(0), last_(0), peak_(0), failures_(0) {
+}
+
+void* StaticArena::allocate(size_t bytes) {
+    size_t offset = (used_ + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (offset > size_ || bytes > size_ - offset) {
+        failures_++;
+        return nullptr;
+    }
+
+    last_ = offset;
+    used_ = offset + bytes;
+    peak_ = used_ > peak_ ? used_ : peak_;
+    return buffer_ + offset;
+}
+
+bool StaticArena::resize(void* block, size_t bytes) {
+    if (static_cast<uint8_t*>(block) != buffer_ + last_ || last_ >= used_ || bytes > size_ - last_) {
+        return false;
+    }
+
+    used_ = last_ + bytes;
+    peak_ = used_ > peak_ ? used_ : peak_;
+    return true;
+}
+
+bool StaticArena::owns(const void* pointer) const {
+    const uint8_t* byte = static_cast<const uint8_t*>(pointer);
+    return byte >= buffer_ && byte < buffer_ + size_;
+}
+
+void StaticArena::release(size_t mark) {
+    if (mark < used_) {
+        used_ = mark;
+    }
+
+    // The block before the mark can no longer be told apart, so none is resizable
+    last_ = used_;
+}
+
+}  // namespace LightSensor
@@ -10,6 +10,7 @@ Timer::Timer() {
 void Timer::reset() {
     start_time_ms_ = millis();
     start_time_us_ = micros();
+    start_cycles_ = cycleCount();
 }
 
 uint32_t Timer::elapsedMs() const {
@@ -28,4 +29,12 @@ bool Timer::hasElapsed(uint32_t timeout_ms) const {
     return elapsedMs() >= timeout_ms;
 }
 
+uint32_t Timer::elapsedCycles() const {
+    return cycleCount() - start_cycles_;
+}
+
+uint32_t Timer::cycleCount() {
+    return ESP.getCycleCount();
+}
+
 }  // namespace LightSensor
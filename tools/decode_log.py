@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Decode binary light sensor logs (sensor_<millis>.bin) to CSV.
+
+Usage:
+    python3 tools/decode_log.py sensor_12345.bin [more.bin ...] > readings.csv
+
+The output matches the on-device CSV format:
+    timestamp_ms,raw_value,lux_value,voltage,quality
+"""
+
+import struct
+import sys
+
+MAGIC = 0x4C42534C  # "LSBL"
+HEADER = struct.Struct("<IHHHHIffff")
+RECORD = struct.Struct("<HHIB")
+SYNC_DELTA = 0xFFFF
+FLAG_COMPRESSED = 0x0001
+BLOCK_FRAME = struct.Struct("<HH")
+
+
+def read_header(data):
+    if len(data) < HEADER.size:
+        raise ValueError("file too short for header")
+    (magic, version, header_size, record_size, flags, base_ts,
+     lux_scale, reference_voltage, dark_offset, sensitivity) = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError("bad magic 0x%08x" % magic)
+    return {
+        "version": version,
+        "header_size": header_size,
+        "record_size": record_size,
+        "flags": flags,
+        "base_timestamp_ms": base_ts,
+        "lux_scale": lux_scale,
+        "reference_voltage": reference_voltage,
+        "dark_offset": dark_offset,
+        "sensitivity": sensitivity,
+    }
+
+
+def decode_records(data, header):
+    """Yield (timestamp_ms, raw_value, lux_value, voltage, quality) tuples."""
+    offset = header["header_size"]
+    record_size = header["record_size"]
+    timestamp = header["base_timestamp_ms"]
+    while offset + record_size <= len(data):
+        delta, raw_code, lux, quality = RECORD.unpack_from(data, offset)
+        offset += record_size
+        if delta == SYNC_DELTA:
+            timestamp = lux
+            continue
+        timestamp = (timestamp + delta) & 0xFFFFFFFF
+        raw = raw_code / 65535.0
+        yield (timestamp, raw, lux * header["lux_scale"],
+               raw * header["reference_voltage"], quality)
+
+
+class BitReader:
+    """MSB-first bit reader matching the firmware BitReader."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, bits):
+        value = 0
+        for _ in range(bits):
+            if self.pos >= len(self.data) * 8:
+                raise ValueError("truncated compressed block")
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+
+def zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def read_bucket(reader, widths):
+    """Read a unary-prefixed value: '0' is zero, then one '1' per bucket."""
+    for i, width in enumerate(widths):
+        if i == len(widths) - 1 or not reader.read(1):
+            return zigzag_decode(reader.read(width))
+    return 0
+
+
+def decode_block(payload, count, reference_voltage):
+    reader = BitReader(payload)
+    ts = reader.read(32)
+    raw = reader.read(16)
+    lux = reader.read(32)
+    quality = reader.read(8)
+    delta = 0
+    leading = trailing = 0
+    for i in range(count):
+        if i > 0:
+            if reader.read(1):
+                delta += read_bucket(reader, (7, 9, 12, 32))
+            ts = (ts + delta) & 0xFFFFFFFF
+
+            if reader.read(1):
+                if reader.read(1):
+                    leading = reader.read(5)
+                    bits = reader.read(6)
+                    trailing = 32 - leading - bits
+                lux ^= reader.read(32 - leading - trailing) << trailing
+
+            if reader.read(1):
+                raw = (raw + read_bucket(reader, (5, 8, 16))) & 0xFFFF
+
+            if reader.read(1):
+                quality = reader.read(8)
+
+        raw_value = raw / 65535.0
+        lux_value = struct.unpack("<f", struct.pack("<I", lux))[0]
+        yield (ts, raw_value, lux_value, raw_value * reference_voltage, quality)
+
+
+def decode_compressed(data, header):
+    """Yield readings from a file of BlockCompressor frames."""
+    offset = header["header_size"]
+    while offset + BLOCK_FRAME.size <= len(data):
+        payload_size, count = BLOCK_FRAME.unpack_from(data, offset)
+        offset += BLOCK_FRAME.size
+        payload = data[offset:offset + payload_size]
+        offset += payload_size
+        if len(payload) < payload_size:
+            sys.stderr.write("warning: truncated final block\n")
+            return
+        for reading in decode_block(payload, count, header["reference_voltage"]):
+            yield reading
+
+
+def decode_file(path, out):
+    with open(path, "rb") as f:
+        data = f.read()
+    header = read_header(data)
+    out.write("# %s: v%d, reference_voltage=%.3f, dark_offset=%.6f, sensitivity=%.6f\n" % (
+        path, header["version"], header["reference_voltage"],
+        header["dark_offset"], header["sensitivity"]))
+    if header["flags"] & FLAG_COMPRESSED:
+        readings = decode_compressed(data, header)
+    else:
+        readings = decode_records(data, header)
+    for ts, raw, lux, voltage, quality in readings:
+        out.write("%u,%.6f,%.6f,%.6f,%u\n" % (ts, raw, lux, voltage, quality))
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    out = sys.stdout
+    out.write("timestamp_ms,raw_value,lux_value,voltage,quality\n")
+    for path in argv[1:]:
+        decode_file(path, out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))